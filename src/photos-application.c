@@ -46,6 +46,7 @@
 #include "photos-create-collection-job.h"
 #include "photos-debug.h"
 #include "photos-dlna-renderers-dialog.h"
+#include "photos-export-batch.h"
 #include "photos-export-dialog.h"
 #include "photos-export-notification.h"
 #include "photos-filterable.h"
@@ -180,6 +181,7 @@ typedef struct _PhotosApplicationImportData PhotosApplicationImportData;
 typedef struct _PhotosApplicationImportCopiedData PhotosApplicationImportCopiedData;
 typedef struct _PhotosApplicationImportWaitForFileData PhotosApplicationImportWaitForFileData;
 typedef struct _PhotosApplicationRefreshData PhotosApplicationRefreshData;
+typedef struct _PhotosApplicationSaveData PhotosApplicationSaveData;
 
 struct _PhotosApplicationCreateData
 {
@@ -205,6 +207,13 @@ struct _PhotosApplicationRefreshData
   GomMiner *miner;
 };
 
+struct _PhotosApplicationSaveData
+{
+  PhotosApplication *application;
+  GFile *export_dir;
+  PhotosExportNotification *notification;
+};
+
 static void photos_application_import_file_copy (GObject *source_object, GAsyncResult *res, gpointer user_data);
 static void photos_application_refresh_miner_now (PhotosApplication *self, GomMiner *miner);
 static void photos_application_start_miners (PhotosApplication *self);
@@ -298,6 +307,32 @@ photos_application_refresh_data_free (PhotosApplicationRefreshData *data)
 }
 
 
+static PhotosApplicationSaveData *
+photos_application_save_data_new (PhotosApplication *application,
+                                  GFile *export_dir,
+                                  PhotosExportNotification *notification)
+{
+  PhotosApplicationSaveData *data;
+
+  data = g_slice_new0 (PhotosApplicationSaveData);
+  g_application_hold (G_APPLICATION (application));
+  data->application = application;
+  data->export_dir = g_object_ref (export_dir);
+  data->notification = g_object_ref (notification);
+  return data;
+}
+
+
+static void
+photos_application_save_data_free (PhotosApplicationSaveData *data)
+{
+  g_application_release (G_APPLICATION (data->application));
+  g_object_unref (data->export_dir);
+  g_object_unref (data->notification);
+  g_slice_free (PhotosApplicationSaveData, data);
+}
+
+
 static void
 photos_application_help (PhotosApplication *self)
 {
@@ -344,6 +379,44 @@ photos_application_get_selection_or_active_item (PhotosApplication *self)
 }
 
 
+static GList *
+photos_application_get_selection_or_active_items (PhotosApplication *self)
+{
+  GList *items = NULL;
+
+  if (photos_utils_get_selection_mode ())
+    {
+      GList *l;
+      GList *selection;
+
+      selection = photos_selection_controller_get_selection (self->sel_cntrlr);
+      for (l = selection; l != NULL; l = l->next)
+        {
+          PhotosBaseItem *item;
+          const gchar *urn = (gchar *) l->data;
+
+          item = PHOTOS_BASE_ITEM (photos_base_manager_get_object_by_id (self->state->item_mngr, urn));
+          if (item == NULL)
+            continue;
+
+          items = g_list_prepend (items, g_object_ref (item));
+        }
+
+      items = g_list_reverse (items);
+    }
+  else
+    {
+      PhotosBaseItem *item;
+
+      item = PHOTOS_BASE_ITEM (photos_base_manager_get_active_object (self->state->item_mngr));
+      if (item != NULL)
+        items = g_list_prepend (items, g_object_ref (item));
+    }
+
+  return items;
+}
+
+
 static void
 photos_application_actions_update (PhotosApplication *self)
 {
@@ -352,6 +425,7 @@ photos_application_actions_update (PhotosApplication *self)
   GList *selection;
   PhotosLoadState load_state;
   PhotosWindowMode mode;
+  gboolean can_export;
   gboolean can_open;
   gboolean can_trash;
   gboolean enable;
@@ -505,13 +579,13 @@ photos_application_actions_update (PhotosApplication *self)
   enable = ((load_state == PHOTOS_LOAD_STATE_FINISHED && mode == PHOTOS_WINDOW_MODE_PREVIEW)
             || (selection_mode && item != NULL && !photos_base_item_is_collection (item)));
   g_simple_action_set_enabled (self->print_action, enable);
-  g_simple_action_set_enabled (self->save_action, enable);
 
   enable = (item != NULL
             && ((load_state == PHOTOS_LOAD_STATE_FINISHED && mode == PHOTOS_WINDOW_MODE_PREVIEW) || selection_mode)
             && photos_share_point_manager_can_share (PHOTOS_SHARE_POINT_MANAGER (self->shr_pnt_mngr), item));
   g_simple_action_set_enabled (self->share_action, enable);
 
+  can_export = selection != NULL;
   can_open = FALSE;
   can_trash = selection != NULL;
   for (l = selection; l != NULL; l = l->next)
@@ -526,6 +600,7 @@ photos_application_actions_update (PhotosApplication *self)
       if (selected_item == NULL)
         continue;
 
+      can_export = can_export && !photos_base_item_is_collection (selected_item);
       can_trash = can_trash && photos_base_item_can_trash (selected_item);
 
       if (photos_base_item_get_default_app_name (selected_item) != NULL)
@@ -542,6 +617,10 @@ photos_application_actions_update (PhotosApplication *self)
             || (selection_mode && can_open));
   g_simple_action_set_enabled (self->open_action, enable);
 
+  enable = ((load_state == PHOTOS_LOAD_STATE_FINISHED && mode == PHOTOS_WINDOW_MODE_PREVIEW)
+            || (selection_mode && can_export));
+  g_simple_action_set_enabled (self->save_action, enable);
+
   enable = (load_state == PHOTOS_LOAD_STATE_FINISHED
             && mode == PHOTOS_WINDOW_MODE_PREVIEW
             && photos_base_item_can_edit (item));
@@ -1837,6 +1916,51 @@ photos_application_quit (PhotosApplication *self)
 }
 
 
+static void
+photos_application_save_export_batch (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  PhotosApplicationSaveData *data = (PhotosApplicationSaveData *) user_data;
+  GList *exported = NULL;
+
+  gtk_widget_destroy (GTK_WIDGET (data->notification));
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    /* If some items failed, the error is all that is shown, so that the
+     * same batch doesn't get a success notification too. A cancelled
+     * batch still points to the items that were exported before it was
+     * stopped.
+     */
+    if (!photos_export_batch_finish (res, &exported, &error))
+      {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+          {
+            g_warning ("Unable to export: %s", error->message);
+            photos_export_notification_new_with_error (error);
+            goto out;
+          }
+      }
+  }
+
+  if (exported != NULL)
+    photos_export_notification_new (exported, data->export_dir);
+
+ out:
+  g_list_free_full (exported, g_object_unref);
+  photos_application_save_data_free (data);
+}
+
+
+static void
+photos_application_save_export_batch_progress (guint n_done, guint n_items, gpointer user_data)
+{
+  PhotosExportNotification *notification = PHOTOS_EXPORT_NOTIFICATION (user_data);
+
+  photos_export_notification_set_progress (notification, n_done);
+}
+
+
 static void
 photos_application_save_save_to_dir (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
@@ -1872,8 +1996,8 @@ photos_application_save_response (GtkDialog *dialog, gint response_id, gpointer
   PhotosApplication *self = PHOTOS_APPLICATION (user_data);
   g_autoptr (GFile) export_dir = NULL;
   g_autoptr (GFile) export_sub_dir = NULL;
+  GList *items = NULL;
   GVariant *new_state;
-  PhotosBaseItem *item;
   const gchar *export_dir_name;
   const gchar *pictures_path;
   g_autofree gchar *export_path = NULL;
@@ -1882,8 +2006,8 @@ photos_application_save_response (GtkDialog *dialog, gint response_id, gpointer
   if (response_id != GTK_RESPONSE_OK)
     goto out;
 
-  item = photos_application_get_selection_or_active_item (self);
-  g_return_if_fail (item != NULL);
+  items = photos_application_get_selection_or_active_items (self);
+  g_return_if_fail (items != NULL);
 
   new_state = g_variant_new ("b", FALSE);
   g_action_change_state (G_ACTION (self->selection_mode_action), new_state);
@@ -1918,27 +2042,69 @@ photos_application_save_response (GtkDialog *dialog, gint response_id, gpointer
 
   zoom = photos_export_dialog_get_zoom (PHOTOS_EXPORT_DIALOG (dialog));
 
-  g_application_hold (G_APPLICATION (self));
-  photos_base_item_save_to_dir_async (item, export_sub_dir, zoom, NULL, photos_application_save_save_to_dir, self);
+  if (items->next == NULL) /* length == 1 */
+    {
+      PhotosBaseItem *item = PHOTOS_BASE_ITEM (items->data);
+
+      g_application_hold (G_APPLICATION (self));
+      photos_base_item_save_to_dir_async (item, export_sub_dir, zoom, NULL, photos_application_save_save_to_dir, self);
+    }
+  else
+    {
+      g_autoptr (GCancellable) cancellable = NULL;
+      PhotosApplicationSaveData *data;
+      PhotosExportNotification *notification;
+      guint n_items;
+
+      cancellable = g_cancellable_new ();
+      n_items = g_list_length (items);
+      notification = photos_export_notification_new_with_progress (n_items, cancellable);
+      data = photos_application_save_data_new (self, export_sub_dir, notification);
+
+      photos_export_batch_async (items,
+                                 export_sub_dir,
+                                 zoom,
+                                 photos_application_save_export_batch_progress,
+                                 g_object_ref (notification),
+                                 g_object_unref,
+                                 cancellable,
+                                 photos_application_save_export_batch,
+                                 data);
+    }
 
  out:
   gtk_widget_destroy (GTK_WIDGET (dialog));
+  g_list_free_full (items, g_object_unref);
 }
 
 
 static void
 photos_application_save (PhotosApplication *self)
 {
+  GList *items = NULL;
+  GList *l;
   GtkWidget *dialog;
-  PhotosBaseItem *item;
 
-  item = photos_application_get_selection_or_active_item (self);
-  g_return_if_fail (item != NULL);
-  g_return_if_fail (!photos_base_item_is_collection (item));
+  items = photos_application_get_selection_or_active_items (self);
+  g_return_if_fail (items != NULL);
 
-  dialog = photos_export_dialog_new (GTK_WINDOW (self->main_window), item);
+  for (l = items; l != NULL; l = l->next)
+    {
+      PhotosBaseItem *item = PHOTOS_BASE_ITEM (l->data);
+
+      if (photos_base_item_is_collection (item))
+        {
+          g_warn_if_reached ();
+          goto out;
+        }
+    }
+
+  dialog = photos_export_dialog_new (GTK_WINDOW (self->main_window), items);
   gtk_widget_show_all (dialog);
   g_signal_connect (dialog, "response", G_CALLBACK (photos_application_save_response), self);
+
+ out:
+  g_list_free_full (items, g_object_unref);
 }
 
 static void
@@ -48,12 +48,14 @@
 #include "photos-glib.h"
 #include "photos-local-item.h"
 #include "photos-pipeline.h"
+#include "photos-pixbuf.h"
 #include "photos-print-notification.h"
 #include "photos-print-operation.h"
 #include "photos-quarks.h"
 #include "photos-query.h"
 #include "photos-search-context.h"
 #include "photos-single-item-job.h"
+#include "photos-thumbnail-queue.h"
 #include "photos-utils.h"
 
 
@@ -64,6 +66,7 @@ struct _PhotosBaseItemPrivate
   GCancellable *cancellable;
   GdkPixbuf *original_icon;
   GeglBuffer *preview_source_buffer;
+  GeglBuffer *proxy_source_buffer;
   GeglNode *buffer_source;
   GeglNode *edit_graph;
   GeglProcessor *processor;
@@ -135,6 +138,8 @@ G_DEFINE_ABSTRACT_TYPE_WITH_CODE (PhotosBaseItem, photos_base_item, G_TYPE_OBJEC
                                   G_IMPLEMENT_INTERFACE (PHOTOS_TYPE_FILTERABLE,
                                                          photos_base_item_filterable_iface_init));
 
+typedef struct _PhotosBaseItemCreateProxyData PhotosBaseItemCreateProxyData;
+typedef struct _PhotosBaseItemLoadPreviewData PhotosBaseItemLoadPreviewData;
 typedef struct _PhotosBaseItemMetadataAddSharedData PhotosBaseItemMetadataAddSharedData;
 typedef struct _PhotosBaseItemQueryInfoData PhotosBaseItemQueryInfoData;
 typedef struct _PhotosBaseItemSaveData PhotosBaseItemSaveData;
@@ -142,6 +147,23 @@ typedef struct _PhotosBaseItemSaveBufferData PhotosBaseItemSaveBufferData;
 typedef struct _PhotosBaseItemSaveToFileData PhotosBaseItemSaveToFileData;
 typedef struct _PhotosBaseItemSaveToStreamData PhotosBaseItemSaveToStreamData;
 
+struct _PhotosBaseItemCreateProxyData
+{
+  GeglBuffer *buffer;
+  GeglBuffer *proxy_source_buffer;
+  GeglNode *buffer_source;
+  GeglNode *graph;
+  GeglRectangle roi;
+  gboolean downscaled;
+  gdouble scale;
+};
+
+struct _PhotosBaseItemLoadPreviewData
+{
+  PhotosPipeline *pipeline;
+  gint size;
+};
+
 struct _PhotosBaseItemMetadataAddSharedData
 {
   gchar *account_identity;
@@ -157,15 +179,19 @@ struct _PhotosBaseItemQueryInfoData
 
 struct _PhotosBaseItemSaveData
 {
+  GBytes *bytes;
+  GError *error;
   GFile *dir;
   GFile *unique_file;
   GeglBuffer *buffer;
+  gchar *cache_key;
   gchar *type;
   gdouble zoom;
 };
 
 struct _PhotosBaseItemSaveBufferData
 {
+  GBytes *bytes;
   GFile *file;
   GFileOutputStream *stream;
 };
@@ -180,6 +206,7 @@ struct _PhotosBaseItemSaveToFileData
 
 struct _PhotosBaseItemSaveToStreamData
 {
+  GBytes *bytes;
   GFile *file;
   GFileIOStream *iostream;
   GOutputStream *ostream;
@@ -192,6 +219,35 @@ static GdkPixbuf *thumbnailing_icon;
 static GThreadPool *create_thumbnail_pool;
 static const gint PIXEL_SIZES[] = {2048, 1024};
 
+/* Pending thumbnail jobs, in order of priority. Items that are visible
+ * in a view come first, followed by everything else that is local,
+ * and then by everything else. The worker threads pick the job with
+ * the highest priority at the time they become free, so that jobs can
+ * be promoted and demoted while they are queued.
+ */
+static GMutex create_thumbnail_mutex;
+static PhotosThumbnailQueue *create_thumbnail_queue;
+static gint64 create_thumbnail_stats_start;
+static guint create_thumbnail_stats_count;
+
+static const gint64 CREATE_THUMBNAIL_STATS_INTERVAL = 2 * G_USEC_PER_SEC;
+static const guint MAX_THUMBNAIL_THREADS = 32;
+
+#define CREATE_THUMBNAIL_BATCH_MAX 8
+
+/* Encoded images kept from guessing the export sizes, so that an
+ * export right afterwards doesn't have to encode them again. The keys
+ * are derived from the item, its edits and the zoom, and the least
+ * recently used images are evicted to stay under SAVE_CACHE_MAX_SIZE.
+ * The sizes are guessed in a worker thread, hence the mutex.
+ */
+static GHashTable *save_cache;
+static GMutex save_cache_mutex;
+static GQueue save_cache_lru = G_QUEUE_INIT;
+static gsize save_cache_size;
+
+static const gsize SAVE_CACHE_MAX_SIZE = 64 * 1024 * 1024;
+
 enum
 {
   THUMBNAIL_GENERATION = 0
@@ -201,6 +257,59 @@ enum
 static void photos_base_item_populate_from_cursor (PhotosBaseItem *self, TrackerSparqlCursor *cursor);
 
 
+static PhotosBaseItemCreateProxyData *
+photos_base_item_create_proxy_data_new (GeglNode *graph,
+                                        GeglNode *buffer_source,
+                                        GeglBuffer *buffer,
+                                        GeglBuffer *proxy_source_buffer,
+                                        const GeglRectangle *roi,
+                                        gdouble scale)
+{
+  PhotosBaseItemCreateProxyData *data;
+
+  data = g_slice_new0 (PhotosBaseItemCreateProxyData);
+  data->graph = g_object_ref (graph);
+  data->buffer_source = g_object_ref (buffer_source);
+  data->buffer = g_object_ref (buffer);
+  g_set_object (&data->proxy_source_buffer, proxy_source_buffer);
+  data->roi = *roi;
+  data->scale = scale;
+
+  return data;
+}
+
+
+static void
+photos_base_item_create_proxy_data_free (PhotosBaseItemCreateProxyData *data)
+{
+  g_clear_object (&data->buffer);
+  g_clear_object (&data->buffer_source);
+  g_clear_object (&data->graph);
+  g_clear_object (&data->proxy_source_buffer);
+  g_slice_free (PhotosBaseItemCreateProxyData, data);
+}
+
+
+static PhotosBaseItemLoadPreviewData *
+photos_base_item_load_preview_data_new (gint size)
+{
+  PhotosBaseItemLoadPreviewData *data;
+
+  data = g_slice_new0 (PhotosBaseItemLoadPreviewData);
+  data->size = size;
+
+  return data;
+}
+
+
+static void
+photos_base_item_load_preview_data_free (PhotosBaseItemLoadPreviewData *data)
+{
+  g_clear_object (&data->pipeline);
+  g_slice_free (PhotosBaseItemLoadPreviewData, data);
+}
+
+
 static PhotosBaseItemMetadataAddSharedData *
 photos_base_item_metadata_add_shared_data_new (const gchar *provider_type,
                                                const gchar *account_identity,
@@ -274,17 +383,24 @@ photos_base_item_save_data_free (PhotosBaseItemSaveData *data)
   g_clear_object (&data->dir);
   g_clear_object (&data->unique_file);
   g_clear_object (&data->buffer);
+  g_clear_error (&data->error);
+  g_clear_pointer (&data->bytes, g_bytes_unref);
+  g_free (data->cache_key);
   g_free (data->type);
   g_slice_free (PhotosBaseItemSaveData, data);
 }
 
 
 static PhotosBaseItemSaveBufferData *
-photos_base_item_save_buffer_data_new (GFile *file, GFileOutputStream *stream)
+photos_base_item_save_buffer_data_new (GBytes *bytes, GFile *file, GFileOutputStream *stream)
 {
   PhotosBaseItemSaveBufferData *data;
 
   data = g_slice_new0 (PhotosBaseItemSaveBufferData);
+
+  if (bytes != NULL)
+    data->bytes = g_bytes_ref (bytes);
+
   data->file = g_object_ref (file);
   data->stream = g_object_ref (stream);
 
@@ -295,6 +411,7 @@ photos_base_item_save_buffer_data_new (GFile *file, GFileOutputStream *stream)
 static void
 photos_base_item_save_buffer_data_free (PhotosBaseItemSaveBufferData *data)
 {
+  g_clear_pointer (&data->bytes, g_bytes_unref);
   g_clear_object (&data->file);
   g_clear_object (&data->stream);
   g_slice_free (PhotosBaseItemSaveBufferData, data);
@@ -340,6 +457,7 @@ photos_base_item_save_to_stream_data_new (GOutputStream *ostream, gdouble zoom)
 static void
 photos_base_item_save_to_stream_data_free (PhotosBaseItemSaveToStreamData *data)
 {
+  g_clear_pointer (&data->bytes, g_bytes_unref);
   g_clear_object (&data->file);
   g_clear_object (&data->iostream);
   g_clear_object (&data->ostream);
@@ -363,6 +481,76 @@ photos_base_item_create_placeholder_icon (const gchar *icon_name)
 }
 
 
+static void
+photos_base_item_create_proxy_in_thread_func (GTask *task,
+                                              gpointer source_object,
+                                              gpointer task_data,
+                                              GCancellable *cancellable)
+{
+  PhotosBaseItemCreateProxyData *data = (PhotosBaseItemCreateProxyData *) task_data;
+  const Babl *format;
+  GeglBuffer *buffer;
+  GeglNode *output;
+  gint64 end;
+  gint64 start;
+
+  /* The downscaled source is reused by later proxies at the same scale,
+   * so it is handed back to the main thread by create_proxy_finish.
+   */
+  if (data->proxy_source_buffer == NULL)
+    {
+      const Babl *buffer_format;
+      gint bpp;
+      guchar *buf;
+
+      buffer_format = gegl_buffer_get_format (data->buffer);
+      bpp = babl_format_get_bytes_per_pixel (buffer_format);
+      buf = g_malloc0_n ((gsize) data->roi.height * (gsize) data->roi.width, (gsize) bpp);
+
+      start = g_get_monotonic_time ();
+
+      gegl_buffer_get (data->buffer,
+                       &data->roi,
+                       data->scale,
+                       buffer_format,
+                       buf,
+                       GEGL_AUTO_ROWSTRIDE,
+                       GEGL_ABYSS_NONE);
+
+      end = g_get_monotonic_time ();
+      photos_debug (PHOTOS_DEBUG_GEGL, "Create Proxy: Downscale: %" G_GINT64_FORMAT, end - start);
+
+      data->proxy_source_buffer = gegl_buffer_linear_new_from_data (buf,
+                                                                    buffer_format,
+                                                                    &data->roi,
+                                                                    GEGL_AUTO_ROWSTRIDE,
+                                                                    g_free,
+                                                                    NULL);
+      data->downscaled = TRUE;
+    }
+
+  if (g_task_return_error_if_cancelled (task))
+    goto out;
+
+  gegl_node_set (data->buffer_source, "buffer", data->proxy_source_buffer, NULL);
+
+  output = gegl_node_get_output_proxy (data->graph, "output");
+  format = babl_format ("cairo-ARGB32");
+
+  start = g_get_monotonic_time ();
+
+  buffer = photos_gegl_dup_buffer_from_node (output, format);
+
+  end = g_get_monotonic_time ();
+  photos_debug (PHOTOS_DEBUG_GEGL, "Create Proxy: Process: %" G_GINT64_FORMAT, end - start);
+
+  g_task_return_pointer (task, buffer, g_object_unref);
+
+ out:
+  return;
+}
+
+
 static GIcon *
 photos_base_item_create_symbolic_emblem (const gchar *name, gint scale)
 {
@@ -478,16 +666,78 @@ photos_base_item_clear_pixels (PhotosBaseItem *self)
   g_clear_object (&priv->edit_graph);
   g_clear_object (&priv->preview_source_buffer);
   g_clear_object (&priv->processor);
+  g_clear_object (&priv->proxy_source_buffer);
+}
+
+
+static PhotosThumbnailQueuePriority
+photos_base_item_create_thumbnail_get_priority (PhotosBaseItem *self)
+{
+  PhotosThumbnailQueuePriority ret_val;
+
+  if (PHOTOS_IS_LOCAL_ITEM (self))
+    ret_val = PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL;
+  else
+    ret_val = PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE;
+
+  return ret_val;
 }
 
 
 static void
-photos_base_item_create_thumbnail_in_thread_func (gpointer data, gpointer user_data)
+photos_base_item_create_thumbnail_stats_update (guint n_thumbnails)
+{
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  create_thumbnail_stats_count += n_thumbnails;
+
+  if (create_thumbnail_stats_start == 0)
+    create_thumbnail_stats_start = now;
+
+  if (now - create_thumbnail_stats_start >= CREATE_THUMBNAIL_STATS_INTERVAL)
+    {
+      gdouble throughput;
+
+      throughput = (gdouble) create_thumbnail_stats_count * G_USEC_PER_SEC / (now - create_thumbnail_stats_start);
+      photos_debug (PHOTOS_DEBUG_THUMBNAILER,
+                    "Thumbnail queue: %u visible, %u local, %u remote; %.1f thumbnails/s with %u threads",
+                    photos_thumbnail_queue_get_length (create_thumbnail_queue,
+                                                       PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE),
+                    photos_thumbnail_queue_get_length (create_thumbnail_queue,
+                                                       PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL),
+                    photos_thumbnail_queue_get_length (create_thumbnail_queue,
+                                                       PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE),
+                    throughput,
+                    g_thread_pool_get_max_threads (create_thumbnail_pool));
+
+      create_thumbnail_stats_count = 0;
+      create_thumbnail_stats_start = now;
+    }
+}
+
+
+static void
+photos_base_item_create_thumbnail_delete (PhotosBaseItem *self)
+{
+  g_autoptr (GFile) file = NULL;
+  g_autofree gchar *path = NULL;
+
+  path = photos_base_item_create_thumbnail_path (self);
+  file = g_file_new_for_path (path);
+  g_file_delete (file, NULL, NULL);
+}
+
+
+static void
+photos_base_item_create_thumbnail_in_thread (GTask *task)
 {
-  g_autoptr (GTask) task = G_TASK (data);
   PhotosBaseItem *self;
   GCancellable *cancellable;
 
+  if (g_task_return_error_if_cancelled (task))
+    goto out;
+
   self = PHOTOS_BASE_ITEM (g_task_get_source_object (task));
   cancellable = g_task_get_cancellable (task);
 
@@ -497,14 +747,7 @@ photos_base_item_create_thumbnail_in_thread_func (gpointer data, gpointer user_d
     if (!PHOTOS_BASE_ITEM_GET_CLASS (self)->create_thumbnail (self, cancellable, &error))
       {
         if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-          {
-            g_autoptr (GFile) file = NULL;
-            g_autofree gchar *path = NULL;
-
-            path = photos_base_item_create_thumbnail_path (self);
-            file = g_file_new_for_path (path);
-            g_file_delete (file, NULL, NULL);
-          }
+          photos_base_item_create_thumbnail_delete (self);
 
         g_task_return_error (task, g_steal_pointer (&error));
         goto out;
@@ -518,41 +761,227 @@ photos_base_item_create_thumbnail_in_thread_func (gpointer data, gpointer user_d
 }
 
 
-static gint
-photos_base_item_create_thumbnail_sort_func (gconstpointer a, gconstpointer b, gpointer user_data)
+static void
+photos_base_item_create_thumbnails_generated (guint index, const GError *error, gpointer user_data)
 {
-  GTask *task_a = G_TASK (a);
-  GTask *task_b = G_TASK (b);
-  PhotosBaseItem *item_a;
-  PhotosBaseItem *item_b;
-  gint ret_val = 0;
+  GPtrArray *tasks = (GPtrArray *) user_data;
+  g_autoptr (GTask) task = NULL;
+
+  g_return_if_fail (index < tasks->len);
+
+  task = (GTask *) g_steal_pointer (&g_ptr_array_index (tasks, index));
+  g_return_if_fail (G_IS_TASK (task));
+
+  if (error != NULL)
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          PhotosBaseItem *self;
+
+          self = PHOTOS_BASE_ITEM (g_task_get_source_object (task));
+          photos_base_item_create_thumbnail_delete (self);
+        }
+
+      g_task_return_error (task, g_error_copy (error));
+      return;
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+
+static void
+photos_base_item_create_thumbnails_in_thread (GTask **tasks, guint n_tasks)
+{
+  g_autoptr (GArray) requests = NULL;
+  g_autoptr (GPtrArray) batch_tasks = NULL;
+  g_autoptr (PhotosThumbnailFactory) factory = NULL;
+  g_autoptr (GError) error = NULL;
+  guint i;
+
+  requests = g_array_sized_new (FALSE, TRUE, sizeof (PhotosThumbnailFactoryRequest), n_tasks);
+  g_array_set_clear_func (requests, (GDestroyNotify) photos_thumbnail_factory_request_clear);
+
+  batch_tasks = g_ptr_array_sized_new (n_tasks);
+
+  for (i = 0; i < n_tasks; i++)
+    {
+      g_autoptr (GTask) task = tasks[i];
+      PhotosBaseItem *self;
+      PhotosBaseItemClass *class;
+      PhotosThumbnailFactoryRequest request = { NULL };
+
+      if (g_task_return_error_if_cancelled (task))
+        continue;
+
+      self = PHOTOS_BASE_ITEM (g_task_get_source_object (task));
+      class = PHOTOS_BASE_ITEM_GET_CLASS (self);
+      if (class->create_thumbnail_request == NULL || !class->create_thumbnail_request (self, &request))
+        {
+          photos_thumbnail_factory_request_clear (&request);
+          photos_base_item_create_thumbnail_in_thread (task);
+          continue;
+        }
+
+      g_set_object (&request.cancellable, g_task_get_cancellable (task));
+      g_array_append_val (requests, request);
+      g_ptr_array_add (batch_tasks, g_steal_pointer (&task));
+    }
+
+  if (batch_tasks->len == 0)
+    goto out;
+
+  factory = photos_thumbnail_factory_dup_singleton (NULL, &error);
+  if (factory != NULL
+      && !photos_thumbnail_factory_generate_thumbnails (factory,
+                                                        (const PhotosThumbnailFactoryRequest *) requests->data,
+                                                        requests->len,
+                                                        photos_base_item_create_thumbnails_generated,
+                                                        batch_tasks,
+                                                        NULL,
+                                                        &error))
+    {
+      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Unable to generate a batch of thumbnails: %s", error->message);
+    }
+
+  /* Anything that wasn't reported back, for example because the
+   * thumbnailer crashed, is tried once more on its own. That way, a
+   * file that crashes the thumbnailer doesn't fail the whole batch.
+   */
+  for (i = 0; i < batch_tasks->len; i++)
+    {
+      g_autoptr (GTask) task = NULL;
+
+      task = (GTask *) g_steal_pointer (&g_ptr_array_index (batch_tasks, i));
+      if (task == NULL)
+        continue;
+
+      if (factory == NULL)
+        g_task_return_error (task, g_error_copy (error));
+      else
+        photos_base_item_create_thumbnail_in_thread (task);
+    }
+
+ out:
+  return;
+}
+
+
+static guint
+photos_base_item_create_thumbnail_queue_pop (GTask **tasks, guint n_tasks_max)
+{
+  PhotosBaseItem *item;
+  PhotosThumbnailQueuePriority priority;
+  guint n_visible;
+  guint ret_val = 0;
+
+  tasks[0] = photos_thumbnail_queue_pop (create_thumbnail_queue);
+  if (tasks[0] == NULL)
+    goto out;
+
+  ret_val = 1;
+
+  /* Background jobs for items that can be batched are sent to the
+   * thumbnailer together, to save a round trip for each of them. Jobs
+   * for visible items are kept apart, so that they can be
+   * re-prioritized until the last moment.
+   */
+  n_visible = photos_thumbnail_queue_get_length (create_thumbnail_queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE);
+  if (n_visible > 0)
+    goto out;
 
-  item_a = PHOTOS_BASE_ITEM (g_task_get_source_object (task_a));
-  item_b = PHOTOS_BASE_ITEM (g_task_get_source_object (task_b));
+  item = PHOTOS_BASE_ITEM (g_task_get_source_object (tasks[0]));
+  if (PHOTOS_BASE_ITEM_GET_CLASS (item)->create_thumbnail_request == NULL)
+    goto out;
 
-  if (PHOTOS_IS_LOCAL_ITEM (item_a))
-    ret_val = -1;
-  else if (PHOTOS_IS_LOCAL_ITEM (item_b))
-    ret_val = 1;
+  priority = photos_base_item_create_thumbnail_get_priority (item);
+  ret_val += photos_thumbnail_queue_pop_n (create_thumbnail_queue, priority, tasks + 1, n_tasks_max - 1);
 
+ out:
   return ret_val;
 }
 
 
+static void
+photos_base_item_create_thumbnail_in_thread_func (gpointer data, gpointer user_data)
+{
+  GTask *tasks[CREATE_THUMBNAIL_BATCH_MAX];
+  guint n_tasks;
+
+  /* The data is only a token. Pick whichever jobs have the highest
+   * priority right now.
+   */
+  g_mutex_lock (&create_thumbnail_mutex);
+  n_tasks = photos_base_item_create_thumbnail_queue_pop (tasks, G_N_ELEMENTS (tasks));
+  g_mutex_unlock (&create_thumbnail_mutex);
+
+  if (n_tasks == 0)
+    goto out;
+
+  if (n_tasks == 1)
+    {
+      g_autoptr (GTask) task = tasks[0];
+
+      photos_base_item_create_thumbnail_in_thread (task);
+    }
+  else
+    {
+      photos_base_item_create_thumbnails_in_thread (tasks, n_tasks);
+    }
+
+  g_mutex_lock (&create_thumbnail_mutex);
+  photos_base_item_create_thumbnail_stats_update (n_tasks);
+  g_mutex_unlock (&create_thumbnail_mutex);
+
+ out:
+  return;
+}
+
+
 static void
 photos_base_item_create_thumbnail_async (PhotosBaseItem *self,
                                          GCancellable *cancellable,
                                          GAsyncReadyCallback callback,
                                          gpointer user_data)
 {
+  g_autoptr (GTask) superseded_task = NULL;
   g_autoptr (GTask) task = NULL;
+  PhotosThumbnailQueuePriority priority;
 
   g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
 
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, photos_base_item_create_thumbnail_async);
 
-  g_thread_pool_push (create_thumbnail_pool, g_object_ref (task), NULL);
+  priority = photos_base_item_create_thumbnail_get_priority (self);
+
+  g_mutex_lock (&create_thumbnail_mutex);
+  superseded_task = photos_thumbnail_queue_push (create_thumbnail_queue, g_object_ref (task), priority);
+  g_mutex_unlock (&create_thumbnail_mutex);
+
+  /* A refresh can ask for a thumbnail again while the earlier request
+   * is still queued. The new task takes over the queued job, and the
+   * older one is completed as cancelled since its result is no longer
+   * wanted.
+   */
+  if (superseded_task != NULL)
+    {
+      PhotosBaseItemPrivate *priv;
+
+      priv = photos_base_item_get_instance_private (self);
+      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Coalesced thumbnail requests for %s", priv->uri);
+
+      g_task_return_new_error (superseded_task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_CANCELLED,
+                               "Superseded by a newer thumbnail request");
+      goto out;
+    }
+
+  g_thread_pool_push (create_thumbnail_pool, GINT_TO_POINTER (1), NULL);
+
+ out:
+  return;
 }
 
 
@@ -1268,11 +1697,124 @@ photos_base_item_get_preview_source_buffer (PhotosBaseItem *self, gint size, gin
 }
 
 
+static void
+photos_base_item_get_proxy_source_roi (GeglBuffer *buffer, gdouble scale, GeglRectangle *out_roi)
+{
+  GeglRectangle bbox;
+
+  bbox = *gegl_buffer_get_extent (buffer);
+  out_roi->x = (gint) ((gdouble) bbox.x * scale + 0.5);
+  out_roi->y = (gint) ((gdouble) bbox.y * scale + 0.5);
+  out_roi->width = MAX ((gint) ((gdouble) bbox.width * scale + 0.5), 1);
+  out_roi->height = MAX ((gint) ((gdouble) bbox.height * scale + 0.5), 1);
+}
+
+
+static gchar *
+photos_base_item_save_cache_create_key (PhotosBaseItem *self, gdouble zoom)
+{
+  PhotosBaseItemPrivate *priv;
+  GeglNode *graph;
+  PhotosPipeline *pipeline;
+  gchar zoom_str[G_ASCII_DTOSTR_BUF_SIZE];
+  g_autofree gchar *key = NULL;
+  g_autofree gchar *xml = NULL;
+
+  priv = photos_base_item_get_instance_private (self);
+
+  pipeline = PHOTOS_PIPELINE (dzl_task_cache_peek (pipeline_cache, self));
+  if (pipeline == NULL)
+    return NULL;
+
+  graph = photos_pipeline_get_graph (pipeline);
+  xml = gegl_node_to_xml_full (graph, graph, "/");
+  g_ascii_dtostr (zoom_str, G_N_ELEMENTS (zoom_str), zoom);
+
+  key = g_strdup_printf ("%s\n%s\n%" G_GINT64_FORMAT "\n%s\n%s",
+                         priv->id,
+                         priv->mime_type != NULL ? priv->mime_type : "",
+                         priv->mtime,
+                         zoom_str,
+                         xml);
+
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+}
+
+
+static void
+photos_base_item_save_cache_remove_unlocked (const gchar *key)
+{
+  GBytes *bytes;
+  gpointer orig_key;
+
+  if (!g_hash_table_lookup_extended (save_cache, key, &orig_key, (gpointer *) &bytes))
+    return;
+
+  save_cache_size -= g_bytes_get_size (bytes);
+  g_queue_remove (&save_cache_lru, orig_key);
+  g_hash_table_remove (save_cache, orig_key);
+}
+
+
+static void
+photos_base_item_save_cache_insert (const gchar *key, GBytes *bytes)
+{
+  gchar *key_copy;
+  gsize size;
+
+  size = g_bytes_get_size (bytes);
+  if (size > SAVE_CACHE_MAX_SIZE)
+    return;
+
+  g_mutex_lock (&save_cache_mutex);
+
+  photos_base_item_save_cache_remove_unlocked (key);
+
+  while (save_cache_size + size > SAVE_CACHE_MAX_SIZE)
+    {
+      const gchar *oldest_key;
+
+      oldest_key = (const gchar *) g_queue_peek_tail (&save_cache_lru);
+      photos_base_item_save_cache_remove_unlocked (oldest_key);
+    }
+
+  key_copy = g_strdup (key);
+  g_hash_table_insert (save_cache, key_copy, g_bytes_ref (bytes));
+  g_queue_push_head (&save_cache_lru, key_copy);
+  save_cache_size += size;
+
+  g_mutex_unlock (&save_cache_mutex);
+}
+
+
+static GBytes *
+photos_base_item_save_cache_lookup (const gchar *key)
+{
+  GBytes *bytes;
+  GBytes *ret_val = NULL;
+  gpointer orig_key;
+
+  g_mutex_lock (&save_cache_mutex);
+
+  if (g_hash_table_lookup_extended (save_cache, key, &orig_key, (gpointer *) &bytes))
+    {
+      g_queue_remove (&save_cache_lru, orig_key);
+      g_queue_push_head (&save_cache_lru, orig_key);
+      ret_val = g_bytes_ref (bytes);
+    }
+
+  g_mutex_unlock (&save_cache_mutex);
+
+  return ret_val;
+}
+
+
 static void
 photos_base_item_guess_save_sizes_from_buffer (GeglBuffer *buffer,
                                                const gchar *mime_type,
                                                gsize *out_full_size,
                                                gsize *out_reduced_size,
+                                               GBytes **out_full_bytes,
                                                GCancellable *cancellable)
 {
   GeglNode *buffer_source;
@@ -1283,16 +1825,24 @@ photos_base_item_guess_save_sizes_from_buffer (GeglBuffer *buffer,
   graph = gegl_node_new ();
   buffer_source = gegl_node_new_child (graph, "operation", "gegl:buffer-source", "buffer", buffer, NULL);
 
+  /* The parameters match the ones used for exporting, so that the
+   * images encoded in full can be written out as they are. JPEG is
+   * cheap enough to always encode in full, but PNG is only for images
+   * that are too small to be sampled.
+   */
   if (g_strcmp0 (mime_type, "image/png") == 0)
     guess_sizes = gegl_node_new_child (graph,
                                        "operation", "photos:png-guess-sizes",
                                        "background", FALSE,
                                        "bitdepth", 8,
                                        "compression", -1,
+                                       "keep-data", TRUE,
                                        NULL);
   else
     guess_sizes = gegl_node_new_child (graph,
                                        "operation", "photos:jpg-guess-sizes",
+                                       "exact", TRUE,
+                                       "keep-data", TRUE,
                                        "optimize", FALSE,
                                        "progressive", FALSE,
                                        "sampling", TRUE,
@@ -1306,6 +1856,8 @@ photos_base_item_guess_save_sizes_from_buffer (GeglBuffer *buffer,
     *out_full_size = (gsize) sizes[0];
   if (out_reduced_size != NULL)
     *out_reduced_size = (gsize) sizes[1];
+  if (out_full_bytes != NULL)
+    gegl_node_get (guess_sizes, "data", out_full_bytes, NULL);
 }
 
 
@@ -1316,10 +1868,20 @@ photos_base_item_guess_save_sizes_in_thread_func (GTask *task,
                                                   GCancellable *cancellable)
 {
   PhotosBaseItemSaveData *data = (PhotosBaseItemSaveData *) task_data;
+  g_autoptr (GBytes) full_bytes = NULL;
   gsize *sizes;
 
   sizes = g_malloc0_n (2, sizeof (gsize));
-  photos_base_item_guess_save_sizes_from_buffer (data->buffer, data->type, &sizes[0], &sizes[1], cancellable);
+  photos_base_item_guess_save_sizes_from_buffer (data->buffer,
+                                                 data->type,
+                                                 &sizes[0],
+                                                 &sizes[1],
+                                                 &full_bytes,
+                                                 cancellable);
+
+  if (full_bytes != NULL && data->cache_key != NULL)
+    photos_base_item_save_cache_insert (data->cache_key, full_bytes);
+
   g_task_return_pointer (task, sizes, g_free);
 }
 
@@ -1349,6 +1911,7 @@ photos_base_item_guess_save_sizes_load (GObject *source_object, GAsyncResult *re
 
   buffer = photos_gegl_get_buffer_from_node (graph, NULL);
   data = photos_base_item_save_data_new (NULL, buffer, priv->mime_type, 0.0);
+  data->cache_key = photos_base_item_save_cache_create_key (self, 1.0);
   g_task_set_task_data (task, data, (GDestroyNotify) photos_base_item_save_data_free);
 
   g_task_run_in_thread (task, photos_base_item_guess_save_sizes_in_thread_func);
@@ -1811,6 +2374,127 @@ photos_base_item_load_load_pipeline (GObject *source_object, GAsyncResult *res,
 }
 
 
+static void
+photos_base_item_load_preview_pixbuf (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autoptr (GTask) task = G_TASK (user_data);
+  PhotosBaseItem *self;
+  PhotosBaseItemPrivate *priv;
+  PhotosBaseItemLoadPreviewData *data;
+  g_autoptr (GdkPixbuf) pixbuf = NULL;
+  g_autoptr (GeglBuffer) buffer = NULL;
+  g_autoptr (GeglBuffer) buffer_oriented = NULL;
+  GeglNode *buffer_source;
+  g_autoptr (GeglNode) graph = NULL;
+  GeglNode *output;
+  g_autoptr (GeglNode) proxy_graph = NULL;
+  GeglNode *scale_ratio;
+  gdouble scale;
+  gint height;
+  gint width;
+
+  self = PHOTOS_BASE_ITEM (g_task_get_source_object (task));
+  priv = photos_base_item_get_instance_private (self);
+
+  data = (PhotosBaseItemLoadPreviewData *) g_task_get_task_data (task);
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    pixbuf = photos_pixbuf_new_from_file_at_size_finish (res, &error);
+    if (error != NULL)
+      {
+        g_task_return_error (task, g_steal_pointer (&error));
+        goto out;
+      }
+  }
+
+  height = gdk_pixbuf_get_height (pixbuf);
+  width = gdk_pixbuf_get_width (pixbuf);
+
+  /* The original size might have been stored with or without the
+   * orientation applied, but either way the sum of the sides scales
+   * by the same factor.
+   */
+  scale = (gdouble) (height + width) / (gdouble) (priv->height + priv->width);
+  if (scale >= 1.0)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Image is not larger than the preview");
+      goto out;
+    }
+
+  buffer = photos_gegl_buffer_new_from_pixbuf (pixbuf);
+  buffer_oriented = photos_gegl_buffer_apply_orientation (buffer, priv->orientation);
+
+  /* The edits are applied to the small image, and the result is scaled
+   * back up so that the node has the same size as the one that will
+   * replace it.
+   */
+  graph = gegl_node_new ();
+  buffer_source = gegl_node_new_child (graph, "operation", "gegl:buffer-source", "buffer", buffer_oriented, NULL);
+
+  proxy_graph = photos_pipeline_new_proxy_graph (data->pipeline, scale);
+  gegl_node_add_child (graph, proxy_graph);
+
+  scale_ratio = gegl_node_new_child (graph,
+                                     "operation", "gegl:scale-ratio",
+                                     "x", 1.0 / scale,
+                                     "y", 1.0 / scale,
+                                     NULL);
+
+  output = gegl_node_get_output_proxy (graph, "output");
+  gegl_node_link_many (buffer_source, proxy_graph, scale_ratio, output, NULL);
+
+  photos_debug (PHOTOS_DEBUG_GEGL, "Load Preview: %d×%d at %f", width, height, scale);
+  g_task_return_pointer (task, g_steal_pointer (&graph), g_object_unref);
+
+ out:
+  return;
+}
+
+
+static void
+photos_base_item_load_preview_load_pipeline (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autoptr (GTask) task = G_TASK (user_data);
+  PhotosBaseItem *self = PHOTOS_BASE_ITEM (source_object);
+  PhotosBaseItemPrivate *priv;
+  PhotosBaseItemLoadPreviewData *data;
+  GCancellable *cancellable;
+  g_autoptr (GFile) file = NULL;
+  g_autofree gchar *path = NULL;
+
+  priv = photos_base_item_get_instance_private (self);
+  data = (PhotosBaseItemLoadPreviewData *) g_task_get_task_data (task);
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    data->pipeline = photos_base_item_load_pipeline_finish (self, res, &error);
+    if (error != NULL)
+      {
+        g_task_return_error (task, g_steal_pointer (&error));
+        goto out;
+      }
+  }
+
+  cancellable = g_task_get_cancellable (task);
+
+  file = g_file_new_for_uri (priv->uri);
+  path = g_file_get_path (file);
+
+  photos_pixbuf_new_from_file_at_size_async (path,
+                                             data->size,
+                                             data->size,
+                                             cancellable,
+                                             photos_base_item_load_preview_pixbuf,
+                                             g_object_ref (task));
+
+ out:
+  return;
+}
+
+
 static void
 photos_base_item_metadata_add_shared_in_thread_func (GTask *task,
                                                      gpointer source_object,
@@ -2104,10 +2788,43 @@ photos_base_item_save_buffer_stream_close (GObject *source_object, GAsyncResult
 }
 
 
+static void
+photos_base_item_save_buffer_write_all (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autoptr (GTask) task = G_TASK (user_data);
+  PhotosBaseItemSaveBufferData *data;
+  GCancellable *cancellable;
+  GOutputStream *stream = G_OUTPUT_STREAM (source_object);
+
+  cancellable = g_task_get_cancellable (task);
+  data = (PhotosBaseItemSaveBufferData *) g_task_get_task_data (task);
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    if (!g_output_stream_write_all_finish (stream, res, NULL, &error))
+      {
+        g_task_return_error (task, g_steal_pointer (&error));
+        goto out;
+      }
+  }
+
+  g_output_stream_close_async (G_OUTPUT_STREAM (data->stream),
+                               G_PRIORITY_DEFAULT,
+                               cancellable,
+                               photos_base_item_save_buffer_stream_close,
+                               g_object_ref (task));
+
+ out:
+  return;
+}
+
+
 static void
 photos_base_item_save_buffer_save_to_stream (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
   g_autoptr (GTask) task = G_TASK (user_data);
+  GeglBuffer *buffer = GEGL_BUFFER (source_object);
   PhotosBaseItemSaveBufferData *data;
   GCancellable *cancellable;
 
@@ -2117,7 +2834,7 @@ photos_base_item_save_buffer_save_to_stream (GObject *source_object, GAsyncResul
   {
     g_autoptr (GError) error = NULL;
 
-    if (!gdk_pixbuf_save_to_stream_finish (res, &error))
+    if (!photos_gegl_buffer_save_to_stream_finish (buffer, res, &error))
       {
         g_task_return_error (task, g_steal_pointer (&error));
         goto out;
@@ -2138,6 +2855,7 @@ photos_base_item_save_buffer_save_to_stream (GObject *source_object, GAsyncResul
 static void
 photos_base_item_save_buffer_async (PhotosBaseItem *self,
                                     GeglBuffer *buffer,
+                                    GBytes *bytes,
                                     GFile *file,
                                     GFileOutputStream *stream,
                                     GCancellable *cancellable,
@@ -2146,54 +2864,45 @@ photos_base_item_save_buffer_async (PhotosBaseItem *self,
 {
   PhotosBaseItemPrivate *priv;
   g_autoptr (GTask) task = NULL;
-  g_autoptr (GdkPixbuf) pixbuf = NULL;
-  GeglNode *buffer_source;
-  g_autoptr (GeglNode) graph = NULL;
   PhotosBaseItemSaveBufferData *data;
 
   priv = photos_base_item_get_instance_private (self);
 
+  g_return_if_fail (GEGL_IS_BUFFER (buffer) || bytes != NULL);
   g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
 
-  data = photos_base_item_save_buffer_data_new (file, stream);
+  data = photos_base_item_save_buffer_data_new (bytes, file, stream);
 
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, photos_base_item_save_buffer_async);
   g_task_set_task_data (task, data, (GDestroyNotify) photos_base_item_save_buffer_data_free);
 
-  graph = gegl_node_new ();
-  buffer_source = gegl_node_new_child (graph, "operation", "gegl:buffer-source", "buffer", buffer, NULL);
-  pixbuf = photos_gegl_create_pixbuf_from_node (buffer_source);
-  if (pixbuf == NULL)
-    {
-      g_task_return_new_error (task, PHOTOS_ERROR, 0, "Failed to create a GdkPixbuf from the GeglBuffer");
-      goto out;
-    }
-
-  if (g_strcmp0 (priv->mime_type, "image/png") == 0)
+  if (data->bytes != NULL)
     {
-      gdk_pixbuf_save_to_stream_async (pixbuf,
-                                       G_OUTPUT_STREAM (stream),
-                                       "png",
+      photos_debug (PHOTOS_DEBUG_GEGL,
+                    "Saving previously encoded image: %" G_GSIZE_FORMAT,
+                    g_bytes_get_size (data->bytes));
+
+      g_output_stream_write_all_async (G_OUTPUT_STREAM (stream),
+                                       g_bytes_get_data (data->bytes, NULL),
+                                       g_bytes_get_size (data->bytes),
+                                       G_PRIORITY_DEFAULT,
                                        cancellable,
-                                       photos_base_item_save_buffer_save_to_stream,
-                                       g_object_ref (task),
-                                       NULL);
+                                       photos_base_item_save_buffer_write_all,
+                                       g_object_ref (task));
     }
   else
     {
-      gdk_pixbuf_save_to_stream_async (pixbuf,
-                                       G_OUTPUT_STREAM (stream),
-                                       "jpeg",
-                                       cancellable,
-                                       photos_base_item_save_buffer_save_to_stream,
-                                       g_object_ref (task),
-                                       "quality", "90",
-                                       NULL);
+      /* Encode straight from the GeglBuffer, a strip at a time,
+       * instead of first copying the whole image into a GdkPixbuf.
+       */
+      photos_gegl_buffer_save_to_stream_async (buffer,
+                                               priv->mime_type,
+                                               G_OUTPUT_STREAM (stream),
+                                               cancellable,
+                                               photos_base_item_save_buffer_save_to_stream,
+                                               g_object_ref (task));
     }
-
- out:
-  return;
 }
 
 
@@ -2212,6 +2921,32 @@ photos_base_item_save_buffer_finish (PhotosBaseItem *self, GAsyncResult *res, GE
 }
 
 
+static void
+photos_base_item_save_to_dir_file_delete (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  GFile *file = G_FILE (source_object);
+  g_autoptr (GTask) task = G_TASK (user_data);
+  PhotosBaseItemSaveData *data;
+
+  data = (PhotosBaseItemSaveData *) g_task_get_task_data (task);
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    if (!g_file_delete_finish (file, res, &error))
+      {
+        g_autofree gchar *uri = NULL;
+
+        uri = g_file_get_uri (file);
+        g_warning ("Unable to delete partially exported file %s: %s", uri, error->message);
+      }
+  }
+
+  g_assert_nonnull (data->error);
+  g_task_return_error (task, g_steal_pointer (&data->error));
+}
+
+
 static void
 photos_base_item_save_to_dir_save_buffer (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
@@ -2226,7 +2961,17 @@ photos_base_item_save_to_dir_save_buffer (GObject *source_object, GAsyncResult *
 
     if (!photos_base_item_save_buffer_finish (self, res, &error))
       {
-        g_task_return_error (task, g_steal_pointer (&error));
+        /* Don't leave a truncated file behind. The task's
+         * GCancellable might be the reason for the failure, so it
+         * can't be used here.
+         */
+        g_assert_null (data->error);
+        data->error = g_steal_pointer (&error);
+        g_file_delete_async (data->unique_file,
+                             G_PRIORITY_DEFAULT,
+                             NULL,
+                             photos_base_item_save_to_dir_file_delete,
+                             g_object_ref (task));
         goto out;
       }
   }
@@ -2272,14 +3017,45 @@ photos_base_item_save_to_dir_file_create (GObject *source_object, GAsyncResult *
 
   photos_base_item_save_buffer_async (self,
                                       data->buffer,
+                                      data->bytes,
                                       unique_file,
                                       stream,
                                       cancellable,
                                       photos_base_item_save_to_dir_save_buffer,
                                       g_object_ref (task));
 
- out:
-  return;
+ out:
+  return;
+}
+
+
+static void
+photos_base_item_save_to_dir_create_file (PhotosBaseItem *self, GTask *task)
+{
+  PhotosBaseItemPrivate *priv;
+  GCancellable *cancellable;
+  g_autoptr (GFile) file = NULL;
+  PhotosBaseItemSaveData *data;
+  const gchar *extension;
+  g_autofree gchar *basename = NULL;
+  g_autofree gchar *filename = NULL;
+
+  priv = photos_base_item_get_instance_private (self);
+
+  cancellable = g_task_get_cancellable (task);
+  data = (PhotosBaseItemSaveData *) g_task_get_task_data (task);
+
+  basename = photos_glib_filename_strip_extension (priv->filename);
+  extension = g_strcmp0 (priv->mime_type, "image/png") == 0 ? ".png" : ".jpg";
+  filename = g_strconcat (basename, extension, NULL);
+
+  file = g_file_get_child (data->dir, filename);
+  photos_glib_file_create_async (file,
+                                 G_FILE_CREATE_NONE,
+                                 G_PRIORITY_DEFAULT,
+                                 cancellable,
+                                 photos_base_item_save_to_dir_file_create,
+                                 g_object_ref (task));
 }
 
 
@@ -2287,21 +3063,12 @@ static void
 photos_base_item_save_to_dir_buffer_zoom (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
   PhotosBaseItem *self;
-  PhotosBaseItemPrivate *priv;
-  GCancellable *cancellable;
-  g_autoptr (GFile) file = NULL;
   g_autoptr (GTask) task = G_TASK (user_data);
   GeglBuffer *buffer = GEGL_BUFFER (source_object);
   g_autoptr (GeglBuffer) buffer_zoomed = NULL;
   PhotosBaseItemSaveData *data;
-  const gchar *extension;
-  g_autofree gchar *basename = NULL;
-  g_autofree gchar *filename = NULL;
 
   self = PHOTOS_BASE_ITEM (g_task_get_source_object (task));
-  priv = photos_base_item_get_instance_private (self);
-
-  cancellable = g_task_get_cancellable (task);
   data = (PhotosBaseItemSaveData *) g_task_get_task_data (task);
 
   {
@@ -2318,17 +3085,7 @@ photos_base_item_save_to_dir_buffer_zoom (GObject *source_object, GAsyncResult *
   g_assert_null (data->buffer);
   data->buffer = g_object_ref (buffer_zoomed);
 
-  basename = photos_glib_filename_strip_extension (priv->filename);
-  extension = g_strcmp0 (priv->mime_type, "image/png") == 0 ? ".png" : ".jpg";
-  filename = g_strconcat (basename, extension, NULL);
-
-  file = g_file_get_child (data->dir, filename);
-  photos_glib_file_create_async (file,
-                                 G_FILE_CREATE_NONE,
-                                 G_PRIORITY_DEFAULT,
-                                 cancellable,
-                                 photos_base_item_save_to_dir_file_create,
-                                 g_object_ref (task));
+  photos_base_item_save_to_dir_create_file (self, task);
 
  out:
   return;
@@ -2344,6 +3101,7 @@ photos_base_item_save_to_dir_load (GObject *source_object, GAsyncResult *res, gp
   g_autoptr (GeglBuffer) buffer = NULL;
   g_autoptr (GeglNode) graph = NULL;
   PhotosBaseItemSaveData *data;
+  g_autofree gchar *cache_key = NULL;
 
   cancellable = g_task_get_cancellable (task);
   data = (PhotosBaseItemSaveData *) g_task_get_task_data (task);
@@ -2359,6 +3117,19 @@ photos_base_item_save_to_dir_load (GObject *source_object, GAsyncResult *res, gp
       }
   }
 
+  /* Reuse the image encoded while guessing the export sizes, if the
+   * item hasn't been edited since.
+   */
+  cache_key = photos_base_item_save_cache_create_key (self, data->zoom);
+  if (cache_key != NULL)
+    data->bytes = photos_base_item_save_cache_lookup (cache_key);
+
+  if (data->bytes != NULL)
+    {
+      photos_base_item_save_to_dir_create_file (self, task);
+      goto out;
+    }
+
   buffer = photos_gegl_get_buffer_from_node (graph, NULL);
   photos_gegl_buffer_zoom_async (buffer,
                                  data->zoom,
@@ -2421,6 +3192,7 @@ photos_base_item_save_to_file_file_replace (GObject *source_object, GAsyncResult
 
   photos_base_item_save_buffer_async (self,
                                       data->buffer,
+                                      NULL,
                                       file,
                                       stream,
                                       cancellable,
@@ -2650,33 +3422,17 @@ photos_base_item_save_to_stream_save_buffer (GObject *source_object, GAsyncResul
 
 
 static void
-photos_base_item_save_to_stream_buffer_zoom (GObject *source_object, GAsyncResult *res, gpointer user_data)
+photos_base_item_save_to_stream_save_buffer_to_tmp (PhotosBaseItem *self, GTask *task, GeglBuffer *buffer)
 {
-  g_autoptr (GTask) task = G_TASK (user_data);
-  PhotosBaseItem *self;
   GCancellable *cancellable;
   g_autoptr (GFile) file = NULL;
   g_autoptr (GFileIOStream) iostream = NULL;
   GOutputStream *ostream;
-  GeglBuffer *buffer = GEGL_BUFFER (source_object);
-  g_autoptr (GeglBuffer) buffer_zoomed = NULL;
   PhotosBaseItemSaveToStreamData *data;
 
-  self = PHOTOS_BASE_ITEM (g_task_get_source_object (task));
   cancellable = g_task_get_cancellable (task);
   data = (PhotosBaseItemSaveToStreamData *) g_task_get_task_data (task);
 
-  {
-    g_autoptr (GError) error = NULL;
-
-    buffer_zoomed = photos_gegl_buffer_zoom_finish (buffer, res, &error);
-    if (error != NULL)
-      {
-        g_task_return_error (task, g_steal_pointer (&error));
-        goto out;
-      }
-  }
-
   {
     g_autoptr (GError) error = NULL;
 
@@ -2696,7 +3452,8 @@ photos_base_item_save_to_stream_buffer_zoom (GObject *source_object, GAsyncResul
 
   ostream = g_io_stream_get_output_stream (G_IO_STREAM (iostream));
   photos_base_item_save_buffer_async (self,
-                                      buffer_zoomed,
+                                      buffer,
+                                      data->bytes,
                                       file,
                                       G_FILE_OUTPUT_STREAM (ostream),
                                       cancellable,
@@ -2708,6 +3465,34 @@ photos_base_item_save_to_stream_buffer_zoom (GObject *source_object, GAsyncResul
 }
 
 
+static void
+photos_base_item_save_to_stream_buffer_zoom (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autoptr (GTask) task = G_TASK (user_data);
+  PhotosBaseItem *self;
+  GeglBuffer *buffer = GEGL_BUFFER (source_object);
+  g_autoptr (GeglBuffer) buffer_zoomed = NULL;
+
+  self = PHOTOS_BASE_ITEM (g_task_get_source_object (task));
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    buffer_zoomed = photos_gegl_buffer_zoom_finish (buffer, res, &error);
+    if (error != NULL)
+      {
+        g_task_return_error (task, g_steal_pointer (&error));
+        goto out;
+      }
+  }
+
+  photos_base_item_save_to_stream_save_buffer_to_tmp (self, task, buffer_zoomed);
+
+ out:
+  return;
+}
+
+
 static void
 photos_base_item_save_to_stream_load (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
@@ -2717,6 +3502,7 @@ photos_base_item_save_to_stream_load (GObject *source_object, GAsyncResult *res,
   g_autoptr (GeglBuffer) buffer = NULL;
   g_autoptr (GeglNode) graph = NULL;
   PhotosBaseItemSaveToStreamData *data;
+  g_autofree gchar *cache_key = NULL;
 
   cancellable = g_task_get_cancellable (task);
   data = (PhotosBaseItemSaveToStreamData *) g_task_get_task_data (task);
@@ -2732,6 +3518,16 @@ photos_base_item_save_to_stream_load (GObject *source_object, GAsyncResult *res,
       }
   }
 
+  cache_key = photos_base_item_save_cache_create_key (self, data->zoom);
+  if (cache_key != NULL)
+    data->bytes = photos_base_item_save_cache_lookup (cache_key);
+
+  if (data->bytes != NULL)
+    {
+      photos_base_item_save_to_stream_save_buffer_to_tmp (self, task, NULL);
+      goto out;
+    }
+
   buffer = photos_gegl_get_buffer_from_node (graph, NULL);
   photos_gegl_buffer_zoom_async (buffer,
                                  data->zoom,
@@ -3139,6 +3935,41 @@ photos_base_item_set_property (GObject *object, guint prop_id, const GValue *val
 }
 
 
+static gint
+photos_base_item_get_n_thumbnail_threads (void)
+{
+  const gchar *threads_str;
+  gint ret_val;
+  guint n_processors;
+
+  threads_str = g_getenv ("GNOME_PHOTOS_THUMBNAIL_THREADS");
+  if (threads_str != NULL)
+    {
+      g_autoptr (GError) error = NULL;
+      guint64 threads;
+
+      if (g_ascii_string_to_unsigned (threads_str, 10, 1, MAX_THUMBNAIL_THREADS, &threads, &error))
+        {
+          ret_val = (gint) threads;
+          goto out;
+        }
+
+      g_warning ("Unable to parse GNOME_PHOTOS_THUMBNAIL_THREADS: %s", error->message);
+    }
+
+  /* Most of the time spent by a thumbnailing thread is spent waiting
+   * for I/O or for the out-of-process thumbnailer, so one thread per
+   * CPU core is enough to keep them busy.
+   */
+  n_processors = g_get_num_processors ();
+  ret_val = (gint) CLAMP (n_processors, 1U, MAX_THUMBNAIL_THREADS);
+
+ out:
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Using %d threads to create thumbnails", ret_val);
+  return ret_val;
+}
+
+
 static void
 photos_base_item_init (PhotosBaseItem *self)
 {
@@ -3216,12 +4047,14 @@ photos_base_item_class_init (PhotosBaseItemClass *class)
                                        NULL);
   dzl_task_cache_set_name (pipeline_cache, "PhotosPipeline cache");
 
+  save_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_bytes_unref);
+
+  create_thumbnail_queue = photos_thumbnail_queue_new ();
   create_thumbnail_pool = g_thread_pool_new (photos_base_item_create_thumbnail_in_thread_func,
                                              NULL,
-                                             1,
+                                             photos_base_item_get_n_thumbnail_threads (),
                                              FALSE,
                                              NULL);
-  g_thread_pool_set_sort_function (create_thumbnail_pool, photos_base_item_create_thumbnail_sort_func, NULL);
 }
 
 
@@ -3361,6 +4194,119 @@ photos_base_item_create_preview (PhotosBaseItem *self,
 }
 
 
+void
+photos_base_item_create_proxy_async (PhotosBaseItem *self,
+                                     gdouble zoom,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+  PhotosBaseItemPrivate *priv;
+  PhotosBaseItemCreateProxyData *data;
+  g_autoptr (GeglBuffer) buffer = NULL;
+  GeglBuffer *proxy_source_buffer = NULL;
+  GeglNode *buffer_source;
+  g_autoptr (GeglNode) graph = NULL;
+  GeglNode *output;
+  g_autoptr (GeglNode) proxy_graph = NULL;
+  GeglRectangle roi;
+  g_autoptr (GTask) task = NULL;
+  PhotosPipeline *pipeline;
+  gdouble scale;
+
+  g_return_if_fail (PHOTOS_IS_BASE_ITEM (self));
+  priv = photos_base_item_get_instance_private (self);
+
+  g_return_if_fail (!priv->collection);
+  g_return_if_fail (zoom > 0.0);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (priv->buffer_source != NULL);
+
+  pipeline = PHOTOS_PIPELINE (dzl_task_cache_peek (pipeline_cache, self));
+  g_return_if_fail (PHOTOS_IS_PIPELINE (pipeline));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, photos_base_item_create_proxy_async);
+
+  /* Only powers of two are used, so that the downscaled source can be
+   * reused as long as the zoom doesn't change much.
+   */
+  scale = 1.0;
+  while (scale / 2.0 >= zoom)
+    scale /= 2.0;
+
+  if (scale >= 1.0)
+    {
+      g_task_return_pointer (task, NULL, NULL);
+      goto out;
+    }
+
+  gegl_node_get (priv->buffer_source, "buffer", &buffer, NULL);
+  if (!GEGL_IS_BUFFER (buffer))
+    {
+      g_task_return_new_error (task, PHOTOS_ERROR, 0, "Failed to downscale the image");
+      goto out;
+    }
+
+  /* Downscaling the full resolution buffer is slow, so if it hasn't
+   * been done for this scale yet, it is left to the thread.
+   */
+  photos_base_item_get_proxy_source_roi (buffer, scale, &roi);
+  if (priv->proxy_source_buffer != NULL
+      && gegl_rectangle_equal (gegl_buffer_get_extent (priv->proxy_source_buffer), &roi))
+    proxy_source_buffer = priv->proxy_source_buffer;
+
+  graph = gegl_node_new ();
+  buffer_source = gegl_node_new_child (graph, "operation", "gegl:buffer-source", NULL);
+
+  proxy_graph = photos_pipeline_new_proxy_graph (pipeline, scale);
+  gegl_node_add_child (graph, proxy_graph);
+
+  output = gegl_node_get_output_proxy (graph, "output");
+  gegl_node_link_many (buffer_source, proxy_graph, output, NULL);
+
+  data = photos_base_item_create_proxy_data_new (graph, buffer_source, buffer, proxy_source_buffer, &roi, scale);
+  g_task_set_task_data (task, data, (GDestroyNotify) photos_base_item_create_proxy_data_free);
+  g_task_run_in_thread (task, photos_base_item_create_proxy_in_thread_func);
+
+ out:
+  return;
+}
+
+
+GeglBuffer *
+photos_base_item_create_proxy_finish (PhotosBaseItem *self, GAsyncResult *res, GError **error)
+{
+  PhotosBaseItemPrivate *priv;
+  PhotosBaseItemCreateProxyData *data;
+  GTask *task;
+
+  g_return_val_if_fail (PHOTOS_IS_BASE_ITEM (self), NULL);
+  priv = photos_base_item_get_instance_private (self);
+
+  g_return_val_if_fail (g_task_is_valid (res, self), NULL);
+  task = G_TASK (res);
+
+  g_return_val_if_fail (g_task_get_source_tag (task) == photos_base_item_create_proxy_async, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  /* Keep the source that was downscaled in the thread, unless the image
+   * was reloaded in the mean time.
+   */
+  data = (PhotosBaseItemCreateProxyData *) g_task_get_task_data (task);
+  if (data != NULL && data->downscaled && priv->buffer_source != NULL)
+    {
+      g_autoptr (GeglBuffer) buffer = NULL;
+
+      gegl_node_get (priv->buffer_source, "buffer", &buffer, NULL);
+      if (buffer == data->buffer)
+        g_set_object (&priv->proxy_source_buffer, data->proxy_source_buffer);
+    }
+
+  return g_task_propagate_pointer (task, error);
+}
+
+
 gchar *
 photos_base_item_create_thumbnail_path (PhotosBaseItem *self)
 {
@@ -3936,6 +4882,18 @@ photos_base_item_is_favorite (PhotosBaseItem *self)
 }
 
 
+gboolean
+photos_base_item_is_loaded (PhotosBaseItem *self)
+{
+  PhotosBaseItemPrivate *priv;
+
+  g_return_val_if_fail (PHOTOS_IS_BASE_ITEM (self), FALSE);
+  priv = photos_base_item_get_instance_private (self);
+
+  return priv->edit_graph != NULL;
+}
+
+
 void
 photos_base_item_load_async (PhotosBaseItem *self,
                              GCancellable *cancellable,
@@ -3994,6 +4952,68 @@ photos_base_item_load_finish (PhotosBaseItem *self, GAsyncResult *res, GError **
 }
 
 
+void
+photos_base_item_load_preview_async (PhotosBaseItem *self,
+                                     gint size,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+  PhotosBaseItemPrivate *priv;
+  g_autoptr (GFile) file = NULL;
+  g_autoptr (GTask) task = NULL;
+
+  g_return_if_fail (PHOTOS_IS_BASE_ITEM (self));
+  priv = photos_base_item_get_instance_private (self);
+
+  g_return_if_fail (size > 0);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (!priv->collection);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, photos_base_item_load_preview_async);
+  g_task_set_task_data (task,
+                        photos_base_item_load_preview_data_new (size),
+                        (GDestroyNotify) photos_base_item_load_preview_data_free);
+
+  /* Only local files can be decoded at a reduced size without first
+   * being downloaded in full, and once the item is loaded there is no
+   * point in a preview.
+   */
+  file = g_file_new_for_uri (priv->uri);
+  if (!g_file_is_native (file) || priv->edit_graph != NULL || priv->height <= 0 || priv->width <= 0)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "No preview is needed for this item");
+      goto out;
+    }
+
+  photos_base_item_load_pipeline_async (self,
+                                        cancellable,
+                                        photos_base_item_load_preview_load_pipeline,
+                                        g_object_ref (task));
+
+ out:
+  return;
+}
+
+
+GeglNode *
+photos_base_item_load_preview_finish (PhotosBaseItem *self, GAsyncResult *res, GError **error)
+{
+  GTask *task;
+
+  g_return_val_if_fail (PHOTOS_IS_BASE_ITEM (self), NULL);
+
+  g_return_val_if_fail (g_task_is_valid (res, self), NULL);
+  task = G_TASK (res);
+
+  g_return_val_if_fail (g_task_get_source_tag (task) == photos_base_item_load_preview_async, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (task, error);
+}
+
+
 void
 photos_base_item_mark_busy (PhotosBaseItem *self)
 {
@@ -4419,6 +5439,29 @@ photos_base_item_print (PhotosBaseItem *self, GtkWidget *toplevel)
 }
 
 
+void
+photos_base_item_prioritize_thumbnails (GList *items)
+{
+  GList *l;
+  guint n_visible = 0;
+
+  g_mutex_lock (&create_thumbnail_mutex);
+
+  photos_thumbnail_queue_demote_all (create_thumbnail_queue);
+
+  for (l = items; l != NULL; l = l->next)
+    {
+      if (photos_thumbnail_queue_promote (create_thumbnail_queue, l->data))
+        n_visible++;
+    }
+
+  g_mutex_unlock (&create_thumbnail_mutex);
+
+  if (n_visible > 0)
+    photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Prioritized thumbnails for %u visible items", n_visible);
+}
+
+
 GFileInfo *
 photos_base_item_query_info (PhotosBaseItem *self,
                              const gchar *attributes,
@@ -4807,6 +5850,20 @@ photos_base_item_trash_finish (PhotosBaseItem *self, GAsyncResult *res, GError *
 }
 
 
+void
+photos_base_item_unload (PhotosBaseItem *self)
+{
+  PhotosBaseItemPrivate *priv;
+
+  g_return_if_fail (PHOTOS_IS_BASE_ITEM (self));
+  priv = photos_base_item_get_instance_private (self);
+
+  g_return_if_fail (!priv->collection);
+
+  photos_base_item_clear_pixels (self);
+}
+
+
 void
 photos_base_item_unmark_busy (PhotosBaseItem *self)
 {
@@ -30,6 +30,8 @@
 #include <glib-object.h>
 #include <gtk/gtk.h>
 
+#include "photos-thumbnail-factory.h"
+
 G_BEGIN_DECLS
 
 #define PHOTOS_TYPE_BASE_ITEM (photos_base_item_get_type ())
@@ -60,6 +62,7 @@ struct _PhotosBaseItemClass
   GStrv       (*create_pipeline_paths)      (PhotosBaseItem *self);
   gboolean    (*create_thumbnail)           (PhotosBaseItem *self, GCancellable *cancellable, GError **error);
   gchar      *(*create_thumbnail_path)      (PhotosBaseItem *self);
+  gboolean    (*create_thumbnail_request)   (PhotosBaseItem *self, PhotosThumbnailFactoryRequest *request);
   GFile      *(*download)                   (PhotosBaseItem *self, GCancellable *cancellable, GError **error);
   GtkWidget  *(*get_source_widget)          (PhotosBaseItem *self);
   gboolean    (*metadata_add_shared)        (PhotosBaseItem  *self,
@@ -95,6 +98,16 @@ cairo_surface_t    *photos_base_item_create_preview          (PhotosBaseItem *se
                                                               const gchar *first_property_name,
                                                               ...) G_GNUC_NULL_TERMINATED G_GNUC_WARN_UNUSED_RESULT;
 
+void                photos_base_item_create_proxy_async      (PhotosBaseItem *self,
+                                                              gdouble zoom,
+                                                              GCancellable *cancellable,
+                                                              GAsyncReadyCallback callback,
+                                                              gpointer user_data);
+
+GeglBuffer         *photos_base_item_create_proxy_finish     (PhotosBaseItem *self,
+                                                              GAsyncResult *res,
+                                                              GError **error);
+
 gchar              *photos_base_item_create_thumbnail_path   (PhotosBaseItem *self) G_GNUC_WARN_UNUSED_RESULT;
 
 void                photos_base_item_destroy                 (PhotosBaseItem *self);
@@ -183,6 +196,8 @@ gboolean            photos_base_item_is_collection           (PhotosBaseItem *se
 
 gboolean            photos_base_item_is_favorite             (PhotosBaseItem *self);
 
+gboolean            photos_base_item_is_loaded               (PhotosBaseItem *self);
+
 void                photos_base_item_load_async              (PhotosBaseItem *self,
                                                               GCancellable *cancellable,
                                                               GAsyncReadyCallback callback,
@@ -192,6 +207,16 @@ GeglNode           *photos_base_item_load_finish             (PhotosBaseItem *se
                                                               GAsyncResult *res,
                                                               GError **error);
 
+void                photos_base_item_load_preview_async      (PhotosBaseItem *self,
+                                                              gint size,
+                                                              GCancellable *cancellable,
+                                                              GAsyncReadyCallback callback,
+                                                              gpointer user_data);
+
+GeglNode           *photos_base_item_load_preview_finish     (PhotosBaseItem *self,
+                                                              GAsyncResult *res,
+                                                              GError **error);
+
 void                photos_base_item_mark_busy               (PhotosBaseItem *self);
 
 void                photos_base_item_metadata_add_shared_async  (PhotosBaseItem *self,
@@ -277,6 +302,8 @@ void                photos_base_item_pipeline_snapshot       (PhotosBaseItem *se
 
 void                photos_base_item_print                   (PhotosBaseItem *self, GtkWidget *toplevel);
 
+void                photos_base_item_prioritize_thumbnails   (GList *items);
+
 GFileInfo          *photos_base_item_query_info              (PhotosBaseItem *self,
                                                               const gchar *attributes,
                                                               GFileQueryInfoFlags flags,
@@ -346,6 +373,8 @@ gboolean            photos_base_item_trash_finish            (PhotosBaseItem *se
                                                               GAsyncResult *res,
                                                               GError **error);
 
+void                photos_base_item_unload                  (PhotosBaseItem *self);
+
 void                photos_base_item_unmark_busy             (PhotosBaseItem *self);
 
 G_END_DECLS
@@ -106,13 +106,12 @@ static void
 photos_camera_cache_equipment_query_executed (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
   GTask *task = G_TASK (user_data);
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   g_autoptr (TrackerSparqlCursor) cursor = NULL;
 
   {
     g_autoptr (GError) error = NULL;
 
-    cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+    cursor = photos_tracker_queue_select_finish (source_object, res, &error);
     if (error != NULL)
       {
         g_task_return_error (task, g_steal_pointer (&error));
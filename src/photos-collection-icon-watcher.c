@@ -289,13 +289,12 @@ static void
 photos_collection_icon_watcher_query_executed (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
   PhotosCollectionIconWatcher *self = PHOTOS_COLLECTION_ICON_WATCHER (user_data);
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   g_autoptr (TrackerSparqlCursor) cursor = NULL;
 
   {
     g_autoptr (GError) error = NULL;
 
-    cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+    cursor = photos_tracker_queue_select_finish (source_object, res, &error);
     if (error != NULL)
       {
         g_warning ("Unable to query collection items: %s", error->message);
@@ -334,12 +333,13 @@ photos_collection_icon_watcher_start (PhotosCollectionIconWatcher *self)
 
   id = photos_filterable_get_id (PHOTOS_FILTERABLE (self->collection));
   query = photos_query_builder_collection_icon_query (state, id);
-  photos_tracker_queue_select (self->queue,
-                               query,
-                               NULL,
-                               photos_collection_icon_watcher_query_executed,
-                               g_object_ref (self),
-                               g_object_unref);
+  photos_tracker_queue_select_with_priority (self->queue,
+                                             query,
+                                             PHOTOS_TRACKER_QUEUE_PRIORITY_BACKGROUND,
+                                             NULL,
+                                             photos_collection_icon_watcher_query_executed,
+                                             g_object_ref (self),
+                                             g_object_unref);
 }
 
 
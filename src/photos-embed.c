@@ -365,6 +365,17 @@ photos_embed_load_finished (PhotosEmbed *self, PhotosBaseItem *item, GeglNode *n
 }
 
 
+static void
+photos_embed_load_preview (PhotosEmbed *self, PhotosBaseItem *item, GeglNode *node)
+{
+  photos_embed_clear_load_timer (self);
+  photos_spinner_box_stop (PHOTOS_SPINNER_BOX (self->spinner_box));
+  g_return_if_fail (GEGL_IS_NODE (node));
+
+  photos_preview_view_set_node (PHOTOS_PREVIEW_VIEW (self->preview), node);
+}
+
+
 static gboolean
 photos_embed_load_show_timeout (gpointer user_data)
 {
@@ -885,6 +896,11 @@ photos_embed_init (PhotosEmbed *self)
                            G_CALLBACK (photos_embed_load_finished),
                            self,
                            G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->item_mngr,
+                           "load-preview",
+                           G_CALLBACK (photos_embed_load_preview),
+                           self,
+                           G_CONNECT_SWAPPED);
   g_signal_connect_object (self->item_mngr,
                            "load-started",
                            G_CALLBACK (photos_embed_load_started),
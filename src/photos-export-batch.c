@@ -0,0 +1,349 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include "photos-base-item.h"
+#include "photos-base-manager.h"
+#include "photos-debug.h"
+#include "photos-export-batch.h"
+#include "photos-search-context.h"
+
+
+typedef struct _PhotosExportBatchData PhotosExportBatchData;
+typedef struct _PhotosExportBatchJob PhotosExportBatchJob;
+
+struct _PhotosExportBatchData
+{
+  GDestroyNotify progress_data_destroy;
+  GError *error;
+  GFile *dir;
+  GHashTable *jobs;
+  GList *exported;
+  GQueue *pending;
+  PhotosExportBatchProgressFunc progress_func;
+  gpointer progress_data;
+  gdouble zoom;
+  guint64 memory_in_use;
+  guint max_jobs;
+  guint n_done;
+  guint n_items;
+};
+
+struct _PhotosExportBatchJob
+{
+  gboolean was_loaded;
+  guint64 cost;
+};
+
+/* An export keeps the decoded original, the output of the edit
+ * pipeline and the zoomed copy alive at the same time. GEGL works in
+ * 32-bit float RGBA, so use that as the size of a pixel.
+ */
+static const gdouble BYTES_PER_PIXEL = 16.0;
+
+/* Used when Tracker doesn't know the dimensions of an item. */
+static const guint64 DEFAULT_N_PIXELS = 24000000;
+
+/* Upper bound on the estimated memory used by the exports that are in
+ * flight. A single item is always allowed to run, even if it is
+ * larger than this.
+ */
+static const guint64 MEMORY_BUDGET = 1024 * 1024 * 1024;
+
+
+static PhotosExportBatchData *
+photos_export_batch_data_new (GList *items,
+                              GFile *dir,
+                              gdouble zoom,
+                              PhotosExportBatchProgressFunc progress_func,
+                              gpointer progress_data,
+                              GDestroyNotify progress_data_destroy)
+{
+  PhotosExportBatchData *data;
+  GList *l;
+
+  data = g_slice_new0 (PhotosExportBatchData);
+  data->dir = g_object_ref (dir);
+  data->jobs = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, g_free);
+  data->pending = g_queue_new ();
+  data->progress_func = progress_func;
+  data->progress_data = progress_data;
+  data->progress_data_destroy = progress_data_destroy;
+  data->zoom = zoom;
+  data->max_jobs = (guint) MAX (g_get_num_processors (), 1);
+
+  for (l = items; l != NULL; l = l->next)
+    {
+      PhotosBaseItem *item = PHOTOS_BASE_ITEM (l->data);
+
+      g_queue_push_tail (data->pending, g_object_ref (item));
+    }
+
+  data->n_items = g_queue_get_length (data->pending);
+
+  return data;
+}
+
+
+static void
+photos_export_batch_data_free (PhotosExportBatchData *data)
+{
+  g_assert_cmpuint (g_hash_table_size (data->jobs), ==, 0);
+
+  if (data->progress_data_destroy != NULL)
+    (*data->progress_data_destroy) (data->progress_data);
+
+  g_clear_error (&data->error);
+  g_object_unref (data->dir);
+  g_hash_table_unref (data->jobs);
+  g_list_free_full (data->exported, g_object_unref);
+  g_queue_free_full (data->pending, g_object_unref);
+  g_slice_free (PhotosExportBatchData, data);
+}
+
+
+static guint64
+photos_export_batch_get_cost (PhotosBaseItem *item, gdouble zoom)
+{
+  gint64 height;
+  gint64 width;
+  guint64 n_pixels;
+
+  height = photos_base_item_get_height (item);
+  width = photos_base_item_get_width (item);
+
+  if (height > 0 && width > 0)
+    n_pixels = (guint64) height * (guint64) width;
+  else
+    n_pixels = DEFAULT_N_PIXELS;
+
+  return (guint64) ((gdouble) n_pixels * BYTES_PER_PIXEL * (2.0 + zoom * zoom));
+}
+
+
+static void
+photos_export_batch_unload (PhotosBaseItem *item)
+{
+  GApplication *app;
+  GObject *active_object;
+  PhotosSearchContextState *state;
+
+  app = g_application_get_default ();
+  state = photos_search_context_get_state (PHOTOS_SEARCH_CONTEXT (app));
+
+  /* The item might have been opened while it was being exported. */
+  active_object = photos_base_manager_get_active_object (state->item_mngr);
+  if ((GObject *) item == active_object)
+    return;
+
+  photos_base_item_unload (item);
+}
+
+
+static void photos_export_batch_schedule (GTask *task);
+
+
+static void
+photos_export_batch_save_to_dir (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  PhotosBaseItem *item = PHOTOS_BASE_ITEM (source_object);
+  g_autoptr (GTask) task = G_TASK (user_data);
+  PhotosExportBatchData *data;
+  PhotosExportBatchJob *job;
+
+  data = (PhotosExportBatchData *) g_task_get_task_data (task);
+
+  job = (PhotosExportBatchJob *) g_hash_table_lookup (data->jobs, item);
+  g_assert_nonnull (job);
+
+  {
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GFile) file = NULL;
+
+    file = photos_base_item_save_to_dir_finish (item, res, &error);
+    if (error != NULL)
+      {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+          {
+            const gchar *uri;
+
+            uri = photos_base_item_get_uri (item);
+            g_warning ("Unable to export %s: %s", uri, error->message);
+
+            if (data->error == NULL)
+              data->error = g_steal_pointer (&error);
+          }
+      }
+    else
+      {
+        data->exported = g_list_prepend (data->exported, g_object_ref (item));
+      }
+  }
+
+  /* Don't let the decoded pixels of every exported item pile up. */
+  if (!job->was_loaded)
+    photos_export_batch_unload (item);
+
+  g_assert_cmpuint (data->memory_in_use, >=, job->cost);
+  data->memory_in_use -= job->cost;
+  data->n_done++;
+
+  g_hash_table_remove (data->jobs, item);
+
+  if (data->progress_func != NULL)
+    (*data->progress_func) (data->n_done, data->n_items, data->progress_data);
+
+  photos_export_batch_schedule (task);
+}
+
+
+static void
+photos_export_batch_schedule (GTask *task)
+{
+  GCancellable *cancellable;
+  PhotosExportBatchData *data;
+
+  cancellable = g_task_get_cancellable (task);
+  data = (PhotosExportBatchData *) g_task_get_task_data (task);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    {
+      while (!g_queue_is_empty (data->pending))
+        {
+          g_autoptr (PhotosBaseItem) item = NULL;
+
+          item = PHOTOS_BASE_ITEM (g_queue_pop_head (data->pending));
+        }
+    }
+
+  while (!g_queue_is_empty (data->pending))
+    {
+      PhotosBaseItem *item;
+      PhotosExportBatchJob *job;
+      guint n_jobs;
+      guint64 cost;
+
+      n_jobs = g_hash_table_size (data->jobs);
+      if (n_jobs >= data->max_jobs)
+        break;
+
+      item = PHOTOS_BASE_ITEM (g_queue_peek_head (data->pending));
+      cost = photos_export_batch_get_cost (item, data->zoom);
+      if (n_jobs > 0 && data->memory_in_use + cost > MEMORY_BUDGET)
+        break;
+
+      item = PHOTOS_BASE_ITEM (g_queue_pop_head (data->pending));
+
+      /* The selection can't have duplicates. */
+      g_assert_false (g_hash_table_contains (data->jobs, item));
+
+      job = g_new0 (PhotosExportBatchJob, 1);
+      job->cost = cost;
+      job->was_loaded = photos_base_item_is_loaded (item);
+      g_hash_table_insert (data->jobs, item, job);
+
+      data->memory_in_use += cost;
+
+      photos_debug (PHOTOS_DEBUG_MEMORY,
+                    "Export Batch: Starting %s (%u of %u, %u in flight, %" G_GUINT64_FORMAT " bytes)",
+                    photos_base_item_get_uri (item),
+                    data->n_done + n_jobs + 1,
+                    data->n_items,
+                    n_jobs + 1,
+                    data->memory_in_use);
+
+      photos_base_item_save_to_dir_async (item,
+                                          data->dir,
+                                          data->zoom,
+                                          cancellable,
+                                          photos_export_batch_save_to_dir,
+                                          g_object_ref (task));
+    }
+
+  if (g_hash_table_size (data->jobs) > 0)
+    return;
+
+  g_assert_true (g_queue_is_empty (data->pending));
+  data->exported = g_list_reverse (data->exported);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (data->error != NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&data->error));
+      return;
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+
+void
+photos_export_batch_async (GList *items,
+                           GFile *dir,
+                           gdouble zoom,
+                           PhotosExportBatchProgressFunc progress_func,
+                           gpointer progress_data,
+                           GDestroyNotify progress_data_destroy,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  PhotosExportBatchData *data;
+
+  g_return_if_fail (items != NULL);
+  g_return_if_fail (G_IS_FILE (dir));
+  g_return_if_fail (zoom > 0.0);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  data = photos_export_batch_data_new (items, dir, zoom, progress_func, progress_data, progress_data_destroy);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, photos_export_batch_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) photos_export_batch_data_free);
+
+  photos_export_batch_schedule (task);
+}
+
+
+gboolean
+photos_export_batch_finish (GAsyncResult *res, GList **out_exported, GError **error)
+{
+  GTask *task;
+  PhotosExportBatchData *data;
+
+  g_return_val_if_fail (g_task_is_valid (res, NULL), FALSE);
+  task = G_TASK (res);
+
+  g_return_val_if_fail (g_task_get_source_tag (task) == photos_export_batch_async, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  data = (PhotosExportBatchData *) g_task_get_task_data (task);
+
+  /* Items that were exported before a failure or cancellation are
+   * still on disk, so report them either way.
+   */
+  if (out_exported != NULL)
+    *out_exported = g_list_copy_deep (data->exported, (GCopyFunc) g_object_ref, NULL);
+
+  return g_task_propagate_boolean (task, error);
+}
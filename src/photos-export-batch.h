@@ -0,0 +1,42 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_EXPORT_BATCH_H
+#define PHOTOS_EXPORT_BATCH_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef void (*PhotosExportBatchProgressFunc) (guint n_done, guint n_items, gpointer user_data);
+
+void                photos_export_batch_async         (GList *items,
+                                                       GFile *dir,
+                                                       gdouble zoom,
+                                                       PhotosExportBatchProgressFunc progress_func,
+                                                       gpointer progress_data,
+                                                       GDestroyNotify progress_data_destroy,
+                                                       GCancellable *cancellable,
+                                                       GAsyncReadyCallback callback,
+                                                       gpointer user_data);
+
+gboolean            photos_export_batch_finish        (GAsyncResult *res, GList **out_exported, GError **error);
+
+G_END_DECLS
+
+#endif /* PHOTOS_EXPORT_BATCH_H */
@@ -38,14 +38,14 @@ struct _PhotosExportDialog
   GtkWidget *reduced_button;
   GtkWidget *reduced_label;
   GtkWidget *size_label;
-  PhotosBaseItem *item;
+  GList *items;
   gdouble reduced_zoom;
 };
 
 enum
 {
   PROP_0,
-  PROP_ITEM
+  PROP_ITEMS
 };
 
 
@@ -172,14 +172,17 @@ static void
 photos_export_dialog_constructed (GObject *object)
 {
   PhotosExportDialog *self = PHOTOS_EXPORT_DIALOG (object);
+  PhotosBaseItem *item;
 
   G_OBJECT_CLASS (photos_export_dialog_parent_class)->constructed (object);
 
-  if (photos_base_item_is_collection (self->item))
+  item = PHOTOS_BASE_ITEM (self->items->data);
+
+  if (photos_base_item_is_collection (item))
     {
       const gchar *name;
 
-      name = photos_base_item_get_name_with_fallback (self->item);
+      name = photos_base_item_get_name_with_fallback (item);
       gtk_entry_set_text (GTK_ENTRY (self->dir_entry), name);
     }
   else
@@ -196,11 +199,17 @@ photos_export_dialog_constructed (GObject *object)
 
       gtk_entry_set_text (GTK_ENTRY (self->dir_entry), now_str);
 
-      photos_export_dialog_show_size_options (self, FALSE, TRUE);
-      photos_base_item_guess_save_sizes_async (self->item,
-                                               self->cancellable,
-                                               photos_export_dialog_guess_sizes,
-                                               self);
+      /* The reduced size is specific to each item, so a batch is
+       * always exported at full size.
+       */
+      if (self->items->next == NULL) /* length == 1 */
+        {
+          photos_export_dialog_show_size_options (self, FALSE, TRUE);
+          photos_base_item_guess_save_sizes_async (item,
+                                                   self->cancellable,
+                                                   photos_export_dialog_guess_sizes,
+                                                   self);
+        }
     }
 
   gtk_widget_grab_focus (self->dir_entry);
@@ -216,7 +225,12 @@ photos_export_dialog_dispose (GObject *object)
     g_cancellable_cancel (self->cancellable);
 
   g_clear_object (&self->cancellable);
-  g_clear_object (&self->item);
+
+  if (self->items != NULL)
+    {
+      g_list_free_full (self->items, g_object_unref);
+      self->items = NULL;
+    }
 
   G_OBJECT_CLASS (photos_export_dialog_parent_class)->dispose (object);
 }
@@ -229,9 +243,14 @@ photos_export_dialog_set_property (GObject *object, guint prop_id, const GValue
 
   switch (prop_id)
     {
-    case PROP_ITEM:
-      self->item = PHOTOS_BASE_ITEM (g_value_dup_object (value));
-      break;
+    case PROP_ITEMS:
+      {
+        GList *items;
+
+        items = (GList *) g_value_get_pointer (value);
+        self->items = g_list_copy_deep (items, (GCopyFunc) g_object_ref, NULL);
+        break;
+      }
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -267,12 +286,11 @@ photos_export_dialog_class_init (PhotosExportDialogClass *class)
   object_class->set_property = photos_export_dialog_set_property;
 
   g_object_class_install_property (object_class,
-                                   PROP_ITEM,
-                                   g_param_spec_object ("item",
-                                                        "PhotosBaseItem object",
-                                                        "The item to export",
-                                                        PHOTOS_TYPE_BASE_ITEM,
-                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
+                                   PROP_ITEMS,
+                                   g_param_spec_pointer ("items",
+                                                         "List of PhotosBaseItems",
+                                                         "The items to export",
+                                                         G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
 
   gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/Photos/export-dialog.ui");
   gtk_widget_class_bind_template_child (widget_class, PhotosExportDialog, dir_entry);
@@ -287,13 +305,13 @@ photos_export_dialog_class_init (PhotosExportDialogClass *class)
 
 
 GtkWidget *
-photos_export_dialog_new (GtkWindow *parent, PhotosBaseItem *item)
+photos_export_dialog_new (GtkWindow *parent, GList *items)
 {
   g_return_val_if_fail (GTK_IS_WINDOW (parent), NULL);
-  g_return_val_if_fail (PHOTOS_IS_BASE_ITEM (item), NULL);
+  g_return_val_if_fail (items != NULL, NULL);
 
   return g_object_new (PHOTOS_TYPE_EXPORT_DIALOG,
-                       "item", item,
+                       "items", items,
                        "transient-for", parent,
                        "use-header-bar", TRUE,
                        NULL);
@@ -28,7 +28,7 @@ G_BEGIN_DECLS
 #define PHOTOS_TYPE_EXPORT_DIALOG (photos_export_dialog_get_type ())
 G_DECLARE_FINAL_TYPE (PhotosExportDialog, photos_export_dialog, PHOTOS, EXPORT_DIALOG, GtkDialog);
 
-GtkWidget          *photos_export_dialog_new                (GtkWindow *parent, PhotosBaseItem *item);
+GtkWidget          *photos_export_dialog_new                (GtkWindow *parent, GList *items);
 
 const gchar        *photos_export_dialog_get_dir_name       (PhotosExportDialog *self);
 
@@ -34,19 +34,26 @@
 struct _PhotosExportNotification
 {
   GtkGrid parent_instance;
+  GCancellable *cancellable;
   GtkWidget *ntfctn_mngr;
+  GtkWidget *spinner;
+  GtkWidget *status_label;
+  GtkWidget *stop_button;
   GError *error;
   GFile *file;
   GList *items;
+  guint n_items;
   guint timeout_id;
 };
 
 enum
 {
   PROP_0,
+  PROP_CANCELLABLE,
   PROP_ERROR,
   PROP_FILE,
-  PROP_ITEMS
+  PROP_ITEMS,
+  PROP_N_ITEMS
 };
 
 
@@ -281,6 +288,47 @@ photos_export_notification_open (PhotosExportNotification *self)
 }
 
 
+static void
+photos_export_notification_stop_clicked (PhotosExportNotification *self)
+{
+  g_cancellable_cancel (self->cancellable);
+  gtk_widget_set_sensitive (self->stop_button, FALSE);
+}
+
+
+static void
+photos_export_notification_constructed_progress (PhotosExportNotification *self)
+{
+  GtkWidget *image;
+
+  self->spinner = gtk_spinner_new ();
+  gtk_widget_set_size_request (self->spinner, 16, 16);
+  gtk_container_add (GTK_CONTAINER (self), self->spinner);
+  gtk_spinner_start (GTK_SPINNER (self->spinner));
+
+  self->status_label = gtk_label_new (NULL);
+  gtk_widget_set_halign (self->status_label, GTK_ALIGN_START);
+  gtk_widget_set_hexpand (self->status_label, TRUE);
+  gtk_container_add (GTK_CONTAINER (self), self->status_label);
+
+  image = gtk_image_new_from_icon_name ("process-stop-symbolic", GTK_ICON_SIZE_INVALID);
+  gtk_widget_set_margin_bottom (image, 2);
+  gtk_widget_set_margin_top (image, 2);
+  gtk_image_set_pixel_size (GTK_IMAGE (image), 16);
+
+  self->stop_button = gtk_button_new ();
+  gtk_widget_set_valign (self->stop_button, GTK_ALIGN_CENTER);
+  gtk_button_set_image (GTK_BUTTON (self->stop_button), image);
+  gtk_container_add (GTK_CONTAINER (self), self->stop_button);
+  g_signal_connect_swapped (self->stop_button,
+                            "clicked",
+                            G_CALLBACK (photos_export_notification_stop_clicked),
+                            self);
+
+  photos_export_notification_set_progress (self, 0);
+}
+
+
 static gboolean
 photos_export_notification_timeout (gpointer user_data)
 {
@@ -307,6 +355,17 @@ photos_export_notification_constructed (GObject *object)
   gtk_grid_set_column_spacing (GTK_GRID (self), 12);
   gtk_orientable_set_orientation (GTK_ORIENTABLE (self), GTK_ORIENTATION_HORIZONTAL);
 
+  /* An export that is still running stays around until it is
+   * destroyed by whoever started it.
+   */
+  if (self->cancellable != NULL)
+    {
+      photos_export_notification_constructed_progress (self);
+      photos_notification_manager_add_notification (PHOTOS_NOTIFICATION_MANAGER (self->ntfctn_mngr),
+                                                    GTK_WIDGET (self));
+      return;
+    }
+
   length = g_list_length (self->items);
 
   if (length == 0)
@@ -417,9 +476,15 @@ photos_export_notification_dispose (GObject *object)
       self->items = NULL;
     }
 
+  g_clear_object (&self->cancellable);
   g_clear_object (&self->file);
   g_clear_object (&self->ntfctn_mngr);
 
+  /* Owned by the GtkGrid, and gone after it is destroyed. */
+  self->spinner = NULL;
+  self->status_label = NULL;
+  self->stop_button = NULL;
+
   G_OBJECT_CLASS (photos_export_notification_parent_class)->dispose (object);
 }
 
@@ -442,6 +507,10 @@ photos_export_notification_set_property (GObject *object, guint prop_id, const G
 
   switch (prop_id)
     {
+    case PROP_CANCELLABLE:
+      self->cancellable = (GCancellable *) g_value_dup_object (value);
+      break;
+
     case PROP_ERROR:
       self->error = (GError *) g_value_dup_boxed (value);
       break;
@@ -459,6 +528,10 @@ photos_export_notification_set_property (GObject *object, guint prop_id, const G
         break;
       }
 
+    case PROP_N_ITEMS:
+      self->n_items = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -483,6 +556,14 @@ photos_export_notification_class_init (PhotosExportNotificationClass *class)
   object_class->finalize = photos_export_notification_finalize;
   object_class->set_property = photos_export_notification_set_property;
 
+  g_object_class_install_property (object_class,
+                                   PROP_CANCELLABLE,
+                                   g_param_spec_object ("cancellable",
+                                                        "GCancellable",
+                                                        "A GCancellable to stop an export that is in progress",
+                                                        G_TYPE_CANCELLABLE,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
+
   g_object_class_install_property (object_class,
                                    PROP_ERROR,
                                    g_param_spec_boxed ("error",
@@ -505,6 +586,16 @@ photos_export_notification_class_init (PhotosExportNotificationClass *class)
                                                          "List of PhotosBaseItems",
                                                          "List of items that were exported",
                                                          G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_N_ITEMS,
+                                   g_param_spec_uint ("n-items",
+                                                      "Number of items",
+                                                      "Number of items in an export that is in progress",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      0,
+                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
 }
 
 
@@ -524,3 +615,35 @@ photos_export_notification_new_with_error (GError *error)
   g_return_if_fail (error != NULL);
   g_object_new (PHOTOS_TYPE_EXPORT_NOTIFICATION, "error", error, NULL);
 }
+
+
+PhotosExportNotification *
+photos_export_notification_new_with_progress (guint n_items, GCancellable *cancellable)
+{
+  g_return_val_if_fail (n_items > 0, NULL);
+  g_return_val_if_fail (G_IS_CANCELLABLE (cancellable), NULL);
+
+  return g_object_new (PHOTOS_TYPE_EXPORT_NOTIFICATION, "cancellable", cancellable, "n-items", n_items, NULL);
+}
+
+
+void
+photos_export_notification_set_progress (PhotosExportNotification *self, guint n_exported)
+{
+  g_autofree gchar *status = NULL;
+
+  g_return_if_fail (PHOTOS_IS_EXPORT_NOTIFICATION (self));
+  g_return_if_fail (self->cancellable != NULL);
+  g_return_if_fail (n_exported <= self->n_items);
+
+  if (self->status_label == NULL)
+    return;
+
+  /* Translators: this is the progress of an export of several items,
+   * in the form "Exporting 12 of 500 items…".
+   */
+  status = g_strdup_printf (ngettext ("Exporting %u of %u item…", "Exporting %u of %u items…", self->n_items),
+                            n_exported,
+                            self->n_items);
+  gtk_label_set_text (GTK_LABEL (self->status_label), status);
+}
@@ -32,6 +32,10 @@ void                photos_export_notification_new             (GList *items, GF
 
 void                photos_export_notification_new_with_error  (GError *error);
 
+PhotosExportNotification *photos_export_notification_new_with_progress (guint n_items, GCancellable *cancellable);
+
+void                photos_export_notification_set_progress    (PhotosExportNotification *self, guint n_exported);
+
 G_END_DECLS
 
 #endif /* PHOTOS_EXPORT_NOTIFICATION_H */
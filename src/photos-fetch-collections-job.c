@@ -106,7 +106,6 @@ static void
 photos_fetch_collections_job_query_executed (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
   GTask *task = G_TASK (user_data);
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   GCancellable *cancellable;
   TrackerSparqlCursor *cursor;
   GError *error;
@@ -114,7 +113,7 @@ photos_fetch_collections_job_query_executed (GObject *source_object, GAsyncResul
   cancellable = g_task_get_cancellable (task);
 
   error = NULL;
-  cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+  cursor = photos_tracker_queue_select_finish (source_object, res, &error);
   if (error != NULL)
     {
       g_task_return_error (task, error);
@@ -103,14 +103,13 @@ photos_fetch_ids_job_query_executed (GObject *source_object, GAsyncResult *res,
 {
   GCancellable *cancellable;
   GTask *task = G_TASK (user_data);
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   TrackerSparqlCursor *cursor; /* TODO: Use g_autoptr */
   GError *error;
 
   cancellable = g_task_get_cancellable (task);
 
   error = NULL;
-  cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+  cursor = photos_tracker_queue_select_finish (source_object, res, &error);
   if (error != NULL)
     {
       g_task_return_error (task, error);
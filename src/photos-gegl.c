@@ -23,8 +23,11 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "photos-debug.h"
 #include "photos-gegl.h"
+#include "photos-jpeg-save.h"
 #include "photos-operation-insta-clarendon.h"
 #include "photos-operation-insta-curve.h"
 #include "photos-operation-insta-filter.h"
@@ -35,6 +38,7 @@
 #include "photos-operation-png-guess-sizes.h"
 #include "photos-operation-saturation.h"
 #include "photos-operation-svg-multiply.h"
+#include "photos-png-save.h"
 #include "photos-quarks.h"
 
 
@@ -54,12 +58,12 @@ static const gchar *REQUIRED_GEGL_OPS[] =
   "gegl:buffer-source",
   "gegl:crop",
   "gegl:exposure",
-  "gegl:gray",
   "gegl:load",
   "gegl:noise-reduction",
   "gegl:nop",
   "gegl:scale-ratio",
   "gegl:shadows-highlights",
+  "gegl:translate",
   "gegl:unsharp-mask",
 
   /* Used by gegl:load */
@@ -70,306 +74,391 @@ static const gchar *REQUIRED_GEGL_OPS[] =
 };
 
 
+typedef struct _PhotosGeglBufferApplyOrientationData PhotosGeglBufferApplyOrientationData;
+
+struct _PhotosGeglBufferApplyOrientationData
+{
+  const Babl *format;
+  GeglBuffer *buffer_original;
+  GeglBuffer *buffer_oriented;
+  GeglRectangle bbox_original;
+  GeglRectangle bbox_oriented;
+  gint bpp;
+  gint tile_height;
+  gint tile_width;
+
+  /* Maps the pixel (x', y'), relative to the origin of the oriented
+   * buffer, to the pixel (x, y), relative to the origin of the
+   * original buffer:
+   *   x = x0 + xx * x' + xy * y'
+   *   y = y0 + yx * x' + yy * y'
+   */
+  gint x0;
+  gint xx;
+  gint xy;
+  gint y0;
+  gint yx;
+  gint yy;
+};
+
+typedef struct _PhotosGeglBufferSaveToStreamData PhotosGeglBufferSaveToStreamData;
+
+struct _PhotosGeglBufferSaveToStreamData
+{
+  GOutputStream *stream;
+  gchar *mime_type;
+};
+
+/* Cost of an additional thread, in pixels, for
+ * gegl_parallel_distribute_area. Copying a pixel is cheap, so don't
+ * bother with threads for anything smaller than a couple of tiles.
+ */
+static const gdouble APPLY_ORIENTATION_THREAD_COST = 16384.0;
+
+
+static inline void
+photos_gegl_buffer_apply_orientation_copy_pixels (guchar *dest,
+                                                  const guchar *src,
+                                                  gssize src_step,
+                                                  gsize bpp,
+                                                  gint n_pixels)
+{
+  gint i;
+
+  /* Called with a constant bpp, so that the memcpy can be inlined
+   * into a single load and store of the whole pixel.
+   */
+  for (i = 0; i < n_pixels; i++)
+    {
+      memcpy (dest, src, bpp);
+      dest += bpp;
+      src += src_step;
+    }
+}
+
+
+static void
+photos_gegl_buffer_apply_orientation_copy_row (guchar *dest, const guchar *src, gssize src_step, gint bpp, gint n_pixels)
+{
+  if (src_step == bpp)
+    {
+      memcpy (dest, src, (gsize) n_pixels * (gsize) bpp);
+      return;
+    }
+
+  switch (bpp)
+    {
+    case 1:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 1, n_pixels);
+      break;
+
+    case 2:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 2, n_pixels);
+      break;
+
+    case 3:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 3, n_pixels);
+      break;
+
+    case 4:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 4, n_pixels);
+      break;
+
+    case 6:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 6, n_pixels);
+      break;
+
+    case 8:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 8, n_pixels);
+      break;
+
+    case 12:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 12, n_pixels);
+      break;
+
+    case 16:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, 16, n_pixels);
+      break;
+
+    default:
+      photos_gegl_buffer_apply_orientation_copy_pixels (dest, src, src_step, (gsize) bpp, n_pixels);
+      break;
+    }
+}
+
+
 static void
-photos_gegl_buffer_apply_orientation_flip_in_place (guchar *buf, gint bpp, gint n_pixels)
+photos_gegl_buffer_apply_orientation_block (PhotosGeglBufferApplyOrientationData *data,
+                                            const GeglRectangle *block,
+                                            guchar *buf_original,
+                                            guchar *buf_oriented)
 {
+  GeglRectangle block_original;
+  const guchar *row_original;
+  gssize step_x;
+  gssize step_y;
   gint i;
+  gint stride_original;
+  gint stride_oriented;
+  gint x1;
+  gint x2;
+  gint x_rel;
+  gint y1;
+  gint y2;
+  gint y_rel;
+
+  x_rel = block->x - data->bbox_oriented.x;
+  y_rel = block->y - data->bbox_oriented.y;
+
+  /* The top-left and bottom-right corners of the block map to two
+   * opposite corners of the corresponding block in the original.
+   */
+  x1 = data->x0 + data->xx * x_rel + data->xy * y_rel;
+  y1 = data->y0 + data->yx * x_rel + data->yy * y_rel;
+  x2 = data->x0 + data->xx * (x_rel + block->width - 1) + data->xy * (y_rel + block->height - 1);
+  y2 = data->y0 + data->yx * (x_rel + block->width - 1) + data->yy * (y_rel + block->height - 1);
+
+  block_original.x = data->bbox_original.x + MIN (x1, x2);
+  block_original.y = data->bbox_original.y + MIN (y1, y2);
+  block_original.height = ABS (y2 - y1) + 1;
+  block_original.width = ABS (x2 - x1) + 1;
+
+  stride_original = block_original.width * data->bpp;
+  stride_oriented = block->width * data->bpp;
+
+  gegl_buffer_get (data->buffer_original,
+                   &block_original,
+                   1.0,
+                   data->format,
+                   buf_original,
+                   stride_original,
+                   GEGL_ABYSS_NONE);
+
+  step_x = (gssize) data->xx * data->bpp + (gssize) data->yx * stride_original;
+  step_y = (gssize) data->xy * data->bpp + (gssize) data->yy * stride_original;
+  row_original = buf_original + (x1 - MIN (x1, x2)) * data->bpp + (y1 - MIN (y1, y2)) * stride_original;
+
+  for (i = 0; i < block->height; i++)
+    {
+      guchar *row_oriented = buf_oriented + i * stride_oriented;
+
+      photos_gegl_buffer_apply_orientation_copy_row (row_oriented, row_original, step_x, data->bpp, block->width);
+      row_original += step_y;
+    }
 
-  for (i = 0; i < n_pixels / 2; i++)
+  gegl_buffer_set (data->buffer_oriented, block, 0, data->format, buf_oriented, stride_oriented);
+}
+
+
+static void
+photos_gegl_buffer_apply_orientation_area (const GeglRectangle *area, gpointer user_data)
+{
+  PhotosGeglBufferApplyOrientationData *data = (PhotosGeglBufferApplyOrientationData *) user_data;
+  g_autofree guchar *buf_original = NULL;
+  g_autofree guchar *buf_oriented = NULL;
+  gsize n_pixels;
+  gint y;
+
+  n_pixels = (gsize) data->tile_width * (gsize) data->tile_height;
+  buf_original = g_malloc_n (n_pixels, (gsize) data->bpp);
+  buf_oriented = g_malloc_n (n_pixels, (gsize) data->bpp);
+
+  /* Walk the area in blocks that are aligned with the tiles of the
+   * oriented buffer, so that each gegl_buffer_set touches exactly one
+   * tile and each block fits comfortably in the cache.
+   */
+  y = area->y;
+  while (y < area->y + area->height)
     {
-      gint j;
-      guchar *pixel_left = buf + i * bpp;
-      guchar *pixel_right = buf + (n_pixels - 1 - i) * bpp;
+      gint block_height;
+      gint x;
 
-      for (j = 0; j < bpp; j++)
+      block_height = data->tile_height - (y - data->bbox_oriented.y) % data->tile_height;
+      block_height = MIN (block_height, area->y + area->height - y);
+
+      x = area->x;
+      while (x < area->x + area->width)
         {
-          guchar tmp = pixel_left[j];
+          GeglRectangle block;
+          gint block_width;
+
+          block_width = data->tile_width - (x - data->bbox_oriented.x) % data->tile_width;
+          block_width = MIN (block_width, area->x + area->width - x);
 
-          pixel_left[j] = pixel_right[j];
-          pixel_right[j] = tmp;
+          gegl_rectangle_set (&block, x, y, (guint) block_width, (guint) block_height);
+          photos_gegl_buffer_apply_orientation_block (data, &block, buf_original, buf_oriented);
+
+          x += block_width;
         }
+
+      y += block_height;
     }
 }
 
 
-GeglBuffer *
-photos_gegl_buffer_apply_orientation (GeglBuffer *buffer_original, GQuark orientation)
+static gboolean
+photos_gegl_buffer_apply_orientation_init_transform (PhotosGeglBufferApplyOrientationData *data, GQuark orientation)
 {
-  const Babl *format;
-  g_autoptr (GeglBuffer) buffer_oriented = NULL;
-  GeglBuffer *ret_val = NULL;
-  GeglRectangle bbox_oriented;
-  GeglRectangle bbox_original;
-  gint bpp;
+  gboolean ret_val = TRUE;
 
-  g_return_val_if_fail (GEGL_IS_BUFFER (buffer_original), NULL);
-  g_return_val_if_fail (orientation == PHOTOS_ORIENTATION_BOTTOM
-                        || orientation == PHOTOS_ORIENTATION_BOTTOM_MIRROR
-                        || orientation == PHOTOS_ORIENTATION_LEFT
-                        || orientation == PHOTOS_ORIENTATION_LEFT_MIRROR
-                        || orientation == PHOTOS_ORIENTATION_RIGHT
-                        || orientation == PHOTOS_ORIENTATION_RIGHT_MIRROR
-                        || orientation == PHOTOS_ORIENTATION_TOP
-                        || orientation == PHOTOS_ORIENTATION_TOP_MIRROR,
-                        NULL);
+  data->bbox_oriented.x = data->bbox_original.x;
+  data->bbox_oriented.y = data->bbox_original.y;
 
   if (orientation == PHOTOS_ORIENTATION_TOP)
     {
-      ret_val = g_object_ref (buffer_original);
-      goto out;
+      data->bbox_oriented.height = data->bbox_original.height;
+      data->bbox_oriented.width = data->bbox_original.width;
+      data->x0 = 0;
+      data->xx = 1;
+      data->xy = 0;
+      data->y0 = 0;
+      data->yx = 0;
+      data->yy = 1;
     }
-
-  bbox_original = *gegl_buffer_get_extent (buffer_original);
-
-  if (orientation == PHOTOS_ORIENTATION_BOTTOM || orientation == PHOTOS_ORIENTATION_BOTTOM_MIRROR)
+  else if (orientation == PHOTOS_ORIENTATION_BOTTOM)
     {
       /* angle = 180 degrees */
+      data->bbox_oriented.height = data->bbox_original.height;
+      data->bbox_oriented.width = data->bbox_original.width;
+      data->x0 = data->bbox_original.width - 1;
+      data->xx = -1;
+      data->xy = 0;
+      data->y0 = data->bbox_original.height - 1;
+      data->yx = 0;
+      data->yy = -1;
+    }
+  else if (orientation == PHOTOS_ORIENTATION_BOTTOM_MIRROR)
+    {
       /* angle = 180 degrees, axis = vertical; or, axis = horizontal */
-      bbox_oriented.height = bbox_original.height;
-      bbox_oriented.width = bbox_original.width;
-      bbox_oriented.x = bbox_original.x;
-      bbox_oriented.y = bbox_original.y;
+      data->bbox_oriented.height = data->bbox_original.height;
+      data->bbox_oriented.width = data->bbox_original.width;
+      data->x0 = 0;
+      data->xx = 1;
+      data->xy = 0;
+      data->y0 = data->bbox_original.height - 1;
+      data->yx = 0;
+      data->yy = -1;
     }
-  else if (orientation == PHOTOS_ORIENTATION_LEFT || orientation == PHOTOS_ORIENTATION_LEFT_MIRROR)
+  else if (orientation == PHOTOS_ORIENTATION_LEFT)
     {
       /* angle = -270 or 90 degrees counterclockwise */
+      data->bbox_oriented.height = data->bbox_original.width;
+      data->bbox_oriented.width = data->bbox_original.height;
+      data->x0 = data->bbox_original.width - 1;
+      data->xx = 0;
+      data->xy = -1;
+      data->y0 = 0;
+      data->yx = 1;
+      data->yy = 0;
+    }
+  else if (orientation == PHOTOS_ORIENTATION_LEFT_MIRROR)
+    {
       /* angle = -270 or 90 degrees counterclockwise, axis = horizontal */
-      bbox_oriented.height = bbox_original.width;
-      bbox_oriented.width = bbox_original.height;
-      bbox_oriented.x = bbox_original.x;
-      bbox_oriented.y = bbox_original.y;
+      data->bbox_oriented.height = data->bbox_original.width;
+      data->bbox_oriented.width = data->bbox_original.height;
+      data->x0 = 0;
+      data->xx = 0;
+      data->xy = 1;
+      data->y0 = 0;
+      data->yx = 1;
+      data->yy = 0;
     }
-  else if (orientation == PHOTOS_ORIENTATION_RIGHT || orientation == PHOTOS_ORIENTATION_RIGHT_MIRROR)
+  else if (orientation == PHOTOS_ORIENTATION_RIGHT)
     {
       /* angle = -90 or 270 degrees counterclockwise */
+      data->bbox_oriented.height = data->bbox_original.width;
+      data->bbox_oriented.width = data->bbox_original.height;
+      data->x0 = 0;
+      data->xx = 0;
+      data->xy = 1;
+      data->y0 = data->bbox_original.height - 1;
+      data->yx = -1;
+      data->yy = 0;
+    }
+  else if (orientation == PHOTOS_ORIENTATION_RIGHT_MIRROR)
+    {
       /* angle = -90 or 270 degrees counterclockwise, axis = horizontal */
-      bbox_oriented.height = bbox_original.width;
-      bbox_oriented.width = bbox_original.height;
-      bbox_oriented.x = bbox_original.x;
-      bbox_oriented.y = bbox_original.y;
+      data->bbox_oriented.height = data->bbox_original.width;
+      data->bbox_oriented.width = data->bbox_original.height;
+      data->x0 = data->bbox_original.width - 1;
+      data->xx = 0;
+      data->xy = -1;
+      data->y0 = data->bbox_original.height - 1;
+      data->yx = -1;
+      data->yy = 0;
     }
   else if (orientation == PHOTOS_ORIENTATION_TOP_MIRROR)
     {
       /* axis = vertical */
-      bbox_oriented.height = bbox_original.height;
-      bbox_oriented.width = bbox_original.width;
-      bbox_oriented.x = bbox_original.x;
-      bbox_oriented.y = bbox_original.y;
+      data->bbox_oriented.height = data->bbox_original.height;
+      data->bbox_oriented.width = data->bbox_original.width;
+      data->x0 = data->bbox_original.width - 1;
+      data->xx = -1;
+      data->xy = 0;
+      data->y0 = 0;
+      data->yx = 0;
+      data->yy = 1;
     }
   else
     {
-      g_return_val_if_reached (NULL);
+      ret_val = FALSE;
     }
 
-  format = gegl_buffer_get_format (buffer_original);
-  bpp = babl_format_get_bytes_per_pixel (format);
-  buffer_oriented = gegl_buffer_new (&bbox_oriented, format);
-
-  if (orientation == PHOTOS_ORIENTATION_BOTTOM || orientation == PHOTOS_ORIENTATION_BOTTOM_MIRROR)
-    {
-      GeglRectangle bbox_destination;
-      GeglRectangle bbox_source;
-
-      /* angle = 180 degrees */
-      /* angle = 180 degrees, axis = vertical; or, axis = horizontal */
+  return ret_val;
+}
 
-      g_return_val_if_fail (bbox_oriented.height == bbox_original.height, NULL);
-      g_return_val_if_fail (bbox_oriented.width == bbox_original.width, NULL);
 
-      gegl_rectangle_set (&bbox_destination, bbox_oriented.x, bbox_oriented.y, (guint) bbox_oriented.width, 1);
+GeglBuffer *
+photos_gegl_buffer_apply_orientation (GeglBuffer *buffer_original, GQuark orientation)
+{
+  PhotosGeglBufferApplyOrientationData data;
+  g_autoptr (GeglBuffer) buffer_oriented = NULL;
+  GeglBuffer *ret_val = NULL;
+  gint64 end;
+  gint64 start;
 
-      bbox_source.x = bbox_original.x;
-      bbox_source.y = bbox_original.y + bbox_original.height - 1;
-      bbox_source.height = 1;
-      bbox_source.width = bbox_original.width;
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer_original), NULL);
+  g_return_val_if_fail (orientation == PHOTOS_ORIENTATION_BOTTOM
+                        || orientation == PHOTOS_ORIENTATION_BOTTOM_MIRROR
+                        || orientation == PHOTOS_ORIENTATION_LEFT
+                        || orientation == PHOTOS_ORIENTATION_LEFT_MIRROR
+                        || orientation == PHOTOS_ORIENTATION_RIGHT
+                        || orientation == PHOTOS_ORIENTATION_RIGHT_MIRROR
+                        || orientation == PHOTOS_ORIENTATION_TOP
+                        || orientation == PHOTOS_ORIENTATION_TOP_MIRROR,
+                        NULL);
 
-      if (orientation == PHOTOS_ORIENTATION_BOTTOM)
-        {
-          gint i;
-          g_autofree guchar *buf = NULL;
-
-          buf = g_malloc0_n (bbox_oriented.width, bpp);
-
-          for (i = 0; i < bbox_original.height; i++)
-            {
-              gegl_buffer_get (buffer_original,
-                               &bbox_source,
-                               1.0,
-                               format,
-                               buf,
-                               GEGL_AUTO_ROWSTRIDE,
-                               GEGL_ABYSS_NONE);
-              photos_gegl_buffer_apply_orientation_flip_in_place (buf, bpp, bbox_original.width);
-              gegl_buffer_set (buffer_oriented, &bbox_destination, 0, format, buf, GEGL_AUTO_ROWSTRIDE);
-
-              bbox_destination.y++;
-              bbox_source.y--;
-            }
-        }
-      else
-        {
-          gint i;
-
-          for (i = 0; i < bbox_original.height; i++)
-            {
-              gegl_buffer_copy (buffer_original, &bbox_source, GEGL_ABYSS_NONE, buffer_oriented, &bbox_destination);
-              bbox_destination.y++;
-              bbox_source.y--;
-            }
-        }
-    }
-  else if (orientation == PHOTOS_ORIENTATION_LEFT || orientation == PHOTOS_ORIENTATION_LEFT_MIRROR)
+  if (orientation == PHOTOS_ORIENTATION_TOP)
     {
-      GeglRectangle bbox_source;
-      g_autofree guchar *buf = NULL;
-
-      /* angle = -270 or 90 degrees counterclockwise */
-      /* angle = -270 or 90 degrees counterclockwise, axis = horizontal */
-
-      g_return_val_if_fail (bbox_oriented.height == bbox_original.width, NULL);
-      g_return_val_if_fail (bbox_oriented.width == bbox_original.height, NULL);
-
-      bbox_source.x = bbox_original.x + bbox_original.width - 1;
-      bbox_source.y = bbox_original.y;
-      bbox_source.height = bbox_original.height;
-      bbox_source.width = 1;
-
-      buf = g_malloc0_n (bbox_oriented.width, bpp);
-
-      if (orientation == PHOTOS_ORIENTATION_LEFT)
-        {
-          GeglRectangle bbox_destination;
-          gint i;
-
-          gegl_rectangle_set (&bbox_destination, bbox_oriented.x, bbox_oriented.y, (guint) bbox_oriented.width, 1);
-
-          for (i = 0; i < bbox_original.width; i++)
-            {
-              gegl_buffer_get (buffer_original,
-                               &bbox_source,
-                               1.0,
-                               format,
-                               buf,
-                               GEGL_AUTO_ROWSTRIDE,
-                               GEGL_ABYSS_NONE);
-              gegl_buffer_set (buffer_oriented, &bbox_destination, 0, format, buf, GEGL_AUTO_ROWSTRIDE);
-              bbox_destination.y++;
-              bbox_source.x--;
-            }
-        }
-      else
-        {
-          GeglRectangle bbox_destination;
-          gint i;
-
-          bbox_destination.x = bbox_oriented.x;
-          bbox_destination.y = bbox_oriented.y + bbox_oriented.height - 1;
-          bbox_destination.height = 1;
-          bbox_destination.width = bbox_oriented.width;
-
-          for (i = 0; i < bbox_original.width; i++)
-            {
-              gegl_buffer_get (buffer_original,
-                               &bbox_source,
-                               1.0,
-                               format,
-                               buf,
-                               GEGL_AUTO_ROWSTRIDE,
-                               GEGL_ABYSS_NONE);
-              gegl_buffer_set (buffer_oriented, &bbox_destination, 0, format, buf, GEGL_AUTO_ROWSTRIDE);
-              bbox_destination.y--;
-              bbox_source.x--;
-            }
-        }
+      ret_val = g_object_ref (buffer_original);
+      goto out;
     }
-  else if (orientation == PHOTOS_ORIENTATION_RIGHT || orientation == PHOTOS_ORIENTATION_RIGHT_MIRROR)
-    {
-      GeglRectangle bbox_destination;
-      GeglRectangle bbox_source;
-      g_autofree guchar *buf = NULL;
-
-      /* angle = -90 or 270 degrees counterclockwise */
-      /* angle = -90 or 270 degrees counterclockwise, axis = horizontal */
-
-      g_return_val_if_fail (bbox_oriented.height == bbox_original.width, NULL);
-      g_return_val_if_fail (bbox_oriented.width == bbox_original.height, NULL);
-
-      gegl_rectangle_set (&bbox_destination, bbox_oriented.x, bbox_oriented.y, 1, (guint) bbox_oriented.height);
 
-      bbox_source.x = bbox_original.x;
-      bbox_source.y = bbox_original.y + bbox_original.height - 1;
-      bbox_source.height = 1;
-      bbox_source.width = bbox_original.width;
+  data.bbox_original = *gegl_buffer_get_extent (buffer_original);
+  if (!photos_gegl_buffer_apply_orientation_init_transform (&data, orientation))
+    g_return_val_if_reached (NULL);
 
-      buf = g_malloc0_n (bbox_oriented.height, bpp);
-
-      if (orientation == PHOTOS_ORIENTATION_RIGHT)
-        {
-          gint i;
-
-          for (i = 0; i < bbox_original.height; i++)
-            {
-              gegl_buffer_get (buffer_original,
-                               &bbox_source,
-                               1.0,
-                               format,
-                               buf,
-                               GEGL_AUTO_ROWSTRIDE,
-                               GEGL_ABYSS_NONE);
-              gegl_buffer_set (buffer_oriented, &bbox_destination, 0, format, buf, GEGL_AUTO_ROWSTRIDE);
-              bbox_destination.x++;
-              bbox_source.y--;
-            }
-        }
-      else
-        {
-          gint i;
-
-          for (i = 0; i < bbox_original.height; i++)
-            {
-              gegl_buffer_get (buffer_original,
-                               &bbox_source,
-                               1.0,
-                               format,
-                               buf,
-                               GEGL_AUTO_ROWSTRIDE,
-                               GEGL_ABYSS_NONE);
-              photos_gegl_buffer_apply_orientation_flip_in_place (buf, bpp, bbox_original.width);
-              gegl_buffer_set (buffer_oriented, &bbox_destination, 0, format, buf, GEGL_AUTO_ROWSTRIDE);
-              bbox_destination.x++;
-              bbox_source.y--;
-            }
-        }
-    }
-  else if (orientation == PHOTOS_ORIENTATION_TOP_MIRROR)
-    {
-      GeglRectangle bbox_destination;
-      GeglRectangle bbox_source;
-      gint i;
+  data.format = gegl_buffer_get_format (buffer_original);
+  data.bpp = babl_format_get_bytes_per_pixel (data.format);
+  buffer_oriented = gegl_buffer_new (&data.bbox_oriented, data.format);
 
-      /* axis = vertical */
+  g_object_get (buffer_oriented, "tile-height", &data.tile_height, "tile-width", &data.tile_width, NULL);
+  g_return_val_if_fail (data.tile_height > 0, NULL);
+  g_return_val_if_fail (data.tile_width > 0, NULL);
 
-      g_return_val_if_fail (bbox_oriented.height == bbox_original.height, NULL);
-      g_return_val_if_fail (bbox_oriented.width == bbox_original.width, NULL);
+  data.buffer_original = buffer_original;
+  data.buffer_oriented = buffer_oriented;
 
-      bbox_destination.x = bbox_oriented.x + bbox_oriented.width - 1;
-      bbox_destination.y = bbox_oriented.y;
-      bbox_destination.height = bbox_oriented.height;
-      bbox_destination.width = 1;
+  start = g_get_monotonic_time ();
 
-      gegl_rectangle_set (&bbox_source, bbox_original.x, bbox_original.y, 1, (guint) bbox_original.height);
+  gegl_parallel_distribute_area (&data.bbox_oriented,
+                                 APPLY_ORIENTATION_THREAD_COST,
+                                 GEGL_SPLIT_STRATEGY_AUTO,
+                                 photos_gegl_buffer_apply_orientation_area,
+                                 &data);
 
-      for (i = 0; i < bbox_original.width; i++)
-        {
-          gegl_buffer_copy (buffer_original, &bbox_source, GEGL_ABYSS_NONE, buffer_oriented, &bbox_destination);
-          bbox_destination.x--;
-          bbox_source.x++;
-        }
-    }
-  else
-    {
-      g_return_val_if_reached (NULL);
-    }
+  end = g_get_monotonic_time ();
+  photos_debug (PHOTOS_DEBUG_GEGL, "GEGL: Apply Orientation: %" G_GINT64_FORMAT, end - start);
 
   ret_val = g_object_ref (buffer_oriented);
 
@@ -441,6 +530,97 @@ photos_gegl_buffer_new_from_pixbuf (GdkPixbuf *pixbuf)
 }
 
 
+static PhotosGeglBufferSaveToStreamData *
+photos_gegl_buffer_save_to_stream_data_new (GOutputStream *stream, const gchar *mime_type)
+{
+  PhotosGeglBufferSaveToStreamData *data;
+
+  data = g_slice_new0 (PhotosGeglBufferSaveToStreamData);
+  data->stream = g_object_ref (stream);
+  data->mime_type = g_strdup (mime_type);
+  return data;
+}
+
+
+static void
+photos_gegl_buffer_save_to_stream_data_free (PhotosGeglBufferSaveToStreamData *data)
+{
+  g_object_unref (data->stream);
+  g_free (data->mime_type);
+  g_slice_free (PhotosGeglBufferSaveToStreamData, data);
+}
+
+
+static void
+photos_gegl_buffer_save_to_stream_in_thread_func (GTask *task,
+                                                  gpointer source_object,
+                                                  gpointer task_data,
+                                                  GCancellable *cancellable)
+{
+  GeglBuffer *buffer = GEGL_BUFFER (source_object);
+  PhotosGeglBufferSaveToStreamData *data = (PhotosGeglBufferSaveToStreamData *) task_data;
+
+  {
+    g_autoptr (GError) error = NULL;
+    gboolean success;
+
+    if (g_strcmp0 (data->mime_type, "image/png") == 0)
+      success = photos_png_save_buffer_to_stream (buffer, data->stream, -1, cancellable, &error);
+    else
+      success = photos_jpeg_save_buffer_to_stream (buffer, data->stream, 90, cancellable, &error);
+
+    if (!success)
+      {
+        g_task_return_error (task, g_steal_pointer (&error));
+        goto out;
+      }
+  }
+
+  g_task_return_boolean (task, TRUE);
+
+ out:
+  return;
+}
+
+
+void
+photos_gegl_buffer_save_to_stream_async (GeglBuffer *buffer,
+                                         const gchar *mime_type,
+                                         GOutputStream *stream,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  PhotosGeglBufferSaveToStreamData *data;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  data = photos_gegl_buffer_save_to_stream_data_new (stream, mime_type);
+
+  task = g_task_new (buffer, cancellable, callback, user_data);
+  g_task_set_source_tag (task, photos_gegl_buffer_save_to_stream_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) photos_gegl_buffer_save_to_stream_data_free);
+
+  g_task_run_in_thread (task, photos_gegl_buffer_save_to_stream_in_thread_func);
+}
+
+
+gboolean
+photos_gegl_buffer_save_to_stream_finish (GeglBuffer *buffer, GAsyncResult *res, GError **error)
+{
+  GTask *task = G_TASK (res);
+
+  g_return_val_if_fail (g_task_is_valid (res, buffer), FALSE);
+  g_return_val_if_fail (g_task_get_source_tag (task) == photos_gegl_buffer_save_to_stream_async, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return g_task_propagate_boolean (task, error);
+}
+
+
 static GeglBuffer *
 photos_gegl_buffer_zoom (GeglBuffer *buffer, gdouble zoom, GCancellable *cancellable, GError **error)
 {
@@ -856,6 +1036,49 @@ photos_gegl_processor_process_finish (GeglProcessor *processor, GAsyncResult *re
 }
 
 
+gboolean
+photos_gegl_rectangle_unapply_orientation (const GeglRectangle *rect_oriented,
+                                           const GeglRectangle *bbox_original,
+                                           GQuark orientation,
+                                           GeglRectangle *out_rect_original)
+{
+  PhotosGeglBufferApplyOrientationData data;
+  GeglRectangle rect;
+  gint x1;
+  gint x2;
+  gint x_rel;
+  gint y1;
+  gint y2;
+  gint y_rel;
+
+  g_return_val_if_fail (rect_oriented != NULL, FALSE);
+  g_return_val_if_fail (bbox_original != NULL, FALSE);
+  g_return_val_if_fail (out_rect_original != NULL, FALSE);
+
+  data.bbox_original = *bbox_original;
+  if (!photos_gegl_buffer_apply_orientation_init_transform (&data, orientation))
+    g_return_val_if_reached (FALSE);
+
+  if (!gegl_rectangle_intersect (&rect, rect_oriented, &data.bbox_oriented))
+    return FALSE;
+
+  x_rel = rect.x - data.bbox_oriented.x;
+  y_rel = rect.y - data.bbox_oriented.y;
+
+  x1 = data.x0 + data.xx * x_rel + data.xy * y_rel;
+  y1 = data.y0 + data.yx * x_rel + data.yy * y_rel;
+  x2 = data.x0 + data.xx * (x_rel + rect.width - 1) + data.xy * (y_rel + rect.height - 1);
+  y2 = data.y0 + data.yx * (x_rel + rect.width - 1) + data.yy * (y_rel + rect.height - 1);
+
+  out_rect_original->x = data.bbox_original.x + MIN (x1, x2);
+  out_rect_original->y = data.bbox_original.y + MIN (y1, y2);
+  out_rect_original->height = ABS (y2 - y1) + 1;
+  out_rect_original->width = ABS (x2 - x1) + 1;
+
+  return TRUE;
+}
+
+
 void
 photos_gegl_remove_children_from_node (GeglNode *node)
 {
@@ -38,6 +38,15 @@ GeglBuffer      *photos_gegl_buffer_convert               (GeglBuffer *buffer_or
 
 GeglBuffer      *photos_gegl_buffer_new_from_pixbuf       (GdkPixbuf *pixbuf);
 
+void             photos_gegl_buffer_save_to_stream_async  (GeglBuffer *buffer,
+                                                           const gchar *mime_type,
+                                                           GOutputStream *stream,
+                                                           GCancellable *cancellable,
+                                                           GAsyncReadyCallback callback,
+                                                           gpointer user_data);
+
+gboolean         photos_gegl_buffer_save_to_stream_finish (GeglBuffer *buffer, GAsyncResult *res, GError **error);
+
 void             photos_gegl_buffer_zoom_async            (GeglBuffer *buffer,
                                                            gdouble zoom,
                                                            GCancellable *cancellable,
@@ -71,6 +80,11 @@ gboolean         photos_gegl_processor_process_finish     (GeglProcessor *proces
                                                            GAsyncResult *res,
                                                            GError **error);
 
+gboolean         photos_gegl_rectangle_unapply_orientation (const GeglRectangle *rect_oriented,
+                                                            const GeglRectangle *bbox_original,
+                                                            GQuark orientation,
+                                                            GeglRectangle *out_rect_original);
+
 void             photos_gegl_remove_children_from_node    (GeglNode *node);
 
 gboolean         photos_gegl_sanity_check                 (void);
@@ -0,0 +1,288 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The size of an encoded image is estimated by encoding a stratified
+ * sample of full-width bands and extrapolating.
+ *
+ * The zoomed image is split into N_STRATA horizontal strata of equal
+ * height, and one band of BAND_HEIGHT rows is encoded from each at a
+ * pseudo-random, but reproducible, offset. Bands span the full width so
+ * that the encoders see the same row context that they would for the
+ * whole image. A 1×1 image is encoded to measure the fixed overhead of
+ * the headers, which is subtracted from each band before scaling it up
+ * to the height of its stratum.
+ *
+ * With only one band per stratum, the variance of the estimate is
+ * computed by collapsing adjacent strata into pairs, which
+ * overestimates it. The reported error is twice its square root, which
+ * is roughly a 95% bound.
+ *
+ * Levels that are encoded in full can optionally keep the encoded
+ * output, so that it can be written out later without encoding the
+ * image again.
+ */
+
+
+#include "config.h"
+
+#include <math.h>
+
+#include "photos-debug.h"
+#include "photos-guess-sizes.h"
+
+
+typedef struct _PhotosGuessSizesData PhotosGuessSizesData;
+typedef struct _PhotosGuessSizesJob PhotosGuessSizesJob;
+typedef struct _PhotosGuessSizesLevel PhotosGuessSizesLevel;
+
+struct _PhotosGuessSizesData
+{
+  GeglBuffer *buffer;
+  PhotosGuessSizesCountFunc count_func;
+  PhotosGuessSizesJob *jobs;
+  gpointer user_data;
+  guint n_jobs;
+};
+
+struct _PhotosGuessSizesJob
+{
+  GByteArray *data;
+  GeglRectangle rect;
+  gdouble weight;
+  gdouble zoom;
+  gsize size;
+};
+
+struct _PhotosGuessSizesLevel
+{
+  gboolean sampled;
+  guint first_job;
+};
+
+static const gint BAND_HEIGHT = 32;
+static const guint N_STRATA = 16; /* Must be even */
+static const guint32 SEED = 0x5eed5eed;
+
+
+static void
+photos_guess_sizes_run_jobs (gint i, gint n, gpointer user_data)
+{
+  PhotosGuessSizesData *data = (PhotosGuessSizesData *) user_data;
+  guint j;
+
+  for (j = (guint) i; j < data->n_jobs; j += (guint) n)
+    {
+      PhotosGuessSizesJob *job = &data->jobs[j];
+
+      job->size = (*data->count_func) (data->buffer,
+                                       job->zoom,
+                                       job->rect.x,
+                                       job->rect.y,
+                                       job->rect.width,
+                                       job->rect.height,
+                                       job->data,
+                                       data->user_data);
+    }
+}
+
+
+static gdouble
+photos_guess_sizes_scale_band (const PhotosGuessSizesJob *job, gsize overhead)
+{
+  return job->size > overhead ? job->weight * (gdouble) (job->size - overhead) : 0.0;
+}
+
+
+static void
+photos_guess_sizes_extrapolate (const PhotosGuessSizesJob *jobs, gsize *out_size, gsize *out_error)
+{
+  gdouble estimate;
+  gdouble variance = 0.0;
+  gsize overhead;
+  guint i;
+
+  overhead = jobs[0].size;
+  estimate = (gdouble) overhead;
+
+  for (i = 1; i <= N_STRATA; i++)
+    {
+      if (jobs[i].size == 0)
+        {
+          *out_size = 0;
+          *out_error = 0;
+          return;
+        }
+    }
+
+  for (i = 1; i + 1 <= N_STRATA; i += 2)
+    {
+      gdouble difference;
+      gdouble total0;
+      gdouble total1;
+
+      total0 = photos_guess_sizes_scale_band (&jobs[i], overhead);
+      total1 = photos_guess_sizes_scale_band (&jobs[i + 1], overhead);
+      estimate += total0 + total1;
+
+      difference = total0 - total1;
+      variance += difference * difference;
+    }
+
+  *out_size = (gsize) (estimate + 0.5);
+  *out_error = (gsize) (2.0 * sqrt (variance) + 0.5);
+}
+
+
+void
+photos_guess_sizes_run (GeglBuffer *buffer,
+                        const GeglRectangle *roi,
+                        gboolean exact,
+                        gint alignment,
+                        PhotosGuessSizesCountFunc count_func,
+                        gpointer user_data,
+                        gsize *out_sizes,
+                        gsize *out_errors,
+                        GBytes **out_data,
+                        guint n_levels)
+{
+  GRand *rand = NULL;
+  PhotosGuessSizesData data;
+  PhotosGuessSizesLevel *levels = NULL;
+  gint64 end;
+  gint64 start;
+  guint i;
+  guint n_jobs = 0;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (roi != NULL);
+  g_return_if_fail (alignment > 0 && alignment <= BAND_HEIGHT);
+  g_return_if_fail (count_func != NULL);
+  g_return_if_fail (out_sizes != NULL);
+  g_return_if_fail (out_errors != NULL);
+
+  start = g_get_monotonic_time ();
+
+  data.buffer = buffer;
+  data.count_func = count_func;
+  data.jobs = g_new0 (PhotosGuessSizesJob, n_levels * (N_STRATA + 1));
+  data.user_data = user_data;
+
+  levels = g_new0 (PhotosGuessSizesLevel, n_levels);
+  rand = g_rand_new_with_seed (SEED);
+
+  for (i = 0; i < n_levels; i++)
+    {
+      GeglRectangle roi_zoomed;
+      gdouble zoom = 1.0 / (gdouble) (1 << i);
+      guint j;
+
+      roi_zoomed.height = (gint) (zoom * roi->height + 0.5);
+      roi_zoomed.width = (gint) (zoom * roi->width + 0.5);
+      roi_zoomed.x = (gint) (zoom * roi->x + 0.5);
+      roi_zoomed.y = (gint) (zoom * roi->y + 0.5);
+
+      levels[i].first_job = n_jobs;
+      levels[i].sampled = !exact && roi_zoomed.height >= 2 * BAND_HEIGHT * (gint) N_STRATA;
+
+      if (!levels[i].sampled)
+        {
+          data.jobs[n_jobs].data = out_data != NULL ? g_byte_array_new () : NULL;
+          data.jobs[n_jobs].rect = roi_zoomed;
+          data.jobs[n_jobs].weight = 1.0;
+          data.jobs[n_jobs].zoom = zoom;
+          n_jobs++;
+          continue;
+        }
+
+      gegl_rectangle_set (&data.jobs[n_jobs].rect, roi_zoomed.x, roi_zoomed.y, 1, 1);
+      data.jobs[n_jobs].weight = 0.0;
+      data.jobs[n_jobs].zoom = zoom;
+      n_jobs++;
+
+      for (j = 0; j < N_STRATA; j++)
+        {
+          gint band_y;
+          gint stratum_height;
+          gint stratum_y;
+
+          stratum_y = (gint) ((gint64) roi_zoomed.height * j / N_STRATA);
+          stratum_height = (gint) ((gint64) roi_zoomed.height * (j + 1) / N_STRATA) - stratum_y;
+
+          /* Keep the bands on the same block grid as the whole image,
+           * so that they are split into blocks the same way.
+           */
+          band_y = stratum_y + g_rand_int_range (rand, 0, stratum_height - BAND_HEIGHT + 1);
+          band_y -= band_y % alignment;
+          if (band_y < stratum_y)
+            band_y += alignment;
+
+          gegl_rectangle_set (&data.jobs[n_jobs].rect,
+                              roi_zoomed.x,
+                              roi_zoomed.y + band_y,
+                              roi_zoomed.width,
+                              BAND_HEIGHT);
+          data.jobs[n_jobs].weight = (gdouble) stratum_height / (gdouble) BAND_HEIGHT;
+          data.jobs[n_jobs].zoom = zoom;
+          n_jobs++;
+        }
+    }
+
+  data.n_jobs = n_jobs;
+  gegl_parallel_distribute ((gint) n_jobs, photos_guess_sizes_run_jobs, &data);
+
+  for (i = 0; i < n_levels; i++)
+    {
+      PhotosGuessSizesJob *jobs = &data.jobs[levels[i].first_job];
+
+      if (levels[i].sampled)
+        {
+          photos_guess_sizes_extrapolate (jobs, &out_sizes[i], &out_errors[i]);
+          if (out_data != NULL)
+            out_data[i] = NULL;
+        }
+      else
+        {
+          out_sizes[i] = jobs[0].size;
+          out_errors[i] = 0;
+
+          if (out_data != NULL)
+            {
+              if (jobs[0].size > 0)
+                out_data[i] = g_byte_array_free_to_bytes (g_steal_pointer (&jobs[0].data));
+              else
+                out_data[i] = NULL;
+
+              g_clear_pointer (&jobs[0].data, g_byte_array_unref);
+            }
+        }
+
+      photos_debug (PHOTOS_DEBUG_GEGL,
+                    "Guess Sizes: Level %u: %" G_GSIZE_FORMAT " ± %" G_GSIZE_FORMAT " bytes%s",
+                    i,
+                    out_sizes[i],
+                    out_errors[i],
+                    levels[i].sampled ? "" : " (exact)");
+    }
+
+  end = g_get_monotonic_time ();
+  photos_debug (PHOTOS_DEBUG_GEGL, "Guess Sizes: %u encodes: %" G_GINT64_FORMAT, n_jobs, end - start);
+
+  g_free (data.jobs);
+  g_free (levels);
+  g_rand_free (rand);
+}
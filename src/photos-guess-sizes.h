@@ -0,0 +1,48 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_GUESS_SIZES_H
+#define PHOTOS_GUESS_SIZES_H
+
+#include <gegl.h>
+
+G_BEGIN_DECLS
+
+typedef gsize (*PhotosGuessSizesCountFunc) (GeglBuffer *buffer,
+                                            gdouble zoom,
+                                            gint src_x,
+                                            gint src_y,
+                                            gint width,
+                                            gint height,
+                                            GByteArray *data,
+                                            gpointer user_data);
+
+void                photos_guess_sizes_run          (GeglBuffer *buffer,
+                                                     const GeglRectangle *roi,
+                                                     gboolean exact,
+                                                     gint alignment,
+                                                     PhotosGuessSizesCountFunc count_func,
+                                                     gpointer user_data,
+                                                     gsize *out_sizes,
+                                                     gsize *out_errors,
+                                                     GBytes **out_data,
+                                                     guint n_levels);
+
+G_END_DECLS
+
+#endif /* PHOTOS_GUESS_SIZES_H */
@@ -0,0 +1,566 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Level n of the pyramid is the buffer scaled down by 2^n. Level 0 is
+ * the buffer itself, and the other levels are filled in, one tile at a
+ * time, when a render first needs them.
+ *
+ * Renders can come from any thread. The mutex only guards the levels'
+ * buffers and regions. Tiles are box filtered without it, and are only
+ * published, by adding them to their level's region, if nothing was
+ * invalidated or dropped while they were being built.
+ */
+
+
+#include "config.h"
+
+#include <babl/babl.h>
+#include <cairo.h>
+#include <math.h>
+#include <string.h>
+
+#include "photos-debug.h"
+#include "photos-image-view-pyramid.h"
+
+
+enum
+{
+  N_LEVELS = 16
+};
+
+typedef struct _PhotosImageViewPyramidLevel PhotosImageViewPyramidLevel;
+
+struct _PhotosImageViewPyramidLevel
+{
+  GeglBuffer *buffer;
+  cairo_region_t *region;
+};
+
+struct _PhotosImageViewPyramid
+{
+  GObject parent_instance;
+  GMutex mutex;
+  GeglBuffer *buffer;
+  PhotosImageViewPyramidLevel levels[N_LEVELS];
+  guint serial;
+};
+
+enum
+{
+  PROP_0,
+  PROP_BUFFER
+};
+
+
+G_DEFINE_TYPE (PhotosImageViewPyramid, photos_image_view_pyramid, G_TYPE_OBJECT);
+
+
+static const gint TILE_SIZE = 256;
+static const gsize MEMORY_MAX = 64 * 1024 * 1024;
+
+
+static void
+photos_image_view_pyramid_clear_level (PhotosImageViewPyramid *self, guint level)
+{
+  g_return_if_fail (level > 0);
+  g_return_if_fail (level < N_LEVELS);
+
+  g_clear_object (&self->levels[level].buffer);
+  g_clear_pointer (&self->levels[level].region, cairo_region_destroy);
+}
+
+
+static gsize
+photos_image_view_pyramid_get_level_size (PhotosImageViewPyramid *self, guint level)
+{
+  cairo_region_t *region = self->levels[level].region;
+  gint i;
+  gint n_rectangles;
+  gsize ret_val = 0;
+
+  if (region == NULL)
+    goto out;
+
+  n_rectangles = cairo_region_num_rectangles (region);
+  for (i = 0; i < n_rectangles; i++)
+    {
+      cairo_rectangle_int_t rectangle;
+
+      cairo_region_get_rectangle (region, i, &rectangle);
+      ret_val += (gsize) rectangle.width * (gsize) rectangle.height * 4;
+    }
+
+ out:
+  return ret_val;
+}
+
+
+static void
+photos_image_view_pyramid_get_extent (PhotosImageViewPyramid *self, guint level, GeglRectangle *out_extent)
+{
+  GeglRectangle bbox;
+  gdouble scale;
+  gint x1;
+  gint y1;
+
+  bbox = *gegl_buffer_get_extent (self->buffer);
+  scale = ldexp (1.0, - (gint) level);
+
+  x1 = (gint) ceil ((bbox.x + bbox.width) * scale);
+  y1 = (gint) ceil ((bbox.y + bbox.height) * scale);
+  out_extent->x = (gint) floor (bbox.x * scale);
+  out_extent->y = (gint) floor (bbox.y * scale);
+  out_extent->width = x1 - out_extent->x;
+  out_extent->height = y1 - out_extent->y;
+}
+
+
+static void
+photos_image_view_pyramid_snap_to_tiles (const GeglRectangle *rect, GeglRectangle *out_tiles)
+{
+  gint x1;
+  gint y1;
+
+  x1 = (gint) ceil ((gdouble) (rect->x + rect->width) / TILE_SIZE) * TILE_SIZE;
+  y1 = (gint) ceil ((gdouble) (rect->y + rect->height) / TILE_SIZE) * TILE_SIZE;
+  out_tiles->x = (gint) floor ((gdouble) rect->x / TILE_SIZE) * TILE_SIZE;
+  out_tiles->y = (gint) floor ((gdouble) rect->y / TILE_SIZE) * TILE_SIZE;
+  out_tiles->width = x1 - out_tiles->x;
+  out_tiles->height = y1 - out_tiles->y;
+}
+
+
+static void
+photos_image_view_pyramid_evict (PhotosImageViewPyramid *self, guint level)
+{
+  gsize size = 0;
+  guint i;
+
+  for (i = 1; i < N_LEVELS; i++)
+    size += photos_image_view_pyramid_get_level_size (self, i);
+
+  /* Drop the levels that are furthest from the one in use until the
+   * pyramid fits. The one in use is always kept.
+   */
+  while (size > MEMORY_MAX)
+    {
+      gsize victim_size;
+      guint distance_max = 0;
+      guint victim = 0;
+
+      for (i = 1; i < N_LEVELS; i++)
+        {
+          guint distance;
+
+          if (i == level || self->levels[i].buffer == NULL)
+            continue;
+
+          distance = i > level ? i - level : level - i;
+          if (distance > distance_max)
+            {
+              distance_max = distance;
+              victim = i;
+            }
+        }
+
+      if (victim == 0)
+        break;
+
+      victim_size = photos_image_view_pyramid_get_level_size (self, victim);
+      photos_debug (PHOTOS_DEBUG_GEGL,
+                    "PhotosImageViewPyramid: Evicting level %u, %" G_GSIZE_FORMAT " bytes",
+                    victim,
+                    victim_size);
+
+      size -= victim_size;
+      photos_image_view_pyramid_clear_level (self, victim);
+    }
+}
+
+
+/* Returns a reference to the buffer of the level that was filled, or
+ * NULL if the rect is entirely outside the image. The buffer is used
+ * directly, because the level might be evicted or replaced as soon as
+ * the lock is dropped. If some of the tiles couldn't be built or
+ * published, because the level or its parents were invalidated or
+ * evicted in the mean time, then out_complete is set to FALSE and the
+ * buffer shouldn't be trusted for the rect.
+ */
+static GeglBuffer *
+photos_image_view_pyramid_ensure (PhotosImageViewPyramid *self,
+                                  guint level,
+                                  const GeglRectangle *rect,
+                                  gboolean *out_complete)
+{
+  PhotosImageViewPyramidLevel *pyramid_level;
+  const Babl *format;
+  GeglBuffer *ret_val = NULL;
+  GeglRectangle extent;
+  GeglRectangle tiles;
+  g_autofree guchar *tile_memory = NULL;
+  gboolean complete = TRUE;
+  gint stride;
+  gint x;
+  gint y;
+
+  g_return_val_if_fail (level < N_LEVELS, NULL);
+
+  if (level == 0)
+    {
+      ret_val = g_object_ref (self->buffer);
+      goto out;
+    }
+
+  photos_image_view_pyramid_get_extent (self, level, &extent);
+  if (!gegl_rectangle_intersect (&tiles, &extent, rect))
+    goto out;
+
+  pyramid_level = &self->levels[level];
+  format = babl_format ("cairo-ARGB32");
+
+  g_mutex_lock (&self->mutex);
+
+  if (pyramid_level->buffer == NULL)
+    {
+      pyramid_level->buffer = gegl_buffer_new (&extent, format);
+      pyramid_level->region = cairo_region_create ();
+    }
+
+  ret_val = g_object_ref (pyramid_level->buffer);
+
+  g_mutex_unlock (&self->mutex);
+
+  /* Snap to the tile grid, so that later renders of nearby areas can
+   * reuse the work.
+   */
+  photos_image_view_pyramid_snap_to_tiles (&tiles, &tiles);
+  stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, TILE_SIZE);
+
+  for (y = tiles.y; y < tiles.y + tiles.height && complete; y += TILE_SIZE)
+    {
+      for (x = tiles.x; x < tiles.x + tiles.width && complete; x += TILE_SIZE)
+        {
+          g_autoptr (GeglBuffer) parent_buffer = NULL;
+          GeglRectangle parent_rect;
+          GeglRectangle tile;
+          cairo_region_overlap_t overlap = CAIRO_REGION_OVERLAP_OUT;
+          gboolean parent_complete;
+          gboolean published = FALSE;
+          guint serial;
+
+          gegl_rectangle_set (&tile, x, y, (guint) TILE_SIZE, (guint) TILE_SIZE);
+          if (!gegl_rectangle_intersect (&tile, &tile, &extent))
+            continue;
+
+          g_mutex_lock (&self->mutex);
+
+          /* The region belongs to whichever buffer the level has now. */
+          if (pyramid_level->buffer == ret_val)
+            overlap = cairo_region_contains_rectangle (pyramid_level->region, (cairo_rectangle_int_t *) &tile);
+          else
+            complete = FALSE;
+
+          serial = self->serial;
+
+          g_mutex_unlock (&self->mutex);
+
+          if (!complete || overlap == CAIRO_REGION_OVERLAP_IN)
+            continue;
+
+          gegl_rectangle_set (&parent_rect, 2 * tile.x, 2 * tile.y, 2 * (guint) tile.width, 2 * (guint) tile.height);
+          parent_buffer = photos_image_view_pyramid_ensure (self, level - 1, &parent_rect, &parent_complete);
+          if (parent_buffer == NULL || !parent_complete)
+            {
+              complete = FALSE;
+              continue;
+            }
+
+          if (tile_memory == NULL)
+            tile_memory = (guchar *) g_malloc ((gsize) TILE_SIZE * (gsize) stride);
+
+          /* cairo-ARGB32 is premultiplied, so the box filter doesn't
+           * bleed colour out of transparent pixels.
+           */
+          gegl_buffer_get (parent_buffer,
+                           &tile,
+                           0.5,
+                           format,
+                           tile_memory,
+                           stride,
+                           GEGL_ABYSS_NONE | GEGL_BUFFER_FILTER_BOX);
+          gegl_buffer_set (ret_val, &tile, 0, format, tile_memory, stride);
+
+          g_mutex_lock (&self->mutex);
+
+          if (pyramid_level->buffer == ret_val && self->serial == serial)
+            {
+              cairo_status_t status;
+
+              status = cairo_region_union_rectangle (pyramid_level->region, (cairo_rectangle_int_t *) &tile);
+              if (status != CAIRO_STATUS_SUCCESS)
+                g_warning ("Unable to add tile to pyramid level %u: %s", level, cairo_status_to_string (status));
+              else
+                published = TRUE;
+            }
+
+          g_mutex_unlock (&self->mutex);
+
+          if (!published)
+            complete = FALSE;
+        }
+    }
+
+ out:
+  if (out_complete != NULL)
+    *out_complete = complete;
+
+  return ret_val;
+}
+
+
+static void
+photos_image_view_pyramid_dispose (GObject *object)
+{
+  PhotosImageViewPyramid *self = PHOTOS_IMAGE_VIEW_PYRAMID (object);
+  guint i;
+
+  for (i = 1; i < N_LEVELS; i++)
+    photos_image_view_pyramid_clear_level (self, i);
+
+  g_clear_object (&self->buffer);
+
+  G_OBJECT_CLASS (photos_image_view_pyramid_parent_class)->dispose (object);
+}
+
+
+static void
+photos_image_view_pyramid_finalize (GObject *object)
+{
+  PhotosImageViewPyramid *self = PHOTOS_IMAGE_VIEW_PYRAMID (object);
+
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (photos_image_view_pyramid_parent_class)->finalize (object);
+}
+
+
+static void
+photos_image_view_pyramid_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+  PhotosImageViewPyramid *self = PHOTOS_IMAGE_VIEW_PYRAMID (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUFFER:
+      g_value_set_object (value, self->buffer);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+
+static void
+photos_image_view_pyramid_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+  PhotosImageViewPyramid *self = PHOTOS_IMAGE_VIEW_PYRAMID (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUFFER:
+      self->buffer = GEGL_BUFFER (g_value_dup_object (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+
+static void
+photos_image_view_pyramid_init (PhotosImageViewPyramid *self)
+{
+  g_mutex_init (&self->mutex);
+}
+
+
+static void
+photos_image_view_pyramid_class_init (PhotosImageViewPyramidClass *class)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (class);
+
+  object_class->dispose = photos_image_view_pyramid_dispose;
+  object_class->finalize = photos_image_view_pyramid_finalize;
+  object_class->get_property = photos_image_view_pyramid_get_property;
+  object_class->set_property = photos_image_view_pyramid_set_property;
+
+  g_object_class_install_property (object_class,
+                                   PROP_BUFFER,
+                                   g_param_spec_object ("buffer",
+                                                        "GeglBuffer object",
+                                                        "The cairo-ARGB32 buffer at the bottom of the pyramid",
+                                                        GEGL_TYPE_BUFFER,
+                                                        G_PARAM_CONSTRUCT_ONLY
+                                                        | G_PARAM_READWRITE
+                                                        | G_PARAM_STATIC_STRINGS));
+}
+
+
+PhotosImageViewPyramid *
+photos_image_view_pyramid_new (GeglBuffer *buffer)
+{
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  return g_object_new (PHOTOS_TYPE_IMAGE_VIEW_PYRAMID, "buffer", buffer, NULL);
+}
+
+
+GeglBuffer *
+photos_image_view_pyramid_get_buffer (PhotosImageViewPyramid *self)
+{
+  g_return_val_if_fail (PHOTOS_IS_IMAGE_VIEW_PYRAMID (self), NULL);
+  return self->buffer;
+}
+
+
+void
+photos_image_view_pyramid_invalidate (PhotosImageViewPyramid *self, const GeglRectangle *rect)
+{
+  guint i;
+
+  g_return_if_fail (PHOTOS_IS_IMAGE_VIEW_PYRAMID (self));
+  g_return_if_fail (rect != NULL);
+
+  g_mutex_lock (&self->mutex);
+
+  /* Tiles that are being built from the old pixels won't be published. */
+  self->serial++;
+
+  for (i = 1; i < N_LEVELS; i++)
+    {
+      GeglRectangle rect_level;
+      GeglRectangle tiles;
+      gdouble scale;
+      gint x1;
+      gint y1;
+
+      if (self->levels[i].region == NULL)
+        continue;
+
+      scale = ldexp (1.0, - (gint) i);
+      x1 = (gint) ceil ((rect->x + rect->width) * scale);
+      y1 = (gint) ceil ((rect->y + rect->height) * scale);
+      rect_level.x = (gint) floor (rect->x * scale);
+      rect_level.y = (gint) floor (rect->y * scale);
+      rect_level.width = x1 - rect_level.x;
+      rect_level.height = y1 - rect_level.y;
+
+      /* Tiles are only ever built whole. */
+      photos_image_view_pyramid_snap_to_tiles (&rect_level, &tiles);
+      cairo_region_subtract_rectangle (self->levels[i].region, (cairo_rectangle_int_t *) &tiles);
+    }
+
+  g_mutex_unlock (&self->mutex);
+}
+
+
+gboolean
+photos_image_view_pyramid_render (PhotosImageViewPyramid *self,
+                                  const GeglRectangle *roi,
+                                  gdouble zoom,
+                                  guchar *data,
+                                  gint stride)
+{
+  const Babl *format;
+  GeglAbyssPolicy buffer_flags;
+  g_autoptr (GeglBuffer) buffer = NULL;
+  gboolean ret_val = FALSE;
+  gdouble scale;
+  guint level;
+
+  g_return_val_if_fail (PHOTOS_IS_IMAGE_VIEW_PYRAMID (self), FALSE);
+  g_return_val_if_fail (roi != NULL, FALSE);
+  g_return_val_if_fail (zoom > 0.0, FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  /* When zoomed out, sample the smallest level that is still at least
+   * as large as the output. What is left to scale is between 0.5 and 1,
+   * which bilinear filtering handles well enough to use even while
+   * zooming.
+   */
+  level = 0;
+  scale = zoom;
+  while (scale <= 0.5 && level < N_LEVELS - 1)
+    {
+      level++;
+      scale *= 2.0;
+    }
+
+  if (level == 0)
+    {
+      buffer = g_object_ref (self->buffer);
+    }
+  else
+    {
+      GeglRectangle roi_level;
+      gboolean complete;
+      gint x1;
+      gint y1;
+
+      /* One more pixel around the edges for the bilinear filter. */
+      x1 = (gint) ceil ((roi->x + roi->width) / scale) + 1;
+      y1 = (gint) ceil ((roi->y + roi->height) / scale) + 1;
+      roi_level.x = (gint) floor (roi->x / scale) - 1;
+      roi_level.y = (gint) floor (roi->y / scale) - 1;
+      roi_level.width = x1 - roi_level.x;
+      roi_level.height = y1 - roi_level.y;
+
+      buffer = photos_image_view_pyramid_ensure (self, level, &roi_level, &complete);
+      if (!complete)
+        {
+          photos_debug (PHOTOS_DEBUG_GEGL, "PhotosImageViewPyramid: Level %u changed while rendering", level);
+          goto out;
+        }
+
+      g_mutex_lock (&self->mutex);
+      photos_image_view_pyramid_evict (self, level);
+      g_mutex_unlock (&self->mutex);
+
+      /* The roi is entirely outside the image. */
+      if (buffer == NULL)
+        {
+          memset (data, 0, (gsize) roi->height * (gsize) stride);
+          ret_val = TRUE;
+          goto out;
+        }
+    }
+
+  if (scale < 1.0)
+    buffer_flags = GEGL_ABYSS_NONE | GEGL_BUFFER_FILTER_BILINEAR;
+  else
+    buffer_flags = GEGL_ABYSS_NONE | GEGL_BUFFER_FILTER_AUTO;
+
+  format = babl_format ("cairo-ARGB32");
+  gegl_buffer_get (buffer, roi, scale, format, data, stride, buffer_flags);
+  ret_val = TRUE;
+
+ out:
+  return ret_val;
+}
@@ -0,0 +1,44 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_IMAGE_VIEW_PYRAMID_H
+#define PHOTOS_IMAGE_VIEW_PYRAMID_H
+
+#include <gegl.h>
+
+G_BEGIN_DECLS
+
+#define PHOTOS_TYPE_IMAGE_VIEW_PYRAMID (photos_image_view_pyramid_get_type ())
+G_DECLARE_FINAL_TYPE (PhotosImageViewPyramid, photos_image_view_pyramid, PHOTOS, IMAGE_VIEW_PYRAMID, GObject);
+
+PhotosImageViewPyramid   *photos_image_view_pyramid_new           (GeglBuffer *buffer);
+
+GeglBuffer               *photos_image_view_pyramid_get_buffer    (PhotosImageViewPyramid *self);
+
+void                      photos_image_view_pyramid_invalidate    (PhotosImageViewPyramid *self,
+                                                                   const GeglRectangle *rect);
+
+gboolean                  photos_image_view_pyramid_render        (PhotosImageViewPyramid *self,
+                                                                   const GeglRectangle *roi,
+                                                                   gdouble zoom,
+                                                                   guchar *data,
+                                                                   gint stride);
+
+G_END_DECLS
+
+#endif /* PHOTOS_IMAGE_VIEW_PYRAMID_H */
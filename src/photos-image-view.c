@@ -24,18 +24,27 @@
 #include <cairo-gobject.h>
 #include <dazzle.h>
 #include <glib.h>
+#include <math.h>
 
 #include "photos-debug.h"
 #include "photos-gegl.h"
 #include "photos-image-view.h"
 #include "photos-image-view-helper.h"
+#include "photos-image-view-pyramid.h"
 #include "photos-marshalers.h"
 
 
+typedef struct _PhotosImageViewTile PhotosImageViewTile;
+typedef struct _PhotosImageViewTileData PhotosImageViewTileData;
+
 struct _PhotosImageView
 {
   GtkDrawingArea parent_instance;
   DzlAnimation *zoom_animation;
+  GCancellable *cancellable;
+  GCancellable *tiles_cancellable;
+  GHashTable *tiles;
+  GHashTable *tiles_old;
   GeglBuffer *buffer;
   GeglNode *node;
   GeglRectangle bbox_zoomed_old;
@@ -44,11 +53,19 @@ struct _PhotosImageView
   GtkAllocation allocation_scaled_old;
   GtkScrollablePolicy hscroll_policy;
   GtkScrollablePolicy vscroll_policy;
+  PhotosImageViewPyramid *pyramid;
   cairo_region_t *bbox_region;
   cairo_region_t *region;
+  cairo_surface_t *overview;
+  cairo_surface_t *proxy;
   gboolean best_fit;
+  gboolean overview_pending;
+  gboolean overview_valid;
   gdouble bbox_zoomed_height;
   gdouble bbox_zoomed_width;
+  gdouble overview_zoom;
+  gdouble tiles_old_zoom;
+  gdouble tiles_zoom;
   gdouble x;
   gdouble x_scaled;
   gdouble y;
@@ -56,8 +73,33 @@ struct _PhotosImageView
   gdouble zoom;
   gdouble zoom_visible;
   gdouble zoom_visible_scaled;
-  gsize surface_memory_size;
-  guchar *surface_memory;
+  gint tiles_x_offset;
+  gint tiles_y_offset;
+  guint overview_serial;
+  guint tiles_serial;
+};
+
+/* The view is drawn from tiles of TILE_SIZE × TILE_SIZE device pixels
+ * at the current zoom, which are rendered from the pyramid in worker
+ * threads. Until a tile is ready, the area is covered with the tiles
+ * from the previous zoom level, if any, and a small overview of the
+ * whole image, both scaled to fit.
+ */
+struct _PhotosImageViewTile
+{
+  cairo_surface_t *surface;
+  gboolean pending;
+  gboolean valid;
+  guint serial;
+};
+
+struct _PhotosImageViewTileData
+{
+  PhotosImageViewPyramid *pyramid;
+  GeglRectangle roi;
+  gdouble zoom;
+  gint64 key;
+  guint serial;
 };
 
 enum
@@ -89,6 +131,9 @@ G_DEFINE_TYPE_WITH_CODE (PhotosImageView, photos_image_view, GTK_TYPE_DRAWING_AR
 
 static const DzlAnimationMode ZOOM_ANIMATION_MODE = DZL_ANIMATION_EASE_OUT_CUBIC;
 static const guint ZOOM_ANIMATION_DURATION = 250; /* ms */
+static const gint OVERVIEW_SIZE = 512;
+static const guint TILES_MAX = 256;
+static const gint TILE_SIZE = 256;
 
 
 static void photos_image_view_computed (PhotosImageView *self, GeglRectangle *rect);
@@ -223,6 +268,521 @@ photos_image_view_start_zoom_animation (PhotosImageView *self)
 }
 
 
+static PhotosImageViewTile *
+photos_image_view_tile_new (void)
+{
+  PhotosImageViewTile *tile;
+
+  tile = g_slice_new0 (PhotosImageViewTile);
+  return tile;
+}
+
+
+static void
+photos_image_view_tile_free (PhotosImageViewTile *tile)
+{
+  g_clear_pointer (&tile->surface, cairo_surface_destroy);
+  g_slice_free (PhotosImageViewTile, tile);
+}
+
+
+static PhotosImageViewTileData *
+photos_image_view_tile_data_new (PhotosImageViewPyramid *pyramid,
+                                 const GeglRectangle *roi,
+                                 gdouble zoom,
+                                 gint64 key,
+                                 guint serial)
+{
+  PhotosImageViewTileData *data;
+
+  data = g_slice_new0 (PhotosImageViewTileData);
+  data->pyramid = g_object_ref (pyramid);
+  data->roi = *roi;
+  data->zoom = zoom;
+  data->key = key;
+  data->serial = serial;
+  return data;
+}
+
+
+static void
+photos_image_view_tile_data_free (PhotosImageViewTileData *data)
+{
+  g_clear_object (&data->pyramid);
+  g_slice_free (PhotosImageViewTileData, data);
+}
+
+
+static gint64
+photos_image_view_tile_get_key (gint column, gint row)
+{
+  return (gint64) (((guint64) (guint32) row << 32) | (guint64) (guint32) column);
+}
+
+
+static void
+photos_image_view_tile_get_rect (gint64 key, GeglRectangle *out_rect)
+{
+  const gint column = (gint) (guint32) ((guint64) key & 0xffffffff);
+  const gint row = (gint) (guint32) ((guint64) key >> 32);
+
+  gegl_rectangle_set (out_rect, column * TILE_SIZE, row * TILE_SIZE, (guint) TILE_SIZE, (guint) TILE_SIZE);
+}
+
+
+static void
+photos_image_view_tile_render_in_thread_func (GTask *task,
+                                              gpointer source_object,
+                                              gpointer task_data,
+                                              GCancellable *cancellable)
+{
+  PhotosImageViewTileData *data = (PhotosImageViewTileData *) task_data;
+  cairo_surface_t *surface = NULL;
+  cairo_status_t status;
+  gint stride;
+  guchar *surface_data;
+
+  if (g_task_return_error_if_cancelled (task))
+    goto out;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, data->roi.width, data->roi.height);
+  status = cairo_surface_status (surface);
+  if (status != CAIRO_STATUS_SUCCESS)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", cairo_status_to_string (status));
+      goto out;
+    }
+
+  cairo_surface_flush (surface);
+  surface_data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+  if (!photos_image_view_pyramid_render (data->pyramid, &data->roi, data->zoom, surface_data, stride))
+    {
+      /* The pyramid changed under the render. Return no surface, so
+       * that it is asked for again instead of showing a partial one.
+       */
+      g_task_return_pointer (task, NULL, NULL);
+      goto out;
+    }
+
+  cairo_surface_mark_dirty (surface);
+
+  g_task_return_pointer (task, g_steal_pointer (&surface), (GDestroyNotify) cairo_surface_destroy);
+
+ out:
+  g_clear_pointer (&surface, cairo_surface_destroy);
+}
+
+
+static void
+photos_image_view_tile_render_async (PhotosImageView *self,
+                                     const GeglRectangle *roi,
+                                     gdouble zoom,
+                                     gint64 key,
+                                     guint serial,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback)
+{
+  g_autoptr (GTask) task = NULL;
+  PhotosImageViewTileData *data;
+
+  data = photos_image_view_tile_data_new (self->pyramid, roi, zoom, key, serial);
+
+  task = g_task_new (self, cancellable, callback, NULL);
+  g_task_set_priority (task, G_PRIORITY_DEFAULT_IDLE);
+  g_task_set_source_tag (task, photos_image_view_tile_render_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) photos_image_view_tile_data_free);
+
+  g_task_run_in_thread (task, photos_image_view_tile_render_in_thread_func);
+}
+
+
+static cairo_surface_t *
+photos_image_view_tile_render_finish (PhotosImageView *self,
+                                      GAsyncResult *res,
+                                      PhotosImageViewTileData **out_data,
+                                      GError **error)
+{
+  GTask *task;
+
+  g_return_val_if_fail (g_task_is_valid (res, self), NULL);
+  task = G_TASK (res);
+
+  g_return_val_if_fail (g_task_get_source_tag (task) == photos_image_view_tile_render_async, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  *out_data = (PhotosImageViewTileData *) g_task_get_task_data (task);
+  return g_task_propagate_pointer (task, error);
+}
+
+
+static void
+photos_image_view_overview_render (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  PhotosImageView *self;
+  PhotosImageViewTileData *data;
+  cairo_surface_t *surface = NULL;
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    surface = photos_image_view_tile_render_finish (PHOTOS_IMAGE_VIEW (source_object), res, &data, &error);
+    if (error != NULL)
+      {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+          g_warning ("Unable to render overview: %s", error->message);
+
+        goto out;
+      }
+  }
+
+  self = PHOTOS_IMAGE_VIEW (source_object);
+
+  if (data->serial != self->overview_serial)
+    goto out;
+
+  if (surface == NULL)
+    {
+      self->overview_pending = FALSE;
+      gtk_widget_queue_draw (GTK_WIDGET (self));
+      goto out;
+    }
+
+  g_clear_pointer (&self->overview, cairo_surface_destroy);
+  self->overview = g_steal_pointer (&surface);
+  self->overview_pending = FALSE;
+  self->overview_valid = TRUE;
+  self->overview_zoom = data->zoom;
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+
+ out:
+  g_clear_pointer (&surface, cairo_surface_destroy);
+}
+
+
+static void
+photos_image_view_overview_request (PhotosImageView *self)
+{
+  GeglRectangle bbox;
+  GeglRectangle roi;
+  gdouble zoom;
+  gint size;
+  gint x1;
+  gint y1;
+
+  if (self->overview_pending || self->overview_valid)
+    return;
+
+  bbox = *gegl_buffer_get_extent (self->buffer);
+  size = MAX (bbox.width, bbox.height);
+  if (size <= 0)
+    return;
+
+  /* Snap outwards with floor and ceil, like the tiles, so that a buffer
+   * with a negative origin isn't shifted by rounding towards zero.
+   */
+  zoom = MIN (1.0, (gdouble) OVERVIEW_SIZE / (gdouble) size);
+  x1 = (gint) ceil (zoom * (bbox.x + bbox.width));
+  y1 = (gint) ceil (zoom * (bbox.y + bbox.height));
+  roi.x = (gint) floor (zoom * bbox.x);
+  roi.y = (gint) floor (zoom * bbox.y);
+  roi.width = MAX (x1 - roi.x, 1);
+  roi.height = MAX (y1 - roi.y, 1);
+
+  self->overview_pending = TRUE;
+  self->overview_serial++;
+  photos_image_view_tile_render_async (self,
+                                       &roi,
+                                       zoom,
+                                       0,
+                                       self->overview_serial,
+                                       self->cancellable,
+                                       photos_image_view_overview_render);
+}
+
+
+static void
+photos_image_view_tiles_render (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  PhotosImageView *self;
+  PhotosImageViewTile *tile;
+  PhotosImageViewTileData *data;
+  cairo_surface_t *surface = NULL;
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    surface = photos_image_view_tile_render_finish (PHOTOS_IMAGE_VIEW (source_object), res, &data, &error);
+    if (error != NULL)
+      {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+          g_warning ("Unable to render tile: %s", error->message);
+
+        goto out;
+      }
+  }
+
+  self = PHOTOS_IMAGE_VIEW (source_object);
+
+  /* The tile might have been evicted or invalidated in the mean time. */
+  tile = (PhotosImageViewTile *) g_hash_table_lookup (self->tiles, &data->key);
+  if (tile == NULL || tile->serial != data->serial)
+    goto out;
+
+  if (surface == NULL)
+    {
+      tile->pending = FALSE;
+      gtk_widget_queue_draw (GTK_WIDGET (self));
+      goto out;
+    }
+
+  g_clear_pointer (&tile->surface, cairo_surface_destroy);
+  tile->surface = g_steal_pointer (&surface);
+  tile->pending = FALSE;
+  tile->valid = TRUE;
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+
+ out:
+  g_clear_pointer (&surface, cairo_surface_destroy);
+}
+
+
+static GHashTable *
+photos_image_view_tiles_new (void)
+{
+  return g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, (GDestroyNotify) photos_image_view_tile_free);
+}
+
+
+static void
+photos_image_view_tiles_clear (PhotosImageView *self)
+{
+  g_cancellable_cancel (self->tiles_cancellable);
+  g_clear_object (&self->tiles_cancellable);
+  self->tiles_cancellable = g_cancellable_new ();
+
+  g_hash_table_remove_all (self->tiles);
+  g_clear_pointer (&self->tiles_old, g_hash_table_unref);
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+  self->cancellable = g_cancellable_new ();
+
+  g_clear_pointer (&self->overview, cairo_surface_destroy);
+  self->overview_pending = FALSE;
+  self->overview_valid = FALSE;
+}
+
+
+static void
+photos_image_view_tiles_invalidate (PhotosImageView *self, const GeglRectangle *rect)
+{
+  GHashTableIter iter;
+  GeglRectangle rect_zoomed;
+  PhotosImageViewTile *tile;
+  gint64 *key;
+  gint x1;
+  gint y1;
+
+  x1 = (gint) ceil ((rect->x + rect->width) * self->tiles_zoom);
+  y1 = (gint) ceil ((rect->y + rect->height) * self->tiles_zoom);
+  rect_zoomed.x = (gint) floor (rect->x * self->tiles_zoom);
+  rect_zoomed.y = (gint) floor (rect->y * self->tiles_zoom);
+  rect_zoomed.width = x1 - rect_zoomed.x;
+  rect_zoomed.height = y1 - rect_zoomed.y;
+
+  /* Stale tiles are still drawn until they are rendered again. A render
+   * that is already in flight started from the old pixels, so the tile
+   * gets a fresh serial to make its result be ignored.
+   */
+  g_hash_table_iter_init (&iter, self->tiles);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &tile))
+    {
+      GeglRectangle tile_rect;
+
+      photos_image_view_tile_get_rect (*key, &tile_rect);
+      if (gegl_rectangle_intersect (NULL, &tile_rect, &rect_zoomed))
+        {
+          tile->pending = FALSE;
+          tile->serial = ++self->tiles_serial;
+          tile->valid = FALSE;
+        }
+    }
+
+  /* Any overview that is being rendered is stale too, and will be
+   * ignored because of the new serial.
+   */
+  g_clear_pointer (&self->tiles_old, g_hash_table_unref);
+  self->overview_pending = FALSE;
+  self->overview_serial++;
+  self->overview_valid = FALSE;
+}
+
+
+static gboolean
+photos_image_view_tiles_set_zoom (PhotosImageView *self, gdouble zoom)
+{
+  GHashTableIter iter;
+  PhotosImageViewTile *tile;
+  gboolean has_surfaces = FALSE;
+
+  if (G_APPROX_VALUE (self->tiles_zoom, zoom, PHOTOS_EPSILON))
+    return FALSE;
+
+  g_cancellable_cancel (self->tiles_cancellable);
+  g_clear_object (&self->tiles_cancellable);
+  self->tiles_cancellable = g_cancellable_new ();
+
+  g_hash_table_iter_init (&iter, self->tiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+    {
+      if (tile->surface != NULL)
+        {
+          has_surfaces = TRUE;
+          break;
+        }
+    }
+
+  /* Keep the last tiles that were drawn, to stand in for the new ones
+   * while zooming.
+   */
+  if (has_surfaces)
+    {
+      g_clear_pointer (&self->tiles_old, g_hash_table_unref);
+      self->tiles_old = g_steal_pointer (&self->tiles);
+      self->tiles_old_zoom = self->tiles_zoom;
+      self->tiles = photos_image_view_tiles_new ();
+    }
+  else
+    {
+      g_hash_table_remove_all (self->tiles);
+    }
+
+  self->tiles_zoom = zoom;
+  return TRUE;
+}
+
+
+static PhotosImageViewTile *
+photos_image_view_tiles_ensure (PhotosImageView *self, gint column, gint row)
+{
+  PhotosImageViewTile *tile;
+  gint64 key;
+
+  key = photos_image_view_tile_get_key (column, row);
+  tile = (PhotosImageViewTile *) g_hash_table_lookup (self->tiles, &key);
+  if (tile == NULL)
+    {
+      gint64 *key_copy;
+
+      key_copy = g_new (gint64, 1);
+      *key_copy = key;
+
+      tile = photos_image_view_tile_new ();
+      g_hash_table_insert (self->tiles, key_copy, tile);
+    }
+
+  if (!tile->valid && !tile->pending)
+    {
+      GeglRectangle tile_rect;
+
+      photos_image_view_tile_get_rect (key, &tile_rect);
+
+      tile->pending = TRUE;
+      tile->serial = ++self->tiles_serial;
+      photos_image_view_tile_render_async (self,
+                                           &tile_rect,
+                                           self->tiles_zoom,
+                                           key,
+                                           tile->serial,
+                                           self->tiles_cancellable,
+                                           photos_image_view_tiles_render);
+    }
+
+  return tile;
+}
+
+
+static void
+photos_image_view_tiles_prefetch (PhotosImageView *self,
+                                  const GeglRectangle *viewport,
+                                  const GeglRectangle *bbox_zoomed,
+                                  gint dx,
+                                  gint dy)
+{
+  gint column;
+  gint column0;
+  gint column1;
+  gint row;
+  gint row0;
+  gint row1;
+
+  column0 = (gint) floor ((gdouble) viewport->x / TILE_SIZE);
+  column1 = (gint) floor ((gdouble) (viewport->x + viewport->width - 1) / TILE_SIZE);
+  row0 = (gint) floor ((gdouble) viewport->y / TILE_SIZE);
+  row1 = (gint) floor ((gdouble) (viewport->y + viewport->height - 1) / TILE_SIZE);
+
+  /* The strips of tiles just outside the edges that are being scrolled
+   * towards.
+   */
+  if (dx != 0)
+    {
+      column = dx > 0 ? column1 + 1 : column0 - 1;
+      for (row = row0; row <= row1; row++)
+        {
+          GeglRectangle tile_rect;
+
+          photos_image_view_tile_get_rect (photos_image_view_tile_get_key (column, row), &tile_rect);
+          if (gegl_rectangle_intersect (NULL, &tile_rect, bbox_zoomed))
+            photos_image_view_tiles_ensure (self, column, row);
+        }
+    }
+
+  if (dy != 0)
+    {
+      row = dy > 0 ? row1 + 1 : row0 - 1;
+      for (column = column0; column <= column1; column++)
+        {
+          GeglRectangle tile_rect;
+
+          photos_image_view_tile_get_rect (photos_image_view_tile_get_key (column, row), &tile_rect);
+          if (gegl_rectangle_intersect (NULL, &tile_rect, bbox_zoomed))
+            photos_image_view_tiles_ensure (self, column, row);
+        }
+    }
+}
+
+
+static void
+photos_image_view_tiles_evict (PhotosImageView *self, const GeglRectangle *viewport)
+{
+  GHashTableIter iter;
+  GeglRectangle area;
+  gint64 *key;
+
+  if (g_hash_table_size (self->tiles) <= TILES_MAX)
+    return;
+
+  area = *viewport;
+  area.x -= TILE_SIZE;
+  area.y -= TILE_SIZE;
+  area.width += 2 * TILE_SIZE;
+  area.height += 2 * TILE_SIZE;
+
+  g_hash_table_iter_init (&iter, self->tiles);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, NULL))
+    {
+      GeglRectangle tile_rect;
+
+      photos_image_view_tile_get_rect (*key, &tile_rect);
+      if (!gegl_rectangle_intersect (NULL, &tile_rect, &area))
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+
 static void
 photos_image_view_update_buffer (PhotosImageView *self)
 {
@@ -233,12 +793,35 @@ photos_image_view_update_buffer (PhotosImageView *self)
 
   format = babl_format ("cairo-ARGB32");
   buffer = photos_gegl_dup_buffer_from_node (self->node, format);
+
+  /* If only the pixels changed, the old tiles can be drawn until the
+   * new ones are ready.
+   */
+  if (self->buffer != NULL
+      && gegl_rectangle_equal (gegl_buffer_get_extent (self->buffer), gegl_buffer_get_extent (buffer)))
+    photos_image_view_tiles_invalidate (self, gegl_buffer_get_extent (buffer));
+  else
+    photos_image_view_tiles_clear (self);
+
   g_set_object (&self->buffer, buffer);
 
+  g_clear_object (&self->pyramid);
+  self->pyramid = photos_image_view_pyramid_new (buffer);
+
   g_signal_handlers_unblock_by_func (self->node, photos_image_view_computed, self);
 }
 
 
+static gboolean
+photos_image_view_is_computed (PhotosImageView *self)
+{
+  if (self->bbox_region == NULL || self->region == NULL)
+    return FALSE;
+
+  return cairo_region_equal (self->bbox_region, self->region);
+}
+
+
 static void
 photos_image_view_update_region (PhotosImageView *self)
 {
@@ -486,7 +1069,9 @@ photos_image_view_update (PhotosImageView *self)
 static void
 photos_image_view_computed (PhotosImageView *self, GeglRectangle *rect)
 {
+  GeglRectangle bbox;
   cairo_status_t status;
+  gboolean progressive;
 
   g_return_if_fail (PHOTOS_IS_IMAGE_VIEW (self));
   g_return_if_fail (GEGL_IS_BUFFER (self->buffer));
@@ -505,12 +1090,32 @@ photos_image_view_computed (PhotosImageView *self, GeglRectangle *rect)
   status = cairo_region_union_rectangle (self->region, (cairo_rectangle_int_t *) rect);
   g_return_if_fail (status == CAIRO_STATUS_SUCCESS);
 
-  if (!cairo_region_equal (self->bbox_region, self->region))
+  /* As long as the size doesn't change, copy each area as soon as it
+   * is computed, and only render the tiles that it touches again.
+   */
+  bbox = gegl_node_get_bounding_box (self->node);
+  progressive = gegl_rectangle_equal (&bbox, gegl_buffer_get_extent (self->buffer));
+  if (progressive)
+    {
+      g_signal_handlers_block_by_func (self->node, photos_image_view_computed, self);
+      gegl_node_blit_buffer (self->node, self->buffer, rect, 0, GEGL_ABYSS_NONE);
+      g_signal_handlers_unblock_by_func (self->node, photos_image_view_computed, self);
+
+      photos_image_view_pyramid_invalidate (self->pyramid, rect);
+      photos_image_view_tiles_invalidate (self, rect);
+      gtk_widget_queue_draw (GTK_WIDGET (self));
+    }
+
+  if (!photos_image_view_is_computed (self))
     return;
 
   photos_debug (PHOTOS_DEBUG_GEGL, "PhotosImageView: Node (%p) Computing Completed", self->node);
 
-  photos_image_view_update_buffer (self);
+  g_clear_pointer (&self->proxy, cairo_surface_destroy);
+
+  if (!progressive)
+    photos_image_view_update_buffer (self);
+
   photos_image_view_update (self);
   gtk_widget_queue_draw (GTK_WIDGET (self));
 }
@@ -527,77 +1132,247 @@ photos_image_view_invalidated (PhotosImageView *self)
 }
 
 
+static void
+photos_image_view_draw_placeholder (PhotosImageView *self,
+                                    cairo_t *cr,
+                                    const GeglRectangle *tile_rect,
+                                    gint x_offset,
+                                    gint y_offset,
+                                    gint scale_factor)
+{
+  const gdouble scale_factor_d = (gdouble) scale_factor;
+
+  cairo_save (cr);
+
+  cairo_rectangle (cr,
+                   (tile_rect->x - x_offset) / scale_factor_d,
+                   (tile_rect->y - y_offset) / scale_factor_d,
+                   tile_rect->width / scale_factor_d,
+                   tile_rect->height / scale_factor_d);
+  cairo_clip (cr);
+
+  /* From here on, user space is the zoomed image, in logical pixels. */
+  cairo_translate (cr, - x_offset / scale_factor_d, - y_offset / scale_factor_d);
+
+  if (self->overview != NULL)
+    {
+      GeglRectangle bbox;
+      gdouble ratio;
+
+      bbox = *gegl_buffer_get_extent (self->buffer);
+      ratio = self->tiles_zoom / self->overview_zoom;
+
+      cairo_save (cr);
+      cairo_scale (cr, ratio, ratio);
+      cairo_surface_set_device_scale (self->overview, scale_factor_d, scale_factor_d);
+      cairo_set_source_surface (cr,
+                                self->overview,
+                                floor (self->overview_zoom * bbox.x) / scale_factor_d,
+                                floor (self->overview_zoom * bbox.y) / scale_factor_d);
+      cairo_paint (cr);
+      cairo_restore (cr);
+    }
+
+  if (self->tiles_old != NULL)
+    {
+      GHashTableIter iter;
+      PhotosImageViewTile *tile;
+      gdouble ratio;
+      gint64 *key;
+
+      ratio = self->tiles_zoom / self->tiles_old_zoom;
+      cairo_scale (cr, ratio, ratio);
+
+      g_hash_table_iter_init (&iter, self->tiles_old);
+      while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &tile))
+        {
+          GeglRectangle tile_old_rect;
+          GeglRectangle tile_old_rect_zoomed;
+
+          if (tile->surface == NULL)
+            continue;
+
+          photos_image_view_tile_get_rect (*key, &tile_old_rect);
+          tile_old_rect_zoomed.x = (gint) floor (tile_old_rect.x * ratio);
+          tile_old_rect_zoomed.y = (gint) floor (tile_old_rect.y * ratio);
+          tile_old_rect_zoomed.width = (gint) ceil (tile_old_rect.width * ratio) + 1;
+          tile_old_rect_zoomed.height = (gint) ceil (tile_old_rect.height * ratio) + 1;
+          if (!gegl_rectangle_intersect (NULL, &tile_old_rect_zoomed, tile_rect))
+            continue;
+
+          cairo_surface_set_device_scale (tile->surface, scale_factor_d, scale_factor_d);
+          cairo_set_source_surface (cr,
+                                    tile->surface,
+                                    tile_old_rect.x / scale_factor_d,
+                                    tile_old_rect.y / scale_factor_d);
+          cairo_paint (cr);
+        }
+    }
+
+  cairo_restore (cr);
+}
+
+
+static void
+photos_image_view_draw_proxy (PhotosImageView *self,
+                              cairo_t *cr,
+                              const GeglRectangle *bbox_zoomed,
+                              gint x_offset,
+                              gint y_offset,
+                              gint scale_factor)
+{
+  const gdouble scale_factor_d = (gdouble) scale_factor;
+  gint height;
+  gint width;
+
+  height = cairo_image_surface_get_height (self->proxy);
+  width = cairo_image_surface_get_width (self->proxy);
+
+  cairo_save (cr);
+
+  cairo_rectangle (cr,
+                   (bbox_zoomed->x - x_offset) / scale_factor_d,
+                   (bbox_zoomed->y - y_offset) / scale_factor_d,
+                   bbox_zoomed->width / scale_factor_d,
+                   bbox_zoomed->height / scale_factor_d);
+  cairo_clip (cr);
+
+  cairo_translate (cr, (bbox_zoomed->x - x_offset) / scale_factor_d, (bbox_zoomed->y - y_offset) / scale_factor_d);
+  cairo_scale (cr,
+               bbox_zoomed->width / (scale_factor_d * width),
+               bbox_zoomed->height / (scale_factor_d * height));
+  cairo_set_source_surface (cr, self->proxy, 0.0, 0.0);
+  cairo_paint (cr);
+
+  cairo_restore (cr);
+}
+
+
 static void
 photos_image_view_draw_node (PhotosImageView *self, cairo_t *cr, GdkRectangle *rect)
 {
-  const Babl *format;
-  GeglAbyssPolicy buffer_flags;
+  GeglRectangle bbox;
+  GeglRectangle bbox_zoomed;
   GeglRectangle roi;
-  cairo_surface_t *surface = NULL;
+  GeglRectangle viewport;
+  gboolean zoom_changed;
+  gint column;
+  gint column0;
+  gint column1;
+  gint row;
+  gint row0;
+  gint row1;
   gint scale_factor;
-  gint stride;
+  gint x_offset;
+  gint y_offset;
   gint64 end;
   gint64 start;
-  gsize surface_memory_size;
+  guint n_pending = 0;
 
   g_return_if_fail (GEGL_IS_BUFFER (self->buffer));
+  g_return_if_fail (PHOTOS_IS_IMAGE_VIEW_PYRAMID (self->pyramid));
   g_return_if_fail (self->zoom_visible > 0.0);
   g_return_if_fail (self->zoom_visible_scaled > 0.0);
 
+  start = g_get_monotonic_time ();
+
+  zoom_changed = photos_image_view_tiles_set_zoom (self, self->zoom_visible_scaled);
+  photos_image_view_overview_request (self);
+
   scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (self));
+  x_offset = (gint) self->x_scaled;
+  y_offset = (gint) self->y_scaled;
 
-  roi.x = (gint) self->x_scaled + rect->x * scale_factor;
-  roi.y = (gint) self->y_scaled + rect->y * scale_factor;
+  roi.x = x_offset + rect->x * scale_factor;
+  roi.y = y_offset + rect->y * scale_factor;
   roi.width  = rect->width * scale_factor;
   roi.height = rect->height * scale_factor;
 
-  stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, roi.width);
+  bbox = *gegl_buffer_get_extent (self->buffer);
+  bbox_zoomed.x = (gint) (self->tiles_zoom * bbox.x + 0.5);
+  bbox_zoomed.y = (gint) (self->tiles_zoom * bbox.y + 0.5);
+  bbox_zoomed.width = (gint) (self->tiles_zoom * bbox.width + 0.5);
+  bbox_zoomed.height = (gint) (self->tiles_zoom * bbox.height + 0.5);
 
-  /* It's assumed that this multiplication won't overflow, because, if
-   * it did then there would be a lot more problems. eg., attempts to
-   * allocate memory for the entire top-level GtkWindow would blow up.
+  /* While the node is being processed after an edit, the proxy is a
+   * better approximation of the result than the stale tiles.
    */
-  surface_memory_size = (gsize) roi.height * (gsize) stride;
-  g_return_if_fail (self->surface_memory_size >= surface_memory_size);
+  if (self->proxy != NULL)
+    {
+      photos_image_view_draw_proxy (self, cr, &bbox_zoomed, x_offset, y_offset, scale_factor);
+      goto out;
+    }
 
-  format = babl_format ("cairo-ARGB32");
+  column0 = (gint) floor ((gdouble) roi.x / TILE_SIZE);
+  column1 = (gint) floor ((gdouble) (roi.x + roi.width - 1) / TILE_SIZE);
+  row0 = (gint) floor ((gdouble) roi.y / TILE_SIZE);
+  row1 = (gint) floor ((gdouble) (roi.y + roi.height - 1) / TILE_SIZE);
 
-  if (self->zoom_animation == NULL)
-    buffer_flags = GEGL_ABYSS_NONE | GEGL_BUFFER_FILTER_AUTO;
-  else
-    buffer_flags = GEGL_ABYSS_NONE | GEGL_BUFFER_FILTER_NEAREST;
+  for (row = row0; row <= row1; row++)
+    {
+      for (column = column0; column <= column1; column++)
+        {
+          GeglRectangle tile_rect;
+          GeglRectangle tile_roi;
+          PhotosImageViewTile *tile;
 
-  start = g_get_monotonic_time ();
+          photos_image_view_tile_get_rect (photos_image_view_tile_get_key (column, row), &tile_rect);
+          if (!gegl_rectangle_intersect (&tile_roi, &tile_rect, &bbox_zoomed))
+            continue;
 
-  gegl_buffer_get (self->buffer,
-                   &roi,
-                   self->zoom_visible_scaled,
-                   format,
-                   self->surface_memory,
-                   stride,
-                   buffer_flags);
+          tile = photos_image_view_tiles_ensure (self, column, row);
 
+          if (tile->pending)
+            n_pending++;
+
+          if (tile->surface == NULL)
+            {
+              photos_image_view_draw_placeholder (self, cr, &tile_roi, x_offset, y_offset, scale_factor);
+              continue;
+            }
+
+          cairo_surface_set_device_scale (tile->surface, (gdouble) scale_factor, (gdouble) scale_factor);
+          cairo_set_source_surface (cr,
+                                    tile->surface,
+                                    (tile_rect.x - x_offset) / (gdouble) scale_factor,
+                                    (tile_rect.y - y_offset) / (gdouble) scale_factor);
+          cairo_paint (cr);
+        }
+    }
+
+  viewport.x = x_offset;
+  viewport.y = y_offset;
+  viewport.width = self->allocation_scaled_old.width;
+  viewport.height = self->allocation_scaled_old.height;
+
+  /* While panning, only the tiles that scroll into view need to be
+   * rendered, and they can be started a frame or more ahead.
+   */
+  if (!zoom_changed)
+    {
+      photos_image_view_tiles_prefetch (self,
+                                        &viewport,
+                                        &bbox_zoomed,
+                                        x_offset - self->tiles_x_offset,
+                                        y_offset - self->tiles_y_offset);
+    }
+
+  self->tiles_x_offset = x_offset;
+  self->tiles_y_offset = y_offset;
+
+  photos_image_view_tiles_evict (self, &viewport);
+
+ out:
   end = g_get_monotonic_time ();
   photos_debug (PHOTOS_DEBUG_GEGL,
-                "PhotosImageView: Node Blit: %d, %d, %d×%d, %.4f, %d, %" G_GINT64_FORMAT,
+                "PhotosImageView: Node Blit: %d, %d, %d×%d, %.4f, %u pending, %" G_GINT64_FORMAT,
                 rect->x,
                 rect->y,
                 rect->width,
                 rect->height,
                 self->zoom_visible_scaled,
-                buffer_flags,
+                n_pending,
                 end - start);
-
-  surface = cairo_image_surface_create_for_data (self->surface_memory,
-                                                 CAIRO_FORMAT_ARGB32,
-                                                 roi.width,
-                                                 roi.height,
-                                                 stride);
-  cairo_surface_set_device_scale (surface, (gdouble) scale_factor, (gdouble) scale_factor);
-  cairo_set_source_surface (cr, surface, rect->x, rect->y);
-  cairo_paint (cr);
-
-  cairo_surface_destroy (surface);
 }
 
 
@@ -643,38 +1418,15 @@ static void
 photos_image_view_size_allocate (GtkWidget *widget, GtkAllocation *allocation)
 {
   PhotosImageView *self = PHOTOS_IMAGE_VIEW (widget);
-  gint allocation_height_scaled;
-  gint allocation_width_scaled;
   gint scale_factor;
-  gint stride;
-  gsize surface_memory_size;
 
   GTK_WIDGET_CLASS (photos_image_view_parent_class)->size_allocate (widget, allocation);
 
   photos_image_view_update (self);
 
   scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (self));
-  allocation_height_scaled = allocation->height * scale_factor;
-  allocation_width_scaled = allocation->width * scale_factor;
-
-  stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, allocation_width_scaled);
-
-  /* It's assumed that this multiplication won't overflow, because, if
-   * it did then there would be a lot more problems. eg., attempts to
-   * allocate memory for the entire top-level GtkWindow would blow up.
-   */
-  surface_memory_size = (gsize) allocation_height_scaled * (gsize) stride;
-
-  if (self->surface_memory_size < surface_memory_size)
-    {
-      g_clear_pointer (&self->surface_memory, g_free);
-
-      self->surface_memory = (guchar *) g_malloc0 (surface_memory_size);
-      self->surface_memory_size = surface_memory_size;
-    }
-
-  self->allocation_scaled_old.height = allocation_height_scaled;
-  self->allocation_scaled_old.width = allocation_width_scaled;
+  self->allocation_scaled_old.height = allocation->height * scale_factor;
+  self->allocation_scaled_old.width = allocation->width * scale_factor;
 }
 
 
@@ -767,6 +1519,17 @@ photos_image_view_dispose (GObject *object)
       g_assert_null (self->zoom_animation);
     }
 
+  if (self->cancellable != NULL)
+    g_cancellable_cancel (self->cancellable);
+
+  if (self->tiles_cancellable != NULL)
+    g_cancellable_cancel (self->tiles_cancellable);
+
+  g_clear_object (&self->cancellable);
+  g_clear_object (&self->tiles_cancellable);
+  g_clear_pointer (&self->tiles, g_hash_table_unref);
+  g_clear_pointer (&self->tiles_old, g_hash_table_unref);
+  g_clear_object (&self->pyramid);
   g_clear_object (&self->buffer);
   g_clear_object (&self->node);
   g_clear_object (&self->hadjustment);
@@ -783,7 +1546,8 @@ photos_image_view_finalize (GObject *object)
 
   g_clear_pointer (&self->bbox_region, cairo_region_destroy);
   g_clear_pointer (&self->region, cairo_region_destroy);
-  g_clear_pointer (&self->surface_memory, g_free);
+  g_clear_pointer (&self->overview, cairo_surface_destroy);
+  g_clear_pointer (&self->proxy, cairo_surface_destroy);
 
   G_OBJECT_CLASS (photos_image_view_parent_class)->finalize (object);
 }
@@ -932,6 +1696,10 @@ photos_image_view_init (PhotosImageView *self)
   gtk_style_context_add_class (context, GTK_STYLE_CLASS_VIEW);
   gtk_style_context_add_class (context, "content-view");
 
+  self->cancellable = g_cancellable_new ();
+  self->tiles_cancellable = g_cancellable_new ();
+  self->tiles = photos_image_view_tiles_new ();
+
   self->best_fit = TRUE;
   self->zoom = 1.0;
   self->zoom_visible = 1.0;
@@ -1145,8 +1913,11 @@ photos_image_view_set_node (PhotosImageView *self, GeglNode *node)
   self->zoom = 1.0;
   self->zoom_visible = 1.0;
   self->zoom_visible_scaled = 1.0;
+  photos_image_view_tiles_clear (self);
+  g_clear_object (&self->pyramid);
   g_clear_object (&self->buffer);
   g_clear_object (&self->node);
+  g_clear_pointer (&self->proxy, cairo_surface_destroy);
   g_clear_pointer (&self->bbox_region, cairo_region_destroy);
   g_clear_pointer (&self->region, cairo_region_destroy);
 
@@ -1177,6 +1948,42 @@ photos_image_view_set_node (PhotosImageView *self, GeglNode *node)
 }
 
 
+void
+photos_image_view_set_proxy (PhotosImageView *self, GeglBuffer *proxy)
+{
+  GeglRectangle bbox;
+  gint stride;
+  guchar *data;
+
+  g_return_if_fail (PHOTOS_IS_IMAGE_VIEW (self));
+  g_return_if_fail (proxy == NULL || GEGL_IS_BUFFER (proxy));
+
+  g_clear_pointer (&self->proxy, cairo_surface_destroy);
+
+  if (proxy == NULL)
+    goto out;
+
+  /* A proxy that arrives after the node has been processed in full
+   * would only make things blurrier.
+   */
+  if (self->node == NULL || photos_image_view_is_computed (self))
+    goto out;
+
+  bbox = *gegl_buffer_get_extent (proxy);
+  self->proxy = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, bbox.width, bbox.height);
+
+  cairo_surface_flush (self->proxy);
+  data = cairo_image_surface_get_data (self->proxy);
+  stride = cairo_image_surface_get_stride (self->proxy);
+  gegl_buffer_get (proxy, &bbox, 1.0, babl_format ("cairo-ARGB32"), data, stride, GEGL_ABYSS_NONE);
+  cairo_surface_mark_dirty (self->proxy);
+
+  photos_debug (PHOTOS_DEBUG_GEGL, "PhotosImageView: Proxy: %d×%d", bbox.width, bbox.height);
+
+ out:
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
 void
 photos_image_view_set_zoom (PhotosImageView *self, gdouble zoom, gboolean enable_animation)
 {
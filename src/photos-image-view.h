@@ -47,6 +47,8 @@ void                photos_image_view_set_best_fit       (PhotosImageView *self,
 
 void                photos_image_view_set_node           (PhotosImageView *self, GeglNode *node);
 
+void                photos_image_view_set_proxy          (PhotosImageView *self, GeglBuffer *proxy);
+
 void                photos_image_view_set_zoom           (PhotosImageView *self,
                                                           gdouble zoom,
                                                           gboolean enable_animation);
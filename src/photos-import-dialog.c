@@ -629,13 +629,12 @@ photos_import_dialog_fetch_collections_local_query_executed (GObject *source_obj
                                                              gpointer user_data)
 {
   PhotosImportDialog *self;
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   TrackerSparqlCursor *cursor = NULL; /* TODO: use g_autoptr */
 
   {
     g_autoptr (GError) error = NULL;
 
-    cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+    cursor = photos_tracker_queue_select_finish (source_object, res, &error);
     if (error != NULL)
       {
         if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
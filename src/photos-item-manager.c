@@ -73,6 +73,7 @@ enum
   FULLSCREEN_CHANGED,
   LOAD_ERROR,
   LOAD_FINISHED,
+  LOAD_PREVIEW,
   LOAD_STARTED,
   WINDOW_MODE_CHANGED,
   LAST_SIGNAL
@@ -676,13 +677,12 @@ photos_item_manager_wait_for_changes_timeout_query_executed (GObject *source_obj
                                                              gpointer user_data)
 {
   PhotosItemManager *self = PHOTOS_ITEM_MANAGER (user_data);
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   TrackerSparqlCursor *cursor = NULL; /* TODO: use g_autoptr */
 
   {
     g_autoptr (GError) error = NULL;
 
-    cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+    cursor = photos_tracker_queue_select_finish (source_object, res, &error);
     if (error != NULL)
       {
         g_warning ("Unable to fetch URN for URI: %s", error->message);
@@ -855,6 +855,60 @@ photos_item_manager_item_load (GObject *source_object, GAsyncResult *res, gpoint
 }
 
 
+static void
+photos_item_manager_item_load_preview (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autoptr (PhotosItemManager) self = PHOTOS_ITEM_MANAGER (user_data);
+  g_autoptr (GeglNode) node = NULL;
+  PhotosBaseItem *item = PHOTOS_BASE_ITEM (source_object);
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    node = photos_base_item_load_preview_finish (item, res, &error);
+    if (error != NULL)
+      {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)
+            && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+          photos_debug (PHOTOS_DEBUG_GEGL, "Unable to load preview: %s", error->message);
+
+        goto out;
+      }
+  }
+
+  /* The full resolution image might have won the race. */
+  if (self->load_state != PHOTOS_LOAD_STATE_STARTED || self->active_object != G_OBJECT (item))
+    goto out;
+
+  g_signal_emit (self, signals[LOAD_PREVIEW], 0, item, node);
+
+ out:
+  return;
+}
+
+
+static gint
+photos_item_manager_get_preview_size (void)
+{
+  GdkDisplay *display;
+  GdkMonitor *monitor;
+  GdkRectangle geometry;
+  gint ret_val;
+  gint scale;
+
+  display = gdk_display_get_default ();
+  monitor = gdk_display_get_primary_monitor (display);
+  if (monitor == NULL)
+    monitor = gdk_display_get_monitor (display, 0);
+
+  gdk_monitor_get_geometry (monitor, &geometry);
+  scale = gdk_monitor_get_scale_factor (monitor);
+
+  ret_val = MAX (geometry.height, geometry.width) * scale;
+  return ret_val;
+}
+
+
 static void
 photos_item_manager_items_changed (PhotosItemManager *self, guint position, guint removed, guint added)
 {
@@ -996,6 +1050,15 @@ photos_item_manager_set_active_object (PhotosBaseManager *manager, GObject *obje
                                    photos_item_manager_item_load,
                                    g_object_ref (self));
 
+      /* A large image takes a while to decode in full, so a reduced
+       * resolution version is shown in the meantime.
+       */
+      photos_base_item_load_preview_async (PHOTOS_BASE_ITEM (object),
+                                           photos_item_manager_get_preview_size (),
+                                           self->loader_cancellable,
+                                           photos_item_manager_item_load_preview,
+                                           g_object_ref (self));
+
       g_signal_emit (self, signals[LOAD_STARTED], 0, PHOTOS_BASE_ITEM (object));
 
       g_assert (self->active_object != (GObject *) self->active_collection);
@@ -1199,6 +1262,18 @@ photos_item_manager_class_init (PhotosItemManagerClass *class)
                                          PHOTOS_TYPE_BASE_ITEM,
                                          GEGL_TYPE_NODE);
 
+  signals[LOAD_PREVIEW] = g_signal_new ("load-preview",
+                                        G_TYPE_FROM_CLASS (class),
+                                        G_SIGNAL_RUN_LAST,
+                                        0,
+                                        NULL, /*accumulator */
+                                        NULL, /*accu_data */
+                                        g_cclosure_marshal_generic,
+                                        G_TYPE_NONE,
+                                        2,
+                                        PHOTOS_TYPE_BASE_ITEM,
+                                        GEGL_TYPE_NODE);
+
   signals[LOAD_STARTED] = g_signal_new ("load-started",
                                         G_TYPE_FROM_CLASS (class),
                                         G_SIGNAL_RUN_LAST,
@@ -25,6 +25,7 @@
 
 
 typedef struct _PhotosJpegCountDestMgr PhotosJpegCountDestMgr;
+typedef struct _PhotosJpegDataDestMgr PhotosJpegDataDestMgr;
 
 struct _PhotosJpegCountDestMgr
 {
@@ -32,7 +33,15 @@ struct _PhotosJpegCountDestMgr
   gsize *out_count;
 };
 
+struct _PhotosJpegDataDestMgr
+{
+  struct jpeg_destination_mgr parent;
+  GByteArray *data;
+  JOCTET *buffer;
+};
+
 static JOCTET dummy_buffer[1];
+static const gsize DATA_BUFFER_SIZE = 65536;
 
 
 static gboolean
@@ -90,3 +99,59 @@ photos_jpeg_count_dest (j_compress_ptr cinfo, gsize *out_count)
   if (dest->out_count != NULL)
     *dest->out_count = 0;
 }
+
+
+static boolean
+photos_jpeg_data_empty_output_buffer (j_compress_ptr cinfo)
+{
+  PhotosJpegDataDestMgr *dest = (PhotosJpegDataDestMgr *) cinfo->dest;
+
+  g_byte_array_append (dest->data, dest->buffer, (guint) DATA_BUFFER_SIZE);
+
+  dest->parent.next_output_byte = dest->buffer;
+  dest->parent.free_in_buffer = DATA_BUFFER_SIZE;
+
+  return TRUE;
+}
+
+
+static void
+photos_jpeg_data_init_destination (j_compress_ptr cinfo)
+{
+  PhotosJpegDataDestMgr *dest = (PhotosJpegDataDestMgr *) cinfo->dest;
+
+  dest->buffer = (JOCTET *) (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE, DATA_BUFFER_SIZE);
+  dest->parent.next_output_byte = dest->buffer;
+  dest->parent.free_in_buffer = DATA_BUFFER_SIZE;
+}
+
+
+static void
+photos_jpeg_data_term_destination (j_compress_ptr cinfo)
+{
+  PhotosJpegDataDestMgr *dest = (PhotosJpegDataDestMgr *) cinfo->dest;
+
+  g_byte_array_append (dest->data, dest->buffer, (guint) (DATA_BUFFER_SIZE - dest->parent.free_in_buffer));
+}
+
+
+void
+photos_jpeg_data_dest (j_compress_ptr cinfo, GByteArray *data)
+{
+  PhotosJpegDataDestMgr *dest;
+
+  g_return_if_fail (cinfo->dest == NULL);
+  g_return_if_fail (data != NULL);
+
+  cinfo->dest
+    = (struct jpeg_destination_mgr *) (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo,
+                                                                  JPOOL_PERMANENT,
+                                                                  sizeof (PhotosJpegDataDestMgr));
+
+  dest = (PhotosJpegDataDestMgr *) cinfo->dest;
+  dest->parent.init_destination = photos_jpeg_data_init_destination;
+  dest->parent.empty_output_buffer = photos_jpeg_data_empty_output_buffer;
+  dest->parent.term_destination = photos_jpeg_data_term_destination;
+  dest->data = data;
+  dest->buffer = NULL;
+}
@@ -26,6 +26,8 @@ G_BEGIN_DECLS
 
 void                photos_jpeg_count_dest          (j_compress_ptr cinfo, gsize *out_count);
 
+void                photos_jpeg_data_dest           (j_compress_ptr cinfo, GByteArray *data);
+
 G_END_DECLS
 
 #endif /* PHOTOS_JPEG_COUNT_H */
@@ -0,0 +1,677 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <jpeglib.h>
+
+#include "photos-debug.h"
+#include "photos-jpeg-load.h"
+
+
+typedef struct _PhotosJpegLoadErrorMgr PhotosJpegLoadErrorMgr;
+
+struct _PhotosJpegLoadErrorMgr
+{
+  struct jpeg_error_mgr parent;
+  jmp_buf setjmp_buffer;
+  gchar message[JMSG_LENGTH_MAX];
+};
+
+static const gdouble ASPECT_RATIO_TOLERANCE = 0.01;
+static const gint CANCELLATION_CHECK_ROWS = 64;
+static const guint16 EXIF_TAG_JPEG_INTERCHANGE_FORMAT = 0x0201;
+static const guint16 EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH = 0x0202;
+static const gint MAX_SCALE_DENOM = 8;
+
+
+static void
+photos_jpeg_load_error_exit (j_common_ptr cinfo)
+{
+  PhotosJpegLoadErrorMgr *err = (PhotosJpegLoadErrorMgr *) cinfo->err;
+
+  (*cinfo->err->format_message) (cinfo, err->message);
+  longjmp (err->setjmp_buffer, 1);
+}
+
+
+static void
+photos_jpeg_load_output_message (j_common_ptr cinfo)
+{
+}
+
+
+static guint16
+photos_jpeg_load_read_uint16 (const JOCTET *data, gboolean little_endian)
+{
+  guint16 ret_val;
+
+  if (little_endian)
+    ret_val = (guint16) (data[0] | (data[1] << 8));
+  else
+    ret_val = (guint16) ((data[0] << 8) | data[1]);
+
+  return ret_val;
+}
+
+
+static guint32
+photos_jpeg_load_read_uint32 (const JOCTET *data, gboolean little_endian)
+{
+  guint32 ret_val;
+
+  if (little_endian)
+    ret_val = (guint32) data[0] | ((guint32) data[1] << 8) | ((guint32) data[2] << 16) | ((guint32) data[3] << 24);
+  else
+    ret_val = ((guint32) data[0] << 24) | ((guint32) data[1] << 16) | ((guint32) data[2] << 8) | (guint32) data[3];
+
+  return ret_val;
+}
+
+
+static gboolean
+photos_jpeg_load_find_exif_thumbnail (j_decompress_ptr cinfo, const JOCTET **out_data, gsize *out_length)
+{
+  jpeg_saved_marker_ptr marker;
+
+  for (marker = cinfo->marker_list; marker != NULL; marker = marker->next)
+    {
+      const JOCTET *tiff;
+      gboolean little_endian;
+      gsize length;
+      guint16 i;
+      guint16 n_entries;
+      guint32 ifd0;
+      guint32 ifd1;
+      guint32 offset = 0;
+      guint32 thumbnail_length = 0;
+
+      if (marker->marker != JPEG_APP0 + 1 || marker->data_length < 6 + 8)
+        continue;
+
+      if (memcmp (marker->data, "Exif\0\0", 6) != 0)
+        continue;
+
+      /* Offsets in IFDs are relative to the start of the TIFF header
+       * that follows the Exif identifier.
+       */
+      tiff = marker->data + 6;
+      length = marker->data_length - 6;
+
+      if (tiff[0] == 'I' && tiff[1] == 'I')
+        little_endian = TRUE;
+      else if (tiff[0] == 'M' && tiff[1] == 'M')
+        little_endian = FALSE;
+      else
+        continue;
+
+      ifd0 = photos_jpeg_load_read_uint32 (tiff + 4, little_endian);
+      if (ifd0 > length - 2)
+        continue;
+
+      n_entries = photos_jpeg_load_read_uint16 (tiff + ifd0, little_endian);
+      if ((gsize) ifd0 + 2 + 12 * (gsize) n_entries + 4 > length)
+        continue;
+
+      /* IFD1, if present, describes the embedded thumbnail. */
+      ifd1 = photos_jpeg_load_read_uint32 (tiff + ifd0 + 2 + 12 * n_entries, little_endian);
+      if (ifd1 == 0 || ifd1 > length - 2)
+        continue;
+
+      n_entries = photos_jpeg_load_read_uint16 (tiff + ifd1, little_endian);
+      for (i = 0; i < n_entries; i++)
+        {
+          const JOCTET *entry;
+          gsize entry_offset = (gsize) ifd1 + 2 + 12 * (gsize) i;
+          guint16 tag;
+
+          if (entry_offset + 12 > length)
+            break;
+
+          entry = tiff + entry_offset;
+          tag = photos_jpeg_load_read_uint16 (entry, little_endian);
+          if (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT)
+            offset = photos_jpeg_load_read_uint32 (entry + 8, little_endian);
+          else if (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH)
+            thumbnail_length = photos_jpeg_load_read_uint32 (entry + 8, little_endian);
+        }
+
+      if (offset == 0 || thumbnail_length == 0 || offset > length || thumbnail_length > length - offset)
+        continue;
+
+      *out_data = tiff + offset;
+      *out_length = thumbnail_length;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+static void
+photos_jpeg_load_get_size_to_fit (gint image_width,
+                                  gint image_height,
+                                  gint width,
+                                  gint height,
+                                  gint *out_width,
+                                  gint *out_height)
+{
+  gdouble scale;
+
+  if (width <= 0 && height <= 0)
+    {
+      *out_width = image_width;
+      *out_height = image_height;
+      return;
+    }
+
+  if (width <= 0)
+    scale = (gdouble) height / (gdouble) image_height;
+  else if (height <= 0)
+    scale = (gdouble) width / (gdouble) image_width;
+  else
+    scale = MIN ((gdouble) width / (gdouble) image_width, (gdouble) height / (gdouble) image_height);
+
+  *out_width = MAX ((gint) (scale * (gdouble) image_width + 0.5), 1);
+  *out_height = MAX ((gint) (scale * (gdouble) image_height + 0.5), 1);
+}
+
+
+static gboolean
+photos_jpeg_load_set_out_color_space (j_decompress_ptr cinfo, GError **error)
+{
+  gboolean ret_val = FALSE;
+
+  switch (cinfo->jpeg_color_space)
+    {
+    case JCS_GRAYSCALE:
+      cinfo->out_color_space = JCS_GRAYSCALE;
+      break;
+
+    case JCS_RGB:
+    case JCS_YCbCr:
+      cinfo->out_color_space = JCS_RGB;
+      break;
+
+    case JCS_CMYK:
+    case JCS_YCCK:
+    case JCS_UNKNOWN:
+    default:
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unsupported JPEG color space");
+      goto out;
+    }
+
+  ret_val = TRUE;
+
+ out:
+  return ret_val;
+}
+
+
+static void
+photos_jpeg_load_copy_row (guchar *dest, const JSAMPLE *src, gint n_components, guint n_pixels)
+{
+  guint i;
+
+  if (n_components == 3)
+    {
+      memcpy (dest, src, 3 * (gsize) n_pixels);
+      return;
+    }
+
+  for (i = 0; i < n_pixels; i++)
+    dest[3 * i] = dest[3 * i + 1] = dest[3 * i + 2] = src[i];
+}
+
+
+static GdkPixbuf *
+photos_jpeg_load_decode (FILE *file,
+                         const JOCTET *data,
+                         gsize length,
+                         gint width,
+                         gint height,
+                         gdouble required_aspect_ratio,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+  GdkPixbuf *volatile pixbuf = NULL;
+  GdkPixbuf *volatile ret_val = NULL;
+  JSAMPARRAY gray_row = NULL;
+  PhotosJpegLoadErrorMgr jerr;
+  struct jpeg_decompress_struct cinfo;
+  const JOCTET *thumbnail_data;
+  guchar *pixels;
+  gsize thumbnail_length;
+  gint denom;
+  gint rowstride;
+  gint target_height;
+  gint target_width;
+
+  cinfo.err = jpeg_std_error (&jerr.parent);
+  jerr.parent.error_exit = photos_jpeg_load_error_exit;
+  jerr.parent.output_message = photos_jpeg_load_output_message;
+
+  /* Only touch volatile and in-memory state here, because locals may
+   * have been clobbered by the longjmp.
+   */
+  if (setjmp (jerr.setjmp_buffer))
+    {
+      g_set_error (error,
+                   GDK_PIXBUF_ERROR,
+                   GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                   "Error interpreting JPEG image file (%s)",
+                   jerr.message);
+
+      jpeg_destroy_decompress (&cinfo);
+      if (pixbuf != NULL)
+        g_object_unref (pixbuf);
+
+      return NULL;
+    }
+
+  jpeg_create_decompress (&cinfo);
+
+  if (file != NULL)
+    jpeg_stdio_src (&cinfo, file);
+  else
+    jpeg_mem_src (&cinfo, (unsigned char *) data, (unsigned long) length);
+
+  if (required_aspect_ratio <= 0.0)
+    jpeg_save_markers (&cinfo, JPEG_APP0 + 1, 0xffff);
+
+  jpeg_read_header (&cinfo, TRUE);
+
+  if (!photos_jpeg_load_set_out_color_space (&cinfo, error))
+    goto out;
+
+  photos_jpeg_load_get_size_to_fit ((gint) cinfo.image_width,
+                                    (gint) cinfo.image_height,
+                                    width,
+                                    height,
+                                    &target_width,
+                                    &target_height);
+
+  if (required_aspect_ratio > 0.0)
+    {
+      gdouble aspect_ratio = (gdouble) cinfo.image_width / (gdouble) cinfo.image_height;
+
+      /* An embedded thumbnail is only useful if it doesn't need to be
+       * scaled up, and if it wasn't letterboxed to a different aspect
+       * ratio, as is common with 160×120 EXIF thumbnails.
+       */
+      if (fabs (aspect_ratio - required_aspect_ratio) > ASPECT_RATIO_TOLERANCE * required_aspect_ratio
+          || (gint) cinfo.image_width < target_width
+          || (gint) cinfo.image_height < target_height)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Embedded thumbnail is too small");
+          goto out;
+        }
+    }
+  else if (photos_jpeg_load_find_exif_thumbnail (&cinfo, &thumbnail_data, &thumbnail_length))
+    {
+      gdouble aspect_ratio = (gdouble) cinfo.image_width / (gdouble) cinfo.image_height;
+
+      ret_val = photos_jpeg_load_decode (NULL,
+                                         thumbnail_data,
+                                         thumbnail_length,
+                                         target_width,
+                                         target_height,
+                                         aspect_ratio,
+                                         cancellable,
+                                         NULL);
+      if (ret_val != NULL)
+        {
+          photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Using the embedded EXIF thumbnail");
+          goto out;
+        }
+    }
+
+  /* Let the IDCT produce the smallest power-of-two reduction that is
+   * still at least as large as the target, so that the final scaling
+   * step never has to magnify.
+   */
+  for (denom = MAX_SCALE_DENOM; denom > 1; denom /= 2)
+    {
+      gint scaled_height = ((gint) cinfo.image_height + denom - 1) / denom;
+      gint scaled_width = ((gint) cinfo.image_width + denom - 1) / denom;
+
+      if (scaled_height >= target_height && scaled_width >= target_width)
+        break;
+    }
+
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = (guint) denom;
+
+  jpeg_start_decompress (&cinfo);
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER,
+                "Decoding JPEG at 1/%d: %u×%u from %u×%u",
+                denom,
+                cinfo.output_width,
+                cinfo.output_height,
+                cinfo.image_width,
+                cinfo.image_height);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, (gint) cinfo.output_width, (gint) cinfo.output_height);
+  if (pixbuf == NULL)
+    {
+      g_set_error_literal (error,
+                           GDK_PIXBUF_ERROR,
+                           GDK_PIXBUF_ERROR_INSUFFICIENT_MEMORY,
+                           "Insufficient memory to load image");
+      goto out;
+    }
+
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  if (cinfo.out_color_space == JCS_GRAYSCALE)
+    gray_row = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width, 1);
+
+  while (cinfo.output_scanline < cinfo.output_height)
+    {
+      guchar *row = pixels + (gsize) cinfo.output_scanline * (gsize) rowstride;
+
+      if (cinfo.output_scanline % CANCELLATION_CHECK_ROWS == 0
+          && g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      if (gray_row == NULL)
+        {
+          JSAMPROW row_pointer[1] = { row };
+
+          jpeg_read_scanlines (&cinfo, row_pointer, 1);
+        }
+      else
+        {
+          jpeg_read_scanlines (&cinfo, gray_row, 1);
+          photos_jpeg_load_copy_row (row, gray_row[0], 1, cinfo.output_width);
+        }
+    }
+
+  jpeg_finish_decompress (&cinfo);
+
+  if (gdk_pixbuf_get_width (pixbuf) == target_width && gdk_pixbuf_get_height (pixbuf) == target_height)
+    ret_val = g_object_ref (pixbuf);
+  else
+    ret_val = gdk_pixbuf_scale_simple (pixbuf, target_width, target_height, GDK_INTERP_BILINEAR);
+
+ out:
+  jpeg_destroy_decompress (&cinfo);
+  if (pixbuf != NULL)
+    g_object_unref (pixbuf);
+  return ret_val;
+}
+
+
+static FILE *
+photos_jpeg_load_open (const gchar *filename, GError **error)
+{
+  FILE *file = NULL;
+  FILE *ret_val = NULL;
+  guchar magic[2];
+
+  file = g_fopen (filename, "rb");
+  if (file == NULL)
+    {
+      gint errsv = errno;
+      g_autofree gchar *display_name = NULL;
+
+      display_name = g_filename_display_name (filename);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to open file “%s”: %s",
+                   display_name,
+                   g_strerror (errsv));
+      goto out;
+    }
+
+  if (fread (magic, 1, sizeof (magic), file) != sizeof (magic) || magic[0] != 0xff || magic[1] != 0xd8)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Not a JPEG file");
+      goto out;
+    }
+
+  rewind (file);
+  ret_val = file;
+  file = NULL;
+
+ out:
+  if (file != NULL)
+    fclose (file);
+  return ret_val;
+}
+
+
+static GdkPixbuf *
+photos_jpeg_load_decode_region (FILE *file,
+                                gint x,
+                                gint y,
+                                gint width,
+                                gint height,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+  GdkPixbuf *volatile pixbuf = NULL;
+  GdkPixbuf *volatile ret_val = NULL;
+  JSAMPARRAY scanline;
+  PhotosJpegLoadErrorMgr jerr;
+  struct jpeg_decompress_struct cinfo;
+  JDIMENSION skip_columns;
+  guchar *pixels;
+  gint rowstride;
+  gint x1;
+  gint x2;
+  gint y1;
+  gint y2;
+
+  cinfo.err = jpeg_std_error (&jerr.parent);
+  jerr.parent.error_exit = photos_jpeg_load_error_exit;
+  jerr.parent.output_message = photos_jpeg_load_output_message;
+
+  if (setjmp (jerr.setjmp_buffer))
+    {
+      g_set_error (error,
+                   GDK_PIXBUF_ERROR,
+                   GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                   "Error interpreting JPEG image file (%s)",
+                   jerr.message);
+
+      jpeg_destroy_decompress (&cinfo);
+      if (pixbuf != NULL)
+        g_object_unref (pixbuf);
+
+      return NULL;
+    }
+
+  jpeg_create_decompress (&cinfo);
+  jpeg_stdio_src (&cinfo, file);
+  jpeg_read_header (&cinfo, TRUE);
+
+  if (!photos_jpeg_load_set_out_color_space (&cinfo, error))
+    goto out;
+
+  x1 = CLAMP (x, 0, (gint) cinfo.image_width);
+  x2 = CLAMP (x + width, 0, (gint) cinfo.image_width);
+  y1 = CLAMP (y, 0, (gint) cinfo.image_height);
+  y2 = CLAMP (y + height, 0, (gint) cinfo.image_height);
+  if (x1 >= x2 || y1 >= y2)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Region lies outside the image");
+      goto out;
+    }
+
+  jpeg_start_decompress (&cinfo);
+
+#ifdef HAVE_JPEG_SKIP_SCANLINES
+  {
+    JDIMENSION crop_width;
+    JDIMENSION xoffset;
+    gint margin;
+
+    /* Chroma upsampling treats the edges of the crop like the edges of
+     * the image, so keep one extra iMCU on either side to get the same
+     * pixels as a full decode. The crop is also aligned to iMCU
+     * boundaries, so the first few columns have to be dropped while
+     * copying.
+     */
+    margin = cinfo.max_h_samp_factor * DCTSIZE;
+    xoffset = (JDIMENSION) MAX (x1 - margin, 0);
+    crop_width = (JDIMENSION) MIN (x2 + margin, (gint) cinfo.image_width) - xoffset;
+    jpeg_crop_scanline (&cinfo, &xoffset, &crop_width);
+    skip_columns = (JDIMENSION) x1 - xoffset;
+
+    if (y1 > 0)
+      jpeg_skip_scanlines (&cinfo, (JDIMENSION) y1);
+  }
+#else
+  skip_columns = (JDIMENSION) x1;
+#endif
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER,
+                "Decoding JPEG region %d, %d, %d×%d from %u×%u",
+                x1,
+                y1,
+                x2 - x1,
+                y2 - y1,
+                cinfo.image_width,
+                cinfo.image_height);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, x2 - x1, y2 - y1);
+  if (pixbuf == NULL)
+    {
+      g_set_error_literal (error,
+                           GDK_PIXBUF_ERROR,
+                           GDK_PIXBUF_ERROR_INSUFFICIENT_MEMORY,
+                           "Insufficient memory to load image");
+      goto out;
+    }
+
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  scanline = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo,
+                                         JPOOL_IMAGE,
+                                         cinfo.output_width * (JDIMENSION) cinfo.output_components,
+                                         1);
+
+  /* Without jpeg_skip_scanlines, the rows above the region still need
+   * to be decoded, but they don't need to be kept around.
+   */
+  while (cinfo.output_scanline < (JDIMENSION) y1)
+    {
+      if (cinfo.output_scanline % CANCELLATION_CHECK_ROWS == 0
+          && g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      jpeg_read_scanlines (&cinfo, scanline, 1);
+    }
+
+  while (cinfo.output_scanline < (JDIMENSION) y2)
+    {
+      guchar *row = pixels + (gsize) (cinfo.output_scanline - (JDIMENSION) y1) * (gsize) rowstride;
+
+      if (cinfo.output_scanline % CANCELLATION_CHECK_ROWS == 0
+          && g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      jpeg_read_scanlines (&cinfo, scanline, 1);
+      photos_jpeg_load_copy_row (row,
+                                 scanline[0] + skip_columns * (JDIMENSION) cinfo.output_components,
+                                 cinfo.output_components,
+                                 (guint) (x2 - x1));
+    }
+
+  /* The rows below the region are never decoded. */
+  jpeg_abort_decompress (&cinfo);
+
+  ret_val = g_object_ref (pixbuf);
+
+ out:
+  jpeg_destroy_decompress (&cinfo);
+  if (pixbuf != NULL)
+    g_object_unref (pixbuf);
+  return ret_val;
+}
+
+
+GdkPixbuf *
+photos_jpeg_load_at_size (const gchar *filename,
+                          gint width,
+                          gint height,
+                          GCancellable *cancellable,
+                          GError **error)
+{
+  FILE *file = NULL;
+  GdkPixbuf *ret_val = NULL;
+
+  g_return_val_if_fail (filename != NULL && filename[0] != '\0', NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  file = photos_jpeg_load_open (filename, error);
+  if (file == NULL)
+    goto out;
+
+  ret_val = photos_jpeg_load_decode (file, NULL, 0, width, height, 0.0, cancellable, error);
+
+ out:
+  if (file != NULL)
+    fclose (file);
+  return ret_val;
+}
+
+
+GdkPixbuf *
+photos_jpeg_load_region (const gchar *filename,
+                         gint x,
+                         gint y,
+                         gint width,
+                         gint height,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+  FILE *file = NULL;
+  GdkPixbuf *ret_val = NULL;
+
+  g_return_val_if_fail (filename != NULL && filename[0] != '\0', NULL);
+  g_return_val_if_fail (width > 0, NULL);
+  g_return_val_if_fail (height > 0, NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  file = photos_jpeg_load_open (filename, error);
+  if (file == NULL)
+    goto out;
+
+  ret_val = photos_jpeg_load_decode_region (file, x, y, width, height, cancellable, error);
+
+ out:
+  if (file != NULL)
+    fclose (file);
+  return ret_val;
+}
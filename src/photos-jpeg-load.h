@@ -0,0 +1,43 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_JPEG_LOAD_H
+#define PHOTOS_JPEG_LOAD_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+GdkPixbuf          *photos_jpeg_load_at_size          (const gchar *filename,
+                                                       gint width,
+                                                       gint height,
+                                                       GCancellable *cancellable,
+                                                       GError **error);
+
+GdkPixbuf          *photos_jpeg_load_region           (const gchar *filename,
+                                                       gint x,
+                                                       gint y,
+                                                       gint width,
+                                                       gint height,
+                                                       GCancellable *cancellable,
+                                                       GError **error);
+
+G_END_DECLS
+
+#endif /* PHOTOS_JPEG_LOAD_H */
@@ -0,0 +1,252 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+#include "photos-debug.h"
+#include "photos-jpeg-save.h"
+
+
+typedef struct _PhotosJpegSaveDestMgr PhotosJpegSaveDestMgr;
+typedef struct _PhotosJpegSaveErrorMgr PhotosJpegSaveErrorMgr;
+
+struct _PhotosJpegSaveDestMgr
+{
+  struct jpeg_destination_mgr parent;
+  GCancellable *cancellable;
+  GError *error;
+  GOutputStream *stream;
+  JOCTET *buffer;
+};
+
+struct _PhotosJpegSaveErrorMgr
+{
+  struct jpeg_error_mgr parent;
+  jmp_buf setjmp_buffer;
+  gchar message[JMSG_LENGTH_MAX];
+};
+
+static const gsize DEST_BUFFER_SIZE = 65536;
+
+
+static void
+photos_jpeg_save_error_exit (j_common_ptr cinfo)
+{
+  PhotosJpegSaveErrorMgr *err = (PhotosJpegSaveErrorMgr *) cinfo->err;
+
+  (*cinfo->err->format_message) (cinfo, err->message);
+  longjmp (err->setjmp_buffer, 1);
+}
+
+
+static void
+photos_jpeg_save_output_message (j_common_ptr cinfo)
+{
+}
+
+
+static void
+photos_jpeg_save_write (j_compress_ptr cinfo, gsize count)
+{
+  PhotosJpegSaveDestMgr *dest = (PhotosJpegSaveDestMgr *) cinfo->dest;
+
+  if (count == 0)
+    return;
+
+  if (!g_output_stream_write_all (dest->stream, dest->buffer, count, NULL, dest->cancellable, &dest->error))
+    ERREXIT (cinfo, JERR_FILE_WRITE);
+}
+
+
+static boolean
+photos_jpeg_save_empty_output_buffer (j_compress_ptr cinfo)
+{
+  PhotosJpegSaveDestMgr *dest = (PhotosJpegSaveDestMgr *) cinfo->dest;
+
+  photos_jpeg_save_write (cinfo, DEST_BUFFER_SIZE);
+
+  dest->parent.next_output_byte = dest->buffer;
+  dest->parent.free_in_buffer = DEST_BUFFER_SIZE;
+
+  return TRUE;
+}
+
+
+static void
+photos_jpeg_save_init_destination (j_compress_ptr cinfo)
+{
+  PhotosJpegSaveDestMgr *dest = (PhotosJpegSaveDestMgr *) cinfo->dest;
+
+  dest->buffer = (JOCTET *) (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE, DEST_BUFFER_SIZE);
+  dest->parent.next_output_byte = dest->buffer;
+  dest->parent.free_in_buffer = DEST_BUFFER_SIZE;
+}
+
+
+static void
+photos_jpeg_save_term_destination (j_compress_ptr cinfo)
+{
+  PhotosJpegSaveDestMgr *dest = (PhotosJpegSaveDestMgr *) cinfo->dest;
+
+  photos_jpeg_save_write (cinfo, DEST_BUFFER_SIZE - dest->parent.free_in_buffer);
+}
+
+
+static void
+photos_jpeg_save_dest (j_compress_ptr cinfo, GOutputStream *stream, GCancellable *cancellable)
+{
+  PhotosJpegSaveDestMgr *dest;
+
+  if (cinfo->dest == NULL)
+    {
+      cinfo->dest
+        = (struct jpeg_destination_mgr *) (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo,
+                                                                      JPOOL_PERMANENT,
+                                                                      sizeof (PhotosJpegSaveDestMgr));
+    }
+
+  dest = (PhotosJpegSaveDestMgr *) cinfo->dest;
+  dest->parent.init_destination = photos_jpeg_save_init_destination;
+  dest->parent.empty_output_buffer = photos_jpeg_save_empty_output_buffer;
+  dest->parent.term_destination = photos_jpeg_save_term_destination;
+  dest->cancellable = cancellable;
+  dest->error = NULL;
+  dest->stream = stream;
+  dest->buffer = NULL;
+}
+
+
+gboolean
+photos_jpeg_save_buffer_to_stream (GeglBuffer *buffer,
+                                   GOutputStream *stream,
+                                   gint quality,
+                                   GCancellable *cancellable,
+                                   GError **error)
+{
+  GeglRectangle bbox;
+  PhotosJpegSaveErrorMgr jerr;
+  struct jpeg_compress_struct cinfo;
+  gint64 end;
+  gint64 start;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  bbox = *gegl_buffer_get_extent (buffer);
+  g_return_val_if_fail (bbox.height > 0 && bbox.width > 0, FALSE);
+
+  cinfo.err = jpeg_std_error (&jerr.parent);
+  jerr.parent.error_exit = photos_jpeg_save_error_exit;
+  jerr.parent.output_message = photos_jpeg_save_output_message;
+
+  /* Only touch in-memory state here, because locals may have been
+   * clobbered by the longjmp.
+   */
+  if (setjmp (jerr.setjmp_buffer))
+    {
+      PhotosJpegSaveDestMgr *dest = (PhotosJpegSaveDestMgr *) cinfo.dest;
+
+      if (dest != NULL && dest->error != NULL)
+        g_propagate_error (error, dest->error);
+      else
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Error writing JPEG image (%s)", jerr.message);
+
+      jpeg_destroy_compress (&cinfo);
+      return FALSE;
+    }
+
+  jpeg_create_compress (&cinfo);
+  photos_jpeg_save_dest (&cinfo, stream, cancellable);
+
+  cinfo.image_width = (JDIMENSION) bbox.width;
+  cinfo.image_height = (JDIMENSION) bbox.height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+
+  jpeg_set_defaults (&cinfo);
+  jpeg_set_quality (&cinfo, quality, TRUE);
+
+  start = g_get_monotonic_time ();
+
+  jpeg_start_compress (&cinfo, TRUE);
+  photos_jpeg_write_buffer (&cinfo, buffer, babl_format ("R'G'B' u8"), 1.0, bbox.x, bbox.y);
+  jpeg_finish_compress (&cinfo);
+
+  end = g_get_monotonic_time ();
+  photos_debug (PHOTOS_DEBUG_GEGL, "JPEG: Save Buffer to Stream: %" G_GINT64_FORMAT, end - start);
+
+  jpeg_destroy_compress (&cinfo);
+  return TRUE;
+}
+
+
+void
+photos_jpeg_write_buffer (j_compress_ptr cinfo,
+                          GeglBuffer *buffer,
+                          const Babl *format,
+                          gdouble zoom,
+                          gint src_x,
+                          gint src_y)
+{
+  JSAMPARRAY rows;
+  JSAMPLE *strip;
+  gint bpp;
+  gint i;
+  gint strip_height;
+  gsize stride;
+
+  g_return_if_fail (cinfo->global_state != 0);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (format != NULL);
+
+  /* Feed the compressor one MCU row at a time. That is the unit it
+   * works in, so it never has to buffer rows on its own, and each strip
+   * is a single gegl_buffer_get. The memory comes from the image pool,
+   * so it is released even if the compressor bails out with a longjmp.
+   */
+  strip_height = cinfo->max_v_samp_factor * DCTSIZE;
+  bpp = babl_format_get_bytes_per_pixel (format);
+  stride = (gsize) cinfo->image_width * (gsize) bpp;
+
+  strip = (JSAMPLE *) (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE, stride * (gsize) strip_height);
+  rows = (JSAMPARRAY) (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo,
+                                                  JPOOL_IMAGE,
+                                                  sizeof (JSAMPROW) * (gsize) strip_height);
+  for (i = 0; i < strip_height; i++)
+    rows[i] = strip + (gsize) i * stride;
+
+  while (cinfo->next_scanline < cinfo->image_height)
+    {
+      GeglRectangle rect;
+      JDIMENSION n_rows;
+
+      n_rows = MIN ((JDIMENSION) strip_height, cinfo->image_height - cinfo->next_scanline);
+      gegl_rectangle_set (&rect, src_x, src_y + (gint) cinfo->next_scanline, cinfo->image_width, n_rows);
+      gegl_buffer_get (buffer, &rect, zoom, format, strip, (gint) stride, GEGL_ABYSS_NONE);
+      jpeg_write_scanlines (cinfo, rows, n_rows);
+    }
+}
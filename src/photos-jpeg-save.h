@@ -0,0 +1,46 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_JPEG_SAVE_H
+#define PHOTOS_JPEG_SAVE_H
+
+#include <stdio.h>
+
+#include <babl/babl.h>
+#include <gegl.h>
+#include <gio/gio.h>
+#include <jpeglib.h>
+
+G_BEGIN_DECLS
+
+gboolean            photos_jpeg_save_buffer_to_stream    (GeglBuffer *buffer,
+                                                          GOutputStream *stream,
+                                                          gint quality,
+                                                          GCancellable *cancellable,
+                                                          GError **error);
+
+void                photos_jpeg_write_buffer             (j_compress_ptr cinfo,
+                                                          GeglBuffer *buffer,
+                                                          const Babl *format,
+                                                          gdouble zoom,
+                                                          gint src_x,
+                                                          gint src_y);
+
+G_END_DECLS
+
+#endif /* PHOTOS_JPEG_SAVE_H */
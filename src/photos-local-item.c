@@ -172,42 +172,46 @@ photos_local_item_create_pipeline_paths (PhotosBaseItem *item)
 
 
 static gboolean
-photos_local_item_create_thumbnail (PhotosBaseItem *item, GCancellable *cancellable, GError **error)
+photos_local_item_create_thumbnail_request (PhotosBaseItem *item, PhotosThumbnailFactoryRequest *request)
 {
   PhotosLocalItem *self = PHOTOS_LOCAL_ITEM (item);
-  g_autoptr (GFile) file = NULL;
-  GQuark orientation;
   g_auto (GStrv) pipeline_paths = NULL;
-  g_auto (GStrv) pipeline_uris = NULL;
-  gboolean ret_val = FALSE;
-  const gchar *mime_type;
   const gchar *uri;
-  g_autofree gchar *pipeline_uri = NULL;
-  g_autofree gchar *thumbnail_path = NULL;
-  gint64 height;
-  gint64 mtime;
-  gint64 width;
 
   uri = photos_base_item_get_uri (PHOTOS_BASE_ITEM (self));
-  file = g_file_new_for_uri (uri);
-  mime_type = photos_base_item_get_mime_type (PHOTOS_BASE_ITEM (self));
-  mtime = photos_base_item_get_mtime (PHOTOS_BASE_ITEM (self));
-  orientation = photos_base_item_get_orientation (PHOTOS_BASE_ITEM (self));
-  height = photos_base_item_get_height (PHOTOS_BASE_ITEM (self));
-  width = photos_base_item_get_width (PHOTOS_BASE_ITEM (self));
-  thumbnail_path = photos_base_item_create_thumbnail_path (PHOTOS_BASE_ITEM (self));
+  request->file = g_file_new_for_uri (uri);
+  request->mime_type = g_strdup (photos_base_item_get_mime_type (PHOTOS_BASE_ITEM (self)));
+  request->orientation = photos_base_item_get_orientation (PHOTOS_BASE_ITEM (self));
+  request->original_height = photos_base_item_get_height (PHOTOS_BASE_ITEM (self));
+  request->original_width = photos_base_item_get_width (PHOTOS_BASE_ITEM (self));
+  request->thumbnail_path = photos_base_item_create_thumbnail_path (PHOTOS_BASE_ITEM (self));
 
   pipeline_paths = photos_base_item_create_pipeline_paths (PHOTOS_BASE_ITEM (self));
-  pipeline_uris = photos_utils_convert_paths_to_uris ((const gchar *const *) pipeline_paths);
+  request->pipeline_uris = photos_utils_convert_paths_to_uris ((const gchar *const *) pipeline_paths);
+
+  return TRUE;
+}
+
+
+static gboolean
+photos_local_item_create_thumbnail (PhotosBaseItem *item, GCancellable *cancellable, GError **error)
+{
+  PhotosLocalItem *self = PHOTOS_LOCAL_ITEM (item);
+  PhotosThumbnailFactoryRequest request = { NULL };
+  gboolean ret_val = FALSE;
+  gint64 mtime;
+
+  mtime = photos_base_item_get_mtime (PHOTOS_BASE_ITEM (self));
+  photos_local_item_create_thumbnail_request (item, &request);
 
-  if (!photos_utils_create_thumbnail (file,
-                                      mime_type,
+  if (!photos_utils_create_thumbnail (request.file,
+                                      request.mime_type,
                                       mtime,
-                                      orientation,
-                                      height,
-                                      width,
-                                      (const gchar *const *) pipeline_uris,
-                                      thumbnail_path,
+                                      request.orientation,
+                                      request.original_height,
+                                      request.original_width,
+                                      (const gchar *const *) request.pipeline_uris,
+                                      request.thumbnail_path,
                                       cancellable,
                                       error))
     goto out;
@@ -215,6 +219,7 @@ photos_local_item_create_thumbnail (PhotosBaseItem *item, GCancellable *cancella
   ret_val = TRUE;
 
  out:
+  photos_thumbnail_factory_request_clear (&request);
   return ret_val;
 }
 
@@ -534,6 +539,7 @@ photos_local_item_class_init (PhotosLocalItemClass *class)
   base_item_class->create_name_fallback = photos_local_item_create_name_fallback;
   base_item_class->create_pipeline_paths = photos_local_item_create_pipeline_paths;
   base_item_class->create_thumbnail = photos_local_item_create_thumbnail;
+  base_item_class->create_thumbnail_request = photos_local_item_create_thumbnail_request;
   base_item_class->download = photos_local_item_download;
   base_item_class->get_source_widget = photos_local_item_get_source_widget;
   base_item_class->metadata_add_shared = photos_local_item_metadata_add_shared;
@@ -28,16 +28,36 @@
 
 #include "photos-debug.h"
 #include "photos-offset-controller.h"
+#include "photos-paging.h"
 #include "photos-query-builder.h"
 #include "photos-tracker-queue.h"
+#include "photos-utils.h"
 
 
+/* Pages are fetched by seeking past the (ctime, mtime, urn) of the
+ * last row of the previous page, instead of skipping a number of rows,
+ * so that a page deep into a large collection costs the same as the
+ * first one. The key is taken from the latest row that was loaded when
+ * the offset is increased. The integer offset only counts the rows.
+ */
 struct _PhotosOffsetControllerPrivate
 {
   GCancellable *cancellable;
   PhotosTrackerQueue *queue;
+  gchar *key_ctime;
+  gchar *key_mtime;
+  gchar *key_urn;
+  gchar *last_ctime;
+  gchar *last_mtime;
+  gchar *last_urn;
+  gboolean increase_pending;
+  gdouble row_cost;
   gint count;
   gint offset;
+  gint step;
+  guint n_pages_loading;
+  guint n_visible;
+  guint prefetch_screens;
 };
 
 enum
@@ -52,10 +72,47 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (PhotosOffsetController, photos_offset_controller, G_TYPE_OBJECT);
 
-enum
+static const guint PREFETCH_SCREENS_DEFAULT = 2;
+static const guint PREFETCH_SCREENS_MAX = 16;
+
+
+static guint
+photos_offset_controller_get_prefetch_screens (void)
 {
-  OFFSET_STEP = 60
-};
+  const gchar *screens_str;
+  guint ret_val = PREFETCH_SCREENS_DEFAULT;
+
+  screens_str = g_getenv ("GNOME_PHOTOS_PREFETCH_SCREENS");
+  if (screens_str != NULL)
+    {
+      g_autoptr (GError) error = NULL;
+      guint64 screens;
+
+      if (g_ascii_string_to_unsigned (screens_str, 10, 0, PREFETCH_SCREENS_MAX, &screens, &error))
+        ret_val = (guint) screens;
+      else
+        g_warning ("Unable to parse GNOME_PHOTOS_PREFETCH_SCREENS: %s", error->message);
+    }
+
+  return ret_val;
+}
+
+
+static void
+photos_offset_controller_update_step (PhotosOffsetController *self)
+{
+  PhotosOffsetControllerPrivate *priv;
+  gint step;
+
+  priv = photos_offset_controller_get_instance_private (self);
+
+  step = photos_paging_get_step (priv->n_visible, priv->row_cost);
+  if (step == priv->step)
+    return;
+
+  photos_debug (PHOTOS_DEBUG_TRACKER, "%s: Page size %d", G_OBJECT_TYPE_NAME (self), step);
+  priv->step = step;
+}
 
 
 static void
@@ -107,7 +164,6 @@ photos_offset_controller_reset_count_query_executed (GObject *source_object, GAs
 {
   PhotosOffsetController *self = PHOTOS_OFFSET_CONTROLLER (user_data);
   PhotosOffsetControllerPrivate *priv;
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   g_autoptr (TrackerSparqlCursor) cursor = NULL;
 
   priv = photos_offset_controller_get_instance_private (self);
@@ -115,7 +171,7 @@ photos_offset_controller_reset_count_query_executed (GObject *source_object, GAs
   {
     g_autoptr (GError) error = NULL;
 
-    cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+    cursor = photos_tracker_queue_select_finish (source_object, res, &error);
     if (error != NULL)
       goto out;
   }
@@ -153,6 +209,18 @@ photos_offset_controller_dispose (GObject *object)
 static void
 photos_offset_controller_finalize (GObject *object)
 {
+  PhotosOffsetController *self = PHOTOS_OFFSET_CONTROLLER (object);
+  PhotosOffsetControllerPrivate *priv;
+
+  priv = photos_offset_controller_get_instance_private (self);
+
+  g_free (priv->key_ctime);
+  g_free (priv->key_mtime);
+  g_free (priv->key_urn);
+  g_free (priv->last_ctime);
+  g_free (priv->last_mtime);
+  g_free (priv->last_urn);
+
   G_OBJECT_CLASS (photos_offset_controller_parent_class)->finalize (object);
 }
 
@@ -166,6 +234,8 @@ photos_offset_controller_init (PhotosOffsetController *self)
 
   priv->cancellable = g_cancellable_new ();
   priv->queue = photos_tracker_queue_dup_singleton (NULL, NULL);
+  priv->step = PHOTOS_PAGING_STEP_MIN;
+  priv->prefetch_screens = photos_offset_controller_get_prefetch_screens ();
 }
 
 
@@ -220,6 +290,34 @@ photos_offset_controller_get_count (PhotosOffsetController *self)
 }
 
 
+gboolean
+photos_offset_controller_get_key (PhotosOffsetController *self,
+                                  const gchar **out_ctime,
+                                  const gchar **out_mtime,
+                                  const gchar **out_urn)
+{
+  PhotosOffsetControllerPrivate *priv;
+
+  g_return_val_if_fail (PHOTOS_IS_OFFSET_CONTROLLER (self), FALSE);
+
+  priv = photos_offset_controller_get_instance_private (self);
+
+  if (priv->key_urn == NULL)
+    return FALSE;
+
+  if (out_ctime != NULL)
+    *out_ctime = priv->key_ctime;
+
+  if (out_mtime != NULL)
+    *out_mtime = priv->key_mtime;
+
+  if (out_urn != NULL)
+    *out_urn = priv->key_urn;
+
+  return TRUE;
+}
+
+
 gint
 photos_offset_controller_get_offset (PhotosOffsetController *self)
 {
@@ -236,14 +334,17 @@ photos_offset_controller_get_remaining (PhotosOffsetController *self)
   PhotosOffsetControllerPrivate *priv;
 
   priv = photos_offset_controller_get_instance_private (self);
-  return priv->count - (priv->offset + OFFSET_STEP);
+  return priv->count - (priv->offset + priv->step);
 }
 
 
 gint
 photos_offset_controller_get_step (PhotosOffsetController *self)
 {
-  return OFFSET_STEP;
+  PhotosOffsetControllerPrivate *priv;
+
+  priv = photos_offset_controller_get_instance_private (self);
+  return priv->step;
 }
 
 
@@ -255,11 +356,30 @@ photos_offset_controller_increase_offset (PhotosOffsetController *self)
 
   priv = photos_offset_controller_get_instance_private (self);
 
+  /* Only one page is loaded at a time. The request is replayed once
+   * the current page is done, because nothing else might ask again.
+   */
+  if (priv->n_pages_loading > 0)
+    {
+      priv->increase_pending = TRUE;
+      goto out;
+    }
+
+  priv->increase_pending = FALSE;
+
   remaining = photos_offset_controller_get_remaining (self);
   if (remaining <= 0)
     goto out;
 
-  priv->offset += OFFSET_STEP;
+  if (priv->last_urn != NULL)
+    {
+      photos_utils_set_string (&priv->key_ctime, priv->last_ctime);
+      photos_utils_set_string (&priv->key_mtime, priv->last_mtime);
+      photos_utils_set_string (&priv->key_urn, priv->last_urn);
+    }
+
+  priv->offset += priv->step;
+  photos_offset_controller_update_step (self);
   g_signal_emit (self, signals[OFFSET_CHANGED], 0, priv->offset);
 
  out:
@@ -267,6 +387,37 @@ photos_offset_controller_increase_offset (PhotosOffsetController *self)
 }
 
 
+void
+photos_offset_controller_page_finished (PhotosOffsetController *self, guint n_rows, gint64 latency)
+{
+  PhotosOffsetControllerPrivate *priv;
+
+  g_return_if_fail (PHOTOS_IS_OFFSET_CONTROLLER (self));
+
+  priv = photos_offset_controller_get_instance_private (self);
+
+  g_return_if_fail (priv->n_pages_loading > 0);
+  priv->n_pages_loading--;
+
+  priv->row_cost = photos_paging_update_row_cost (priv->row_cost, n_rows, latency);
+
+  if (priv->n_pages_loading == 0 && priv->increase_pending)
+    photos_offset_controller_increase_offset (self);
+}
+
+
+void
+photos_offset_controller_page_started (PhotosOffsetController *self)
+{
+  PhotosOffsetControllerPrivate *priv;
+
+  g_return_if_fail (PHOTOS_IS_OFFSET_CONTROLLER (self));
+
+  priv = photos_offset_controller_get_instance_private (self);
+  priv->n_pages_loading++;
+}
+
+
 void
 photos_offset_controller_reset_count (PhotosOffsetController *self)
 {
@@ -287,12 +438,13 @@ photos_offset_controller_reset_count (PhotosOffsetController *self)
   tag = g_strdup_printf ("%s: %s", type_name, G_STRFUNC);
   photos_query_set_tag (query, tag);
 
-  photos_tracker_queue_select (priv->queue,
-                               query,
-                               NULL,
-                               photos_offset_controller_reset_count_query_executed,
-                               g_object_ref (self),
-                               g_object_unref);
+  photos_tracker_queue_select_with_priority (priv->queue,
+                                             query,
+                                             PHOTOS_TRACKER_QUEUE_PRIORITY_BACKGROUND,
+                                             NULL,
+                                             photos_offset_controller_reset_count_query_executed,
+                                             g_object_ref (self),
+                                             g_object_unref);
 
  out:
   return;
@@ -305,5 +457,73 @@ photos_offset_controller_reset_offset (PhotosOffsetController *self)
   PhotosOffsetControllerPrivate *priv;
 
   priv = photos_offset_controller_get_instance_private (self);
+  priv->increase_pending = FALSE;
   priv->offset = 0;
+  photos_offset_controller_update_step (self);
+
+  g_clear_pointer (&priv->key_ctime, g_free);
+  g_clear_pointer (&priv->key_mtime, g_free);
+  g_clear_pointer (&priv->key_urn, g_free);
+  g_clear_pointer (&priv->last_ctime, g_free);
+  g_clear_pointer (&priv->last_mtime, g_free);
+  g_clear_pointer (&priv->last_urn, g_free);
+}
+
+
+void
+photos_offset_controller_set_viewport (PhotosOffsetController *self, guint n_visible, guint n_below)
+{
+  PhotosOffsetControllerPrivate *priv;
+
+  g_return_if_fail (PHOTOS_IS_OFFSET_CONTROLLER (self));
+
+  priv = photos_offset_controller_get_instance_private (self);
+
+  priv->n_visible = n_visible;
+
+  /* Fetch the next page in the background before the user reaches the
+   * end of the view, instead of waiting for the edge to be hit.
+   */
+  if (!photos_paging_is_prefetch_needed (n_visible, n_below, priv->prefetch_screens))
+    goto out;
+
+  if (priv->n_pages_loading > 0)
+    goto out;
+
+  if (photos_offset_controller_get_remaining (self) <= 0)
+    goto out;
+
+  photos_debug (PHOTOS_DEBUG_TRACKER, "%s: Prefetching, %u items left below", G_OBJECT_TYPE_NAME (self), n_below);
+  photos_offset_controller_increase_offset (self);
+
+ out:
+  return;
+}
+
+
+void
+photos_offset_controller_update_key (PhotosOffsetController *self, TrackerSparqlCursor *cursor)
+{
+  PhotosOffsetControllerPrivate *priv;
+  const gchar *ctime;
+  const gchar *mtime;
+  const gchar *urn;
+
+  g_return_if_fail (PHOTOS_IS_OFFSET_CONTROLLER (self));
+  g_return_if_fail (TRACKER_IS_SPARQL_CURSOR (cursor));
+
+  priv = photos_offset_controller_get_instance_private (self);
+
+  urn = tracker_sparql_cursor_get_string (cursor, PHOTOS_QUERY_COLUMNS_URN, NULL);
+  g_return_if_fail (urn != NULL && urn[0] != '\0');
+
+  ctime = tracker_sparql_cursor_get_string (cursor, PHOTOS_QUERY_COLUMNS_DATE_CREATED, NULL);
+  mtime = tracker_sparql_cursor_get_string (cursor, PHOTOS_QUERY_COLUMNS_MTIME, NULL);
+
+  /* An unbound value is kept as NULL, because it sorts after all the
+   * bound ones.
+   */
+  photos_utils_set_string (&priv->last_ctime, ctime != NULL && ctime[0] != '\0' ? ctime : NULL);
+  photos_utils_set_string (&priv->last_mtime, mtime != NULL && mtime[0] != '\0' ? mtime : NULL);
+  photos_utils_set_string (&priv->last_urn, urn);
 }
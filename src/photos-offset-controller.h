@@ -24,6 +24,7 @@
 #define PHOTOS_OFFSET_CONTROLLER_H
 
 #include <glib-object.h>
+#include <tracker-sparql.h>
 
 #include "photos-query.h"
 
@@ -50,6 +51,11 @@ PhotosOffsetController *    photos_offset_controller_new                (void);
 
 gint                        photos_offset_controller_get_count          (PhotosOffsetController *self);
 
+gboolean                    photos_offset_controller_get_key            (PhotosOffsetController *self,
+                                                                         const gchar **out_ctime,
+                                                                         const gchar **out_mtime,
+                                                                         const gchar **out_urn);
+
 gint                        photos_offset_controller_get_offset         (PhotosOffsetController *self);
 
 gint                        photos_offset_controller_get_remaining      (PhotosOffsetController *self);
@@ -58,10 +64,23 @@ gint                        photos_offset_controller_get_step           (PhotosO
 
 void                        photos_offset_controller_increase_offset    (PhotosOffsetController *self);
 
+void                        photos_offset_controller_page_finished      (PhotosOffsetController *self,
+                                                                         guint n_rows,
+                                                                         gint64 latency);
+
+void                        photos_offset_controller_page_started       (PhotosOffsetController *self);
+
 void                        photos_offset_controller_reset_count        (PhotosOffsetController *self);
 
 void                        photos_offset_controller_reset_offset       (PhotosOffsetController *self);
 
+void                        photos_offset_controller_set_viewport       (PhotosOffsetController *self,
+                                                                         guint n_visible,
+                                                                         guint n_below);
+
+void                        photos_offset_controller_update_key         (PhotosOffsetController *self,
+                                                                         TrackerSparqlCursor *cursor);
+
 G_END_DECLS
 
 #endif /* PHOTOS_OFFSET_CONTROLLER_H */
@@ -27,20 +27,33 @@
 #include "photos-enums-gegl.h"
 #include "photos-operation-insta-common.h"
 #include "photos-operation-insta-curve.h"
+#include "photos-simd.h"
 
 
 typedef void (*PhotosOperationProcessFunc) (GeglOperation *, void *, void *, glong, const GeglRectangle *, gint);
 
+typedef struct _PhotosOperationInstaCurveCurves PhotosOperationInstaCurveCurves;
+
+struct _PhotosOperationInstaCurveCurves
+{
+  gfloat *curves_float;
+  guint8 curves_u8[3][G_MAXUINT8 + 1];
+};
+
 struct _PhotosOperationInstaCurve
 {
   GeglOperationPointFilter parent_instance;
+  const Babl *fish_gray;
+  const PhotosOperationInstaCurveCurves *curves;
   PhotosOperationInstaPreset preset;
   PhotosOperationProcessFunc process;
+  gboolean gray;
 };
 
 enum
 {
   PROP_0,
+  PROP_GRAY,
   PROP_PRESET
 };
 
@@ -48,6 +61,32 @@ enum
 G_DEFINE_TYPE (PhotosOperationInstaCurve, photos_operation_insta_curve, GEGL_TYPE_OPERATION_POINT_FILTER);
 
 
+static PhotosOperationInstaCurveCurves *preset_curves[PHOTOS_OPERATION_INSTA_PRESET_HOMETOWN + 1];
+static PhotosSimdApplyCurvesFunc apply_curves;
+static guint8 brannan_increments[G_MAXUINT8 + 1];
+
+/* Each preset's chain of curves, and Nashville's brightness and
+ * contrast adjustment, is fused into one curve per channel the first
+ * time the preset is used. The tables are never modified afterwards, so
+ * they are shared by all instances and can be swapped by prepare while
+ * other threads are still processing with the old ones. The u8 curves
+ * are exact. The float curves are
+ * sampled 16 times between two u8 levels, and linearly interpolated.
+ */
+static const guint CURVE_N_INTERVALS = G_MAXUINT8 * 16;
+
+/* Pixels are converted to grayscale in chunks that fit in the L1
+ * cache.
+ */
+enum
+{
+  GRAY_CHUNK_SIZE = 256
+};
+
+static const gfloat NASHVILLE_BRIGHTNESS = -0.05f;
+static const gfloat NASHVILLE_CONTRAST = 1.1f;
+
+
 static const guint8 NINE_A[] =
 {
   0, 1, 3, 4, 6, 7, 9, 10, 12, 13, 14, 16, 17, 19, 20, 22, 23, 25, 26, 28, 29, 31, 32, 34, 35, 37, 38, 39, 41, 42,
@@ -319,151 +358,137 @@ photos_operation_insta_curve_interpolate (gfloat input, const guint8 *curve1, co
 }
 
 
-static void
-photos_operation_insta_curve_1977_process_alpha_float (GeglOperation *operation,
-                                                       void *in_buf,
-                                                       void *out_buf,
-                                                       glong n_pixels,
-                                                       const GeglRectangle *roi,
-                                                       gint level)
+static gfloat
+photos_operation_insta_curve_nashville_adjust (gfloat channel)
 {
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      out[0] = photos_operation_insta_curve_interpolate (in[0], NINE_R, NINE_A);
-      out[1] = photos_operation_insta_curve_interpolate (in[1], NINE_G, NINE_A);
-      out[2] = photos_operation_insta_curve_interpolate (in[2], NINE_B, NINE_A);
-      out[3] = in[3];
-
-      in += 4;
-      out += 4;
-    }
+  return (channel - 0.5f) * NASHVILLE_CONTRAST + NASHVILLE_BRIGHTNESS + 0.5f;
 }
 
 
-static void
-photos_operation_insta_curve_1977_process_alpha_u8 (GeglOperation *operation,
-                                                    void *in_buf,
-                                                    void *out_buf,
-                                                    glong n_pixels,
-                                                    const GeglRectangle *roi,
-                                                    gint level)
+static PhotosOperationInstaCurveCurves *
+photos_operation_insta_curve_build_curves (PhotosOperationInstaPreset preset)
 {
-  guint8 *in = in_buf;
-  guint8 *out = out_buf;
-  glong i;
+  PhotosOperationInstaCurveCurves *ret_val;
+  const guint8 *curve_a;
+  const guint8 *curves[3];
+  gboolean adjust = FALSE;
+  guint i;
 
-  for (i = 0; i < n_pixels; i++)
+  switch (preset)
     {
-      out[0] = NINE_R[in[0]];
-      out[1] = NINE_G[in[1]];
-      out[2] = NINE_B[in[2]];
+    case PHOTOS_OPERATION_INSTA_PRESET_1977:
+      curve_a = NINE_A;
+      curves[0] = NINE_R;
+      curves[1] = NINE_G;
+      curves[2] = NINE_B;
+      break;
 
-      out[0] = NINE_A[out[0]];
-      out[1] = NINE_A[out[1]];
-      out[2] = NINE_A[out[2]];
+    case PHOTOS_OPERATION_INSTA_PRESET_BRANNAN:
+      curve_a = BRANNAN_A;
+      curves[0] = BRANNAN_R;
+      curves[1] = BRANNAN_G;
+      curves[2] = BRANNAN_B;
+      break;
 
-      out[3] = in[3];
+    case PHOTOS_OPERATION_INSTA_PRESET_GOTHAM:
+      curve_a = GOTHAM_A;
+      curves[0] = GOTHAM_R;
+      curves[1] = GOTHAM_G;
+      curves[2] = GOTHAM_B;
+      break;
 
-      in += 4;
-      out += 4;
-    }
-}
+    case PHOTOS_OPERATION_INSTA_PRESET_NASHVILLE:
+      adjust = TRUE;
+      curve_a = NASHVILLE_A;
+      curves[0] = NASHVILLE_R;
+      curves[1] = NASHVILLE_G;
+      curves[2] = NASHVILLE_B;
+      break;
 
+    case PHOTOS_OPERATION_INSTA_PRESET_NONE:
+    case PHOTOS_OPERATION_INSTA_PRESET_HEFE:
+    case PHOTOS_OPERATION_INSTA_PRESET_CLARENDON:
+    default:
+      g_assert_not_reached ();
+    }
 
-static void
-photos_operation_insta_curve_1977_process_float (GeglOperation *operation,
-                                                 void *in_buf,
-                                                 void *out_buf,
-                                                 glong n_pixels,
-                                                 const GeglRectangle *roi,
-                                                 gint level)
-{
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
+  ret_val = g_new0 (PhotosOperationInstaCurveCurves, 1);
+  ret_val->curves_float = g_new (gfloat, 3 * (CURVE_N_INTERVALS + 1));
 
-  for (i = 0; i < n_pixels; i++)
+  for (i = 0; i < 3; i++)
     {
-      out[0] = photos_operation_insta_curve_interpolate (in[0], NINE_R, NINE_A);
-      out[1] = photos_operation_insta_curve_interpolate (in[1], NINE_G, NINE_A);
-      out[2] = photos_operation_insta_curve_interpolate (in[2], NINE_B, NINE_A);
+      gfloat *curve_float = ret_val->curves_float + i * (CURVE_N_INTERVALS + 1);
+      guint j;
 
-      in += 3;
-      out += 3;
-    }
-}
+      for (j = 0; j <= G_MAXUINT8; j++)
+        {
+          guint8 x = (guint8) j;
 
+          if (adjust)
+            {
+              gfloat channel;
 
-static void
-photos_operation_insta_curve_1977_process_u8 (GeglOperation *operation,
-                                              void *in_buf,
-                                              void *out_buf,
-                                              glong n_pixels,
-                                              const GeglRectangle *roi,
-                                              gint level)
-{
-  guint8 *in = in_buf;
-  guint8 *out = out_buf;
-  glong i;
+              channel = x / 255.0f;
+              channel = photos_operation_insta_curve_nashville_adjust (channel);
+              channel = CLAMP (channel, 0.0f, 1.0f);
+              x = (guint8) (channel * 255.0f);
+            }
 
-  for (i = 0; i < n_pixels; i++)
-    {
-      out[0] = NINE_R[in[0]];
-      out[1] = NINE_G[in[1]];
-      out[2] = NINE_B[in[2]];
+          ret_val->curves_u8[i][j] = curve_a[curves[i][x]];
+        }
 
-      out[0] = NINE_A[out[0]];
-      out[1] = NINE_A[out[1]];
-      out[2] = NINE_A[out[2]];
+      for (j = 0; j <= CURVE_N_INTERVALS; j++)
+        {
+          gfloat x = (gfloat) j / (gfloat) CURVE_N_INTERVALS;
 
-      in += 3;
-      out += 3;
+          if (adjust)
+            {
+              x = photos_operation_insta_curve_nashville_adjust (x);
+              x = CLAMP (x, 0.0f, 1.0f);
+            }
+
+          curve_float[j] = photos_operation_insta_curve_interpolate (x, curves[i], curve_a);
+        }
     }
+
+  return ret_val;
 }
 
 
-static void
-photos_operation_insta_curve_brannan_process_alpha_float (GeglOperation *operation,
-                                                          void *in_buf,
-                                                          void *out_buf,
-                                                          glong n_pixels,
-                                                          const GeglRectangle *roi,
-                                                          gint level)
+static const PhotosOperationInstaCurveCurves *
+photos_operation_insta_curve_get_curves (PhotosOperationInstaPreset preset)
 {
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
+  PhotosOperationInstaCurveCurves **curves = &preset_curves[preset];
 
-  for (i = 0; i < n_pixels; i++)
-    {
-      const gfloat saturation = 0.1f;
-      guint max;
+  if (g_once_init_enter (curves))
+    g_once_init_leave (curves, photos_operation_insta_curve_build_curves (preset));
 
-      out[0] = photos_operation_insta_curve_interpolate (in[0], BRANNAN_R, BRANNAN_A);
-      out[1] = photos_operation_insta_curve_interpolate (in[1], BRANNAN_G, BRANNAN_A);
-      out[2] = photos_operation_insta_curve_interpolate (in[2], BRANNAN_B, BRANNAN_A);
+  return *curves;
+}
 
-      max = (out[0] > out[1]) ? 0 : 1;
-      max = (out[max] > out[2]) ? max : 2;
 
-      if (max != 0)
-        out[0] += (guint8) ((out[max] - out[0]) * saturation + 0.5f);
+static void
+photos_operation_insta_curve_apply_curves_float (const PhotosOperationInstaCurveCurves *curves,
+                                                 gfloat *in,
+                                                 gfloat *out,
+                                                 glong n_pixels,
+                                                 guint n_components)
+{
+  (*apply_curves) (in, out, n_pixels, n_components, curves->curves_float, CURVE_N_INTERVALS);
+}
 
-      if (max != 1)
-        out[1] += (guint8) ((out[max] - out[1]) * saturation + 0.5f);
 
-      if (max != 2)
-        out[2] += (guint8) ((out[max] - out[2]) * saturation + 0.5f);
+static void
+photos_operation_insta_curve_brannan_saturate_u8 (guint8 *out)
+{
+  guint max;
 
-      out[3] = in[3];
+  max = (out[0] > out[1]) ? 0 : 1;
+  max = (out[max] > out[2]) ? max : 2;
 
-      in += 4;
-      out += 4;
-    }
+  out[0] += brannan_increments[out[max] - out[0]];
+  out[1] += brannan_increments[out[max] - out[1]];
+  out[2] += brannan_increments[out[max] - out[2]];
 }
 
 
@@ -475,35 +500,18 @@ photos_operation_insta_curve_brannan_process_alpha_u8 (GeglOperation *operation,
                                                        const GeglRectangle *roi,
                                                        gint level)
 {
+  PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
+  const PhotosOperationInstaCurveCurves *curves = self->curves;
   guint8 *in = in_buf;
   guint8 *out = out_buf;
   glong i;
 
   for (i = 0; i < n_pixels; i++)
     {
-      const gfloat saturation = 0.1f;
-      guint max;
-
-      out[0] = BRANNAN_R[in[0]];
-      out[1] = BRANNAN_G[in[1]];
-      out[2] = BRANNAN_B[in[2]];
-
-      out[0] = BRANNAN_A[out[0]];
-      out[1] = BRANNAN_A[out[1]];
-      out[2] = BRANNAN_A[out[2]];
-
-      max = (out[0] > out[1]) ? 0 : 1;
-      max = (out[max] > out[2]) ? max : 2;
-
-      if (max != 0)
-        out[0] += (guint8) ((out[max] - out[0]) * saturation + 0.5f);
-
-      if (max != 1)
-        out[1] += (guint8) ((out[max] - out[1]) * saturation + 0.5f);
-
-      if (max != 2)
-        out[2] += (guint8) ((out[max] - out[2]) * saturation + 0.5f);
-
+      out[0] = curves->curves_u8[0][in[0]];
+      out[1] = curves->curves_u8[1][in[1]];
+      out[2] = curves->curves_u8[2][in[2]];
+      photos_operation_insta_curve_brannan_saturate_u8 (out);
       out[3] = in[3];
 
       in += 4;
@@ -512,45 +520,6 @@ photos_operation_insta_curve_brannan_process_alpha_u8 (GeglOperation *operation,
 }
 
 
-static void
-photos_operation_insta_curve_brannan_process_float (GeglOperation *operation,
-                                                    void *in_buf,
-                                                    void *out_buf,
-                                                    glong n_pixels,
-                                                    const GeglRectangle *roi,
-                                                    gint level)
-{
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      const gfloat saturation = 0.1f;
-      guint max;
-
-      out[0] = photos_operation_insta_curve_interpolate (in[0], BRANNAN_R, BRANNAN_A);
-      out[1] = photos_operation_insta_curve_interpolate (in[1], BRANNAN_G, BRANNAN_A);
-      out[2] = photos_operation_insta_curve_interpolate (in[2], BRANNAN_B, BRANNAN_A);
-
-      max = (out[0] > out[1]) ? 0 : 1;
-      max = (out[max] > out[2]) ? max : 2;
-
-      if (max != 0)
-        out[0] += (guint8) ((out[max] - out[0]) * saturation + 0.5f);
-
-      if (max != 1)
-        out[1] += (guint8) ((out[max] - out[1]) * saturation + 0.5f);
-
-      if (max != 2)
-        out[2] += (guint8) ((out[max] - out[2]) * saturation + 0.5f);
-
-      in += 3;
-      out += 3;
-    }
-}
-
-
 static void
 photos_operation_insta_curve_brannan_process_u8 (GeglOperation *operation,
                                                  void *in_buf,
@@ -559,113 +528,18 @@ photos_operation_insta_curve_brannan_process_u8 (GeglOperation *operation,
                                                  const GeglRectangle *roi,
                                                  gint level)
 {
+  PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
+  const PhotosOperationInstaCurveCurves *curves = self->curves;
   guint8 *in = in_buf;
   guint8 *out = out_buf;
   glong i;
 
   for (i = 0; i < n_pixels; i++)
     {
-      const gfloat saturation = 0.1f;
-      guint max;
-
-      out[0] = BRANNAN_R[in[0]];
-      out[1] = BRANNAN_G[in[1]];
-      out[2] = BRANNAN_B[in[2]];
-
-      out[0] = BRANNAN_A[out[0]];
-      out[1] = BRANNAN_A[out[1]];
-      out[2] = BRANNAN_A[out[2]];
-
-      max = (out[0] > out[1]) ? 0 : 1;
-      max = (out[max] > out[2]) ? max : 2;
-
-      if (max != 0)
-        out[0] += (guint8) ((out[max] - out[0]) * saturation + 0.5f);
-
-      if (max != 1)
-        out[1] += (guint8) ((out[max] - out[1]) * saturation + 0.5f);
-
-      if (max != 2)
-        out[2] += (guint8) ((out[max] - out[2]) * saturation + 0.5f);
-
-      in += 3;
-      out += 3;
-    }
-}
-
-
-static void
-photos_operation_insta_curve_gotham_process_alpha_float (GeglOperation *operation,
-                                                         void *in_buf,
-                                                         void *out_buf,
-                                                         glong n_pixels,
-                                                         const GeglRectangle *roi,
-                                                         gint level)
-{
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      out[0] = photos_operation_insta_curve_interpolate (in[0], GOTHAM_R, GOTHAM_A);
-      out[1] = photos_operation_insta_curve_interpolate (in[1], GOTHAM_G, GOTHAM_A);
-      out[2] = photos_operation_insta_curve_interpolate (in[2], GOTHAM_B, GOTHAM_A);
-      out[3] = in[3];
-
-      in += 4;
-      out += 4;
-    }
-}
-
-
-static void
-photos_operation_insta_curve_gotham_process_alpha_u8 (GeglOperation *operation,
-                                                      void *in_buf,
-                                                      void *out_buf,
-                                                      glong n_pixels,
-                                                      const GeglRectangle *roi,
-                                                      gint level)
-{
-  guint8 *in = in_buf;
-  guint8 *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      out[0] = GOTHAM_R[in[0]];
-      out[1] = GOTHAM_G[in[1]];
-      out[2] = GOTHAM_B[in[2]];
-
-      out[0] = GOTHAM_A[out[0]];
-      out[1] = GOTHAM_A[out[1]];
-      out[2] = GOTHAM_A[out[2]];
-
-      out[3] = in[3];
-
-      in += 4;
-      out += 4;
-    }
-}
-
-
-static void
-photos_operation_insta_curve_gotham_process_float (GeglOperation *operation,
-                                                   void *in_buf,
-                                                   void *out_buf,
-                                                   glong n_pixels,
-                                                   const GeglRectangle *roi,
-                                                   gint level)
-{
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      out[0] = photos_operation_insta_curve_interpolate (in[0], GOTHAM_R, GOTHAM_A);
-      out[1] = photos_operation_insta_curve_interpolate (in[1], GOTHAM_G, GOTHAM_A);
-      out[2] = photos_operation_insta_curve_interpolate (in[2], GOTHAM_B, GOTHAM_A);
+      out[0] = curves->curves_u8[0][in[0]];
+      out[1] = curves->curves_u8[1][in[1]];
+      out[2] = curves->curves_u8[2][in[2]];
+      photos_operation_insta_curve_brannan_saturate_u8 (out);
 
       in += 3;
       out += 3;
@@ -674,107 +548,38 @@ photos_operation_insta_curve_gotham_process_float (GeglOperation *operation,
 
 
 static void
-photos_operation_insta_curve_gotham_process_u8 (GeglOperation *operation,
-                                                void *in_buf,
-                                                void *out_buf,
-                                                glong n_pixels,
-                                                const GeglRectangle *roi,
-                                                gint level)
+photos_operation_insta_curve_process_alpha_float (GeglOperation *operation,
+                                                  void *in_buf,
+                                                  void *out_buf,
+                                                  glong n_pixels,
+                                                  const GeglRectangle *roi,
+                                                  gint level)
 {
-  guint8 *in = in_buf;
-  guint8 *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      out[0] = GOTHAM_R[in[0]];
-      out[1] = GOTHAM_G[in[1]];
-      out[2] = GOTHAM_B[in[2]];
-
-      out[0] = GOTHAM_A[out[0]];
-      out[1] = GOTHAM_A[out[1]];
-      out[2] = GOTHAM_A[out[2]];
+  PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
 
-      in += 3;
-      out += 3;
-    }
+  photos_operation_insta_curve_apply_curves_float (self->curves, in_buf, out_buf, n_pixels, 4);
 }
 
 
 static void
-photos_operation_insta_curve_nashville_process_alpha_float (GeglOperation *operation,
-                                                            void *in_buf,
-                                                            void *out_buf,
-                                                            glong n_pixels,
-                                                            const GeglRectangle *roi,
-                                                            gint level)
-{
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      const gfloat brightness = -0.05f;
-      const gfloat contrast = 1.1f;
-
-      out[0] = (in[0] - 0.5f) * contrast + brightness + 0.5f;
-      out[1] = (in[1] - 0.5f) * contrast + brightness + 0.5f;
-      out[2] = (in[2] - 0.5f) * contrast + brightness + 0.5f;
-
-      out[0] = photos_operation_insta_curve_interpolate (out[0], NASHVILLE_R, NASHVILLE_A);
-      out[1] = photos_operation_insta_curve_interpolate (out[1], NASHVILLE_G, NASHVILLE_A);
-      out[2] = photos_operation_insta_curve_interpolate (out[2], NASHVILLE_B, NASHVILLE_A);
-
-      out[3] = in[3];
-
-      in += 4;
-      out += 4;
-    }
-}
-
-
-static void
-photos_operation_insta_curve_nashville_process_alpha_u8 (GeglOperation *operation,
-                                                         void *in_buf,
-                                                         void *out_buf,
-                                                         glong n_pixels,
-                                                         const GeglRectangle *roi,
-                                                         gint level)
+photos_operation_insta_curve_process_alpha_u8 (GeglOperation *operation,
+                                               void *in_buf,
+                                               void *out_buf,
+                                               glong n_pixels,
+                                               const GeglRectangle *roi,
+                                               gint level)
 {
+  PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
+  const PhotosOperationInstaCurveCurves *curves = self->curves;
   guint8 *in = in_buf;
   guint8 *out = out_buf;
   glong i;
 
   for (i = 0; i < n_pixels; i++)
     {
-      const gfloat brightness = -0.05f;
-      const gfloat contrast = 1.1f;
-      gfloat channel;
-
-      channel = in[0] / 255.0f;
-      channel = (channel - 0.5f) * contrast + brightness + 0.5f;
-      channel = CLAMP (channel, 0.0f, 1.0f);
-      out[0] = (guint8) (channel * 255.0f);
-
-      channel = in[1] / 255.0f;
-      channel = (channel - 0.5f) * contrast + brightness + 0.5f;
-      channel = CLAMP (channel, 0.0f, 1.0f);
-      out[1] = (guint8) (channel * 255.0f);
-
-      channel = in[2] / 255.0f;
-      channel = (channel - 0.5f) * contrast + brightness + 0.5f;
-      channel = CLAMP (channel, 0.0f, 1.0f);
-      out[2] = (guint8) (channel * 255.0f);
-
-      out[0] = NASHVILLE_R[out[0]];
-      out[1] = NASHVILLE_G[out[1]];
-      out[2] = NASHVILLE_B[out[2]];
-
-      out[0] = NASHVILLE_A[out[0]];
-      out[1] = NASHVILLE_A[out[1]];
-      out[2] = NASHVILLE_A[out[2]];
-
+      out[0] = curves->curves_u8[0][in[0]];
+      out[1] = curves->curves_u8[1][in[1]];
+      out[2] = curves->curves_u8[2][in[2]];
       out[3] = in[3];
 
       in += 4;
@@ -784,76 +589,38 @@ photos_operation_insta_curve_nashville_process_alpha_u8 (GeglOperation *operatio
 
 
 static void
-photos_operation_insta_curve_nashville_process_float (GeglOperation *operation,
-                                                      void *in_buf,
-                                                      void *out_buf,
-                                                      glong n_pixels,
-                                                      const GeglRectangle *roi,
-                                                      gint level)
+photos_operation_insta_curve_process_float (GeglOperation *operation,
+                                            void *in_buf,
+                                            void *out_buf,
+                                            glong n_pixels,
+                                            const GeglRectangle *roi,
+                                            gint level)
 {
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-  glong i;
-
-  for (i = 0; i < n_pixels; i++)
-    {
-      const gfloat brightness = -0.05f;
-      const gfloat contrast = 1.1f;
-
-      out[0] = (in[0] - 0.5f) * contrast + brightness + 0.5f;
-      out[1] = (in[1] - 0.5f) * contrast + brightness + 0.5f;
-      out[2] = (in[2] - 0.5f) * contrast + brightness + 0.5f;
-
-      out[0] = photos_operation_insta_curve_interpolate (out[0], NASHVILLE_R, NASHVILLE_A);
-      out[1] = photos_operation_insta_curve_interpolate (out[1], NASHVILLE_G, NASHVILLE_A);
-      out[2] = photos_operation_insta_curve_interpolate (out[2], NASHVILLE_B, NASHVILLE_A);
+  PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
 
-      in += 3;
-      out += 3;
-    }
+  photos_operation_insta_curve_apply_curves_float (self->curves, in_buf, out_buf, n_pixels, 3);
 }
 
 
 static void
-photos_operation_insta_curve_nashville_process_u8 (GeglOperation *operation,
-                                                   void *in_buf,
-                                                   void *out_buf,
-                                                   glong n_pixels,
-                                                   const GeglRectangle *roi,
-                                                   gint level)
+photos_operation_insta_curve_process_u8 (GeglOperation *operation,
+                                         void *in_buf,
+                                         void *out_buf,
+                                         glong n_pixels,
+                                         const GeglRectangle *roi,
+                                         gint level)
 {
+  PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
+  const PhotosOperationInstaCurveCurves *curves = self->curves;
   guint8 *in = in_buf;
   guint8 *out = out_buf;
   glong i;
 
   for (i = 0; i < n_pixels; i++)
     {
-      const gfloat brightness = -0.05f;
-      const gfloat contrast = 1.1f;
-      gfloat channel;
-
-      channel = in[0] / 255.0f;
-      channel = (channel - 0.5f) * contrast + brightness + 0.5f;
-      channel = CLAMP (channel, 0.0f, 1.0f);
-      out[0] = (guint8) (channel * 255.0f);
-
-      channel = in[1] / 255.0f;
-      channel = (channel - 0.5f) * contrast + brightness + 0.5f;
-      channel = CLAMP (channel, 0.0f, 1.0f);
-      out[1] = (guint8) (channel * 255.0f);
-
-      channel = in[2] / 255.0f;
-      channel = (channel - 0.5f) * contrast + brightness + 0.5f;
-      channel = CLAMP (channel, 0.0f, 1.0f);
-      out[2] = (guint8) (channel * 255.0f);
-
-      out[0] = NASHVILLE_R[out[0]];
-      out[1] = NASHVILLE_G[out[1]];
-      out[2] = NASHVILLE_B[out[2]];
-
-      out[0] = NASHVILLE_A[out[0]];
-      out[1] = NASHVILLE_A[out[1]];
-      out[2] = NASHVILLE_A[out[2]];
+      out[0] = curves->curves_u8[0][in[0]];
+      out[1] = curves->curves_u8[1][in[1]];
+      out[2] = curves->curves_u8[2][in[2]];
 
       in += 3;
       out += 3;
@@ -866,13 +633,10 @@ photos_operation_insta_curve_prepare (GeglOperation *operation)
 {
   PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
   const Babl *format;
-  const Babl *format_alpha_float;
-  const Babl *format_alpha_u8;
-  const Babl *format_float;
-  const Babl *format_u8;
   const Babl *input_format;
   const Babl *type;
   const Babl *type_u8;
+  gboolean brannan;
   gboolean has_alpha;
 
   input_format = gegl_operation_get_source_format (operation, "input");
@@ -887,139 +651,69 @@ photos_operation_insta_curve_prepare (GeglOperation *operation)
       type = babl_format_get_type (input_format, 0);
     }
 
-  format_alpha_float = babl_format ("R'G'B'A float");
-  format_alpha_u8 = babl_format ("R'G'B'A u8");
-  format_float = babl_format ("R'G'B' float");
-  format_u8 = babl_format ("R'G'B' u8");
   type_u8 = babl_type ("u8");
 
-  switch (self->preset)
-    {
-    case PHOTOS_OPERATION_INSTA_PRESET_1977:
-      if (has_alpha)
-        {
-          if (type == type_u8)
-            {
-              format = format_alpha_u8;
-              self->process = photos_operation_insta_curve_1977_process_alpha_u8;
-            }
-          else
-            {
-              format = format_alpha_float;
-              self->process = photos_operation_insta_curve_1977_process_alpha_float;
-            }
-        }
-      else
-        {
-          if (type == type_u8)
-            {
-              format = format_u8;
-              self->process = photos_operation_insta_curve_1977_process_u8;
-            }
-          else
-            {
-              format = format_float;
-              self->process = photos_operation_insta_curve_1977_process_float;
-            }
-        }
-      break;
+  self->curves = photos_operation_insta_curve_get_curves (self->preset);
 
-    case PHOTOS_OPERATION_INSTA_PRESET_BRANNAN:
-      if (has_alpha)
-        {
-          if (type == type_u8)
-            {
-              format = format_alpha_u8;
-              self->process = photos_operation_insta_curve_brannan_process_alpha_u8;
-            }
-          else
-            {
-              format = format_alpha_float;
-              self->process = photos_operation_insta_curve_brannan_process_alpha_float;
-            }
-        }
-      else
-        {
-          if (type == type_u8)
-            {
-              format = format_u8;
-              self->process = photos_operation_insta_curve_brannan_process_u8;
-            }
-          else
-            {
-              format = format_float;
-              self->process = photos_operation_insta_curve_brannan_process_float;
-            }
-        }
-      break;
+  /* The saturation boost is only applied to u8 pixels. The float
+   * variants used to truncate the increment to an integer, which made it
+   * a no-op.
+   */
+  brannan = self->preset == PHOTOS_OPERATION_INSTA_PRESET_BRANNAN;
 
-    case PHOTOS_OPERATION_INSTA_PRESET_GOTHAM:
-      if (has_alpha)
+  if (has_alpha)
+    {
+      if (type == type_u8)
         {
-          if (type == type_u8)
-            {
-              format = format_alpha_u8;
-              self->process = photos_operation_insta_curve_gotham_process_alpha_u8;
-            }
+          format = babl_format ("R'G'B'A u8");
+          if (brannan)
+            self->process = photos_operation_insta_curve_brannan_process_alpha_u8;
           else
-            {
-              format = format_alpha_float;
-              self->process = photos_operation_insta_curve_gotham_process_alpha_float;
-            }
+            self->process = photos_operation_insta_curve_process_alpha_u8;
         }
       else
         {
-          if (type == type_u8)
-            {
-              format = format_u8;
-              self->process = photos_operation_insta_curve_gotham_process_u8;
-            }
-          else
-            {
-              format = format_float;
-              self->process = photos_operation_insta_curve_gotham_process_float;
-            }
+          format = babl_format ("R'G'B'A float");
+          self->process = photos_operation_insta_curve_process_alpha_float;
         }
-      break;
-
-    case PHOTOS_OPERATION_INSTA_PRESET_NASHVILLE:
-      if (has_alpha)
+    }
+  else
+    {
+      if (type == type_u8)
         {
-          if (type == type_u8)
-            {
-              format = format_alpha_u8;
-              self->process = photos_operation_insta_curve_nashville_process_alpha_u8;
-            }
+          format = babl_format ("R'G'B' u8");
+          if (brannan)
+            self->process = photos_operation_insta_curve_brannan_process_u8;
           else
-            {
-              format = format_alpha_float;
-              self->process = photos_operation_insta_curve_nashville_process_alpha_float;
-            }
+            self->process = photos_operation_insta_curve_process_u8;
         }
       else
         {
-          if (type == type_u8)
-            {
-              format = format_u8;
-              self->process = photos_operation_insta_curve_nashville_process_u8;
-            }
-          else
-            {
-              format = format_float;
-              self->process = photos_operation_insta_curve_nashville_process_float;
-            }
+          format = babl_format ("R'G'B' float");
+          self->process = photos_operation_insta_curve_process_float;
         }
-      break;
-
-    case PHOTOS_OPERATION_INSTA_PRESET_NONE:
-    case PHOTOS_OPERATION_INSTA_PRESET_HEFE:
-    case PHOTOS_OPERATION_INSTA_PRESET_CLARENDON:
-    default:
-      g_assert_not_reached ();
     }
 
   gegl_operation_set_format (operation, "input", format);
-  gegl_operation_set_format (operation, "output", format);
+
+  /* The curves are applied in their own format, and the result is
+   * converted to grayscale while it is still in the cache, instead of
+   * in a separate pass over the whole image. The output format is the
+   * same as gegl:gray's.
+   */
+  if (self->gray)
+    {
+      const Babl *format_gray;
+
+      format_gray = babl_format ("YA float");
+      self->fish_gray = babl_fish (format, format_gray);
+      gegl_operation_set_format (operation, "output", format_gray);
+    }
+  else
+    {
+      self->fish_gray = NULL;
+      gegl_operation_set_format (operation, "output", format);
+    }
 }
 
 
@@ -1033,7 +727,38 @@ photos_operation_insta_curve_process (GeglOperation *operation,
 {
   PhotosOperationInstaCurve *self = PHOTOS_OPERATION_INSTA_CURVE (operation);
 
-  self->process (operation, in_buf, out_buf, n_pixels, roi, level);
+  if (self->fish_gray == NULL)
+    {
+      self->process (operation, in_buf, out_buf, n_pixels, roi, level);
+    }
+  else
+    {
+      const Babl *format_in;
+      const Babl *format_out;
+      gfloat chunk[GRAY_CHUNK_SIZE * 4];
+      gint bpp_in;
+      gint bpp_out;
+      glong i;
+      guint8 *in = in_buf;
+      guint8 *out = out_buf;
+
+      format_in = gegl_operation_get_format (operation, "input");
+      format_out = gegl_operation_get_format (operation, "output");
+      bpp_in = babl_format_get_bytes_per_pixel (format_in);
+      bpp_out = babl_format_get_bytes_per_pixel (format_out);
+
+      for (i = 0; i < n_pixels; i += GRAY_CHUNK_SIZE)
+        {
+          const glong n = MIN (GRAY_CHUNK_SIZE, n_pixels - i);
+
+          self->process (operation, in, chunk, n, roi, level);
+          babl_process (self->fish_gray, chunk, out, n);
+
+          in += n * bpp_in;
+          out += n * bpp_out;
+        }
+    }
+
   return TRUE;
 }
 
@@ -1045,6 +770,10 @@ photos_operation_insta_curve_get_property (GObject *object, guint prop_id, GValu
 
   switch (prop_id)
     {
+    case PROP_GRAY:
+      g_value_set_boolean (value, self->gray);
+      break;
+
     case PROP_PRESET:
       g_value_set_enum (value, (gint) self->preset);
       break;
@@ -1063,6 +792,10 @@ photos_operation_insta_curve_set_property (GObject *object, guint prop_id, const
 
   switch (prop_id)
     {
+    case PROP_GRAY:
+      self->gray = g_value_get_boolean (value);
+      break;
+
     case PROP_PRESET:
       self->preset = (PhotosOperationInstaPreset) g_value_get_enum (value);
       break;
@@ -1086,14 +819,34 @@ photos_operation_insta_curve_class_init (PhotosOperationInstaCurveClass *class)
   GObjectClass *object_class = G_OBJECT_CLASS (class);
   GeglOperationClass *operation_class = GEGL_OPERATION_CLASS (class);
   GeglOperationPointFilterClass *point_filter_class = GEGL_OPERATION_POINT_FILTER_CLASS (class);
+  guint i;
 
   operation_class->opencl_support = FALSE;
 
+  apply_curves = photos_simd_get_apply_curves_func (photos_simd_get_support ());
+  if (apply_curves == NULL)
+    apply_curves = photos_simd_apply_curves_scalar;
+
+  for (i = 0; i <= G_MAXUINT8; i++)
+    {
+      const gfloat saturation = 0.1f;
+
+      brannan_increments[i] = (guint8) (i * saturation + 0.5f);
+    }
+
   object_class->get_property = photos_operation_insta_curve_get_property;
   object_class->set_property = photos_operation_insta_curve_set_property;
   operation_class->prepare = photos_operation_insta_curve_prepare;
   point_filter_class->process = photos_operation_insta_curve_process;
 
+  g_object_class_install_property (object_class,
+                                   PROP_GRAY,
+                                   g_param_spec_boolean ("gray",
+                                                         "Gray",
+                                                         "Convert the result to grayscale",
+                                                         FALSE,
+                                                         G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
   g_object_class_install_property (object_class,
                                    PROP_PRESET,
                                    g_param_spec_enum ("preset",
@@ -92,14 +92,10 @@ photos_operation_insta_filter_setup (PhotosOperationInstaFilter *self)
     case PHOTOS_OPERATION_INSTA_PRESET_GOTHAM:
       node = gegl_node_new_child (operation->node,
                                   "operation", "photos:insta-curve",
+                                  "gray", TRUE,
                                   "preset", self->preset,
                                   NULL);
       self->nodes = g_list_prepend (self->nodes, node);
-
-      node = gegl_node_new_child (operation->node,
-                                  "operation", "gegl:gray",
-                                  NULL);
-      self->nodes = g_list_prepend (self->nodes, node);
       break;
 
     case PHOTOS_OPERATION_INSTA_PRESET_HEFE:
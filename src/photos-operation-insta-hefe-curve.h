@@ -28,7 +28,7 @@ G_DECLARE_FINAL_TYPE (PhotosOperationInstaHefeCurve,
                       photos_operation_insta_hefe_curve,
                       PHOTOS,
                       OPERATION_INSTA_HEFE_CURVE,
-                      GeglOperationPointFilter);
+                      GeglOperationPointComposer);
 
 G_END_DECLS
 
@@ -22,21 +22,39 @@
 #include <babl/babl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
+#include <string.h>
 
 #include "photos-operation-insta-hefe-vignette.h"
 
 
+typedef struct _PhotosOperationInstaHefeVignetteField PhotosOperationInstaHefeVignetteField;
+
 struct _PhotosOperationInstaHefeVignette
 {
   GeglOperationPointRender parent_instance;
+  PhotosOperationInstaHefeVignetteField *field;
   gdouble height;
-  gdouble height_ratio;
   gdouble width;
-  gdouble width_ratio;
   gdouble x;
   gdouble y;
 };
 
+/* The vignette is resampled with nearest-neighbour lookups, so the
+ * mapping from output to vignette pixels is separable. A field holds
+ * the vignette column for every output column and the offset of the
+ * vignette row for every output row for one output size. Fields are
+ * shared by all instances rendering at the same size.
+ */
+struct _PhotosOperationInstaHefeVignetteField
+{
+  gdouble height;
+  gdouble width;
+  gint n_columns;
+  gint n_rows;
+  guint *columns;
+  guint *rows;
+};
+
 enum
 {
   PROP_0,
@@ -52,36 +70,123 @@ G_DEFINE_TYPE (PhotosOperationInstaHefeVignette,
                GEGL_TYPE_OPERATION_POINT_RENDER);
 
 
-static GdkPixbuf *vignette;
-static guchar *vignette_pixels;
-static gint vignette_channels;
+G_LOCK_DEFINE_STATIC (fields);
+static GHashTable *fields;
+static guint32 *vignette_pixels;
 static gint vignette_height;
-static gint vignette_rowstride;
 static gint vignette_width;
 
+static const guint FIELDS_MAX = 8;
+
 
 static void
-photos_operation_insta_hefe_vignette_get_rgb (PhotosOperationInstaHefeVignette *self,
-                                              gint x,
-                                              gint y,
-                                              guint8 *out_r,
-                                              guint8 *out_g,
-                                              guint8 *out_b)
+photos_operation_insta_hefe_vignette_field_clear (PhotosOperationInstaHefeVignetteField *field)
+{
+  g_free (field->columns);
+  g_free (field->rows);
+}
+
+
+static gboolean
+photos_operation_insta_hefe_vignette_field_equal (gconstpointer a, gconstpointer b)
 {
-  gint pixbuf_x;
-  gint pixbuf_y;
-  guchar *pixel;
+  const PhotosOperationInstaHefeVignetteField *field_a = (const PhotosOperationInstaHefeVignetteField *) a;
+  const PhotosOperationInstaHefeVignetteField *field_b = (const PhotosOperationInstaHefeVignetteField *) b;
 
-  pixbuf_x = (gint) (((gdouble) x - self->x) * self->width_ratio + 0.5);
-  pixbuf_y = (gint) (((gdouble) y - self->y) * self->height_ratio + 0.5);
-  pixel = vignette_pixels + (vignette_rowstride * pixbuf_y) + vignette_channels * pixbuf_x;
+  return field_a->height == field_b->height && field_a->width == field_b->width;
+}
 
-  /* We don't want optional out parameters because they will
-   * introduce if branches in this hot path.
-   */
-  *out_r = (guint8) pixel[0];
-  *out_g = (guint8) pixel[1];
-  *out_b = (guint8) pixel[2];
+
+static guint
+photos_operation_insta_hefe_vignette_field_hash (gconstpointer key)
+{
+  const PhotosOperationInstaHefeVignetteField *field = (const PhotosOperationInstaHefeVignetteField *) key;
+  guint ret_val;
+
+  ret_val = g_double_hash (&field->width) * 31 + g_double_hash (&field->height);
+  return ret_val;
+}
+
+
+static guint *
+photos_operation_insta_hefe_vignette_field_map (gint n, gdouble extent, gint vignette_extent, guint stride)
+{
+  const gdouble ratio = vignette_extent / extent;
+  gint i;
+  guint *ret_val;
+
+  ret_val = g_new (guint, MAX (n, 1));
+
+  for (i = 0; i < n; i++)
+    {
+      gint vignette_i;
+
+      /* Rounding can step one past the last vignette pixel when
+       * upscaling.
+       */
+      vignette_i = (gint) ((gdouble) i * ratio + 0.5);
+      vignette_i = CLAMP (vignette_i, 0, vignette_extent - 1);
+      ret_val[i] = (guint) vignette_i * stride;
+    }
+
+  return ret_val;
+}
+
+
+static void
+photos_operation_insta_hefe_vignette_field_release (PhotosOperationInstaHefeVignetteField *field)
+{
+  g_atomic_rc_box_release_full (field, (GDestroyNotify) photos_operation_insta_hefe_vignette_field_clear);
+}
+
+
+static PhotosOperationInstaHefeVignetteField *
+photos_operation_insta_hefe_vignette_field_lookup (gdouble width, gdouble height)
+{
+  PhotosOperationInstaHefeVignetteField *ret_val = NULL;
+  PhotosOperationInstaHefeVignetteField key;
+
+  key.height = height;
+  key.width = width;
+
+  G_LOCK (fields);
+
+  if (fields == NULL)
+    {
+      fields = g_hash_table_new_full (photos_operation_insta_hefe_vignette_field_hash,
+                                      photos_operation_insta_hefe_vignette_field_equal,
+                                      (GDestroyNotify) photos_operation_insta_hefe_vignette_field_release,
+                                      NULL);
+    }
+
+  ret_val = (PhotosOperationInstaHefeVignetteField *) g_hash_table_lookup (fields, &key);
+  if (ret_val == NULL)
+    {
+      /* Fields still in use are kept alive by their operations. */
+      if (g_hash_table_size (fields) >= FIELDS_MAX)
+        g_hash_table_remove_all (fields);
+
+      ret_val = g_atomic_rc_box_new0 (PhotosOperationInstaHefeVignetteField);
+      ret_val->height = height;
+      ret_val->width = width;
+      ret_val->n_columns = (gint) (guint) width;
+      ret_val->n_rows = (gint) (guint) height;
+      ret_val->columns = photos_operation_insta_hefe_vignette_field_map (ret_val->n_columns,
+                                                                          width,
+                                                                          vignette_width,
+                                                                          1);
+      ret_val->rows = photos_operation_insta_hefe_vignette_field_map (ret_val->n_rows,
+                                                                       height,
+                                                                       vignette_height,
+                                                                       (guint) vignette_width);
+      g_hash_table_add (fields, ret_val);
+    }
+
+  g_atomic_rc_box_acquire (ret_val);
+
+  G_UNLOCK (fields);
+
+  return ret_val;
 }
 
 
@@ -99,10 +204,17 @@ photos_operation_insta_hefe_vignette_get_bounding_box (GeglOperation *operation)
 static void
 photos_operation_insta_hefe_vignette_prepare (GeglOperation *operation)
 {
+  PhotosOperationInstaHefeVignette *self = PHOTOS_OPERATION_INSTA_HEFE_VIGNETTE (operation);
   const Babl* format;
 
   format = babl_format ("R'G'B'A u8");
   gegl_operation_set_format (operation, "output", format);
+
+  if (self->field == NULL || self->field->height != self->height || self->field->width != self->width)
+    {
+      g_clear_pointer (&self->field, photos_operation_insta_hefe_vignette_field_release);
+      self->field = photos_operation_insta_hefe_vignette_field_lookup (self->width, self->height);
+    }
 }
 
 
@@ -114,20 +226,44 @@ photos_operation_insta_hefe_vignette_process (GeglOperation *operation,
                                               gint level)
 {
   PhotosOperationInstaHefeVignette *self = PHOTOS_OPERATION_INSTA_HEFE_VIGNETTE (operation);
-  const gint x1 = roi->x + roi->width;
-  const gint y1 = roi->y + roi->height;
+  PhotosOperationInstaHefeVignetteField *field = self->field;
+  const gint x0 = roi->x - (gint) self->x;
+  const gint x1 = x0 + roi->width;
+  const gint y0 = roi->y - (gint) self->y;
+  const gint y1 = y0 + roi->height;
+  const gsize row_size = (gsize) roi->width * sizeof (guint32);
+  const guint32 *previous_row = NULL;
   gint x;
   gint y;
-  guint8 *out = out_buf;
+  guint previous_offset = G_MAXUINT;
+  guint32 *out = out_buf;
+
+  g_return_val_if_fail (field != NULL, FALSE);
 
-  for (y = roi->y; y < y1; y++)
+  /* Neighbouring output rows usually come from the same vignette row,
+   * so only rows that move to a different one are resampled.
+   */
+  for (y = y0; y < y1; y++)
     {
-      for (x = roi->x; x < x1; x++)
+      const guint32 *vignette_row;
+      guint offset;
+
+      offset = field->rows[CLAMP (y, 0, field->n_rows - 1)];
+      if (offset == previous_offset)
         {
-          photos_operation_insta_hefe_vignette_get_rgb (self, x, y, &out[0], &out[1], &out[2]);
-          out[3] = 255;
-          out += 4;
+          memcpy (out, previous_row, row_size);
         }
+      else
+        {
+          vignette_row = vignette_pixels + offset;
+          for (x = x0; x < x1; x++)
+            out[x - x0] = vignette_row[field->columns[CLAMP (x, 0, field->n_columns - 1)]];
+
+          previous_offset = offset;
+        }
+
+      previous_row = out;
+      out += roi->width;
     }
 
   return TRUE;
@@ -176,12 +312,10 @@ photos_operation_insta_hefe_vignette_set_property (GObject *object,
     {
     case PROP_HEIGHT:
       self->height = g_value_get_double (value);
-      self->height_ratio = vignette_height / self->height;
       break;
 
     case PROP_WIDTH:
       self->width = g_value_get_double (value);
-      self->width_ratio = vignette_width / self->width;
       break;
 
     case PROP_X:
@@ -199,24 +333,68 @@ photos_operation_insta_hefe_vignette_set_property (GObject *object,
 }
 
 
+static void
+photos_operation_insta_hefe_vignette_finalize (GObject *object)
+{
+  PhotosOperationInstaHefeVignette *self = PHOTOS_OPERATION_INSTA_HEFE_VIGNETTE (object);
+
+  g_clear_pointer (&self->field, photos_operation_insta_hefe_vignette_field_release);
+
+  G_OBJECT_CLASS (photos_operation_insta_hefe_vignette_parent_class)->finalize (object);
+}
+
+
 static void
 photos_operation_insta_hefe_vignette_init (PhotosOperationInstaHefeVignette *self)
 {
-  if (vignette == NULL)
+  /* Operations are created from several threads, so the table is only
+   * published once it is completely filled.
+   */
+  if (g_once_init_enter (&vignette_pixels))
     {
+      g_autoptr (GdkPixbuf) vignette = NULL;
       GError *error;
+      const guchar *pixels;
+      gint i;
+      gint j;
+      gint n_channels;
+      gint rowstride;
+      guint32 *table;
+      guint8 *pixel;
 
       error = NULL;
       vignette = gdk_pixbuf_new_from_resource ("/org/gnome/Photos/gegl/vignette.png", &error);
       g_assert_no_error (error);
 
-      vignette_channels = gdk_pixbuf_get_n_channels (vignette);
-      g_assert_cmpint (vignette_channels, ==, 3);
+      n_channels = gdk_pixbuf_get_n_channels (vignette);
+      g_assert_cmpint (n_channels, ==, 3);
 
-      vignette_pixels = gdk_pixbuf_get_pixels (vignette);
-      vignette_rowstride = gdk_pixbuf_get_rowstride (vignette);
+      pixels = gdk_pixbuf_read_pixels (vignette);
+      rowstride = gdk_pixbuf_get_rowstride (vignette);
       vignette_height = gdk_pixbuf_get_height (vignette);
       vignette_width = gdk_pixbuf_get_width (vignette);
+
+      /* Keep the vignette as packed R'G'B'A u8 so that each output
+       * pixel is a single 32-bit copy.
+       */
+      table = g_new (guint32, (gsize) vignette_width * (gsize) vignette_height);
+      pixel = (guint8 *) table;
+
+      for (i = 0; i < vignette_height; i++)
+        {
+          const guchar *row = pixels + (gsize) rowstride * (gsize) i;
+
+          for (j = 0; j < vignette_width; j++)
+            {
+              pixel[0] = row[n_channels * j];
+              pixel[1] = row[n_channels * j + 1];
+              pixel[2] = row[n_channels * j + 2];
+              pixel[3] = 255;
+              pixel += 4;
+            }
+        }
+
+      g_once_init_leave (&vignette_pixels, table);
     }
 }
 
@@ -230,6 +408,7 @@ photos_operation_insta_hefe_vignette_class_init (PhotosOperationInstaHefeVignett
 
   operation_class->opencl_support = FALSE;
 
+  object_class->finalize = photos_operation_insta_hefe_vignette_finalize;
   object_class->get_property = photos_operation_insta_hefe_vignette_get_property;
   object_class->set_property = photos_operation_insta_hefe_vignette_set_property;
   operation_class->get_bounding_box = photos_operation_insta_hefe_vignette_get_bounding_box;
@@ -55,17 +55,16 @@ photos_operation_insta_hefe_attach (GeglOperation *operation)
 {
   PhotosOperationInstaHefe *self = PHOTOS_OPERATION_INSTA_HEFE (operation);
   GeglNode *curve;
-  GeglNode *multiply;
 
   self->input = gegl_node_get_output_proxy (operation->node, "input");
   self->output = gegl_node_get_output_proxy (operation->node, "output");
 
+  /* The curve also multiplies the image with the vignette. */
   curve = gegl_node_new_child (operation->node, "operation", "photos:insta-hefe-curve", NULL);
-  multiply = gegl_node_new_child (operation->node, "operation", "photos:svg-multiply", "srgb", TRUE, NULL);
   self->vignette = gegl_node_new_child (operation->node, "operation", "photos:insta-hefe-vignette", NULL);
 
-  gegl_node_connect_to (self->vignette, "output", multiply, "aux");
-  gegl_node_link_many (self->input, multiply, curve, self->output, NULL);
+  gegl_node_connect_to (self->vignette, "output", curve, "aux");
+  gegl_node_link_many (self->input, curve, self->output, NULL);
 }
 
 
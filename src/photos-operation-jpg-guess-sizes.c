@@ -25,29 +25,41 @@
 #include <gegl.h>
 #include <jpeglib.h>
 
+#include "photos-guess-sizes.h"
 #include "photos-jpeg-count.h"
+#include "photos-jpeg-save.h"
 #include "photos-operation-jpg-guess-sizes.h"
 
 
 struct _PhotosOperationJpgGuessSizes
 {
   GeglOperationSink parent_instance;
+  GBytes *data[2];
+  gboolean exact;
+  gboolean keep_data;
   gboolean optimize;
   gboolean progressive;
   gboolean sampling;
   gint quality;
+  gsize errors[2];
   gsize sizes[2];
 };
 
 enum
 {
   PROP_0,
+  PROP_DATA,
+  PROP_DATA_1,
+  PROP_EXACT,
+  PROP_KEEP_DATA,
   PROP_OPTIMIZE,
   PROP_PROGRESSIVE,
   PROP_QUALITY,
   PROP_SAMPLING,
   PROP_SIZE,
-  PROP_SIZE_1
+  PROP_SIZE_1,
+  PROP_SIZE_1_ERROR,
+  PROP_SIZE_ERROR
 };
 
 
@@ -66,19 +78,21 @@ photos_operation_jpg_guess_sizes_count (GeglBuffer *buffer,
                                         gint src_x,
                                         gint src_y,
                                         gint width,
-                                        gint height)
+                                        gint height,
+                                        GByteArray *data)
 {
   struct jpeg_compress_struct cinfo;
   struct jpeg_error_mgr jerr;
-  JSAMPROW row_pointer[1];
   const Babl *format;
-  gint bpp;
   gsize size;
 
   cinfo.err = jpeg_std_error (&jerr);
   jpeg_create_compress (&cinfo);
 
-  photos_jpeg_count_dest (&cinfo, &size);
+  if (data == NULL)
+    photos_jpeg_count_dest (&cinfo, &size);
+  else
+    photos_jpeg_data_dest (&cinfo, data);
 
   cinfo.image_width = width;
   cinfo.image_height = height;
@@ -123,30 +137,45 @@ photos_operation_jpg_guess_sizes_count (GeglBuffer *buffer,
   cinfo.restart_in_rows = 0;
 
   jpeg_start_compress (&cinfo, TRUE);
-
-  bpp = babl_format_get_bytes_per_pixel (format);
-  row_pointer[0] = g_malloc (width * bpp);
-
-  while (cinfo.next_scanline < cinfo.image_height)
-    {
-      GeglRectangle rect;
-
-      rect.x = src_x;
-      rect.y = src_y + cinfo.next_scanline;
-      rect.width = width;
-      rect.height = 1;
-      gegl_buffer_get (buffer, &rect, zoom, format, row_pointer[0], GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      jpeg_write_scanlines (&cinfo, row_pointer, 1);
-    }
-
+  photos_jpeg_write_buffer (&cinfo, buffer, format, zoom, src_x, src_y);
   jpeg_finish_compress (&cinfo);
   jpeg_destroy_compress (&cinfo);
-  g_free (row_pointer[0]);
+
+  if (data != NULL)
+    size = data->len;
 
   return size;
 }
 
 
+static gsize
+photos_operation_jpg_guess_sizes_count_func (GeglBuffer *buffer,
+                                             gdouble zoom,
+                                             gint src_x,
+                                             gint src_y,
+                                             gint width,
+                                             gint height,
+                                             GByteArray *data,
+                                             gpointer user_data)
+{
+  PhotosOperationJpgGuessSizes *self = PHOTOS_OPERATION_JPG_GUESS_SIZES (user_data);
+
+  return photos_operation_jpg_guess_sizes_count (buffer,
+                                                 self->quality,
+                                                 0,
+                                                 self->optimize,
+                                                 self->progressive,
+                                                 self->sampling,
+                                                 FALSE,
+                                                 zoom,
+                                                 src_x,
+                                                 src_y,
+                                                 width,
+                                                 height,
+                                                 data);
+}
+
+
 static gboolean
 photos_operation_jpg_guess_sizes_process (GeglOperation *operation,
                                           GeglBuffer *input,
@@ -156,34 +185,40 @@ photos_operation_jpg_guess_sizes_process (GeglOperation *operation,
   PhotosOperationJpgGuessSizes *self = PHOTOS_OPERATION_JPG_GUESS_SIZES (operation);
   gsize i;
 
-  for (i = 0; i < G_N_ELEMENTS (self->sizes); i++)
-    {
-      GeglRectangle roi_zoomed;
-      gdouble zoom = 1.0 / (gdouble) (1 << i);
-
-      roi_zoomed.height = (gint) (zoom * roi->height + 0.5);
-      roi_zoomed.width = (gint) (zoom * roi->width + 0.5);
-      roi_zoomed.x = (gint) (zoom * roi->x + 0.5);
-      roi_zoomed.y = (gint) (zoom * roi->y + 0.5);
-
-      self->sizes[i] = photos_operation_jpg_guess_sizes_count (input,
-                                                               self->quality,
-                                                               0,
-                                                               self->optimize,
-                                                               self->progressive,
-                                                               self->sampling,
-                                                               FALSE,
-                                                               zoom,
-                                                               roi_zoomed.x,
-                                                               roi_zoomed.y,
-                                                               roi_zoomed.width,
-                                                               roi_zoomed.height);
-    }
+  for (i = 0; i < G_N_ELEMENTS (self->data); i++)
+    g_clear_pointer (&self->data[i], g_bytes_unref);
+
+  /* Bands are aligned to the largest MCU height, which is 16 rows
+   * with sub-sampling.
+   */
+  photos_guess_sizes_run (input,
+                          roi,
+                          self->exact,
+                          16,
+                          photos_operation_jpg_guess_sizes_count_func,
+                          self,
+                          self->sizes,
+                          self->errors,
+                          self->keep_data ? self->data : NULL,
+                          G_N_ELEMENTS (self->sizes));
 
   return TRUE;
 }
 
 
+static void
+photos_operation_jpg_guess_sizes_finalize (GObject *object)
+{
+  PhotosOperationJpgGuessSizes *self = PHOTOS_OPERATION_JPG_GUESS_SIZES (object);
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS (self->data); i++)
+    g_clear_pointer (&self->data[i], g_bytes_unref);
+
+  G_OBJECT_CLASS (photos_operation_jpg_guess_sizes_parent_class)->finalize (object);
+}
+
+
 static void
 photos_operation_jpg_guess_sizes_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
 {
@@ -191,6 +226,22 @@ photos_operation_jpg_guess_sizes_get_property (GObject *object, guint prop_id, G
 
   switch (prop_id)
     {
+    case PROP_DATA:
+      g_value_set_boxed (value, self->data[0]);
+      break;
+
+    case PROP_DATA_1:
+      g_value_set_boxed (value, self->data[1]);
+      break;
+
+    case PROP_EXACT:
+      g_value_set_boolean (value, self->exact);
+      break;
+
+    case PROP_KEEP_DATA:
+      g_value_set_boolean (value, self->keep_data);
+      break;
+
     case PROP_OPTIMIZE:
       g_value_set_boolean (value, self->optimize);
       break;
@@ -215,6 +266,14 @@ photos_operation_jpg_guess_sizes_get_property (GObject *object, guint prop_id, G
       g_value_set_uint64 (value, (guint64) self->sizes[1]);
       break;
 
+    case PROP_SIZE_1_ERROR:
+      g_value_set_uint64 (value, (guint64) self->errors[1]);
+      break;
+
+    case PROP_SIZE_ERROR:
+      g_value_set_uint64 (value, (guint64) self->errors[0]);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -232,6 +291,14 @@ photos_operation_jpg_guess_sizes_set_property (GObject *object,
 
   switch (prop_id)
     {
+    case PROP_EXACT:
+      self->exact = g_value_get_boolean (value);
+      break;
+
+    case PROP_KEEP_DATA:
+      self->keep_data = g_value_get_boolean (value);
+      break;
+
     case PROP_OPTIMIZE:
       self->optimize = g_value_get_boolean (value);
       break;
@@ -271,10 +338,47 @@ photos_operation_jpg_guess_sizes_class_init (PhotosOperationJpgGuessSizesClass *
   operation_class->opencl_support = FALSE;
   sink_class->needs_full = TRUE;
 
+  object_class->finalize = photos_operation_jpg_guess_sizes_finalize;
   object_class->get_property = photos_operation_jpg_guess_sizes_get_property;
   object_class->set_property = photos_operation_jpg_guess_sizes_set_property;
   sink_class->process = photos_operation_jpg_guess_sizes_process;
 
+  g_object_class_install_property (object_class,
+                                   PROP_DATA,
+                                   g_param_spec_boxed ("data",
+                                                       "Data (level=0)",
+                                                       "The JPEG image at zoom=1.0, if keep-data is set and it was "
+                                                       "encoded in full",
+                                                       G_TYPE_BYTES,
+                                                       G_PARAM_READABLE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_DATA_1,
+                                   g_param_spec_boxed ("data-1",
+                                                       "Data (level=1)",
+                                                       "The JPEG image at zoom=0.5, if keep-data is set and it was "
+                                                       "encoded in full",
+                                                       G_TYPE_BYTES,
+                                                       G_PARAM_READABLE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_EXACT,
+                                   g_param_spec_boolean ("exact",
+                                                         "Exact",
+                                                         "Encode the whole image instead of estimating the sizes from "
+                                                         "a sample of bands",
+                                                         FALSE,
+                                                         G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_KEEP_DATA,
+                                   g_param_spec_boolean ("keep-data",
+                                                         "Keep data",
+                                                         "Keep the encoded images of the levels that were encoded "
+                                                         "in full",
+                                                         FALSE,
+                                                         G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
   g_object_class_install_property (object_class,
                                    PROP_OPTIMIZE,
                                    g_param_spec_boolean ("optimize",
@@ -331,6 +435,28 @@ photos_operation_jpg_guess_sizes_class_init (PhotosOperationJpgGuessSizesClass *
                                                         0,
                                                         G_PARAM_READABLE));
 
+  g_object_class_install_property (object_class,
+                                   PROP_SIZE_1_ERROR,
+                                   g_param_spec_uint64 ("size-1-error",
+                                                        "Size error (level=1)",
+                                                        "Approximate 95% bound in bytes on the error in size-1, or 0 "
+                                                        "if it was not estimated",
+                                                        0,
+                                                        G_MAXSIZE,
+                                                        0,
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_SIZE_ERROR,
+                                   g_param_spec_uint64 ("size-error",
+                                                        "Size error (level=0)",
+                                                        "Approximate 95% bound in bytes on the error in size, or 0 if "
+                                                        "it was not estimated",
+                                                        0,
+                                                        G_MAXSIZE,
+                                                        0,
+                                                        G_PARAM_READABLE));
+
   gegl_operation_class_set_keys (operation_class,
                                  "name", "photos:jpg-guess-sizes",
                                  "title", "JPEG Guess Sizes",
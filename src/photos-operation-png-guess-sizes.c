@@ -25,16 +25,22 @@
 #include <gegl.h>
 #include <png.h>
 
+#include "photos-guess-sizes.h"
 #include "photos-png-count.h"
+#include "photos-png-save.h"
 #include "photos-operation-png-guess-sizes.h"
 
 
 struct _PhotosOperationPngGuessSizes
 {
   GeglOperationSink parent_instance;
+  GBytes *data[2];
   gboolean background;
+  gboolean exact;
+  gboolean keep_data;
   gint bitdepth;
   gint compression;
+  gsize errors[2];
   gsize sizes[2];
 };
 
@@ -44,8 +50,14 @@ enum
   PROP_BACKGROUND,
   PROP_BITDEPTH,
   PROP_COMPRESSION,
+  PROP_DATA,
+  PROP_DATA_1,
+  PROP_EXACT,
+  PROP_KEEP_DATA,
   PROP_SIZE,
-  PROP_SIZE_1
+  PROP_SIZE_1,
+  PROP_SIZE_1_ERROR,
+  PROP_SIZE_ERROR
 };
 
 
@@ -61,17 +73,16 @@ photos_operation_png_guess_sizes_count (GeglBuffer *buffer,
                                         gint src_x,
                                         gint src_y,
                                         gint width,
-                                        gint height)
+                                        gint height,
+                                        GByteArray *data)
 {
-  gint bpp;
-  gint i;
   gint png_color_type;
   gchar format_string[16];
   const Babl *format;
   const Babl *format_buffer;
   gsize ret_val = 0;
   gsize size;
-  g_autofree guchar *pixels = NULL;
+  guchar *volatile strip = NULL;
   png_infop info_ptr = NULL;
   png_structp png_ptr = NULL;
 
@@ -125,7 +136,10 @@ photos_operation_png_guess_sizes_count (GeglBuffer *buffer,
   if (compression >= 0)
     png_set_compression_level (png_ptr, compression);
 
-  photos_png_init_count (png_ptr, &size);
+  if (data == NULL)
+    photos_png_init_count (png_ptr, &size);
+  else
+    photos_png_init_data (png_ptr, data);
 
   png_set_IHDR (png_ptr,
                 info_ptr,
@@ -163,30 +177,44 @@ photos_operation_png_guess_sizes_count (GeglBuffer *buffer,
 #endif
 
   format = babl_format (format_string);
-  bpp = babl_format_get_bytes_per_pixel (format);
-  pixels = g_malloc0 (width * bpp);
-
-  for (i = 0; i < height; i++)
-    {
-      GeglRectangle rect;
-
-      rect.x = src_x;
-      rect.y = src_y + i;
-      rect.width = width;
-      rect.height = 1;
-      gegl_buffer_get (buffer, &rect, zoom, format, pixels, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      png_write_rows (png_ptr, &pixels, 1);
-    }
+  strip = g_malloc (photos_png_get_strip_size (format, width));
+  photos_png_write_buffer (png_ptr, buffer, format, zoom, src_x, src_y, width, height, strip);
 
   png_write_end (png_ptr, info_ptr);
-  ret_val = size;
+  ret_val = data == NULL ? size : data->len;
 
  out:
+  g_free (strip);
   png_destroy_write_struct (&png_ptr, &info_ptr);
   return ret_val;
 }
 
 
+static gsize
+photos_operation_png_guess_sizes_count_func (GeglBuffer *buffer,
+                                             gdouble zoom,
+                                             gint src_x,
+                                             gint src_y,
+                                             gint width,
+                                             gint height,
+                                             GByteArray *data,
+                                             gpointer user_data)
+{
+  PhotosOperationPngGuessSizes *self = PHOTOS_OPERATION_PNG_GUESS_SIZES (user_data);
+
+  return photos_operation_png_guess_sizes_count (buffer,
+                                                 self->compression,
+                                                 self->bitdepth,
+                                                 self->background,
+                                                 zoom,
+                                                 src_x,
+                                                 src_y,
+                                                 width,
+                                                 height,
+                                                 data);
+}
+
+
 static gboolean
 photos_operation_png_guess_sizes_process (GeglOperation *operation,
                                           GeglBuffer *input,
@@ -196,31 +224,37 @@ photos_operation_png_guess_sizes_process (GeglOperation *operation,
   PhotosOperationPngGuessSizes *self = PHOTOS_OPERATION_PNG_GUESS_SIZES (operation);
   gsize i;
 
-  for (i = 0; i < G_N_ELEMENTS (self->sizes); i++)
-    {
-      GeglRectangle roi_zoomed;
-      gdouble zoom = 1.0 / (gdouble) (1 << i);
-
-      roi_zoomed.height = (gint) (zoom * roi->height + 0.5);
-      roi_zoomed.width = (gint) (zoom * roi->width + 0.5);
-      roi_zoomed.x = (gint) (zoom * roi->x + 0.5);
-      roi_zoomed.y = (gint) (zoom * roi->y + 0.5);
-
-      self->sizes[i] = photos_operation_png_guess_sizes_count (input,
-                                                               self->compression,
-                                                               self->bitdepth,
-                                                               self->background,
-                                                               zoom,
-                                                               roi_zoomed.x,
-                                                               roi_zoomed.y,
-                                                               roi_zoomed.width,
-                                                               roi_zoomed.height);
-    }
+  for (i = 0; i < G_N_ELEMENTS (self->data); i++)
+    g_clear_pointer (&self->data[i], g_bytes_unref);
+
+  photos_guess_sizes_run (input,
+                          roi,
+                          self->exact,
+                          1,
+                          photos_operation_png_guess_sizes_count_func,
+                          self,
+                          self->sizes,
+                          self->errors,
+                          self->keep_data ? self->data : NULL,
+                          G_N_ELEMENTS (self->sizes));
 
   return TRUE;
 }
 
 
+static void
+photos_operation_png_guess_sizes_finalize (GObject *object)
+{
+  PhotosOperationPngGuessSizes *self = PHOTOS_OPERATION_PNG_GUESS_SIZES (object);
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS (self->data); i++)
+    g_clear_pointer (&self->data[i], g_bytes_unref);
+
+  G_OBJECT_CLASS (photos_operation_png_guess_sizes_parent_class)->finalize (object);
+}
+
+
 static void
 photos_operation_png_guess_sizes_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
 {
@@ -240,6 +274,22 @@ photos_operation_png_guess_sizes_get_property (GObject *object, guint prop_id, G
       g_value_set_int (value, self->compression);
       break;
 
+    case PROP_DATA:
+      g_value_set_boxed (value, self->data[0]);
+      break;
+
+    case PROP_DATA_1:
+      g_value_set_boxed (value, self->data[1]);
+      break;
+
+    case PROP_EXACT:
+      g_value_set_boolean (value, self->exact);
+      break;
+
+    case PROP_KEEP_DATA:
+      g_value_set_boolean (value, self->keep_data);
+      break;
+
     case PROP_SIZE:
       g_value_set_uint64 (value, (guint64) self->sizes[0]);
       break;
@@ -248,6 +298,14 @@ photos_operation_png_guess_sizes_get_property (GObject *object, guint prop_id, G
       g_value_set_uint64 (value, (guint64) self->sizes[1]);
       break;
 
+    case PROP_SIZE_1_ERROR:
+      g_value_set_uint64 (value, (guint64) self->errors[1]);
+      break;
+
+    case PROP_SIZE_ERROR:
+      g_value_set_uint64 (value, (guint64) self->errors[0]);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -277,6 +335,14 @@ photos_operation_png_guess_sizes_set_property (GObject *object,
       self->compression = g_value_get_int (value);
       break;
 
+    case PROP_EXACT:
+      self->exact = g_value_get_boolean (value);
+      break;
+
+    case PROP_KEEP_DATA:
+      self->keep_data = g_value_get_boolean (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -300,6 +366,7 @@ photos_operation_png_guess_sizes_class_init (PhotosOperationPngGuessSizesClass *
   operation_class->opencl_support = FALSE;
   sink_class->needs_full = TRUE;
 
+  object_class->finalize = photos_operation_png_guess_sizes_finalize;
   object_class->get_property = photos_operation_png_guess_sizes_get_property;
   object_class->set_property = photos_operation_png_guess_sizes_set_property;
   sink_class->process = photos_operation_png_guess_sizes_process;
@@ -333,6 +400,42 @@ photos_operation_png_guess_sizes_class_init (PhotosOperationPngGuessSizesClass *
                                                      3,
                                                      G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
 
+  g_object_class_install_property (object_class,
+                                   PROP_DATA,
+                                   g_param_spec_boxed ("data",
+                                                       "Data (level=0)",
+                                                       "The PNG image at zoom=1.0, if keep-data is set and it was "
+                                                       "encoded in full",
+                                                       G_TYPE_BYTES,
+                                                       G_PARAM_READABLE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_DATA_1,
+                                   g_param_spec_boxed ("data-1",
+                                                       "Data (level=1)",
+                                                       "The PNG image at zoom=0.5, if keep-data is set and it was "
+                                                       "encoded in full",
+                                                       G_TYPE_BYTES,
+                                                       G_PARAM_READABLE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_EXACT,
+                                   g_param_spec_boolean ("exact",
+                                                         "Exact",
+                                                         "Encode the whole image instead of estimating the sizes from "
+                                                         "a sample of bands",
+                                                         FALSE,
+                                                         G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_KEEP_DATA,
+                                   g_param_spec_boolean ("keep-data",
+                                                         "Keep data",
+                                                         "Keep the encoded images of the levels that were encoded "
+                                                         "in full",
+                                                         FALSE,
+                                                         G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
   g_object_class_install_property (object_class,
                                    PROP_SIZE,
                                    g_param_spec_uint64 ("size",
@@ -355,6 +458,28 @@ photos_operation_png_guess_sizes_class_init (PhotosOperationPngGuessSizesClass *
                                                         0,
                                                         G_PARAM_READABLE));
 
+  g_object_class_install_property (object_class,
+                                   PROP_SIZE_1_ERROR,
+                                   g_param_spec_uint64 ("size-1-error",
+                                                        "Size error (level=1)",
+                                                        "Approximate 95% bound in bytes on the error in size-1, or 0 "
+                                                        "if it was not estimated",
+                                                        0,
+                                                        G_MAXSIZE,
+                                                        0,
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_SIZE_ERROR,
+                                   g_param_spec_uint64 ("size-error",
+                                                        "Size error (level=0)",
+                                                        "Approximate 95% bound in bytes on the error in size, or 0 if "
+                                                        "it was not estimated",
+                                                        0,
+                                                        G_MAXSIZE,
+                                                        0,
+                                                        G_PARAM_READABLE));
+
   gegl_operation_class_set_keys (operation_class,
                                  "name", "photos:png-guess-sizes",
                                  "title", "PNG Guess Sizes",
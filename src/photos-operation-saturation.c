@@ -23,6 +23,7 @@
 #include <gegl.h>
 
 #include "photos-operation-saturation.h"
+#include "photos-simd.h"
 
 
 typedef void (*PhotosOperationProcessFunc) (GeglOperation *, void *, void *, glong, const GeglRectangle *, gint);
@@ -31,7 +32,9 @@ struct _PhotosOperationSaturation
 {
   GeglOperationPointFilter parent_instance;
   PhotosOperationProcessFunc process;
+  gboolean lch;
   gfloat scale;
+  guint n_components;
 };
 
 enum
@@ -44,6 +47,9 @@ enum
 G_DEFINE_TYPE (PhotosOperationSaturation, photos_operation_saturation, GEGL_TYPE_OPERATION_POINT_FILTER);
 
 
+static PhotosSimdScaleChannelsFunc scale_channels;
+
+
 static void
 photos_operation_saturation_process_lab (GeglOperation *operation,
                                          void *in_buf,
@@ -146,6 +152,26 @@ photos_operation_saturation_process_lch_alpha (GeglOperation *operation,
 }
 
 
+static void
+photos_operation_saturation_process_simd (GeglOperation *operation,
+                                          void *in_buf,
+                                          void *out_buf,
+                                          glong n_pixels,
+                                          const GeglRectangle *roi,
+                                          gint level)
+{
+  PhotosOperationSaturation *self = PHOTOS_OPERATION_SATURATION (operation);
+  gfloat factors[4];
+
+  factors[0] = 1.0f;
+  factors[1] = self->scale;
+  factors[2] = self->lch ? 1.0f : self->scale;
+  factors[3] = 1.0f;
+
+  (*scale_channels) (in_buf, out_buf, n_pixels, self->n_components, factors);
+}
+
+
 static void
 photos_operation_saturation_prepare (GeglOperation *operation)
 {
@@ -155,6 +181,8 @@ photos_operation_saturation_prepare (GeglOperation *operation)
   const Babl *model_input;
   const Babl *model_lch;
 
+  self->lch = FALSE;
+
   input_format = gegl_operation_get_source_format (operation, "input");
   if (input_format == NULL)
     {
@@ -171,6 +199,7 @@ photos_operation_saturation_prepare (GeglOperation *operation)
       if (model_input == model_lch)
         {
           format = babl_format ("CIE LCH(ab) alpha float");
+          self->lch = TRUE;
           self->process = photos_operation_saturation_process_lch_alpha;
         }
       else
@@ -185,6 +214,7 @@ photos_operation_saturation_prepare (GeglOperation *operation)
       if (model_input == model_lch)
         {
           format = babl_format ("CIE LCH(ab) float");
+          self->lch = TRUE;
           self->process = photos_operation_saturation_process_lch;
         }
       else
@@ -195,6 +225,13 @@ photos_operation_saturation_prepare (GeglOperation *operation)
     }
 
  out:
+  /* The scalar kernels are the reference, and are used when the CPU
+   * has no vector unit that we know of.
+   */
+  self->n_components = (guint) babl_format_get_n_components (format);
+  if (scale_channels != NULL)
+    self->process = photos_operation_saturation_process_simd;
+
   gegl_operation_set_format (operation, "input", format);
   gegl_operation_set_format (operation, "output", format);
 }
@@ -266,6 +303,8 @@ photos_operation_saturation_class_init (PhotosOperationSaturationClass *class)
 
   operation_class->opencl_support = FALSE;
 
+  scale_channels = photos_simd_get_scale_channels_func (photos_simd_get_support ());
+
   object_class->get_property = photos_operation_saturation_get_property;
   object_class->set_property = photos_operation_saturation_set_property;
   operation_class->prepare = photos_operation_saturation_prepare;
@@ -0,0 +1,91 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Pages are sized to cover a few screens, and grown while a page can
+ * still be fetched within the target latency. The cost of a row is a
+ * running average over the pages that were fetched so far.
+ */
+
+
+#include "config.h"
+
+#include "photos-paging.h"
+
+
+static const gint64 PAGE_LATENCY_TARGET = 200000; /* us */
+static const guint PAGE_SCREENS = 3;
+
+
+gint
+photos_paging_get_step (guint n_visible, gdouble row_cost)
+{
+  gint ret_val;
+  gint step_min;
+
+  /* Clamp before multiplying, so that it can't overflow */
+  step_min = (gint) (MIN (n_visible, PHOTOS_PAGING_STEP_MAX / PAGE_SCREENS) * PAGE_SCREENS);
+  step_min = MAX (step_min, PHOTOS_PAGING_STEP_MIN);
+
+  if (row_cost > 0.0)
+    ret_val = (gint) MIN ((gdouble) PAGE_LATENCY_TARGET / row_cost, (gdouble) PHOTOS_PAGING_STEP_MAX);
+  else
+    ret_val = step_min;
+
+  ret_val = CLAMP (ret_val, step_min, PHOTOS_PAGING_STEP_MAX);
+  return ret_val;
+}
+
+
+gboolean
+photos_paging_is_prefetch_needed (guint n_visible, guint n_below, guint prefetch_screens)
+{
+  gboolean ret_val = FALSE;
+
+  if (prefetch_screens == 0 || n_visible == 0)
+    goto out;
+
+  if (n_below > n_visible * prefetch_screens)
+    goto out;
+
+  ret_val = TRUE;
+
+ out:
+  return ret_val;
+}
+
+
+gdouble
+photos_paging_update_row_cost (gdouble row_cost, guint n_rows, gint64 latency)
+{
+  gdouble ret_val = row_cost;
+  gdouble page_row_cost;
+
+  /* A negative latency means that the page failed */
+  if (latency < 0 || n_rows == 0)
+    goto out;
+
+  page_row_cost = (gdouble) latency / n_rows;
+
+  if (row_cost > 0.0)
+    ret_val = (row_cost + page_row_cost) / 2.0;
+  else
+    ret_val = page_row_cost;
+
+ out:
+  return ret_val;
+}
@@ -0,0 +1,40 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_PAGING_H
+#define PHOTOS_PAGING_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+enum
+{
+  PHOTOS_PAGING_STEP_MIN = 60,
+  PHOTOS_PAGING_STEP_MAX = 600
+};
+
+gint          photos_paging_get_step               (guint n_visible, gdouble row_cost);
+
+gboolean      photos_paging_is_prefetch_needed     (guint n_visible, guint n_below, guint prefetch_screens);
+
+gdouble       photos_paging_update_row_cost        (gdouble row_cost, guint n_rows, gint64 latency);
+
+G_END_DECLS
+
+#endif /* PHOTOS_PAGING_H */
@@ -34,6 +34,7 @@ struct _PhotosPipeline
 {
   GObject parent_instance;
   GHashTable *hash;
+  GQueue cache_points;
   GStrv uris;
   GeglNode *graph;
   gchar *snapshot;
@@ -61,6 +62,84 @@ static const gchar *OPERATIONS[] =
   "photos:insta-filter"
 };
 
+/* Only the output of the node right before the most recently edited
+ * one needs to be kept around for an edit to be cheap. A few of them
+ * are kept so that switching between tools doesn't start over, but
+ * they hold the whole image, so the total has to be bounded.
+ */
+static const gsize CACHE_POINTS_MEMORY_MAX = 512 * 1024 * 1024;
+
+
+static void
+photos_pipeline_cache_points_clear (PhotosPipeline *self)
+{
+  GeglNode *node;
+
+  while ((node = GEGL_NODE (g_queue_pop_head (&self->cache_points))) != NULL)
+    {
+      gegl_node_set (node, "cache-policy", GEGL_CACHE_POLICY_AUTO, NULL);
+      g_object_unref (node);
+    }
+}
+
+
+static void
+photos_pipeline_cache_points_update (PhotosPipeline *self, GeglNode *node)
+{
+  const Babl *format;
+  GeglNode *input;
+  GeglNode *producer;
+  GeglRectangle bbox;
+  GList *link;
+  gsize size;
+  guint n_cache_points_max;
+
+  input = gegl_node_get_input_proxy (self->graph, "input");
+
+  /* GEGL only invalidates the nodes downstream of the one whose
+   * properties were changed, so anything cached upstream stays valid.
+   */
+  producer = gegl_node_get_producer (node, "input", NULL);
+  while (producer != NULL && producer != input && gegl_node_get_passthrough (producer))
+    producer = gegl_node_get_producer (producer, "input", NULL);
+
+  if (producer == NULL || producer == input)
+    return;
+
+  link = g_queue_find (&self->cache_points, producer);
+  if (link != NULL)
+    {
+      g_queue_unlink (&self->cache_points, link);
+      g_queue_push_head_link (&self->cache_points, link);
+      return;
+    }
+
+  bbox = gegl_node_get_bounding_box (producer);
+  format = babl_format ("RGBA float");
+  size = (gsize) bbox.height * (gsize) bbox.width * (gsize) babl_format_get_bytes_per_pixel (format);
+  n_cache_points_max = size > 0 ? (guint) (CACHE_POINTS_MEMORY_MAX / size) : 0;
+  if (n_cache_points_max == 0)
+    return;
+
+  while (g_queue_get_length (&self->cache_points) >= n_cache_points_max)
+    {
+      GeglNode *evicted;
+
+      evicted = GEGL_NODE (g_queue_pop_tail (&self->cache_points));
+      gegl_node_set (evicted, "cache-policy", GEGL_CACHE_POLICY_AUTO, NULL);
+      g_object_unref (evicted);
+    }
+
+  gegl_node_set (producer, "cache-policy", GEGL_CACHE_POLICY_ALWAYS, NULL);
+  g_queue_push_head (&self->cache_points, g_object_ref (producer));
+
+  photos_debug (PHOTOS_DEBUG_GEGL,
+                "Pipeline: Cache Point: %s, %u of %u",
+                gegl_node_get_operation (producer),
+                g_queue_get_length (&self->cache_points),
+                n_cache_points_max);
+}
+
 
 static void
 photos_pipeline_link_nodes (GeglNode *input, GeglNode *output, GSList *nodes)
@@ -89,6 +168,59 @@ photos_pipeline_link_nodes (GeglNode *input, GeglNode *output, GSList *nodes)
 }
 
 
+static GeglNode *
+photos_pipeline_copy_node (GeglNode *parent, GeglNode *node, gdouble scale)
+{
+  GParamSpec **pspecs;
+  GeglNode *ret_val;
+  const gchar *operation;
+  guint i;
+  guint n_pspecs;
+
+  operation = gegl_node_get_operation (node);
+  ret_val = gegl_node_new_child (parent, "operation", operation, NULL);
+
+  pspecs = gegl_operation_list_properties (operation, &n_pspecs);
+  for (i = 0; i < n_pspecs; i++)
+    {
+      GValue value = G_VALUE_INIT;
+
+      if ((pspecs[i]->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE)
+        continue;
+
+      /* These can't be set once the operation exists. */
+      if ((pspecs[i]->flags & G_PARAM_CONSTRUCT_ONLY) != 0)
+        continue;
+
+      g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (pspecs[i]));
+      gegl_node_get_property (node, pspecs[i]->name, &value);
+      gegl_node_set_property (ret_val, pspecs[i]->name, &value);
+      g_value_unset (&value);
+    }
+
+  g_free (pspecs);
+
+  /* The geometry is in the co-ordinates of the unscaled image. */
+  if (g_strcmp0 (operation, "gegl:crop") == 0)
+    {
+      gdouble height;
+      gdouble width;
+      gdouble x;
+      gdouble y;
+
+      gegl_node_get (ret_val, "height", &height, "width", &width, "x", &x, "y", &y, NULL);
+      gegl_node_set (ret_val,
+                     "height", height * scale,
+                     "width", width * scale,
+                     "x", x * scale,
+                     "y", y * scale,
+                     NULL);
+    }
+
+  return ret_val;
+}
+
+
 static void
 photos_pipeline_reset (PhotosPipeline *self)
 {
@@ -141,6 +273,7 @@ photos_pipeline_create_graph_from_xml (PhotosPipeline *self, const gchar *conten
   if (graph == NULL)
     goto out;
 
+  photos_pipeline_cache_points_clear (self);
   g_hash_table_remove_all (self->hash);
   photos_gegl_remove_children_from_node (self->graph);
 
@@ -274,6 +407,7 @@ photos_pipeline_dispose (GObject *object)
    *
    * See: https://bugzilla.gnome.org/show_bug.cgi?id=759995
    */
+  g_queue_clear_full (&self->cache_points, g_object_unref);
   g_clear_pointer (&self->hash, g_hash_table_unref);
 
   g_clear_object (&self->graph);
@@ -325,6 +459,7 @@ static void
 photos_pipeline_init (PhotosPipeline *self)
 {
   self->hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  g_queue_init (&self->cache_points);
   self->graph = gegl_node_new ();
 }
 
@@ -551,6 +686,7 @@ photos_pipeline_add_valist (PhotosPipeline *self,
     }
 
   gegl_node_set_valist (node, first_property_name, ap);
+  photos_pipeline_cache_points_update (self, node);
 
   xml = gegl_node_to_xml_full (self->graph, self->graph, "/");
   photos_debug (PHOTOS_DEBUG_GEGL, "Pipeline: %s", xml);
@@ -665,6 +801,45 @@ photos_pipeline_is_edited (PhotosPipeline *self)
 }
 
 
+GeglNode *
+photos_pipeline_new_proxy_graph (PhotosPipeline *self, gdouble scale)
+{
+  GSList *nodes = NULL;
+  GeglNode *input;
+  GeglNode *node;
+  GeglNode *output;
+  GeglNode *ret_val;
+
+  g_return_val_if_fail (PHOTOS_IS_PIPELINE (self), NULL);
+  g_return_val_if_fail (scale > 0.0, NULL);
+
+  ret_val = gegl_node_new ();
+
+  input = gegl_node_get_input_proxy (self->graph, "input");
+  output = gegl_node_get_output_proxy (self->graph, "output");
+
+  for (node = gegl_node_get_producer (output, "input", NULL);
+       node != NULL && node != input;
+       node = gegl_node_get_producer (node, "input", NULL))
+    {
+      GeglNode *copy;
+
+      if (gegl_node_get_passthrough (node))
+        continue;
+
+      copy = photos_pipeline_copy_node (ret_val, node, scale);
+      nodes = g_slist_prepend (nodes, copy);
+    }
+
+  input = gegl_node_get_input_proxy (ret_val, "input");
+  output = gegl_node_get_output_proxy (ret_val, "output");
+  photos_pipeline_link_nodes (input, output, nodes);
+
+  g_slist_free (nodes);
+  return ret_val;
+}
+
+
 GeglProcessor *
 photos_pipeline_new_processor (PhotosPipeline *self)
 {
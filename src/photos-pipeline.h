@@ -60,6 +60,8 @@ gboolean               photos_pipeline_is_edited         (PhotosPipeline *self);
 
 GeglProcessor         *photos_pipeline_new_processor     (PhotosPipeline *self);
 
+GeglNode              *photos_pipeline_new_proxy_graph   (PhotosPipeline *self, gdouble scale);
+
 void                   photos_pipeline_save_async        (PhotosPipeline *self,
                                                           GCancellable *cancellable,
                                                           GAsyncReadyCallback callback,
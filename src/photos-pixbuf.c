@@ -19,10 +19,14 @@
 
 #include "config.h"
 
+#include "photos-gegl.h"
+#include "photos-jpeg-load.h"
 #include "photos-pixbuf.h"
+#include "photos-png-load.h"
 
 
 typedef struct _PhotosPixbufNewFromFileData PhotosPixbufNewFromFileData;
+typedef struct _PhotosPixbufNewFromFileRegionData PhotosPixbufNewFromFileRegionData;
 
 struct _PhotosPixbufNewFromFileData
 {
@@ -31,6 +35,13 @@ struct _PhotosPixbufNewFromFileData
   gint width;
 };
 
+struct _PhotosPixbufNewFromFileRegionData
+{
+  GQuark orientation;
+  GeglRectangle region;
+  gchar *filename;
+};
+
 
 static PhotosPixbufNewFromFileData *
 photos_pixbuf_new_from_file_data_new (const gchar *filename, gint height, gint width)
@@ -54,6 +65,43 @@ photos_pixbuf_new_from_file_data_free (PhotosPixbufNewFromFileData *data)
 }
 
 
+static PhotosPixbufNewFromFileRegionData *
+photos_pixbuf_new_from_file_region_data_new (const gchar *filename, GQuark orientation, const GeglRectangle *region)
+{
+  PhotosPixbufNewFromFileRegionData *data;
+
+  data = g_slice_new0 (PhotosPixbufNewFromFileRegionData);
+  data->filename = g_strdup (filename);
+  data->orientation = orientation;
+  data->region = *region;
+
+  return data;
+}
+
+
+static void
+photos_pixbuf_new_from_file_region_data_free (PhotosPixbufNewFromFileRegionData *data)
+{
+  g_free (data->filename);
+  g_slice_free (PhotosPixbufNewFromFileRegionData, data);
+}
+
+
+static gboolean
+photos_pixbuf_should_fall_back (const GError *error)
+{
+  gboolean ret_val;
+
+  /* GdkPixbuf is more lenient with damaged JPEGs, and some of those
+   * used to load before the reduced resolution loaders were added.
+   */
+  ret_val = g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)
+            || g_error_matches (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE);
+
+  return ret_val;
+}
+
+
 static void
 photos_pixbuf_new_from_file_at_size_in_thread_func (GTask *task,
                                                     gpointer source_object,
@@ -66,7 +114,13 @@ photos_pixbuf_new_from_file_at_size_in_thread_func (GTask *task,
   {
     g_autoptr (GError) error = NULL;
 
-    result = gdk_pixbuf_new_from_file_at_size (data->filename, data->width, data->height, &error);
+    result = photos_jpeg_load_at_size (data->filename, data->width, data->height, cancellable, &error);
+    if (photos_pixbuf_should_fall_back (error))
+      {
+        g_clear_error (&error);
+        result = gdk_pixbuf_new_from_file_at_size (data->filename, data->width, data->height, &error);
+      }
+
     if (error != NULL)
       {
         g_task_return_error (task, g_steal_pointer (&error));
@@ -117,3 +171,134 @@ photos_pixbuf_new_from_file_at_size_finish (GAsyncResult *res, GError **error)
 
   return g_task_propagate_pointer (task, error);
 }
+
+
+static void
+photos_pixbuf_new_from_file_region_in_thread_func (GTask *task,
+                                                   gpointer source_object,
+                                                   gpointer task_data,
+                                                   GCancellable *cancellable)
+{
+  g_autoptr (GdkPixbuf) result = NULL;
+  GeglRectangle bbox_original;
+  GeglRectangle region_original;
+  PhotosPixbufNewFromFileRegionData *data = (PhotosPixbufNewFromFileRegionData *) task_data;
+  gint height;
+  gint width;
+
+  if (gdk_pixbuf_get_file_info (data->filename, &width, &height) == NULL)
+    {
+      g_task_return_new_error (task,
+                               GDK_PIXBUF_ERROR,
+                               GDK_PIXBUF_ERROR_UNKNOWN_TYPE,
+                               "Couldn’t recognize the image file format");
+      goto out;
+    }
+
+  /* The region is in the coordinates of the oriented image, but the
+   * pixels are stored without the orientation applied.
+   */
+  gegl_rectangle_set (&bbox_original, 0, 0, (guint) width, (guint) height);
+  if (!photos_gegl_rectangle_unapply_orientation (&data->region,
+                                                  &bbox_original,
+                                                  data->orientation,
+                                                  &region_original))
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Region lies outside the image");
+      goto out;
+    }
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    result = photos_jpeg_load_region (data->filename,
+                                      region_original.x,
+                                      region_original.y,
+                                      region_original.width,
+                                      region_original.height,
+                                      cancellable,
+                                      &error);
+
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+      {
+        g_clear_error (&error);
+        result = photos_png_load_region (data->filename,
+                                         region_original.x,
+                                         region_original.y,
+                                         region_original.width,
+                                         region_original.height,
+                                         cancellable,
+                                         &error);
+      }
+
+    if (photos_pixbuf_should_fall_back (error))
+      {
+        g_autoptr (GdkPixbuf) pixbuf = NULL;
+        g_autoptr (GdkPixbuf) pixbuf_region = NULL;
+
+        g_clear_error (&error);
+        pixbuf = gdk_pixbuf_new_from_file (data->filename, &error);
+        if (pixbuf != NULL)
+          {
+            pixbuf_region = gdk_pixbuf_new_subpixbuf (pixbuf,
+                                                      region_original.x,
+                                                      region_original.y,
+                                                      region_original.width,
+                                                      region_original.height);
+            result = gdk_pixbuf_copy (pixbuf_region);
+          }
+      }
+
+    if (error != NULL)
+      {
+        g_task_return_error (task, g_steal_pointer (&error));
+        goto out;
+      }
+  }
+
+  g_task_return_pointer (task, g_object_ref (result), g_object_unref);
+
+ out:
+  return;
+}
+
+
+void
+photos_pixbuf_new_from_file_region_async (const gchar *filename,
+                                          GQuark orientation,
+                                          const GeglRectangle *region,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  PhotosPixbufNewFromFileRegionData *data;
+
+  g_return_if_fail (filename != NULL && filename[0] != '\0');
+  g_return_if_fail (region != NULL);
+  g_return_if_fail (region->height > 0);
+  g_return_if_fail (region->width > 0);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  data = photos_pixbuf_new_from_file_region_data_new (filename, orientation, region);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_return_on_cancel (task, TRUE);
+  g_task_set_source_tag (task, photos_pixbuf_new_from_file_region_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) photos_pixbuf_new_from_file_region_data_free);
+
+  g_task_run_in_thread (task, photos_pixbuf_new_from_file_region_in_thread_func);
+}
+
+
+GdkPixbuf *
+photos_pixbuf_new_from_file_region_finish (GAsyncResult *res, GError **error)
+{
+  GTask *task = G_TASK (res);
+
+  g_return_val_if_fail (g_task_is_valid (res, NULL), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (task) == photos_pixbuf_new_from_file_region_async, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (task, error);
+}
@@ -20,6 +20,7 @@
 #define PHOTOS_PIXBUF_H
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
 #include <gio/gio.h>
 
 G_BEGIN_DECLS
@@ -33,6 +34,15 @@ void             photos_pixbuf_new_from_file_at_size_async     (const gchar *fil
 
 GdkPixbuf       *photos_pixbuf_new_from_file_at_size_finish    (GAsyncResult *res, GError **error);
 
+void             photos_pixbuf_new_from_file_region_async      (const gchar *filename,
+                                                                GQuark orientation,
+                                                                const GeglRectangle *region,
+                                                                GCancellable *cancellable,
+                                                                GAsyncReadyCallback callback,
+                                                                gpointer user_data);
+
+GdkPixbuf       *photos_pixbuf_new_from_file_region_finish     (GAsyncResult *res, GError **error);
+
 G_END_DECLS
 
 #endif /* PHOTOS_PIXBUF_H */
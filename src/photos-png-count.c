@@ -46,3 +46,21 @@ photos_png_init_count (png_structp png_ptr, gsize *out_count)
   if (out_count != NULL)
     *out_count = 0;
 }
+
+
+static void
+photos_png_data_write_data (png_structp png_ptr, png_bytep data, png_size_t length)
+{
+  GByteArray *array;
+
+  array = (GByteArray *) png_get_io_ptr (png_ptr);
+  g_byte_array_append (array, data, (guint) length);
+}
+
+
+void
+photos_png_init_data (png_structp png_ptr, GByteArray *data)
+{
+  g_return_if_fail (data != NULL);
+  png_set_write_fn (png_ptr, data, photos_png_data_write_data, photos_png_count_flush_data);
+}
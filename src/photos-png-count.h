@@ -26,6 +26,8 @@ G_BEGIN_DECLS
 
 void                photos_png_init_count          (png_structp png_ptr, gsize *out_count);
 
+void                photos_png_init_data           (png_structp png_ptr, GByteArray *data);
+
 G_END_DECLS
 
 #endif /* PHOTOS_PNG_COUNT_H */
@@ -0,0 +1,269 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <png.h>
+
+#include "photos-debug.h"
+#include "photos-png-load.h"
+
+
+typedef struct _PhotosPngLoadError PhotosPngLoadError;
+
+struct _PhotosPngLoadError
+{
+  gchar message[256];
+};
+
+static const guint32 CANCELLATION_CHECK_ROWS = 64;
+
+
+static void
+photos_png_load_error (png_structp png_ptr, png_const_charp message)
+{
+  PhotosPngLoadError *err;
+
+  err = (PhotosPngLoadError *) png_get_error_ptr (png_ptr);
+  g_strlcpy (err->message, message, sizeof (err->message));
+  png_longjmp (png_ptr, 1);
+}
+
+
+static void
+photos_png_load_warning (png_structp png_ptr, png_const_charp message)
+{
+}
+
+
+static GdkPixbuf *
+photos_png_load_decode_region (FILE *file,
+                               gint x,
+                               gint y,
+                               gint width,
+                               gint height,
+                               GCancellable *cancellable,
+                               GError **error)
+{
+  GdkPixbuf *volatile pixbuf = NULL;
+  GdkPixbuf *volatile ret_val = NULL;
+  PhotosPngLoadError err = { { '\0' } };
+  guchar *volatile scanline = NULL;
+  png_infop info_ptr = NULL;
+  png_structp png_ptr = NULL;
+  guchar *pixels;
+  gsize row_bytes;
+  gint channels;
+  gint image_height;
+  gint image_width;
+  gint rowstride;
+  gint x1;
+  gint x2;
+  gint y1;
+  gint y2;
+  guint32 i;
+
+  png_ptr = png_create_read_struct (PNG_LIBPNG_VER_STRING, &err, photos_png_load_error, photos_png_load_warning);
+  if (png_ptr == NULL)
+    {
+      g_set_error_literal (error,
+                           GDK_PIXBUF_ERROR,
+                           GDK_PIXBUF_ERROR_INSUFFICIENT_MEMORY,
+                           "Insufficient memory to load image");
+      return NULL;
+    }
+
+  info_ptr = png_create_info_struct (png_ptr);
+  if (info_ptr == NULL)
+    {
+      png_destroy_read_struct (&png_ptr, NULL, NULL);
+      g_set_error_literal (error,
+                           GDK_PIXBUF_ERROR,
+                           GDK_PIXBUF_ERROR_INSUFFICIENT_MEMORY,
+                           "Insufficient memory to load image");
+      return NULL;
+    }
+
+  /* Only touch volatile and in-memory state here, because locals may
+   * have been clobbered by the longjmp.
+   */
+  if (setjmp (png_jmpbuf (png_ptr)))
+    {
+      g_set_error (error,
+                   GDK_PIXBUF_ERROR,
+                   GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                   "Error interpreting PNG image file (%s)",
+                   err.message);
+
+      png_destroy_read_struct (&png_ptr, &info_ptr, NULL);
+      g_free (scanline);
+      if (pixbuf != NULL)
+        g_object_unref (pixbuf);
+
+      return NULL;
+    }
+
+  png_init_io (png_ptr, file);
+  png_read_info (png_ptr, info_ptr);
+
+  /* Every row of an interlaced image is spread across all the passes,
+   * so there is no way to stop early.
+   */
+  if (png_get_interlace_type (png_ptr, info_ptr) != PNG_INTERLACE_NONE)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Interlaced PNG files are not supported");
+      goto out;
+    }
+
+  png_set_expand (png_ptr);
+  png_set_strip_16 (png_ptr);
+  png_set_gray_to_rgb (png_ptr);
+  png_read_update_info (png_ptr, info_ptr);
+
+  channels = png_get_channels (png_ptr, info_ptr);
+  if (channels != 3 && channels != 4)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unsupported PNG color type");
+      goto out;
+    }
+
+  image_height = (gint) png_get_image_height (png_ptr, info_ptr);
+  image_width = (gint) png_get_image_width (png_ptr, info_ptr);
+
+  x1 = CLAMP (x, 0, image_width);
+  x2 = CLAMP (x + width, 0, image_width);
+  y1 = CLAMP (y, 0, image_height);
+  y2 = CLAMP (y + height, 0, image_height);
+  if (x1 >= x2 || y1 >= y2)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Region lies outside the image");
+      goto out;
+    }
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER,
+                "Decoding PNG region %d, %d, %d×%d from %d×%d",
+                x1,
+                y1,
+                x2 - x1,
+                y2 - y1,
+                image_width,
+                image_height);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, channels == 4, 8, x2 - x1, y2 - y1);
+  if (pixbuf == NULL)
+    {
+      g_set_error_literal (error,
+                           GDK_PIXBUF_ERROR,
+                           GDK_PIXBUF_ERROR_INSUFFICIENT_MEMORY,
+                           "Insufficient memory to load image");
+      goto out;
+    }
+
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  row_bytes = png_get_rowbytes (png_ptr, info_ptr);
+  scanline = g_malloc (row_bytes);
+
+  /* Rows above the region have to be decoded, because each row is
+   * filtered against the previous one, but only one row is kept at a
+   * time. Rows below the region are never read.
+   */
+  for (i = 0; i < (guint32) y2; i++)
+    {
+      if (i % CANCELLATION_CHECK_ROWS == 0 && g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      png_read_row (png_ptr, scanline, NULL);
+
+      if (i >= (guint32) y1)
+        {
+          guchar *row = pixels + (gsize) (i - (guint32) y1) * (gsize) rowstride;
+
+          memcpy (row, scanline + (gsize) x1 * (gsize) channels, (gsize) (x2 - x1) * (gsize) channels);
+        }
+    }
+
+  ret_val = g_object_ref (pixbuf);
+
+ out:
+  png_destroy_read_struct (&png_ptr, &info_ptr, NULL);
+  g_free (scanline);
+  if (pixbuf != NULL)
+    g_object_unref (pixbuf);
+  return ret_val;
+}
+
+
+GdkPixbuf *
+photos_png_load_region (const gchar *filename,
+                        gint x,
+                        gint y,
+                        gint width,
+                        gint height,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+  FILE *file = NULL;
+  GdkPixbuf *ret_val = NULL;
+  png_byte signature[8];
+
+  g_return_val_if_fail (filename != NULL && filename[0] != '\0', NULL);
+  g_return_val_if_fail (width > 0, NULL);
+  g_return_val_if_fail (height > 0, NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  file = g_fopen (filename, "rb");
+  if (file == NULL)
+    {
+      gint errsv = errno;
+      g_autofree gchar *display_name = NULL;
+
+      display_name = g_filename_display_name (filename);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to open file “%s”: %s",
+                   display_name,
+                   g_strerror (errsv));
+      goto out;
+    }
+
+  if (fread (signature, 1, sizeof (signature), file) != sizeof (signature)
+      || png_sig_cmp (signature, 0, sizeof (signature)) != 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Not a PNG file");
+      goto out;
+    }
+
+  rewind (file);
+
+  ret_val = photos_png_load_decode_region (file, x, y, width, height, cancellable, error);
+
+ out:
+  if (file != NULL)
+    fclose (file);
+  return ret_val;
+}
@@ -0,0 +1,231 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <setjmp.h>
+
+#include "photos-debug.h"
+#include "photos-png-save.h"
+
+
+typedef struct _PhotosPngSaveData PhotosPngSaveData;
+
+struct _PhotosPngSaveData
+{
+  GCancellable *cancellable;
+  GError *error;
+  GOutputStream *stream;
+  gchar message[256];
+};
+
+static const gint STRIP_HEIGHT = 16;
+
+
+static void
+photos_png_save_error (png_structp png_ptr, png_const_charp message)
+{
+  PhotosPngSaveData *data;
+
+  data = (PhotosPngSaveData *) png_get_error_ptr (png_ptr);
+  g_strlcpy (data->message, message, sizeof (data->message));
+  png_longjmp (png_ptr, 1);
+}
+
+
+static void
+photos_png_save_warning (png_structp png_ptr, png_const_charp message)
+{
+}
+
+
+static void
+photos_png_save_write (png_structp png_ptr, png_bytep bytes, png_size_t length)
+{
+  PhotosPngSaveData *data;
+
+  data = (PhotosPngSaveData *) png_get_io_ptr (png_ptr);
+  if (!g_output_stream_write_all (data->stream, bytes, length, NULL, data->cancellable, &data->error))
+    png_error (png_ptr, "Failed to write");
+}
+
+
+static void
+photos_png_save_flush (png_structp png_ptr)
+{
+}
+
+
+gboolean
+photos_png_save_buffer_to_stream (GeglBuffer *buffer,
+                                  GOutputStream *stream,
+                                  gint compression,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+  GeglRectangle bbox;
+  PhotosPngSaveData data = { NULL, NULL, NULL, { '\0' } };
+  const Babl *format;
+  guchar *volatile strip = NULL;
+  png_infop info_ptr = NULL;
+  png_structp png_ptr = NULL;
+  gint png_color_type;
+  gint64 end;
+  gint64 start;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  bbox = *gegl_buffer_get_extent (buffer);
+  g_return_val_if_fail (bbox.height > 0 && bbox.width > 0, FALSE);
+
+  data.cancellable = cancellable;
+  data.stream = stream;
+
+  png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, &data, photos_png_save_error, photos_png_save_warning);
+  if (png_ptr == NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Insufficient memory to save image");
+      return FALSE;
+    }
+
+  info_ptr = png_create_info_struct (png_ptr);
+  if (info_ptr == NULL)
+    {
+      png_destroy_write_struct (&png_ptr, NULL);
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Insufficient memory to save image");
+      return FALSE;
+    }
+
+  /* Only touch in-memory state here, because locals may have been
+   * clobbered by the longjmp.
+   */
+  if (setjmp (png_jmpbuf (png_ptr)))
+    {
+      if (data.error != NULL)
+        g_propagate_error (error, data.error);
+      else
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Error writing PNG image (%s)", data.message);
+
+      g_free (strip);
+      png_destroy_write_struct (&png_ptr, &info_ptr);
+      return FALSE;
+    }
+
+  png_set_write_fn (png_ptr, &data, photos_png_save_write, photos_png_save_flush);
+
+  if (babl_format_has_alpha (gegl_buffer_get_format (buffer)))
+    {
+      format = babl_format ("R'G'B'A u8");
+      png_color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+    }
+  else
+    {
+      format = babl_format ("R'G'B' u8");
+      png_color_type = PNG_COLOR_TYPE_RGB;
+    }
+
+  if (compression >= 0)
+    png_set_compression_level (png_ptr, compression);
+
+  png_set_IHDR (png_ptr,
+                info_ptr,
+                (png_uint_32) bbox.width,
+                (png_uint_32) bbox.height,
+                8,
+                png_color_type,
+                PNG_INTERLACE_NONE,
+                PNG_COMPRESSION_TYPE_BASE,
+                PNG_FILTER_TYPE_DEFAULT);
+
+  start = g_get_monotonic_time ();
+
+  strip = g_malloc (photos_png_get_strip_size (format, bbox.width));
+
+  png_write_info (png_ptr, info_ptr);
+  photos_png_write_buffer (png_ptr, buffer, format, 1.0, bbox.x, bbox.y, bbox.width, bbox.height, strip);
+  png_write_end (png_ptr, info_ptr);
+
+  end = g_get_monotonic_time ();
+  photos_debug (PHOTOS_DEBUG_GEGL, "PNG: Save Buffer to Stream: %" G_GINT64_FORMAT, end - start);
+
+  g_free (strip);
+  png_destroy_write_struct (&png_ptr, &info_ptr);
+  return TRUE;
+}
+
+
+gsize
+photos_png_get_strip_size (const Babl *format, gint width)
+{
+  gint bpp;
+  gsize ret_val;
+
+  g_return_val_if_fail (format != NULL, 0);
+  g_return_val_if_fail (width > 0, 0);
+
+  bpp = babl_format_get_bytes_per_pixel (format);
+  ret_val = (gsize) width * (gsize) bpp * (gsize) STRIP_HEIGHT;
+  return ret_val;
+}
+
+
+void
+photos_png_write_buffer (png_structp png_ptr,
+                         GeglBuffer *buffer,
+                         const Babl *format,
+                         gdouble zoom,
+                         gint src_x,
+                         gint src_y,
+                         gint width,
+                         gint height,
+                         guchar *strip)
+{
+  gint bpp;
+  gint y;
+  gsize stride;
+
+  g_return_if_fail (png_ptr != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (format != NULL);
+  g_return_if_fail (strip != NULL);
+
+  /* The strip is owned by the caller, so that it can be freed from the
+   * same scope as the setjmp that catches libpng's errors.
+   */
+
+  bpp = babl_format_get_bytes_per_pixel (format);
+  stride = (gsize) width * (gsize) bpp;
+
+  for (y = 0; y < height; y += STRIP_HEIGHT)
+    {
+      GeglRectangle rect;
+      gint i;
+      gint n_rows;
+
+      n_rows = MIN (STRIP_HEIGHT, height - y);
+      gegl_rectangle_set (&rect, src_x, src_y + y, (guint) width, (guint) n_rows);
+      gegl_buffer_get (buffer, &rect, zoom, format, strip, (gint) stride, GEGL_ABYSS_NONE);
+
+      for (i = 0; i < n_rows; i++)
+        png_write_row (png_ptr, strip + (gsize) i * stride);
+    }
+}
@@ -0,0 +1,49 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_PNG_SAVE_H
+#define PHOTOS_PNG_SAVE_H
+
+#include <babl/babl.h>
+#include <gegl.h>
+#include <gio/gio.h>
+#include <png.h>
+
+G_BEGIN_DECLS
+
+gboolean            photos_png_save_buffer_to_stream     (GeglBuffer *buffer,
+                                                          GOutputStream *stream,
+                                                          gint compression,
+                                                          GCancellable *cancellable,
+                                                          GError **error);
+
+gsize               photos_png_get_strip_size            (const Babl *format, gint width);
+
+void                photos_png_write_buffer              (png_structp png_ptr,
+                                                          GeglBuffer *buffer,
+                                                          const Babl *format,
+                                                          gdouble zoom,
+                                                          gint src_x,
+                                                          gint src_y,
+                                                          gint width,
+                                                          gint height,
+                                                          guchar *strip);
+
+G_END_DECLS
+
+#endif /* PHOTOS_PNG_SAVE_H */
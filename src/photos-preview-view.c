@@ -52,6 +52,7 @@ struct _PhotosPreviewView
   GAction *zoom_in_action;
   GAction *zoom_out_action;
   GCancellable *cancellable;
+  GCancellable *proxy_cancellable;
   GeglNode *node;
   GtkWidget *overlay;
   GtkWidget *palette;
@@ -536,6 +537,72 @@ photos_preview_view_process (GObject *source_object, GAsyncResult *res, gpointer
 }
 
 
+static void
+photos_preview_view_process_proxy (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  PhotosPreviewView *self;
+  PhotosBaseItem *item = PHOTOS_BASE_ITEM (source_object);
+  g_autoptr (GeglBuffer) proxy = NULL;
+  GtkWidget *view;
+  GtkWidget *view_container;
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    proxy = photos_base_item_create_proxy_finish (item, res, &error);
+    if (error != NULL)
+      {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+          g_warning ("Unable to create proxy: %s", error->message);
+
+        goto out;
+      }
+  }
+
+  self = PHOTOS_PREVIEW_VIEW (user_data);
+
+  view_container = gtk_stack_get_visible_child (GTK_STACK (self->stack));
+  view = photos_preview_view_get_view_from_view_container (view_container);
+  photos_image_view_set_proxy (PHOTOS_IMAGE_VIEW (view), proxy);
+
+ out:
+  return;
+}
+
+
+/* Processing the edited image at full resolution can take a while,
+ * so a proxy sized for the current zoom is rendered alongside and
+ * shown by the view until the full resolution result is ready.
+ */
+static void
+photos_preview_view_request_proxy (PhotosPreviewView *self, PhotosBaseItem *item)
+{
+  GtkWidget *view;
+  GtkWidget *view_container;
+  gdouble zoom;
+  gint scale_factor;
+
+  if (self->proxy_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->proxy_cancellable);
+      g_object_unref (self->proxy_cancellable);
+    }
+
+  self->proxy_cancellable = g_cancellable_new ();
+
+  view_container = gtk_stack_get_visible_child (GTK_STACK (self->stack));
+  view = photos_preview_view_get_view_from_view_container (view_container);
+  scale_factor = gtk_widget_get_scale_factor (view);
+  zoom = photos_image_view_get_zoom (PHOTOS_IMAGE_VIEW (view)) * (gdouble) scale_factor;
+
+  photos_base_item_create_proxy_async (item,
+                                       zoom,
+                                       self->proxy_cancellable,
+                                       photos_preview_view_process_proxy,
+                                       self);
+}
+
+
 static void
 photos_preview_view_blacks_exposure (PhotosPreviewView *self, GVariant *parameter)
 {
@@ -570,6 +637,8 @@ photos_preview_view_blacks_exposure (PhotosPreviewView *self, GVariant *paramete
                                         "black-level", blacks,
                                         "exposure", exposure,
                                         NULL);
+
+  photos_preview_view_request_proxy (self, item);
 }
 
 
@@ -591,6 +660,8 @@ photos_preview_view_contrast (PhotosPreviewView *self, GVariant *parameter)
                                         "gegl:brightness-contrast",
                                         "contrast", contrast,
                                         NULL);
+
+  photos_preview_view_request_proxy (self, item);
 }
 
 
@@ -628,6 +699,8 @@ photos_preview_view_shadows_highlights (PhotosPreviewView *self, GVariant *param
                                         "shadows", shadows,
                                         "highlights", highlights,
                                         NULL);
+
+  photos_preview_view_request_proxy (self, item);
 }
 
 
@@ -696,6 +769,8 @@ photos_preview_view_denoise (PhotosPreviewView *self, GVariant *parameter)
                                         "gegl:noise-reduction",
                                         "iterations", (gint) iterations,
                                         NULL);
+
+  photos_preview_view_request_proxy (self, item);
 }
 
 
@@ -738,6 +813,8 @@ photos_preview_view_saturation (PhotosPreviewView *self, GVariant *parameter)
                                         "photos:saturation",
                                         "scale", scale,
                                         NULL);
+
+  photos_preview_view_request_proxy (self, item);
 }
 
 
@@ -759,6 +836,8 @@ photos_preview_view_sharpen (PhotosPreviewView *self, GVariant *parameter)
                                         "gegl:unsharp-mask",
                                         "scale", scale,
                                         NULL);
+
+  photos_preview_view_request_proxy (self, item);
 }
 
 
@@ -1162,6 +1241,12 @@ photos_preview_view_dispose (GObject *object)
       g_clear_object (&self->cancellable);
     }
 
+  if (self->proxy_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->proxy_cancellable);
+      g_clear_object (&self->proxy_cancellable);
+    }
+
   g_clear_object (&self->node);
   g_clear_object (&self->item_mngr);
   g_clear_object (&self->gesture_zoom);
@@ -30,6 +30,8 @@
 #include "photos-application.h"
 #include "photos-base-manager.h"
 #include "photos-query-builder.h"
+#include "photos-query-seek.h"
+#include "photos-search-controller.h"
 #include "photos-search-type.h"
 #include "photos-source-manager.h"
 #include "photos-search-match-manager.h"
@@ -44,12 +46,53 @@ static const gchar *COLLECTIONS_FILTER
     " || (?urn = nfo:image-category-screenshot))";
 
 
+static void
+photos_query_builder_bind_terms (PhotosSearchContextState *state, gint flags, GVariantDict *bindings)
+{
+  g_auto (GStrv) terms = NULL;
+  guint i;
+
+  if ((flags & PHOTOS_QUERY_FLAGS_UNFILTERED) != 0 || (flags & PHOTOS_QUERY_FLAGS_SEARCH) == 0)
+    return;
+
+  /* Keep this in sync with photos_search_match_manager_get_filter */
+  terms = photos_search_controller_get_terms (PHOTOS_SEARCH_CONTROLLER (state->srch_cntrlr));
+  for (i = 0; terms[i] != NULL; i++)
+    {
+      g_autofree gchar *parameter = NULL;
+
+      parameter = g_strdup_printf (PHOTOS_QUERY_TERM_PARAMETER_FORMAT, i);
+      g_variant_dict_insert (bindings, parameter, "s", terms[i]);
+    }
+}
+
+
 static gchar *
+photos_query_builder_seek_filter (PhotosOffsetController *offset_cntrlr, GVariantDict *bindings)
+{
+  const gchar *ctime;
+  const gchar *mtime;
+  const gchar *urn;
+  gchar *ret_val = NULL;
+
+  if (!photos_offset_controller_get_key (offset_cntrlr, &ctime, &mtime, &urn))
+    goto out;
+
+  ret_val = photos_query_seek_get_filter (ctime, mtime, urn, bindings);
+
+ out:
+  return ret_val;
+}
+
+
+static PhotosQuery *
 photos_query_builder_query (PhotosSearchContextState *state,
+                            PhotosSearchContextState *query_state,
                             const gchar *values,
                             gint flags,
                             PhotosOffsetController *offset_cntrlr)
 {
+  GVariantDict bindings;
   GApplication *app;
   PhotosSparqlTemplate *sparql_template;
   const gchar *miner_files_name;
@@ -141,11 +184,15 @@ photos_query_builder_query (PhotosSearchContextState *state,
       "?flash "
       "?location ";
 
+  PhotosQuery *query;
+  const gchar *offset_limit = NULL;
   g_autofree gchar *item_mngr_where = NULL;
-  g_autofree gchar *offset_limit = NULL;
+  g_autofree gchar *seek_filter = NULL;
   g_autofree gchar *src_mngr_filter = NULL;
   g_autofree gchar *srch_mtch_mngr_filter = NULL;
-  gchar *sparql;
+  g_autofree gchar *sparql = NULL;
+
+  g_variant_dict_init (&bindings, NULL);
 
   app = g_application_get_default ();
   miner_files_name = photos_application_get_miner_files_name (PHOTOS_APPLICATION (app));
@@ -167,25 +214,30 @@ photos_query_builder_query (PhotosSearchContextState *state,
 
   if (values == NULL && (flags & PHOTOS_QUERY_FLAGS_UNLIMITED) == 0)
     {
-      gint offset = 0;
       gint step = 60;
 
       if (offset_cntrlr != NULL)
         {
-          offset = photos_offset_controller_get_offset (offset_cntrlr);
+          seek_filter = photos_query_builder_seek_filter (offset_cntrlr, &bindings);
           step = photos_offset_controller_get_step (offset_cntrlr);
         }
 
-      offset_limit = g_strdup_printf ("LIMIT %d OFFSET %d", step, offset);
+      /* Bind it as a parameter, so that the SPARQL remains the same
+       * from one page to the next.
+       */
+      offset_limit = "LIMIT ~" PHOTOS_QUERY_LIMIT_PARAMETER;
+      g_variant_dict_insert (&bindings, PHOTOS_QUERY_LIMIT_PARAMETER, "x", (gint64) step);
     }
 
+  photos_query_builder_bind_terms (state, flags, &bindings);
+
   sparql
     = photos_sparql_template_get_sparql (sparql_template,
                                          "blocked_mime_types_filter", BLOCKED_MIME_TYPES_FILTER,
                                          "collections_filter", COLLECTIONS_FILTER,
                                          "item_where", item_mngr_where == NULL ? "" : item_mngr_where,
                                          "miner_files_name", miner_files_name,
-                                         "order", "ORDER BY DESC (?ctime) DESC (?mtime)",
+                                         "order", PHOTOS_QUERY_SEEK_ORDER,
                                          "offset_limit", offset_limit ? offset_limit : "",
                                          "projection", projection,
                                          "projection_dbus", projection_database,
@@ -194,11 +246,15 @@ photos_query_builder_query (PhotosSearchContextState *state,
                                          "search_match_filter", srch_mtch_mngr_filter == NULL
                                                                 ? "(true)"
                                                                 : srch_mtch_mngr_filter,
+                                         "seek_filter", seek_filter == NULL ? "" : seek_filter,
                                          "source_filter", src_mngr_filter == NULL ? "(true)" : src_mngr_filter,
                                          "values", values == NULL ? "" : values,
                                          NULL);
 
-  return sparql;
+  query = photos_query_new (query_state, sparql);
+  photos_query_set_bindings (query, g_variant_dict_end (&bindings));
+
+  return query;
 }
 
 
@@ -270,6 +326,7 @@ PhotosQuery *
 photos_query_builder_count_query (PhotosSearchContextState *state, gint flags)
 {
   GApplication *app;
+  GVariantDict bindings;
   PhotosQuery *query;
   PhotosSparqlTemplate *sparql_template;
   const gchar *miner_files_name;
@@ -305,11 +362,16 @@ photos_query_builder_count_query (PhotosSearchContextState *state, gint flags)
                                          "search_match_filter", srch_mtch_mngr_filter == NULL
                                                                 ? "(true)"
                                                                 : srch_mtch_mngr_filter,
+                                         "seek_filter", "",
                                          "source_filter", src_mngr_filter == NULL ? "(true)" : src_mngr_filter,
                                          "values", "",
                                          NULL);
 
+  g_variant_dict_init (&bindings, NULL);
+  photos_query_builder_bind_terms (state, flags, &bindings);
+
   query = photos_query_new (state, sparql);
+  photos_query_set_bindings (query, g_variant_dict_end (&bindings));
 
   return query;
 }
@@ -402,16 +464,14 @@ PhotosQuery *
 photos_query_builder_fetch_collections_local (PhotosSearchContextState *state)
 {
   PhotosQuery *query;
-  g_autofree gchar *sparql = NULL;
-
-  sparql = photos_query_builder_query (state,
-                                       NULL,
-                                       PHOTOS_QUERY_FLAGS_COLLECTIONS
-                                       | PHOTOS_QUERY_FLAGS_LOCAL
-                                       | PHOTOS_QUERY_FLAGS_UNLIMITED,
-                                       NULL);
 
-  query = photos_query_new (NULL, sparql);
+  query = photos_query_builder_query (state,
+                                      NULL,
+                                      NULL,
+                                      PHOTOS_QUERY_FLAGS_COLLECTIONS
+                                      | PHOTOS_QUERY_FLAGS_LOCAL
+                                      | PHOTOS_QUERY_FLAGS_UNLIMITED,
+                                      NULL);
 
   return query;
 }
@@ -423,11 +483,8 @@ photos_query_builder_global_query (PhotosSearchContextState *state,
                                    PhotosOffsetController *offset_cntrlr)
 {
   PhotosQuery *query;
-  g_autofree gchar *sparql = NULL;
-
-  sparql = photos_query_builder_query (state, NULL, flags, offset_cntrlr);
-  query = photos_query_new (state, sparql);
 
+  query = photos_query_builder_query (state, state, NULL, flags, offset_cntrlr);
   return query;
 }
 
@@ -495,12 +552,10 @@ PhotosQuery *
 photos_query_builder_single_query (PhotosSearchContextState *state, gint flags, const gchar *resource)
 {
   PhotosQuery *query;
-  g_autofree gchar *sparql = NULL;
   g_autofree gchar *values = NULL;
 
   values = g_strdup_printf ("VALUES ?urn { <%s> }", resource);
-  sparql = photos_query_builder_query (state, values, flags, NULL);
-  query = photos_query_new (state, sparql);
+  query = photos_query_builder_query (state, state, values, flags, NULL);
   return query;
 }
 
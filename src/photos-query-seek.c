@@ -0,0 +1,84 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Pages are fetched by seeking past the (ctime, mtime, urn) of the
+ * last row that was loaded, in the order given by
+ * PHOTOS_QUERY_SEEK_ORDER. Since the ORDER BY is descending, unbound
+ * values sort after all the bound ones, and the urn makes the order
+ * total.
+ *
+ * The filter only refers to ?ctime, ?mtime and ?urn, so that it can be
+ * placed in every branch of a UNION, and inside a SERVICE, right after
+ * the sub-SELECT that projects them. That way the rows before the key
+ * are discarded where they are found, instead of being sent to the
+ * outermost SELECT first.
+ */
+
+
+#include "config.h"
+
+#include "photos-query-seek.h"
+
+
+gchar *
+photos_query_seek_get_filter (const gchar *ctime, const gchar *mtime, const gchar *urn, GVariantDict *bindings)
+{
+  const gchar *ctime_after;
+  const gchar *ctime_equal;
+  const gchar *mtime_after;
+  const gchar *mtime_equal;
+  gchar *ret_val;
+
+  g_return_val_if_fail (urn != NULL && urn[0] != '\0', NULL);
+  g_return_val_if_fail (bindings != NULL, NULL);
+
+  if (ctime == NULL)
+    {
+      ctime_after = "false";
+      ctime_equal = "!BOUND (?ctime)";
+    }
+  else
+    {
+      ctime_after = "(!BOUND (?ctime) || ?ctime < ~" PHOTOS_QUERY_SEEK_CTIME_PARAMETER ")";
+      ctime_equal = "?ctime = ~" PHOTOS_QUERY_SEEK_CTIME_PARAMETER;
+      g_variant_dict_insert (bindings, PHOTOS_QUERY_SEEK_CTIME_PARAMETER, "(s)", ctime);
+    }
+
+  if (mtime == NULL)
+    {
+      mtime_after = "false";
+      mtime_equal = "!BOUND (?mtime)";
+    }
+  else
+    {
+      mtime_after = "(!BOUND (?mtime) || ?mtime < ~" PHOTOS_QUERY_SEEK_MTIME_PARAMETER ")";
+      mtime_equal = "?mtime = ~" PHOTOS_QUERY_SEEK_MTIME_PARAMETER;
+      g_variant_dict_insert (bindings, PHOTOS_QUERY_SEEK_MTIME_PARAMETER, "(s)", mtime);
+    }
+
+  g_variant_dict_insert (bindings, PHOTOS_QUERY_SEEK_URN_PARAMETER, "s", urn);
+
+  ret_val = g_strdup_printf ("FILTER (%s || (%s && (%s || (%s && str (?urn) < ~"
+                             PHOTOS_QUERY_SEEK_URN_PARAMETER "))))",
+                             ctime_after,
+                             ctime_equal,
+                             mtime_after,
+                             mtime_equal);
+
+  return ret_val;
+}
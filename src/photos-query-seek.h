@@ -0,0 +1,39 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_QUERY_SEEK_H
+#define PHOTOS_QUERY_SEEK_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define PHOTOS_QUERY_SEEK_CTIME_PARAMETER "ctime"
+#define PHOTOS_QUERY_SEEK_MTIME_PARAMETER "mtime"
+#define PHOTOS_QUERY_SEEK_URN_PARAMETER "urn"
+
+#define PHOTOS_QUERY_SEEK_ORDER "ORDER BY DESC (?ctime) DESC (?mtime) DESC (str (?urn))"
+
+gchar        *photos_query_seek_get_filter         (const gchar *ctime,
+                                                    const gchar *mtime,
+                                                    const gchar *urn,
+                                                    GVariantDict *bindings);
+
+G_END_DECLS
+
+#endif /* PHOTOS_QUERY_SEEK_H */
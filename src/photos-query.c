@@ -31,6 +31,7 @@
 struct _PhotosQuery
 {
   GObject parent_instance;
+  GVariant *bindings;
   PhotosSearchContextState *state;
   PhotosSource *source;
   gchar *sparql;
@@ -83,6 +84,7 @@ photos_query_finalize (GObject *object)
 {
   PhotosQuery *self = PHOTOS_QUERY (object);
 
+  g_clear_pointer (&self->bindings, g_variant_unref);
   g_free (self->sparql);
   g_free (self->tag);
 
@@ -172,6 +174,14 @@ photos_query_new (PhotosSearchContextState *state, const gchar *sparql)
 }
 
 
+GVariant *
+photos_query_get_bindings (PhotosQuery *self)
+{
+  g_return_val_if_fail (PHOTOS_IS_QUERY (self), NULL);
+  return self->bindings;
+}
+
+
 const gchar *
 photos_query_get_sparql (PhotosQuery *self)
 {
@@ -196,6 +206,26 @@ photos_query_get_tag (PhotosQuery *self)
 }
 
 
+void
+photos_query_set_bindings (PhotosQuery *self, GVariant *bindings)
+{
+  g_return_if_fail (PHOTOS_IS_QUERY (self));
+  g_return_if_fail (bindings == NULL || g_variant_is_of_type (bindings, G_VARIANT_TYPE_VARDICT));
+
+  if (bindings != NULL)
+    {
+      g_variant_ref_sink (bindings);
+
+      /* A query without any parameters is sent as it is */
+      if (g_variant_n_children (bindings) == 0)
+        g_clear_pointer (&bindings, g_variant_unref);
+    }
+
+  g_clear_pointer (&self->bindings, g_variant_unref);
+  self->bindings = bindings;
+}
+
+
 void
 photos_query_set_tag (PhotosQuery *self, const gchar *tag)
 {
@@ -33,6 +33,9 @@ G_BEGIN_DECLS
 #define PHOTOS_QUERY_COLLECTIONS_IDENTIFIER "photos:collection:"
 #define PHOTOS_QUERY_LOCAL_COLLECTIONS_IDENTIFIER "photos:collection:local:"
 
+#define PHOTOS_QUERY_LIMIT_PARAMETER "limit"
+#define PHOTOS_QUERY_TERM_PARAMETER_FORMAT "term%u"
+
 #define PHOTOS_TYPE_QUERY (photos_query_get_type ())
 G_DECLARE_FINAL_TYPE (PhotosQuery, photos_query, PHOTOS, QUERY, GObject);
 
@@ -78,12 +81,16 @@ typedef enum
 
 PhotosQuery     *photos_query_new           (PhotosSearchContextState *state, const gchar *sparql);
 
+GVariant        *photos_query_get_bindings  (PhotosQuery *self);
+
 const gchar     *photos_query_get_sparql    (PhotosQuery *self);
 
 PhotosSource    *photos_query_get_source    (PhotosQuery *self);
 
 const gchar     *photos_query_get_tag       (PhotosQuery *self);
 
+void             photos_query_set_bindings  (PhotosQuery *self, GVariant *bindings);
+
 void             photos_query_set_tag       (PhotosQuery *self, const gchar *tag);
 
 G_END_DECLS
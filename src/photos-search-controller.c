@@ -24,7 +24,6 @@
 #include "config.h"
 
 #include <glib.h>
-#include <tracker-sparql.h>
 
 #include "photos-search-controller.h"
 
@@ -102,12 +101,13 @@ photos_search_controller_get_string (PhotosSearchController *self)
 gchar **
 photos_search_controller_get_terms (PhotosSearchController *self)
 {
-  g_autofree gchar *escaped_str = NULL;
   g_autofree gchar *str = NULL;
   gchar **terms;
 
-  escaped_str = tracker_sparql_escape_string (self->str);
-  str = g_utf8_casefold (escaped_str, -1);
+  /* The terms are bound as parameters of a TrackerSparqlStatement,
+   * so they are not escaped.
+   */
+  str = g_utf8_casefold (self->str, -1);
   /* TODO: find out what str.replace(/ + /g, ' ') does */
   terms = g_strsplit (str, " ", -1);
   return terms;
@@ -71,20 +71,26 @@ photos_search_match_manager_get_filter (PhotosBaseManager *mngr, gint flags)
 
   filters = (gchar **) g_malloc0_n (n_terms + 1, sizeof (gchar *));
 
+  /* Refer to the terms by the names of their parameters, so that the
+   * SPARQL doesn't change as the user types.
+   */
   for (i = 0; terms[i] != NULL; i++)
     {
       PhotosSearchMatch *active_search_match;
       const gchar *id;
+      g_autofree gchar *parameter = NULL;
       guint j;
       guint n_items;
 
+      parameter = g_strdup_printf ("~" PHOTOS_QUERY_TERM_PARAMETER_FORMAT, i);
+
       n_items = g_list_model_get_n_items (G_LIST_MODEL (self));
       for (j = 0; j < n_items; j++)
         {
           g_autoptr (PhotosSearchMatch) search_match = NULL;
 
           search_match = PHOTOS_SEARCH_MATCH (g_list_model_get_object (G_LIST_MODEL (self), j));
-          photos_search_match_set_filter_term (search_match, terms[i]);
+          photos_search_match_set_filter_term (search_match, parameter);
         }
 
       active_search_match = PHOTOS_SEARCH_MATCH (photos_base_manager_get_active_object (PHOTOS_BASE_MANAGER (self)));
@@ -153,7 +159,7 @@ photos_search_match_manager_init (PhotosSearchMatchManager *self)
       PHOTOS_SEARCH_MATCH_STOCK_TITLE,
       /* Translators: "Title" refers to "Match Title" when searching. */
       NC_("Search Filter", "Title"),
-      "fn:contains (tracker:case-fold (tracker:coalesce (nie:title (?urn), nfo:fileName(?file))), \"%s\")"
+      "fn:contains (tracker:case-fold (tracker:coalesce (nie:title (?urn), nfo:fileName(?file))), %s)"
     },
     {
       PHOTOS_SEARCH_MATCH_STOCK_AUTHOR,
@@ -161,7 +167,7 @@ photos_search_match_manager_init (PhotosSearchMatchManager *self)
       NC_("Search Filter", "Author"),
       "fn:contains ("
       "  tracker:case-fold (tracker:coalesce (nco:fullname (?creator), nco:fullname(?publisher))),"
-      "  \"%s\")"
+      "  %s)"
     }
   };
 
@@ -0,0 +1,731 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Vectorized kernels for the point operations, and the run-time
+ * detection needed to pick them.
+ *
+ * The x86 kernels are compiled with per-function target attributes,
+ * instead of per-file compiler flags, so that the rest of the code is
+ * still built for the baseline instruction set. They must only be
+ * called after photos_simd_get_support has confirmed that the CPU can
+ * run them.
+ *
+ * Interleaved pixels with 3 or 4 components don't line up with the
+ * vector lanes, so the per-component factors are repeated to fill a
+ * block that is a multiple of both 3 and 4 floats, and the buffer is
+ * processed one block at a time. Multiplying a component by a factor of
+ * 1 leaves it unchanged, so the output is identical to the scalar code.
+ *
+ * The curves are sampled at n_intervals + 1 evenly spaced points over
+ * [0, 1], one table after the other for the first three components, and
+ * are linearly interpolated. Any other component is copied as it is.
+ * Only AVX2 can gather the samples for several pixels at once, so there
+ * are no SSE2 or NEON variants.
+ *
+ * The SVG multiply blend works on premultiplied RGBA pixels, and each
+ * pixel's alpha is broadcast across its lanes. When the aux pixels are
+ * known to be opaque, the terms that vanish with an aux alpha of 1 are
+ * skipped. The arithmetic is done in the same order as the scalar code,
+ * so the output is identical to it.
+ *
+ * The scalar kernels are the reference that the vectorized ones are
+ * tested against, and are what the operations use when the getters
+ * return NULL.
+ */
+
+
+#include "config.h"
+
+#if defined (__GNUC__) && (defined (__i386__) || defined (__x86_64__))
+#define PHOTOS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "photos-debug.h"
+#include "photos-simd.h"
+
+
+enum
+{
+  BLOCK_SIZE_128 = 12,
+  BLOCK_SIZE_256 = 24
+};
+
+
+static void
+photos_simd_fill_block (gfloat *block, guint block_size, guint n_components, const gfloat *factors)
+{
+  guint i;
+
+  for (i = 0; i < block_size; i++)
+    block[i] = factors[i % n_components];
+}
+
+
+static gfloat
+photos_simd_apply_curve (gfloat input, const gfloat *curve, guint n_intervals)
+{
+  gfloat t;
+  gfloat x;
+  guint i;
+
+  /* Written to also map NaN to 0. */
+  x = input > 0.0f ? input : 0.0f;
+  x = x < 1.0f ? x : 1.0f;
+  x *= (gfloat) n_intervals;
+
+  i = MIN ((guint) x, n_intervals - 1);
+  t = x - (gfloat) i;
+
+  return curve[i] + (curve[i + 1] - curve[i]) * t;
+}
+
+
+static void
+photos_simd_multiply_pixel (const gfloat *in, const gfloat *aux, gfloat *out)
+{
+  const gfloat aA = aux[3];
+  const gfloat aB = in[3];
+  const gfloat aR = aA + aB * (1.0f - aA);
+  guint i;
+
+  for (i = 0; i < 3; i++)
+    {
+      gfloat xR;
+
+      xR = (1.0f - aB) * aux[i] + (1.0f - aA) * in[i] + aux[i] * in[i];
+      xR = xR > 0.0f ? xR : 0.0f;
+      out[i] = xR < aR ? xR : aR;
+    }
+
+  out[3] = aR;
+}
+
+
+static void
+photos_simd_multiply_opaque_pixel (const gfloat *in, const gfloat *aux, gfloat *out)
+{
+  const gfloat aB = in[3];
+  guint i;
+
+  /* With an opaque aux, aA is 1, and so is aR. */
+  for (i = 0; i < 3; i++)
+    {
+      gfloat xR;
+
+      xR = (1.0f - aB) * aux[i] + aux[i] * in[i];
+      xR = xR > 0.0f ? xR : 0.0f;
+      out[i] = xR < 1.0f ? xR : 1.0f;
+    }
+
+  out[3] = 1.0f;
+}
+
+
+#ifdef PHOTOS_SIMD_X86
+
+__attribute__ ((target ("avx2")))
+static inline __m256
+photos_simd_apply_curves_avx2_8 (__m256 v, __m256i offsets, __m256 mask, const gfloat *curves, guint n_intervals)
+{
+  __m256 t;
+  __m256 x;
+  __m256 y;
+  __m256 y0;
+  __m256 y1;
+  __m256i i;
+
+  x = _mm256_max_ps (v, _mm256_setzero_ps ());
+  x = _mm256_min_ps (x, _mm256_set1_ps (1.0f));
+  x = _mm256_mul_ps (x, _mm256_set1_ps ((gfloat) n_intervals));
+
+  i = _mm256_min_epi32 (_mm256_cvttps_epi32 (x), _mm256_set1_epi32 ((gint) n_intervals - 1));
+  t = _mm256_sub_ps (x, _mm256_cvtepi32_ps (i));
+
+  i = _mm256_add_epi32 (i, offsets);
+  y0 = _mm256_i32gather_ps (curves, i, 4);
+  y1 = _mm256_i32gather_ps (curves + 1, i, 4);
+  y = _mm256_add_ps (y0, _mm256_mul_ps (_mm256_sub_ps (y1, y0), t));
+
+  return _mm256_blendv_ps (v, y, mask);
+}
+
+
+__attribute__ ((target ("avx2")))
+static void
+photos_simd_apply_curves_avx2 (const gfloat *in,
+                               gfloat *out,
+                               glong n_pixels,
+                               guint n_components,
+                               const gfloat *curves,
+                               guint n_intervals)
+{
+  __m256 masks[3];
+  __m256i offsets[3];
+  gint block_masks[BLOCK_SIZE_256];
+  gint block_offsets[BLOCK_SIZE_256];
+  gsize i;
+  gsize j;
+  gsize n;
+
+  for (i = 0; i < BLOCK_SIZE_256; i++)
+    {
+      guint component = (guint) i % n_components;
+
+      block_masks[i] = component < 3 ? -1 : 0;
+      block_offsets[i] = component < 3 ? (gint) (component * (n_intervals + 1)) : 0;
+    }
+
+  for (i = 0; i < 3; i++)
+    {
+      masks[i] = _mm256_castsi256_ps (_mm256_loadu_si256 ((const __m256i *) (block_masks + 8 * i)));
+      offsets[i] = _mm256_loadu_si256 ((const __m256i *) (block_offsets + 8 * i));
+    }
+
+  n = (gsize) n_pixels * n_components;
+
+  for (i = 0; i + BLOCK_SIZE_256 <= n; i += BLOCK_SIZE_256)
+    {
+      __m256 v0 = _mm256_loadu_ps (in + i);
+      __m256 v1 = _mm256_loadu_ps (in + i + 8);
+      __m256 v2 = _mm256_loadu_ps (in + i + 16);
+
+      v0 = photos_simd_apply_curves_avx2_8 (v0, offsets[0], masks[0], curves, n_intervals);
+      v1 = photos_simd_apply_curves_avx2_8 (v1, offsets[1], masks[1], curves, n_intervals);
+      v2 = photos_simd_apply_curves_avx2_8 (v2, offsets[2], masks[2], curves, n_intervals);
+
+      _mm256_storeu_ps (out + i, v0);
+      _mm256_storeu_ps (out + i + 8, v1);
+      _mm256_storeu_ps (out + i + 16, v2);
+    }
+
+  _mm256_zeroupper ();
+
+  for (j = 0; i < n; i++, j++)
+    {
+      if (block_masks[j] == 0)
+        out[i] = in[i];
+      else
+        out[i] = photos_simd_apply_curve (in[i], curves + block_offsets[j], n_intervals);
+    }
+}
+
+
+__attribute__ ((target ("sse2")))
+static void
+photos_simd_multiply_sse2 (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  const __m128 alpha_mask = _mm_castsi128_ps (_mm_set_epi32 (-1, 0, 0, 0));
+  const __m128 one = _mm_set1_ps (1.0f);
+  const __m128 zero = _mm_setzero_ps ();
+  glong i;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      __m128 a = _mm_loadu_ps (aux);
+      __m128 b = _mm_loadu_ps (in);
+      __m128 aA = _mm_shuffle_ps (a, a, _MM_SHUFFLE (3, 3, 3, 3));
+      __m128 aB = _mm_shuffle_ps (b, b, _MM_SHUFFLE (3, 3, 3, 3));
+      __m128 aR;
+      __m128 xR;
+
+      aR = _mm_add_ps (aA, _mm_mul_ps (aB, _mm_sub_ps (one, aA)));
+      xR = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (one, aB), a), _mm_mul_ps (_mm_sub_ps (one, aA), b));
+      xR = _mm_add_ps (xR, _mm_mul_ps (a, b));
+      xR = _mm_min_ps (_mm_max_ps (xR, zero), aR);
+      xR = _mm_or_ps (_mm_andnot_ps (alpha_mask, xR), _mm_and_ps (alpha_mask, aR));
+      _mm_storeu_ps (out, xR);
+
+      aux += 4;
+      in += 4;
+      out += 4;
+    }
+}
+
+
+__attribute__ ((target ("sse2")))
+static void
+photos_simd_multiply_opaque_sse2 (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  const __m128 alpha_mask = _mm_castsi128_ps (_mm_set_epi32 (-1, 0, 0, 0));
+  const __m128 one = _mm_set1_ps (1.0f);
+  const __m128 zero = _mm_setzero_ps ();
+  glong i;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      __m128 a = _mm_loadu_ps (aux);
+      __m128 b = _mm_loadu_ps (in);
+      __m128 aB = _mm_shuffle_ps (b, b, _MM_SHUFFLE (3, 3, 3, 3));
+      __m128 xR;
+
+      xR = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (one, aB), a), _mm_mul_ps (a, b));
+      xR = _mm_min_ps (_mm_max_ps (xR, zero), one);
+      xR = _mm_or_ps (_mm_andnot_ps (alpha_mask, xR), _mm_and_ps (alpha_mask, one));
+      _mm_storeu_ps (out, xR);
+
+      aux += 4;
+      in += 4;
+      out += 4;
+    }
+}
+
+
+__attribute__ ((target ("avx2")))
+static void
+photos_simd_multiply_avx2 (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  const __m256 one = _mm256_set1_ps (1.0f);
+  const __m256 zero = _mm256_setzero_ps ();
+  glong i;
+
+  for (i = 0; i + 2 <= n_pixels; i += 2)
+    {
+      __m256 a = _mm256_loadu_ps (aux);
+      __m256 b = _mm256_loadu_ps (in);
+      __m256 aA = _mm256_permute_ps (a, _MM_SHUFFLE (3, 3, 3, 3));
+      __m256 aB = _mm256_permute_ps (b, _MM_SHUFFLE (3, 3, 3, 3));
+      __m256 aR;
+      __m256 xR;
+
+      aR = _mm256_add_ps (aA, _mm256_mul_ps (aB, _mm256_sub_ps (one, aA)));
+      xR = _mm256_add_ps (_mm256_mul_ps (_mm256_sub_ps (one, aB), a), _mm256_mul_ps (_mm256_sub_ps (one, aA), b));
+      xR = _mm256_add_ps (xR, _mm256_mul_ps (a, b));
+      xR = _mm256_min_ps (_mm256_max_ps (xR, zero), aR);
+      _mm256_storeu_ps (out, _mm256_blend_ps (xR, aR, 0x88));
+
+      aux += 8;
+      in += 8;
+      out += 8;
+    }
+
+  _mm256_zeroupper ();
+
+  if (i < n_pixels)
+    photos_simd_multiply_pixel (in, aux, out);
+}
+
+
+__attribute__ ((target ("avx2")))
+static void
+photos_simd_multiply_opaque_avx2 (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  const __m256 one = _mm256_set1_ps (1.0f);
+  const __m256 zero = _mm256_setzero_ps ();
+  glong i;
+
+  for (i = 0; i + 2 <= n_pixels; i += 2)
+    {
+      __m256 a = _mm256_loadu_ps (aux);
+      __m256 b = _mm256_loadu_ps (in);
+      __m256 aB = _mm256_permute_ps (b, _MM_SHUFFLE (3, 3, 3, 3));
+      __m256 xR;
+
+      xR = _mm256_add_ps (_mm256_mul_ps (_mm256_sub_ps (one, aB), a), _mm256_mul_ps (a, b));
+      xR = _mm256_min_ps (_mm256_max_ps (xR, zero), one);
+      _mm256_storeu_ps (out, _mm256_blend_ps (xR, one, 0x88));
+
+      aux += 8;
+      in += 8;
+      out += 8;
+    }
+
+  _mm256_zeroupper ();
+
+  if (i < n_pixels)
+    photos_simd_multiply_opaque_pixel (in, aux, out);
+}
+
+
+__attribute__ ((target ("sse2")))
+static void
+photos_simd_scale_channels_sse2 (const gfloat *in,
+                                 gfloat *out,
+                                 glong n_pixels,
+                                 guint n_components,
+                                 const gfloat *factors)
+{
+  __m128 f0;
+  __m128 f1;
+  __m128 f2;
+  gfloat block[BLOCK_SIZE_128];
+  gsize i;
+  gsize j;
+  gsize n;
+
+  photos_simd_fill_block (block, BLOCK_SIZE_128, n_components, factors);
+  f0 = _mm_loadu_ps (block);
+  f1 = _mm_loadu_ps (block + 4);
+  f2 = _mm_loadu_ps (block + 8);
+
+  n = (gsize) n_pixels * n_components;
+
+  for (i = 0; i + BLOCK_SIZE_128 <= n; i += BLOCK_SIZE_128)
+    {
+      __m128 v0 = _mm_loadu_ps (in + i);
+      __m128 v1 = _mm_loadu_ps (in + i + 4);
+      __m128 v2 = _mm_loadu_ps (in + i + 8);
+
+      _mm_storeu_ps (out + i, _mm_mul_ps (v0, f0));
+      _mm_storeu_ps (out + i + 4, _mm_mul_ps (v1, f1));
+      _mm_storeu_ps (out + i + 8, _mm_mul_ps (v2, f2));
+    }
+
+  for (j = 0; i < n; i++, j++)
+    out[i] = in[i] * block[j];
+}
+
+
+__attribute__ ((target ("avx2")))
+static void
+photos_simd_scale_channels_avx2 (const gfloat *in,
+                                 gfloat *out,
+                                 glong n_pixels,
+                                 guint n_components,
+                                 const gfloat *factors)
+{
+  __m256 f0;
+  __m256 f1;
+  __m256 f2;
+  gfloat block[BLOCK_SIZE_256];
+  gsize i;
+  gsize j;
+  gsize n;
+
+  photos_simd_fill_block (block, BLOCK_SIZE_256, n_components, factors);
+  f0 = _mm256_loadu_ps (block);
+  f1 = _mm256_loadu_ps (block + 8);
+  f2 = _mm256_loadu_ps (block + 16);
+
+  n = (gsize) n_pixels * n_components;
+
+  for (i = 0; i + BLOCK_SIZE_256 <= n; i += BLOCK_SIZE_256)
+    {
+      __m256 v0 = _mm256_loadu_ps (in + i);
+      __m256 v1 = _mm256_loadu_ps (in + i + 8);
+      __m256 v2 = _mm256_loadu_ps (in + i + 16);
+
+      _mm256_storeu_ps (out + i, _mm256_mul_ps (v0, f0));
+      _mm256_storeu_ps (out + i + 8, _mm256_mul_ps (v1, f1));
+      _mm256_storeu_ps (out + i + 16, _mm256_mul_ps (v2, f2));
+    }
+
+  /* Avoid the penalty for mixing 256-bit and legacy SSE code in the
+   * caller.
+   */
+  _mm256_zeroupper ();
+
+  for (j = 0; i < n; i++, j++)
+    out[i] = in[i] * block[j];
+}
+
+#endif /* PHOTOS_SIMD_X86 */
+
+
+#ifdef __ARM_NEON
+
+static void
+photos_simd_multiply_neon (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  const float32x4_t one = vdupq_n_f32 (1.0f);
+  const float32x4_t zero = vdupq_n_f32 (0.0f);
+  glong i;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      float32x4_t a = vld1q_f32 (aux);
+      float32x4_t b = vld1q_f32 (in);
+      float32x4_t aA = vdupq_n_f32 (aux[3]);
+      float32x4_t aB = vdupq_n_f32 (in[3]);
+      float32x4_t aR;
+      float32x4_t xR;
+
+      aR = vaddq_f32 (aA, vmulq_f32 (aB, vsubq_f32 (one, aA)));
+      xR = vaddq_f32 (vmulq_f32 (vsubq_f32 (one, aB), a), vmulq_f32 (vsubq_f32 (one, aA), b));
+      xR = vaddq_f32 (xR, vmulq_f32 (a, b));
+      xR = vminq_f32 (vmaxq_f32 (xR, zero), aR);
+      vst1q_f32 (out, vsetq_lane_f32 (vgetq_lane_f32 (aR, 0), xR, 3));
+
+      aux += 4;
+      in += 4;
+      out += 4;
+    }
+}
+
+
+static void
+photos_simd_multiply_opaque_neon (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  const float32x4_t one = vdupq_n_f32 (1.0f);
+  const float32x4_t zero = vdupq_n_f32 (0.0f);
+  glong i;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      float32x4_t a = vld1q_f32 (aux);
+      float32x4_t b = vld1q_f32 (in);
+      float32x4_t aB = vdupq_n_f32 (in[3]);
+      float32x4_t xR;
+
+      xR = vaddq_f32 (vmulq_f32 (vsubq_f32 (one, aB), a), vmulq_f32 (a, b));
+      xR = vminq_f32 (vmaxq_f32 (xR, zero), one);
+      vst1q_f32 (out, vsetq_lane_f32 (1.0f, xR, 3));
+
+      aux += 4;
+      in += 4;
+      out += 4;
+    }
+}
+
+
+static void
+photos_simd_scale_channels_neon (const gfloat *in,
+                                 gfloat *out,
+                                 glong n_pixels,
+                                 guint n_components,
+                                 const gfloat *factors)
+{
+  float32x4_t f0;
+  float32x4_t f1;
+  float32x4_t f2;
+  gfloat block[BLOCK_SIZE_128];
+  gsize i;
+  gsize j;
+  gsize n;
+
+  photos_simd_fill_block (block, BLOCK_SIZE_128, n_components, factors);
+  f0 = vld1q_f32 (block);
+  f1 = vld1q_f32 (block + 4);
+  f2 = vld1q_f32 (block + 8);
+
+  n = (gsize) n_pixels * n_components;
+
+  for (i = 0; i + BLOCK_SIZE_128 <= n; i += BLOCK_SIZE_128)
+    {
+      float32x4_t v0 = vld1q_f32 (in + i);
+      float32x4_t v1 = vld1q_f32 (in + i + 4);
+      float32x4_t v2 = vld1q_f32 (in + i + 8);
+
+      vst1q_f32 (out + i, vmulq_f32 (v0, f0));
+      vst1q_f32 (out + i + 4, vmulq_f32 (v1, f1));
+      vst1q_f32 (out + i + 8, vmulq_f32 (v2, f2));
+    }
+
+  for (j = 0; i < n; i++, j++)
+    out[i] = in[i] * block[j];
+}
+
+#endif /* __ARM_NEON */
+
+
+PhotosSimdFlags
+photos_simd_get_support (void)
+{
+  static PhotosSimdFlags support = PHOTOS_SIMD_NONE;
+  static gsize once_init_value = 0;
+
+  if (g_once_init_enter (&once_init_value))
+    {
+#ifdef PHOTOS_SIMD_X86
+      __builtin_cpu_init ();
+
+      if (__builtin_cpu_supports ("sse2"))
+        support |= PHOTOS_SIMD_SSE2;
+
+      if (__builtin_cpu_supports ("avx2"))
+        support |= PHOTOS_SIMD_AVX2;
+#endif
+
+#ifdef __ARM_NEON
+      support |= PHOTOS_SIMD_NEON;
+#endif
+
+      photos_debug (PHOTOS_DEBUG_GEGL,
+                    "SIMD: SSE2: %s, AVX2: %s, NEON: %s",
+                    (support & PHOTOS_SIMD_SSE2) != 0 ? "yes" : "no",
+                    (support & PHOTOS_SIMD_AVX2) != 0 ? "yes" : "no",
+                    (support & PHOTOS_SIMD_NEON) != 0 ? "yes" : "no");
+
+      g_once_init_leave (&once_init_value, 1);
+    }
+
+  return support;
+}
+
+
+void
+photos_simd_apply_curves_scalar (const gfloat *in,
+                                 gfloat *out,
+                                 glong n_pixels,
+                                 guint n_components,
+                                 const gfloat *curves,
+                                 guint n_intervals)
+{
+  const gfloat *curve_b = curves + 2 * (n_intervals + 1);
+  const gfloat *curve_g = curves + n_intervals + 1;
+  const gfloat *curve_r = curves;
+  glong i;
+  guint j;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      out[0] = photos_simd_apply_curve (in[0], curve_r, n_intervals);
+      out[1] = photos_simd_apply_curve (in[1], curve_g, n_intervals);
+      out[2] = photos_simd_apply_curve (in[2], curve_b, n_intervals);
+
+      for (j = 3; j < n_components; j++)
+        out[j] = in[j];
+
+      in += n_components;
+      out += n_components;
+    }
+}
+
+
+PhotosSimdApplyCurvesFunc
+photos_simd_get_apply_curves_func (PhotosSimdFlags flags)
+{
+  PhotosSimdApplyCurvesFunc ret_val = NULL;
+
+#ifdef PHOTOS_SIMD_X86
+  if ((flags & PHOTOS_SIMD_AVX2) != 0)
+    ret_val = photos_simd_apply_curves_avx2;
+#endif
+
+  return ret_val;
+}
+
+
+void
+photos_simd_multiply_scalar (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  glong i;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      photos_simd_multiply_pixel (in, aux, out);
+
+      aux += 4;
+      in += 4;
+      out += 4;
+    }
+}
+
+
+PhotosSimdMultiplyFunc
+photos_simd_get_multiply_func (PhotosSimdFlags flags)
+{
+  PhotosSimdMultiplyFunc ret_val = NULL;
+
+#ifdef PHOTOS_SIMD_X86
+  if ((flags & PHOTOS_SIMD_AVX2) != 0)
+    ret_val = photos_simd_multiply_avx2;
+  else if ((flags & PHOTOS_SIMD_SSE2) != 0)
+    ret_val = photos_simd_multiply_sse2;
+#endif
+
+#ifdef __ARM_NEON
+  if ((flags & PHOTOS_SIMD_NEON) != 0)
+    ret_val = photos_simd_multiply_neon;
+#endif
+
+  return ret_val;
+}
+
+
+void
+photos_simd_multiply_opaque_scalar (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels)
+{
+  glong i;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      photos_simd_multiply_opaque_pixel (in, aux, out);
+
+      aux += 4;
+      in += 4;
+      out += 4;
+    }
+}
+
+
+PhotosSimdMultiplyFunc
+photos_simd_get_multiply_opaque_func (PhotosSimdFlags flags)
+{
+  PhotosSimdMultiplyFunc ret_val = NULL;
+
+#ifdef PHOTOS_SIMD_X86
+  if ((flags & PHOTOS_SIMD_AVX2) != 0)
+    ret_val = photos_simd_multiply_opaque_avx2;
+  else if ((flags & PHOTOS_SIMD_SSE2) != 0)
+    ret_val = photos_simd_multiply_opaque_sse2;
+#endif
+
+#ifdef __ARM_NEON
+  if ((flags & PHOTOS_SIMD_NEON) != 0)
+    ret_val = photos_simd_multiply_opaque_neon;
+#endif
+
+  return ret_val;
+}
+
+
+void
+photos_simd_scale_channels_scalar (const gfloat *in,
+                                   gfloat *out,
+                                   glong n_pixels,
+                                   guint n_components,
+                                   const gfloat *factors)
+{
+  glong i;
+  guint j;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      for (j = 0; j < n_components; j++)
+        out[j] = in[j] * factors[j];
+
+      in += n_components;
+      out += n_components;
+    }
+}
+
+
+PhotosSimdScaleChannelsFunc
+photos_simd_get_scale_channels_func (PhotosSimdFlags flags)
+{
+  PhotosSimdScaleChannelsFunc ret_val = NULL;
+
+#ifdef PHOTOS_SIMD_X86
+  if ((flags & PHOTOS_SIMD_AVX2) != 0)
+    ret_val = photos_simd_scale_channels_avx2;
+  else if ((flags & PHOTOS_SIMD_SSE2) != 0)
+    ret_val = photos_simd_scale_channels_sse2;
+#endif
+
+#ifdef __ARM_NEON
+  if ((flags & PHOTOS_SIMD_NEON) != 0)
+    ret_val = photos_simd_scale_channels_neon;
+#endif
+
+  return ret_val;
+}
@@ -0,0 +1,84 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_SIMD_H
+#define PHOTOS_SIMD_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  PHOTOS_SIMD_NONE = 0,
+  PHOTOS_SIMD_SSE2 = 1 << 0,
+  PHOTOS_SIMD_AVX2 = 1 << 1,
+  PHOTOS_SIMD_NEON = 1 << 2
+} PhotosSimdFlags;
+
+typedef void (*PhotosSimdScaleChannelsFunc) (const gfloat *in,
+                                             gfloat *out,
+                                             glong n_pixels,
+                                             guint n_components,
+                                             const gfloat *factors);
+
+typedef void (*PhotosSimdApplyCurvesFunc) (const gfloat *in,
+                                           gfloat *out,
+                                           glong n_pixels,
+                                           guint n_components,
+                                           const gfloat *curves,
+                                           guint n_intervals);
+
+typedef void (*PhotosSimdMultiplyFunc) (const gfloat *in, const gfloat *aux, gfloat *out, glong n_pixels);
+
+PhotosSimdFlags                photos_simd_get_support                   (void);
+
+void                           photos_simd_apply_curves_scalar           (const gfloat *in,
+                                                                          gfloat *out,
+                                                                          glong n_pixels,
+                                                                          guint n_components,
+                                                                          const gfloat *curves,
+                                                                          guint n_intervals);
+
+PhotosSimdApplyCurvesFunc      photos_simd_get_apply_curves_func         (PhotosSimdFlags flags);
+
+void                           photos_simd_multiply_scalar               (const gfloat *in,
+                                                                          const gfloat *aux,
+                                                                          gfloat *out,
+                                                                          glong n_pixels);
+
+PhotosSimdMultiplyFunc         photos_simd_get_multiply_func             (PhotosSimdFlags flags);
+
+void                           photos_simd_multiply_opaque_scalar        (const gfloat *in,
+                                                                          const gfloat *aux,
+                                                                          gfloat *out,
+                                                                          glong n_pixels);
+
+PhotosSimdMultiplyFunc         photos_simd_get_multiply_opaque_func      (PhotosSimdFlags flags);
+
+void                           photos_simd_scale_channels_scalar         (const gfloat *in,
+                                                                          gfloat *out,
+                                                                          glong n_pixels,
+                                                                          guint n_components,
+                                                                          const gfloat *factors);
+
+PhotosSimdScaleChannelsFunc    photos_simd_get_scale_channels_func       (PhotosSimdFlags flags);
+
+G_END_DECLS
+
+#endif /* PHOTOS_SIMD_H */
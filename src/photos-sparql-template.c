@@ -19,14 +19,31 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gio/gio.h>
 
 #include "photos-sparql-template.h"
 
 
+typedef struct _PhotosSparqlTemplateSegment PhotosSparqlTemplateSegment;
+
+/* A segment is either a run of literal text, or a placeholder if it
+ * has a name. In both cases, offset and length refer to the
+ * template_text, so that a placeholder without a binding can be
+ * copied as it is.
+ */
+struct _PhotosSparqlTemplateSegment
+{
+  gchar *name;
+  gsize length;
+  gsize offset;
+};
+
 struct _PhotosSparqlTemplate
 {
   GObject parent_instance;
+  GArray *segments;
   gchar *template_path;
   gchar *template_text;
 };
@@ -47,6 +64,78 @@ enum
 };
 
 
+static void
+photos_sparql_template_segment_clear (gpointer data)
+{
+  PhotosSparqlTemplateSegment *segment = (PhotosSparqlTemplateSegment *) data;
+  g_free (segment->name);
+}
+
+
+static void
+photos_sparql_template_add_segment (PhotosSparqlTemplate *self, const gchar *start, const gchar *end, gchar *name)
+{
+  PhotosSparqlTemplateSegment segment;
+
+  if (start == end)
+    return;
+
+  segment.name = name;
+  segment.length = (gsize) (end - start);
+  segment.offset = (gsize) (start - self->template_text);
+  g_array_append_val (self->segments, segment);
+}
+
+
+static void
+photos_sparql_template_tokenize (PhotosSparqlTemplate *self)
+{
+  const gchar *literal;
+  const gchar *p;
+
+  literal = self->template_text;
+  p = self->template_text;
+
+  /* Placeholders look like {{name}}, optionally with a space on
+   * either side of the name. Anything else is literal text.
+   */
+  while ((p = strstr (p, "{{")) != NULL)
+    {
+      const gchar *name_end;
+      const gchar *name_start;
+      const gchar *q;
+
+      q = p + 2;
+      if (g_ascii_isspace (*q))
+        q++;
+
+      name_start = q;
+      while (*q != '\0' && *q != '{' && *q != '}' && !g_ascii_isspace (*q))
+        q++;
+
+      name_end = q;
+      if (g_ascii_isspace (*q))
+        q++;
+
+      if (name_end == name_start || q[0] != '}' || q[1] != '}')
+        {
+          p++;
+          continue;
+        }
+
+      q += 2;
+
+      photos_sparql_template_add_segment (self, literal, p, NULL);
+      photos_sparql_template_add_segment (self, p, q, g_strndup (name_start, (gsize) (name_end - name_start)));
+
+      literal = q;
+      p = q;
+    }
+
+  photos_sparql_template_add_segment (self, literal, literal + strlen (literal), NULL);
+}
+
+
 static void
 photos_sparql_template_constructed (GObject *object)
 {
@@ -83,6 +172,8 @@ photos_sparql_template_constructed (GObject *object)
 
   buffer[bytes_read] = '\0';
   self->template_text = g_strdup (buffer);
+
+  photos_sparql_template_tokenize (self);
 }
 
 
@@ -91,6 +182,7 @@ photos_sparql_template_finalize (GObject *object)
 {
   PhotosSparqlTemplate *self = PHOTOS_SPARQL_TEMPLATE (object);
 
+  g_array_unref (self->segments);
   g_free (self->template_path);
   g_free (self->template_text);
 
@@ -135,6 +227,8 @@ photos_sparql_template_set_property (GObject *object, guint prop_id, const GValu
 static void
 photos_sparql_template_init (PhotosSparqlTemplate *self)
 {
+  self->segments = g_array_new (FALSE, FALSE, sizeof (PhotosSparqlTemplateSegment));
+  g_array_set_clear_func (self->segments, photos_sparql_template_segment_clear);
 }
 
 
@@ -168,28 +262,24 @@ photos_sparql_template_new (const gchar *template_path)
 gchar *
 photos_sparql_template_get_sparql (PhotosSparqlTemplate *self, const gchar *first_binding_name, ...)
 {
+  GString *sparql;
+  g_autoptr (GPtrArray) bindings = NULL;
   const gchar *name;
-  const gchar *value;
-  gchar *sparql = NULL;
+  g_autofree const gchar **values = NULL;
+  gsize length = 0;
+  guint i;
   va_list ap;
 
-  sparql = g_strdup (self->template_text);
+  g_return_val_if_fail (PHOTOS_IS_SPARQL_TEMPLATE (self), NULL);
 
-  if (first_binding_name == NULL)
-    goto out;
-
-  /* FIXME: this is an inefficent way to do template substitutions
-   * because we allocate and free a copy of the string for each binding.
-   * We should check https://gitlab.gnome.org/GNOME/template-glib/
-   */
+  /* The names and values are kept in pairs, without copying them */
+  bindings = g_ptr_array_new ();
 
   va_start (ap, first_binding_name);
-  name = first_binding_name;
-  do
+
+  for (name = first_binding_name; name != NULL; name = va_arg (ap, const gchar *))
     {
-      g_autoptr (GRegex) regex = NULL;
-      g_autofree gchar *name_regex = NULL;
-      g_autofree gchar *str = NULL;
+      const gchar *value;
 
       value = va_arg (ap, const gchar *);
       if (value == NULL)
@@ -198,17 +288,50 @@ photos_sparql_template_get_sparql (PhotosSparqlTemplate *self, const gchar *firs
           break;
         }
 
-      name_regex = g_strdup_printf ("{{\\s?%s\\s?}}", name);
-      regex = g_regex_new (name_regex, 0, 0, NULL);
+      g_ptr_array_add (bindings, (gpointer) name);
+      g_ptr_array_add (bindings, (gpointer) value);
+    }
+
+  va_end (ap);
+
+  /* Resolve the placeholders and measure the result first, so that
+   * the SPARQL can be written out in one go without reallocating.
+   */
+  values = g_new0 (const gchar *, self->segments->len);
+
+  for (i = 0; i < self->segments->len; i++)
+    {
+      PhotosSparqlTemplateSegment *segment;
+      guint j;
+
+      segment = &g_array_index (self->segments, PhotosSparqlTemplateSegment, i);
+      if (segment->name != NULL)
+        {
+          for (j = 0; j < bindings->len; j += 2)
+            {
+              if (g_strcmp0 (segment->name, (const gchar *) bindings->pdata[j]) == 0)
+                {
+                  values[i] = (const gchar *) bindings->pdata[j + 1];
+                  break;
+                }
+            }
+        }
+
+      length += values[i] == NULL ? segment->length : strlen (values[i]);
+    }
 
-      str = g_steal_pointer (&sparql);
-      sparql = g_regex_replace_literal (regex, str, -1, 0, value, 0, NULL) ;
+  sparql = g_string_sized_new (length + 1);
 
-      name = va_arg (ap, const gchar *);
-    } while (name != NULL);
+  for (i = 0; i < self->segments->len; i++)
+    {
+      PhotosSparqlTemplateSegment *segment;
 
-  va_end (ap);
+      segment = &g_array_index (self->segments, PhotosSparqlTemplateSegment, i);
+      if (values[i] == NULL)
+        g_string_append_len (sparql, self->template_text + segment->offset, (gssize) segment->length);
+      else
+        g_string_append (sparql, values[i]);
+    }
 
- out:
-  return sparql;
+  return g_string_free (sparql, FALSE);
 }
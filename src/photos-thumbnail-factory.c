@@ -30,13 +30,15 @@ struct _PhotosThumbnailFactory
 {
   GObject parent_instance;
   GCond cond;
-  GDBusConnection *connection;
   GDBusServer *dbus_server;
   GError *initialization_error;
   GError *thumbnailer_error;
   GMutex mutex;
-  PhotosThumbnailerDBus *thumbnailer;
+  GPtrArray *subprocesses;
+  GPtrArray *workers;
   gboolean is_initialized;
+  guint max_workers;
+  guint n_waiting;
 };
 
 static void photos_thumbnail_factory_initable_iface_init (GInitableIface *iface);
@@ -46,9 +48,140 @@ G_DEFINE_TYPE_WITH_CODE (PhotosThumbnailFactory, photos_thumbnail_factory, G_TYP
                          G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, photos_thumbnail_factory_initable_iface_init));
 
 
+typedef struct _PhotosThumbnailFactoryBatchData PhotosThumbnailFactoryBatchData;
+typedef struct _PhotosThumbnailFactoryBatchItem PhotosThumbnailFactoryBatchItem;
+typedef struct _PhotosThumbnailFactoryWorker PhotosThumbnailFactoryWorker;
+
+struct _PhotosThumbnailFactoryBatchItem
+{
+  PhotosThumbnailFactoryBatchData *data;
+  gulong cancelled_id;
+  guint index;
+};
+
+struct _PhotosThumbnailFactoryBatchData
+{
+  GError *error;
+  PhotosThumbnailFactoryGeneratedFunc func;
+  PhotosThumbnailFactoryWorker *worker;
+  gboolean completed;
+  gpointer user_data;
+  guint32 serial;
+  guint n_requests;
+};
+
+struct _PhotosThumbnailFactoryWorker
+{
+  GDBusConnection *connection;
+  GSubprocess *subprocess;
+  PhotosThumbnailerDBus *thumbnailer;
+  gboolean busy;
+  gint ref_count;
+};
+
 G_LOCK_DEFINE_STATIC (init_lock);
 
 static const gchar *THUMBNAILER_PATH = "/org/gnome/Photos/Thumbnailer";
+static const guint MAX_THUMBNAILERS = 8;
+static const guint MAX_THUMBNAILER_ATTEMPTS = 2;
+
+
+static PhotosThumbnailFactoryWorker *
+photos_thumbnail_factory_worker_new (GDBusConnection *connection, GSubprocess *subprocess)
+{
+  PhotosThumbnailFactoryWorker *worker;
+
+  worker = g_slice_new0 (PhotosThumbnailFactoryWorker);
+  worker->connection = g_object_ref (connection);
+  worker->subprocess = g_object_ref (subprocess);
+  worker->ref_count = 1;
+
+  return worker;
+}
+
+
+static PhotosThumbnailFactoryWorker *
+photos_thumbnail_factory_worker_ref (PhotosThumbnailFactoryWorker *worker)
+{
+  g_atomic_int_inc (&worker->ref_count);
+  return worker;
+}
+
+
+static void
+photos_thumbnail_factory_worker_unref (PhotosThumbnailFactoryWorker *worker)
+{
+  if (g_atomic_int_dec_and_test (&worker->ref_count))
+    {
+      g_clear_object (&worker->connection);
+      g_clear_object (&worker->subprocess);
+      g_clear_object (&worker->thumbnailer);
+      g_slice_free (PhotosThumbnailFactoryWorker, worker);
+    }
+}
+
+
+static PhotosThumbnailFactoryWorker *
+photos_thumbnail_factory_find_worker (PhotosThumbnailFactory *self, GDBusConnection *connection)
+{
+  PhotosThumbnailFactoryWorker *ret_val = NULL;
+  guint i;
+
+  for (i = 0; i < self->workers->len; i++)
+    {
+      PhotosThumbnailFactoryWorker *worker = (PhotosThumbnailFactoryWorker *) g_ptr_array_index (self->workers, i);
+
+      if (worker->connection == connection)
+        {
+          ret_val = worker;
+          break;
+        }
+    }
+
+  return ret_val;
+}
+
+
+static GSubprocess *
+photos_thumbnail_factory_steal_subprocess (PhotosThumbnailFactory *self, GCredentials *credentials)
+{
+  GSubprocess *ret_val = NULL;
+  guint i;
+  pid_t pid = -1;
+
+  if (self->subprocesses->len == 0)
+    goto out;
+
+  if (credentials != NULL)
+    pid = g_credentials_get_unix_pid (credentials, NULL);
+
+  /* Without a PID to go by, assume that the thumbnailers connect in
+   * the same order that they were spawned.
+   */
+  i = 0;
+  if (pid != -1)
+    {
+      for (i = 0; i < self->subprocesses->len; i++)
+        {
+          GSubprocess *subprocess = G_SUBPROCESS (g_ptr_array_index (self->subprocesses, i));
+          const gchar *identifier;
+          g_autofree gchar *pid_str = NULL;
+
+          identifier = g_subprocess_get_identifier (subprocess);
+          pid_str = g_strdup_printf ("%" G_PID_FORMAT, (GPid) pid);
+          if (g_strcmp0 (identifier, pid_str) == 0)
+            break;
+        }
+
+      if (i == self->subprocesses->len)
+        goto out;
+    }
+
+  ret_val = G_SUBPROCESS (g_ptr_array_steal_index (self->subprocesses, i));
+
+ out:
+  return ret_val;
+}
 
 
 static gboolean
@@ -65,9 +198,9 @@ photos_thumbnail_factory_authorize_authenticated_peer (PhotosThumbnailFactory *s
   str = g_credentials_to_string (credentials);
   photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Received authorization request: %s", str);
 
-  if (self->connection != NULL)
+  if (self->subprocesses->len == 0)
     {
-      g_warning ("Unable to authorize peer: Connection exists");
+      g_warning ("Unable to authorize peer: No thumbnailer is waiting to connect");
       goto out;
     }
 
@@ -100,21 +233,31 @@ photos_thumbnail_factory_authorize_authenticated_peer (PhotosThumbnailFactory *s
 static void
 photos_thumbnail_factory_connection_closed (PhotosThumbnailFactory *self,
                                             gboolean remote_peer_vanished,
-                                            GError *error)
+                                            GError *error,
+                                            GDBusConnection *connection)
 {
+  PhotosThumbnailFactoryWorker *worker;
+
   g_mutex_lock (&self->mutex);
 
   if (error != NULL)
-    photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Lost connection to the thumbnailer: %s", error->message);
+    photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Lost connection to a thumbnailer: %s", error->message);
   else
-    photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Lost connection to the thumbnailer");
+    photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Lost connection to a thumbnailer");
 
-  g_signal_handlers_disconnect_by_func (self->connection, photos_thumbnail_factory_connection_closed, self);
-  g_clear_object (&self->connection);
+  g_signal_handlers_disconnect_by_func (connection, photos_thumbnail_factory_connection_closed, self);
 
-  g_clear_error (&self->thumbnailer_error);
-  g_clear_object (&self->thumbnailer);
+  /* A busy worker is still referenced by the thread using it, and its
+   * ongoing call will fail. Either way, a new thumbnailer will be
+   * spawned on demand to take its place.
+   */
+  worker = photos_thumbnail_factory_find_worker (self, connection);
+  if (worker != NULL)
+    g_ptr_array_remove_fast (self->workers, worker);
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Thumbnailers: %u running", self->workers->len);
 
+  g_cond_broadcast (&self->cond);
   g_mutex_unlock (&self->mutex);
 }
 
@@ -122,33 +265,190 @@ photos_thumbnail_factory_connection_closed (PhotosThumbnailFactory *self,
 static gboolean
 photos_thumbnail_factory_new_connection (PhotosThumbnailFactory *self, GDBusConnection *connection)
 {
+  GCredentials *credentials;
+  g_autoptr (GSubprocess) subprocess = NULL;
+  PhotosThumbnailFactoryWorker *worker = NULL;
+  gboolean ret_val = FALSE;
+
   g_mutex_lock (&self->mutex);
 
-  g_assert_null (self->connection);
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Received new connection");
 
-  g_assert (self->thumbnailer_error == NULL);
-  g_assert (self->thumbnailer == NULL);
+  credentials = g_dbus_connection_get_peer_credentials (connection);
+  subprocess = photos_thumbnail_factory_steal_subprocess (self, credentials);
+  if (subprocess == NULL)
+    {
+      g_warning ("Unable to accept connection: No matching thumbnailer");
+      goto out;
+    }
 
-  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Received new connection");
+  worker = photos_thumbnail_factory_worker_new (connection, subprocess);
 
-  self->connection = g_object_ref (connection);
-  g_signal_connect_swapped (self->connection,
-                            "closed",
-                            G_CALLBACK (photos_thumbnail_factory_connection_closed),
-                            self);
+  {
+    g_autoptr (GError) error = NULL;
+
+    worker->thumbnailer = photos_thumbnailer_dbus_proxy_new_sync (connection,
+                                                                  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES
+                                                                  | G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+                                                                  NULL,
+                                                                  THUMBNAILER_PATH,
+                                                                  NULL,
+                                                                  &error);
+    if (error != NULL)
+      {
+        g_clear_error (&self->thumbnailer_error);
+        self->thumbnailer_error = g_steal_pointer (&error);
+        g_subprocess_force_exit (subprocess);
+        goto out;
+      }
+  }
+
+  g_signal_connect_swapped (connection, "closed", G_CALLBACK (photos_thumbnail_factory_connection_closed), self);
+  g_ptr_array_add (self->workers, photos_thumbnail_factory_worker_ref (worker));
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Thumbnailers: %u running", self->workers->len);
+  ret_val = TRUE;
+
+ out:
+  g_clear_pointer (&worker, photos_thumbnail_factory_worker_unref);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  return ret_val;
+}
+
+
+static void
+photos_thumbnail_factory_subprocess_wait (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autoptr (PhotosThumbnailFactory) self = PHOTOS_THUMBNAIL_FACTORY (user_data);
+  GSubprocess *subprocess = G_SUBPROCESS (source_object);
+
+  g_subprocess_wait_finish (subprocess, res, NULL);
+
+  g_mutex_lock (&self->mutex);
+
+  /* A thumbnailer that exits without ever connecting would otherwise
+   * leave its callers waiting forever.
+   */
+  if (self->subprocesses != NULL && g_ptr_array_remove (self->subprocesses, subprocess))
+    {
+      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Thumbnailer exited before connecting");
+
+      if (self->thumbnailer_error == NULL)
+        {
+          self->thumbnailer_error = g_error_new_literal (G_IO_ERROR,
+                                                         G_IO_ERROR_FAILED,
+                                                         "Thumbnailer exited before connecting");
+        }
 
-  self->thumbnailer = photos_thumbnailer_dbus_proxy_new_sync (self->connection,
-                                                              G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES
-                                                              | G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
-                                                              NULL,
-                                                              THUMBNAILER_PATH,
-                                                              NULL,
-                                                              &self->thumbnailer_error);
+      g_cond_broadcast (&self->cond);
+    }
 
-  g_cond_signal (&self->cond);
   g_mutex_unlock (&self->mutex);
+}
+
+
+static gboolean
+photos_thumbnail_factory_spawn (PhotosThumbnailFactory *self, GError **error)
+{
+  g_autoptr (GSubprocess) subprocess = NULL;
+  const gchar *address;
+  gboolean ret_val = FALSE;
+  g_autofree gchar *thumbnailer_path = NULL;
+
+  address = g_dbus_server_get_client_address (self->dbus_server);
+  thumbnailer_path = g_strconcat (PACKAGE_LIBEXEC_DIR, G_DIR_SEPARATOR_S, PACKAGE_TARNAME, "-thumbnailer", NULL);
 
-  return TRUE;
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Spawning “%s --address %s”", thumbnailer_path, address);
+
+  subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, error, thumbnailer_path, "--address", address, NULL);
+  if (subprocess == NULL)
+    goto out;
+
+  g_ptr_array_add (self->subprocesses, g_object_ref (subprocess));
+  g_subprocess_wait_async (subprocess, NULL, photos_thumbnail_factory_subprocess_wait, g_object_ref (self));
+
+  ret_val = TRUE;
+
+ out:
+  return ret_val;
+}
+
+
+static PhotosThumbnailFactoryWorker *
+photos_thumbnail_factory_acquire_worker (PhotosThumbnailFactory *self, GError **error)
+{
+  PhotosThumbnailFactoryWorker *ret_val = NULL;
+
+  g_mutex_lock (&self->mutex);
+
+  self->n_waiting++;
+
+  while (TRUE)
+    {
+      guint i;
+
+      for (i = 0; i < self->workers->len && ret_val == NULL; i++)
+        {
+          PhotosThumbnailFactoryWorker *worker = (PhotosThumbnailFactoryWorker *) g_ptr_array_index (self->workers, i);
+
+          if (!worker->busy)
+            {
+              worker->busy = TRUE;
+              ret_val = photos_thumbnail_factory_worker_ref (worker);
+            }
+        }
+
+      if (ret_val != NULL)
+        break;
+
+      if (self->thumbnailer_error != NULL)
+        {
+          photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Error creating org.gnome.Photos.Thumbnailer proxy");
+          g_propagate_error (error, g_steal_pointer (&self->thumbnailer_error));
+          break;
+        }
+
+      /* Every thumbnailer is busy. Scale up if there are more callers
+       * waiting than thumbnailers about to connect. Idle thumbnailers
+       * exit on their own after a while, which scales the pool back
+       * down.
+       */
+      if (self->n_waiting > self->subprocesses->len
+          && self->workers->len + self->subprocesses->len < self->max_workers)
+        {
+          if (!photos_thumbnail_factory_spawn (self, error))
+            break;
+
+          photos_debug (PHOTOS_DEBUG_THUMBNAILER,
+                        "Thumbnailers: %u running, %u starting, %u callers waiting",
+                        self->workers->len,
+                        self->subprocesses->len,
+                        self->n_waiting);
+        }
+
+      g_cond_wait (&self->cond, &self->mutex);
+    }
+
+  self->n_waiting--;
+
+  g_mutex_unlock (&self->mutex);
+  return ret_val;
+}
+
+
+static void
+photos_thumbnail_factory_release_worker (PhotosThumbnailFactory *self, PhotosThumbnailFactoryWorker *worker)
+{
+  g_mutex_lock (&self->mutex);
+
+  worker->busy = FALSE;
+  g_cond_broadcast (&self->cond);
+
+  g_mutex_unlock (&self->mutex);
+
+  photos_thumbnail_factory_worker_unref (worker);
 }
 
 
@@ -181,8 +481,21 @@ photos_thumbnail_factory_dispose (GObject *object)
       g_clear_object (&self->dbus_server);
     }
 
-  g_clear_object (&self->connection);
-  g_clear_object (&self->thumbnailer);
+  if (self->workers != NULL)
+    {
+      guint i;
+
+      for (i = 0; i < self->workers->len; i++)
+        {
+          PhotosThumbnailFactoryWorker *worker = (PhotosThumbnailFactoryWorker *) g_ptr_array_index (self->workers, i);
+
+          g_signal_handlers_disconnect_by_func (worker->connection, photos_thumbnail_factory_connection_closed, self);
+        }
+
+      g_clear_pointer (&self->workers, g_ptr_array_unref);
+    }
+
+  g_clear_pointer (&self->subprocesses, g_ptr_array_unref);
 
   G_OBJECT_CLASS (photos_thumbnail_factory_parent_class)->dispose (object);
 }
@@ -205,8 +518,19 @@ photos_thumbnail_factory_finalize (GObject *object)
 static void
 photos_thumbnail_factory_init (PhotosThumbnailFactory *self)
 {
+  guint n_processors;
+
   g_cond_init (&self->cond);
   g_mutex_init (&self->mutex);
+
+  self->subprocesses = g_ptr_array_new_with_free_func (g_object_unref);
+  self->workers = g_ptr_array_new_with_free_func ((GDestroyNotify) photos_thumbnail_factory_worker_unref);
+
+  /* Each thumbnailer has its own GEGL thread pool, so there is no
+   * need for more than one per physical core.
+   */
+  n_processors = g_get_num_processors ();
+  self->max_workers = CLAMP (n_processors / 2, 1U, MAX_THUMBNAILERS);
 }
 
 
@@ -304,6 +628,66 @@ photos_thumbnail_factory_dup_singleton (GCancellable *cancellable, GError **erro
 }
 
 
+static gboolean
+photos_thumbnail_factory_generate_thumbnail_with_worker (PhotosThumbnailFactoryWorker *worker,
+                                                         const gchar *uri,
+                                                         const gchar *mime_type,
+                                                         GQuark orientation,
+                                                         gint64 original_height,
+                                                         gint64 original_width,
+                                                         const gchar *const *pipeline_uris,
+                                                         const gchar *thumbnail_path,
+                                                         GCancellable *cancellable,
+                                                         GError **error)
+{
+  GError *local_error = NULL;
+  GVariant *pipeline_uris_variant;
+  const gchar *orientation_str;
+  gboolean ret_val = FALSE;
+  gint thumbnail_size;
+  gssize n_pipeline_uris;
+
+  g_assert_true (PHOTOS_IS_THUMBNAILER_DBUS (worker->thumbnailer));
+
+  orientation_str = g_quark_to_string (orientation);
+
+  n_pipeline_uris = pipeline_uris == NULL ? 0 : -1;
+  pipeline_uris_variant = g_variant_new_strv (pipeline_uris, n_pipeline_uris);
+
+  thumbnail_size = photos_utils_get_icon_size ();
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Calling GenerateThumbnail for %s", uri);
+  if (!photos_thumbnailer_dbus_call_generate_thumbnail_sync (worker->thumbnailer,
+                                                             uri,
+                                                             mime_type,
+                                                             orientation_str,
+                                                             original_height,
+                                                             original_width,
+                                                             pipeline_uris_variant,
+                                                             thumbnail_path,
+                                                             thumbnail_size,
+                                                             cancellable,
+                                                             &local_error))
+    {
+      if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          guint32 serial;
+
+          serial = g_dbus_connection_get_last_serial (worker->connection);
+          photos_thumbnailer_dbus_call_cancel_sync (worker->thumbnailer, (guint) serial, NULL, NULL);
+        }
+
+      g_propagate_error (error, local_error);
+      goto out;
+    }
+
+  ret_val = TRUE;
+
+ out:
+  return ret_val;
+}
+
+
 gboolean
 photos_thumbnail_factory_generate_thumbnail (PhotosThumbnailFactory *self,
                                              GFile *file,
@@ -318,6 +702,8 @@ photos_thumbnail_factory_generate_thumbnail (PhotosThumbnailFactory *self,
 {
   GError *local_error = NULL;
   gboolean ret_val = FALSE;
+  g_autofree gchar *uri = NULL;
+  guint attempt;
 
   g_return_val_if_fail (PHOTOS_IS_THUMBNAIL_FACTORY (self), FALSE);
   g_return_val_if_fail (G_IS_FILE (file), FALSE);
@@ -325,111 +711,274 @@ photos_thumbnail_factory_generate_thumbnail (PhotosThumbnailFactory *self,
   g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-  g_mutex_lock (&self->mutex);
-
   if (orientation == 0)
     orientation = PHOTOS_ORIENTATION_TOP;
 
-  if (self->connection == NULL)
+  uri = g_file_get_uri (file);
+
+  for (attempt = 0; attempt < MAX_THUMBNAILER_ATTEMPTS && !ret_val; attempt++)
     {
-      g_autoptr (GSubprocess) subprocess = NULL;
-      const gchar *address;
-      g_autofree gchar *thumbnailer_path = NULL;
+      PhotosThumbnailFactoryWorker *worker;
+      gboolean crashed;
+
+      g_clear_error (&local_error);
+
+      worker = photos_thumbnail_factory_acquire_worker (self, &local_error);
+      if (worker == NULL)
+        break;
+
+      ret_val = photos_thumbnail_factory_generate_thumbnail_with_worker (worker,
+                                                                         uri,
+                                                                         mime_type,
+                                                                         orientation,
+                                                                         original_height,
+                                                                         original_width,
+                                                                         pipeline_uris,
+                                                                         thumbnail_path,
+                                                                         cancellable,
+                                                                         &local_error);
+
+      /* The thumbnailer might have crashed, or exited due to
+       * inactivity right as the call was made. Try again with another
+       * one, but don't let a file that crashes the thumbnailer take
+       * down the whole pool.
+       */
+      crashed = g_dbus_connection_is_closed (worker->connection);
+      photos_thumbnail_factory_release_worker (self, worker);
+
+      if (!ret_val && (!crashed || g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)))
+        break;
+    }
 
-      g_assert (self->thumbnailer_error == NULL);
-      g_assert (self->thumbnailer == NULL);
+  if (!ret_val)
+    {
+      g_assert_nonnull (local_error);
+      g_propagate_error (error, local_error);
+    }
 
-      address = g_dbus_server_get_client_address (self->dbus_server);
-      thumbnailer_path = g_strconcat (PACKAGE_LIBEXEC_DIR,
-                                      G_DIR_SEPARATOR_S,
-                                      PACKAGE_TARNAME,
-                                      "-thumbnailer",
-                                      NULL);
+  return ret_val;
+}
 
-      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Spawning “%s --address %s”", thumbnailer_path, address);
 
-      {
-        g_autoptr (GError) subprocess_error = NULL;
-
-        subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE,
-                                       &subprocess_error,
-                                       thumbnailer_path,
-                                       "--address",
-                                       address,
-                                       NULL);
-        if (subprocess_error != NULL)
-          {
-            local_error = g_steal_pointer (&subprocess_error);
-            goto out;
-          }
-      }
+static void
+photos_thumbnail_factory_generate_thumbnails_cancelled (GCancellable *cancellable, gpointer user_data)
+{
+  PhotosThumbnailFactoryBatchItem *item = (PhotosThumbnailFactoryBatchItem *) user_data;
+  PhotosThumbnailFactoryBatchData *data = item->data;
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Calling CancelThumbnail for %u, %u", data->serial, item->index);
+  photos_thumbnailer_dbus_call_cancel_thumbnail (data->worker->thumbnailer,
+                                                 (guint) data->serial,
+                                                 item->index,
+                                                 NULL,
+                                                 NULL,
+                                                 NULL);
+}
 
-      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Waiting for org.gnome.Photos.Thumbnailer proxy");
 
-      while (self->connection == NULL)
-        g_cond_wait (&self->cond, &self->mutex);
-    }
+static void
+photos_thumbnail_factory_generate_thumbnails_generated (GDBusConnection *connection,
+                                                        const gchar *sender_name,
+                                                        const gchar *object_path,
+                                                        const gchar *interface_name,
+                                                        const gchar *signal_name,
+                                                        GVariant *parameters,
+                                                        gpointer user_data)
+{
+  PhotosThumbnailFactoryBatchData *data = (PhotosThumbnailFactoryBatchData *) user_data;
+  g_autoptr (GError) error = NULL;
+  const gchar *error_message;
+  const gchar *error_name;
+  guint index;
+  guint serial;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(uuss)")))
+    return;
 
-  if (self->thumbnailer_error != NULL)
+  g_variant_get (parameters, "(uu&s&s)", &serial, &index, &error_name, &error_message);
+  if ((guint32) serial != data->serial || index >= data->n_requests)
+    return;
+
+  if (error_name[0] != '\0')
     {
-      g_assert_null (self->thumbnailer);
+      error = g_dbus_error_new_for_dbus_error (error_name, error_message);
+      g_dbus_error_strip_remote_error (error);
+    }
+
+  if (data->func != NULL)
+    (*data->func) (index, error, data->user_data);
+}
+
+
+static void
+photos_thumbnail_factory_generate_thumbnails_reply (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  PhotosThumbnailFactoryBatchData *data = (PhotosThumbnailFactoryBatchData *) user_data;
+  PhotosThumbnailerDBus *thumbnailer = PHOTOS_THUMBNAILER_DBUS (source_object);
+
+  photos_thumbnailer_dbus_call_generate_thumbnails_finish (thumbnailer, res, &data->error);
+  data->completed = TRUE;
+}
 
-      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Error creating org.gnome.Photos.Thumbnailer proxy");
-      local_error = g_steal_pointer (&self->thumbnailer_error);
+
+gboolean
+photos_thumbnail_factory_generate_thumbnails (PhotosThumbnailFactory *self,
+                                              const PhotosThumbnailFactoryRequest *requests,
+                                              guint n_requests,
+                                              PhotosThumbnailFactoryGeneratedFunc func,
+                                              gpointer user_data,
+                                              GCancellable *cancellable,
+                                              GError **error)
+{
+  GVariantBuilder builder;
+  PhotosThumbnailFactoryBatchData data = { NULL };
+  g_autoptr (GMainContext) context = NULL;
+  gboolean ret_val = FALSE;
+  g_autofree PhotosThumbnailFactoryBatchItem *items = NULL;
+  gint thumbnail_size;
+  guint i;
+  guint subscription_id = 0;
+
+  g_return_val_if_fail (PHOTOS_IS_THUMBNAIL_FACTORY (self), FALSE);
+  g_return_val_if_fail (requests != NULL || n_requests == 0, FALSE);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (n_requests == 0)
+    {
+      ret_val = TRUE;
+      goto out;
     }
-  else
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sssxxass)"));
+
+  for (i = 0; i < n_requests; i++)
     {
-      GVariant *pipeline_uris_variant;
-      const gchar *orientation_str;
+      const PhotosThumbnailFactoryRequest *request = &requests[i];
+      GQuark orientation;
       g_autofree gchar *uri = NULL;
-      gint thumbnail_size;
       gssize n_pipeline_uris;
 
-      g_assert_true (PHOTOS_IS_THUMBNAILER_DBUS (self->thumbnailer));
+      g_return_val_if_fail (G_IS_FILE (request->file), FALSE);
+      g_return_val_if_fail (request->mime_type != NULL && request->mime_type[0] != '\0', FALSE);
+      g_return_val_if_fail (request->cancellable == NULL || G_IS_CANCELLABLE (request->cancellable), FALSE);
+
+      orientation = request->orientation == 0 ? PHOTOS_ORIENTATION_TOP : request->orientation;
+      uri = g_file_get_uri (request->file);
+      n_pipeline_uris = request->pipeline_uris == NULL ? 0 : -1;
+
+      g_variant_builder_add (&builder,
+                             "(sssxx@ass)",
+                             uri,
+                             request->mime_type,
+                             g_quark_to_string (orientation),
+                             request->original_height,
+                             request->original_width,
+                             g_variant_new_strv ((const gchar *const *) request->pipeline_uris, n_pipeline_uris),
+                             request->thumbnail_path);
+    }
 
-      uri = g_file_get_uri (file);
-      orientation_str = g_quark_to_string (orientation);
+  data.func = func;
+  data.n_requests = n_requests;
+  data.user_data = user_data;
 
-      n_pipeline_uris = pipeline_uris == NULL ? 0 : -1;
-      pipeline_uris_variant = g_variant_new_strv (pipeline_uris, n_pipeline_uris);
+  data.worker = photos_thumbnail_factory_acquire_worker (self, error);
+  if (data.worker == NULL)
+    {
+      g_variant_builder_clear (&builder);
+      goto out;
+    }
 
-      thumbnail_size = photos_utils_get_icon_size ();
+  g_assert_true (PHOTOS_IS_THUMBNAILER_DBUS (data.worker->thumbnailer));
+
+  /* Both the ThumbnailGenerated signals and the reply are dispatched
+   * to this context, so that the calling thread receives them in the
+   * order that they were sent, without involving the main loop.
+   */
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  subscription_id = g_dbus_connection_signal_subscribe (data.worker->connection,
+                                                        NULL,
+                                                        "org.gnome.Photos.Thumbnailer",
+                                                        "ThumbnailGenerated",
+                                                        THUMBNAILER_PATH,
+                                                        NULL,
+                                                        G_DBUS_SIGNAL_FLAGS_NONE,
+                                                        photos_thumbnail_factory_generate_thumbnails_generated,
+                                                        &data,
+                                                        NULL);
+
+  thumbnail_size = photos_utils_get_icon_size ();
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Calling GenerateThumbnails for %u thumbnails", n_requests);
+  photos_thumbnailer_dbus_call_generate_thumbnails (data.worker->thumbnailer,
+                                                    g_variant_builder_end (&builder),
+                                                    thumbnail_size,
+                                                    cancellable,
+                                                    photos_thumbnail_factory_generate_thumbnails_reply,
+                                                    &data);
+
+  data.serial = g_dbus_connection_get_last_serial (data.worker->connection);
+
+  items = g_new0 (PhotosThumbnailFactoryBatchItem, n_requests);
+  for (i = 0; i < n_requests; i++)
+    {
+      GCancellable *request_cancellable = requests[i].cancellable;
 
-      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Calling GenerateThumbnail for %s", uri);
-      if (!photos_thumbnailer_dbus_call_generate_thumbnail_sync (self->thumbnailer,
-                                                                 uri,
-                                                                 mime_type,
-                                                                 orientation_str,
-                                                                 original_height,
-                                                                 original_width,
-                                                                 pipeline_uris_variant,
-                                                                 thumbnail_path,
-                                                                 thumbnail_size,
-                                                                 cancellable,
-                                                                 &local_error))
-        {
-          if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-            {
-              guint32 serial;
+      items[i].data = &data;
+      items[i].index = i;
 
-              serial = g_dbus_connection_get_last_serial (self->connection);
-              photos_thumbnailer_dbus_call_cancel_sync (self->thumbnailer, (guint) serial, NULL, NULL);
-            }
-        }
-      else
-        {
-          ret_val = TRUE;
-        }
+      if (request_cancellable == NULL)
+        continue;
+
+      items[i].cancelled_id
+        = g_cancellable_connect (request_cancellable,
+                                 G_CALLBACK (photos_thumbnail_factory_generate_thumbnails_cancelled),
+                                 &items[i],
+                                 NULL);
     }
 
- out:
-  g_mutex_unlock (&self->mutex);
+  while (!data.completed)
+    g_main_context_iteration (context, TRUE);
 
-  if (!ret_val)
+  while (g_main_context_iteration (context, FALSE));
+
+  for (i = 0; i < n_requests; i++)
     {
-      g_assert_nonnull (local_error);
-      g_propagate_error (error, local_error);
+      if (requests[i].cancellable != NULL)
+        g_cancellable_disconnect (requests[i].cancellable, items[i].cancelled_id);
+    }
+
+  if (g_error_matches (data.error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Calling Cancel for %u", data.serial);
+      photos_thumbnailer_dbus_call_cancel_sync (data.worker->thumbnailer, (guint) data.serial, NULL, NULL);
+    }
+
+  g_dbus_connection_signal_unsubscribe (data.worker->connection, subscription_id);
+  g_main_context_pop_thread_default (context);
+  photos_thumbnail_factory_release_worker (self, data.worker);
+
+  if (data.error != NULL)
+    {
+      g_propagate_error (error, data.error);
+      goto out;
     }
 
+  ret_val = TRUE;
+
+ out:
   return ret_val;
 }
+
+
+void
+photos_thumbnail_factory_request_clear (PhotosThumbnailFactoryRequest *request)
+{
+  g_clear_object (&request->cancellable);
+  g_clear_object (&request->file);
+  g_clear_pointer (&request->mime_type, g_free);
+  g_clear_pointer (&request->pipeline_uris, g_strfreev);
+  g_clear_pointer (&request->thumbnail_path, g_free);
+}
@@ -26,6 +26,22 @@ G_BEGIN_DECLS
 #define PHOTOS_TYPE_THUMBNAIL_FACTORY (photos_thumbnail_factory_get_type ())
 G_DECLARE_FINAL_TYPE (PhotosThumbnailFactory, photos_thumbnail_factory, PHOTOS, THUMBNAIL_FACTORY, GObject);
 
+typedef struct _PhotosThumbnailFactoryRequest PhotosThumbnailFactoryRequest;
+
+struct _PhotosThumbnailFactoryRequest
+{
+  GFile *file;
+  gchar *mime_type;
+  GQuark orientation;
+  gint64 original_height;
+  gint64 original_width;
+  GStrv pipeline_uris;
+  gchar *thumbnail_path;
+  GCancellable *cancellable;
+};
+
+typedef void (*PhotosThumbnailFactoryGeneratedFunc) (guint index, const GError *error, gpointer user_data);
+
 PhotosThumbnailFactory  *photos_thumbnail_factory_dup_singleton          (GCancellable *cancellable,
                                                                           GError **error);
 
@@ -40,6 +56,16 @@ gboolean                 photos_thumbnail_factory_generate_thumbnail     (Photos
                                                                           GCancellable *cancellable,
                                                                           GError **error);
 
+gboolean                 photos_thumbnail_factory_generate_thumbnails    (PhotosThumbnailFactory *self,
+                                                                          const PhotosThumbnailFactoryRequest *requests,
+                                                                          guint n_requests,
+                                                                          PhotosThumbnailFactoryGeneratedFunc func,
+                                                                          gpointer user_data,
+                                                                          GCancellable *cancellable,
+                                                                          GError **error);
+
+void                     photos_thumbnail_factory_request_clear          (PhotosThumbnailFactoryRequest *request);
+
 G_END_DECLS
 
 #endif /* PHOTOS_THUMBNAIL_FACTORY_H */
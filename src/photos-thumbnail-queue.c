@@ -0,0 +1,258 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Pending thumbnail jobs, in order of priority. There is at most one
+ * job for each source object. Pushing a task for an object that
+ * already has one queued replaces the older task in place, so that the
+ * job keeps its position, and hands the older task back to the caller
+ * to be completed.
+ *
+ * The queue is not thread-safe. The caller is expected to hold a lock
+ * around every call.
+ */
+
+
+#include "config.h"
+
+#include "photos-thumbnail-queue.h"
+
+
+struct _PhotosThumbnailQueue
+{
+  GHashTable *links;
+  GQueue queues[PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES];
+};
+
+typedef struct _PhotosThumbnailQueueJob PhotosThumbnailQueueJob;
+
+struct _PhotosThumbnailQueueJob
+{
+  GTask *task;
+  PhotosThumbnailQueuePriority default_priority;
+  PhotosThumbnailQueuePriority priority;
+};
+
+
+static void
+photos_thumbnail_queue_job_free (PhotosThumbnailQueueJob *job)
+{
+  g_clear_object (&job->task);
+  g_slice_free (PhotosThumbnailQueueJob, job);
+}
+
+
+static void
+photos_thumbnail_queue_insert (PhotosThumbnailQueue *self,
+                               PhotosThumbnailQueueJob *job,
+                               PhotosThumbnailQueuePriority priority,
+                               gboolean head)
+{
+  GList *link;
+  GQueue *queue;
+  gpointer source_object;
+
+  queue = &self->queues[priority];
+  job->priority = priority;
+
+  if (head)
+    {
+      g_queue_push_head (queue, job);
+      link = queue->head;
+    }
+  else
+    {
+      g_queue_push_tail (queue, job);
+      link = queue->tail;
+    }
+
+  source_object = g_task_get_source_object (job->task);
+  g_hash_table_insert (self->links, source_object, link);
+}
+
+
+static PhotosThumbnailQueueJob *
+photos_thumbnail_queue_remove (PhotosThumbnailQueue *self, GList *link)
+{
+  PhotosThumbnailQueueJob *job = (PhotosThumbnailQueueJob *) link->data;
+  gpointer source_object;
+
+  source_object = g_task_get_source_object (job->task);
+  g_hash_table_remove (self->links, source_object);
+  g_queue_delete_link (&self->queues[job->priority], link);
+
+  return job;
+}
+
+
+PhotosThumbnailQueue *
+photos_thumbnail_queue_new (void)
+{
+  PhotosThumbnailQueue *self;
+  guint i;
+
+  self = g_slice_new0 (PhotosThumbnailQueue);
+  self->links = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (i = 0; i < PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES; i++)
+    g_queue_init (&self->queues[i]);
+
+  return self;
+}
+
+
+void
+photos_thumbnail_queue_free (PhotosThumbnailQueue *self)
+{
+  guint i;
+
+  if (self == NULL)
+    return;
+
+  for (i = 0; i < PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES; i++)
+    g_queue_clear_full (&self->queues[i], (GDestroyNotify) photos_thumbnail_queue_job_free);
+
+  g_hash_table_unref (self->links);
+  g_slice_free (PhotosThumbnailQueue, self);
+}
+
+
+void
+photos_thumbnail_queue_demote_all (PhotosThumbnailQueue *self)
+{
+  GList *link;
+
+  /* Jobs that are no longer visible go back to the head of their usual
+   * queue, in the same order, since they are likely to be scrolled back
+   * into view before the rest.
+   */
+  while ((link = self->queues[PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE].tail) != NULL)
+    {
+      PhotosThumbnailQueueJob *job;
+
+      job = photos_thumbnail_queue_remove (self, link);
+      photos_thumbnail_queue_insert (self, job, job->default_priority, TRUE);
+    }
+}
+
+
+guint
+photos_thumbnail_queue_get_length (PhotosThumbnailQueue *self, PhotosThumbnailQueuePriority priority)
+{
+  g_return_val_if_fail (priority < PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES, 0);
+  return self->queues[priority].length;
+}
+
+
+GTask *
+photos_thumbnail_queue_pop (PhotosThumbnailQueue *self)
+{
+  GTask *ret_val = NULL;
+  guint i;
+
+  for (i = 0; i < PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES && ret_val == NULL; i++)
+    {
+      PhotosThumbnailQueueJob *job;
+
+      if (self->queues[i].head == NULL)
+        continue;
+
+      job = photos_thumbnail_queue_remove (self, self->queues[i].head);
+      ret_val = g_steal_pointer (&job->task);
+      photos_thumbnail_queue_job_free (job);
+    }
+
+  return ret_val;
+}
+
+
+guint
+photos_thumbnail_queue_pop_n (PhotosThumbnailQueue *self,
+                              PhotosThumbnailQueuePriority priority,
+                              GTask **tasks,
+                              guint n_tasks_max)
+{
+  guint ret_val = 0;
+
+  g_return_val_if_fail (priority < PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES, 0);
+  g_return_val_if_fail (tasks != NULL || n_tasks_max == 0, 0);
+
+  while (ret_val < n_tasks_max && self->queues[priority].head != NULL)
+    {
+      PhotosThumbnailQueueJob *job;
+
+      job = photos_thumbnail_queue_remove (self, self->queues[priority].head);
+      tasks[ret_val] = g_steal_pointer (&job->task);
+      photos_thumbnail_queue_job_free (job);
+      ret_val++;
+    }
+
+  return ret_val;
+}
+
+
+gboolean
+photos_thumbnail_queue_promote (PhotosThumbnailQueue *self, gpointer source_object)
+{
+  GList *link;
+  PhotosThumbnailQueueJob *job;
+  gboolean ret_val = FALSE;
+
+  link = (GList *) g_hash_table_lookup (self->links, source_object);
+  if (link == NULL)
+    goto out;
+
+  job = photos_thumbnail_queue_remove (self, link);
+  photos_thumbnail_queue_insert (self, job, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE, FALSE);
+  ret_val = TRUE;
+
+ out:
+  return ret_val;
+}
+
+
+GTask *
+photos_thumbnail_queue_push (PhotosThumbnailQueue *self, GTask *task, PhotosThumbnailQueuePriority priority)
+{
+  GList *link;
+  GTask *ret_val = NULL;
+  PhotosThumbnailQueueJob *job;
+  gpointer source_object;
+
+  g_return_val_if_fail (G_IS_TASK (task), NULL);
+  g_return_val_if_fail (priority < PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES, NULL);
+
+  source_object = g_task_get_source_object (task);
+  g_return_val_if_fail (source_object != NULL, NULL);
+
+  link = (GList *) g_hash_table_lookup (self->links, source_object);
+  if (link != NULL)
+    {
+      job = (PhotosThumbnailQueueJob *) link->data;
+      ret_val = job->task;
+      job->task = task;
+      goto out;
+    }
+
+  job = g_slice_new0 (PhotosThumbnailQueueJob);
+  job->task = task;
+  job->default_priority = priority;
+  photos_thumbnail_queue_insert (self, job, priority, FALSE);
+
+ out:
+  return ret_val;
+}
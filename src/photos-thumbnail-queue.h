@@ -0,0 +1,62 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOS_THUMBNAIL_QUEUE_H
+#define PHOTOS_THUMBNAIL_QUEUE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE,
+  PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL,
+  PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE,
+  PHOTOS_THUMBNAIL_QUEUE_N_PRIORITIES
+} PhotosThumbnailQueuePriority;
+
+typedef struct _PhotosThumbnailQueue PhotosThumbnailQueue;
+
+PhotosThumbnailQueue  *photos_thumbnail_queue_new                 (void);
+
+void                   photos_thumbnail_queue_free                (PhotosThumbnailQueue *self);
+
+void                   photos_thumbnail_queue_demote_all          (PhotosThumbnailQueue *self);
+
+guint                  photos_thumbnail_queue_get_length          (PhotosThumbnailQueue *self,
+                                                                   PhotosThumbnailQueuePriority priority);
+
+GTask                 *photos_thumbnail_queue_pop                 (PhotosThumbnailQueue *self);
+
+guint                  photos_thumbnail_queue_pop_n               (PhotosThumbnailQueue *self,
+                                                                   PhotosThumbnailQueuePriority priority,
+                                                                   GTask **tasks,
+                                                                   guint n_tasks_max);
+
+gboolean               photos_thumbnail_queue_promote             (PhotosThumbnailQueue *self, gpointer source_object);
+
+GTask                 *photos_thumbnail_queue_push                (PhotosThumbnailQueue *self,
+                                                                   GTask *task,
+                                                                   PhotosThumbnailQueuePriority priority);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PhotosThumbnailQueue, photos_thumbnail_queue_free);
+
+G_END_DECLS
+
+#endif /* PHOTOS_THUMBNAIL_QUEUE_H */
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <locale.h>
+#include <math.h>
 #include <stdlib.h>
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -39,17 +40,42 @@ struct _PhotosThumbnailer
 {
   GApplication parent_instance;
   GDBusConnection *connection;
+  GHashTable *batches;
   GHashTable *cancellables;
   PhotosThumbnailerDBus *skeleton;
   gchar *address;
+  guint max_concurrent_thumbnails;
 };
 
 
 G_DEFINE_TYPE (PhotosThumbnailer, photos_thumbnailer, G_TYPE_APPLICATION);
 
 
+typedef struct _PhotosThumbnailerBatch PhotosThumbnailerBatch;
+typedef struct _PhotosThumbnailerBatchItem PhotosThumbnailerBatchItem;
 typedef struct _PhotosThumbnailerGenerateData PhotosThumbnailerGenerateData;
 
+struct _PhotosThumbnailerBatchItem
+{
+  GCancellable *cancellable;
+  PhotosThumbnailerBatch *batch;
+  guint index;
+};
+
+struct _PhotosThumbnailerBatch
+{
+  GCancellable *cancellable;
+  GDBusMethodInvocation *invocation;
+  GVariant *thumbnails;
+  PhotosThumbnailerBatchItem *items;
+  gint thumbnail_size;
+  gulong cancelled_id;
+  guint32 serial;
+  guint n_completed;
+  guint n_items;
+  guint n_started;
+};
+
 struct _PhotosThumbnailerGenerateData
 {
   GFile *file;
@@ -57,6 +83,7 @@ struct _PhotosThumbnailerGenerateData
   GQuark orientation;
   GdkPixbuf *pixbuf_thumbnail;
   GeglNode *graph;
+  GeglRectangle load_region;
   PhotosPipeline *pipeline;
   gchar *thumbnail_path;
   gint thumbnail_size;
@@ -79,6 +106,70 @@ static const GOptionEntry COMMAND_LINE_OPTIONS[] =
 static const gchar *THUMBNAILER_PATH = "/org/gnome/Photos/Thumbnailer";
 
 
+static void
+photos_thumbnailer_batch_cancelled (GCancellable *cancellable, gpointer user_data)
+{
+  PhotosThumbnailerBatch *batch = (PhotosThumbnailerBatch *) user_data;
+  guint i;
+
+  for (i = 0; i < batch->n_items; i++)
+    g_cancellable_cancel (batch->items[i].cancellable);
+}
+
+
+static void
+photos_thumbnailer_batch_free (PhotosThumbnailerBatch *batch)
+{
+  guint i;
+
+  g_cancellable_disconnect (batch->cancellable, batch->cancelled_id);
+
+  for (i = 0; i < batch->n_items; i++)
+    g_object_unref (batch->items[i].cancellable);
+
+  g_free (batch->items);
+  g_object_unref (batch->cancellable);
+  g_object_unref (batch->invocation);
+  g_variant_unref (batch->thumbnails);
+  g_slice_free (PhotosThumbnailerBatch, batch);
+}
+
+
+static PhotosThumbnailerBatch *
+photos_thumbnailer_batch_new (GDBusMethodInvocation *invocation, GVariant *thumbnails, gint thumbnail_size)
+{
+  GDBusMessage *message;
+  PhotosThumbnailerBatch *batch;
+  guint i;
+
+  batch = g_slice_new0 (PhotosThumbnailerBatch);
+  batch->cancellable = g_cancellable_new ();
+  batch->invocation = g_object_ref (invocation);
+  batch->thumbnails = g_variant_ref (thumbnails);
+  batch->thumbnail_size = thumbnail_size;
+
+  message = g_dbus_method_invocation_get_message (invocation);
+  batch->serial = g_dbus_message_get_serial (message);
+
+  batch->n_items = (guint) g_variant_n_children (thumbnails);
+  batch->items = g_new0 (PhotosThumbnailerBatchItem, batch->n_items);
+
+  for (i = 0; i < batch->n_items; i++)
+    {
+      batch->items[i].batch = batch;
+      batch->items[i].cancellable = g_cancellable_new ();
+      batch->items[i].index = i;
+    }
+
+  batch->cancelled_id = g_cancellable_connect (batch->cancellable,
+                                               G_CALLBACK (photos_thumbnailer_batch_cancelled),
+                                               batch,
+                                               NULL);
+
+  return batch;
+}
+
+
 static void
 photos_thumbnailer_generate_data_free (PhotosThumbnailerGenerateData *data)
 {
@@ -371,7 +462,11 @@ photos_thumbnailer_generate_thumbnail_pixbuf (GObject *source_object, GAsyncResu
   {
     g_autoptr (GError) error = NULL;
 
-    pixbuf = photos_pixbuf_new_from_file_at_size_finish (res, &error);
+    if (data->load_region.width > 0)
+      pixbuf = photos_pixbuf_new_from_file_region_finish (res, &error);
+    else
+      pixbuf = photos_pixbuf_new_from_file_at_size_finish (res, &error);
+
     if (error != NULL)
       {
         g_task_return_error (task, g_steal_pointer (&error));
@@ -384,7 +479,25 @@ photos_thumbnailer_generate_thumbnail_pixbuf (GObject *source_object, GAsyncResu
 
   buffer_source = gegl_node_new_child (data->graph, "operation", "gegl:buffer-source", "buffer", buffer_oriented, NULL);
   pipeline_node = photos_pipeline_get_graph (data->pipeline);
-  gegl_node_link (buffer_source, pipeline_node);
+
+  /* Only the cropped region was decoded, so move it back to where the
+   * crop in the pipeline expects it to be.
+   */
+  if (data->load_region.width > 0)
+    {
+      GeglNode *translate;
+
+      translate = gegl_node_new_child (data->graph,
+                                       "operation", "gegl:translate",
+                                       "x", (gdouble) data->load_region.x,
+                                       "y", (gdouble) data->load_region.y,
+                                       NULL);
+      gegl_node_link_many (buffer_source, translate, pipeline_node, NULL);
+    }
+  else
+    {
+      gegl_node_link (buffer_source, pipeline_node);
+    }
 
   processor = gegl_node_new_processor (pipeline_node, NULL);
   photos_gegl_processor_process_async (processor,
@@ -451,11 +564,41 @@ photos_thumbnailer_generate_thumbnail_pipeline (GObject *source_object, GAsyncRe
         }
     }
 
-  if (has_crop
-      || (0 < data->original_height
-          && data->original_height < data->thumbnail_size
-          && 0 < data->original_width
-          && data->original_width < data->thumbnail_size))
+  path = g_file_get_path (data->file);
+  if (!g_file_is_native (data->file))
+    photos_debug (PHOTOS_DEBUG_NETWORK, "Downloading %s (%s)", uri, path);
+
+  if (has_crop)
+    {
+      gint x1 = (gint) floor (x);
+      gint x2 = (gint) ceil (x + width);
+      gint y1 = (gint) floor (y);
+      gint y2 = (gint) ceil (y + height);
+
+      /* Decode only the part of the original that survives the crop. */
+      gegl_rectangle_set (&data->load_region, x1, y1, (guint) MAX (x2 - x1, 1), (guint) MAX (y2 - y1, 1));
+
+      photos_debug (PHOTOS_DEBUG_THUMBNAILER,
+                    "Loading %s at %d, %d, %d×%d",
+                    uri,
+                    data->load_region.x,
+                    data->load_region.y,
+                    data->load_region.width,
+                    data->load_region.height);
+
+      photos_pixbuf_new_from_file_region_async (path,
+                                                data->orientation,
+                                                &data->load_region,
+                                                cancellable,
+                                                photos_thumbnailer_generate_thumbnail_pixbuf,
+                                                g_object_ref (task));
+      goto out;
+    }
+
+  if (0 < data->original_height
+      && data->original_height < data->thumbnail_size
+      && 0 < data->original_width
+      && data->original_width < data->thumbnail_size)
     {
       load_height = (gint) data->original_height;
       load_width = (gint) data->original_width;
@@ -466,10 +609,6 @@ photos_thumbnailer_generate_thumbnail_pipeline (GObject *source_object, GAsyncRe
       load_width = data->thumbnail_size;
     }
 
-  path = g_file_get_path (data->file);
-  if (!g_file_is_native (data->file))
-    photos_debug (PHOTOS_DEBUG_NETWORK, "Downloading %s (%s)", uri, path);
-
   photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Loading %s at %d×%d", uri, load_width, load_height);
   photos_pixbuf_new_from_file_at_size_async (path,
                                              load_width,
@@ -667,6 +806,196 @@ photos_thumbnailer_handle_generate_thumbnail (PhotosThumbnailer *self,
 }
 
 
+static gboolean
+photos_thumbnailer_handle_cancel_thumbnail (PhotosThumbnailer *self,
+                                            GDBusMethodInvocation *invocation,
+                                            guint serial,
+                                            guint index)
+{
+  GDBusConnection *connection;
+  GHashTableIter iter;
+  PhotosThumbnailerBatch *batch;
+
+  g_return_val_if_fail (PHOTOS_IS_THUMBNAILER (self), FALSE);
+  g_return_val_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation), FALSE);
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Handling CancelThumbnail for %u, %u", serial, index);
+  g_application_hold (G_APPLICATION (self));
+
+  connection = g_dbus_method_invocation_get_connection (invocation);
+
+  g_hash_table_iter_init (&iter, self->batches);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &batch))
+    {
+      GDBusConnection *connection_ongoing;
+
+      connection_ongoing = g_dbus_method_invocation_get_connection (batch->invocation);
+      if (connection == connection_ongoing && (guint32) serial == batch->serial)
+        {
+          if (index >= batch->n_items)
+            break;
+
+          g_cancellable_cancel (batch->items[index].cancellable);
+          photos_thumbnailer_dbus_complete_cancel_thumbnail (self->skeleton, invocation);
+          goto out;
+        }
+    }
+
+  g_dbus_method_invocation_return_error_literal (invocation, PHOTOS_ERROR, 0, "Invalid serial or index");
+
+ out:
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Completed CancelThumbnail");
+  g_application_release (G_APPLICATION (self));
+  return TRUE;
+}
+
+
+static void photos_thumbnailer_batch_continue (PhotosThumbnailer *self, PhotosThumbnailerBatch *batch);
+
+
+static void
+photos_thumbnailer_batch_item_completed (PhotosThumbnailer *self, PhotosThumbnailerBatchItem *item, GError *error)
+{
+  PhotosThumbnailerBatch *batch = item->batch;
+  const gchar *error_message = "";
+  g_autofree gchar *error_name = NULL;
+
+  if (error != NULL)
+    {
+      error_name = g_dbus_error_encode_gerror (error);
+      error_message = error->message;
+    }
+
+  photos_thumbnailer_dbus_emit_thumbnail_generated (self->skeleton,
+                                                    batch->serial,
+                                                    item->index,
+                                                    error_name == NULL ? "" : error_name,
+                                                    error_message);
+  batch->n_completed++;
+}
+
+
+static void
+photos_thumbnailer_handle_generate_thumbnails_generate_thumbnail (GObject *source_object,
+                                                                  GAsyncResult *res,
+                                                                  gpointer user_data)
+{
+  PhotosThumbnailer *self = PHOTOS_THUMBNAILER (source_object);
+  g_autoptr (GError) error = NULL;
+  PhotosThumbnailerBatchItem *item = (PhotosThumbnailerBatchItem *) user_data;
+
+  photos_thumbnailer_generate_thumbnail_finish (self, res, &error);
+  photos_thumbnailer_batch_item_completed (self, item, error);
+  photos_thumbnailer_batch_continue (self, item->batch);
+}
+
+
+static void
+photos_thumbnailer_batch_continue (PhotosThumbnailer *self, PhotosThumbnailerBatch *batch)
+{
+  while (batch->n_started < batch->n_items
+         && batch->n_started - batch->n_completed < self->max_concurrent_thumbnails)
+    {
+      g_autoptr (GVariant) pipeline_uris_variant = NULL;
+      PhotosThumbnailerBatchItem *item;
+      const gchar *mime_type;
+      const gchar *orientation;
+      const gchar *thumbnail_path;
+      const gchar *uri;
+      g_auto (GStrv) pipeline_uris = NULL;
+      gint64 original_height;
+      gint64 original_width;
+
+      item = &batch->items[batch->n_started];
+      batch->n_started++;
+
+      g_variant_get_child (batch->thumbnails,
+                           item->index,
+                           "(&s&s&sxx@as&s)",
+                           &uri,
+                           &mime_type,
+                           &orientation,
+                           &original_height,
+                           &original_width,
+                           &pipeline_uris_variant,
+                           &thumbnail_path);
+
+      if (uri[0] == '\0' || mime_type[0] == '\0' || orientation[0] == '\0' || thumbnail_path[0] == '\0')
+        {
+          g_autoptr (GError) error = NULL;
+
+          error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid thumbnail parameters");
+          photos_thumbnailer_batch_item_completed (self, item, error);
+          continue;
+        }
+
+      photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Generating thumbnail %u of %u for %s", item->index, batch->n_items, uri);
+
+      pipeline_uris = g_variant_dup_strv (pipeline_uris_variant, NULL);
+      photos_thumbnailer_generate_thumbnail_async (self,
+                                                   uri,
+                                                   mime_type,
+                                                   orientation,
+                                                   original_height,
+                                                   original_width,
+                                                   (const gchar *const *) pipeline_uris,
+                                                   thumbnail_path,
+                                                   batch->thumbnail_size,
+                                                   item->cancellable,
+                                                   photos_thumbnailer_handle_generate_thumbnails_generate_thumbnail,
+                                                   item);
+    }
+
+  if (batch->n_completed < batch->n_items)
+    return;
+
+  if (g_cancellable_is_cancelled (batch->cancellable))
+    {
+      g_dbus_method_invocation_return_error_literal (batch->invocation,
+                                                     G_IO_ERROR,
+                                                     G_IO_ERROR_CANCELLED,
+                                                     "Operation was cancelled");
+    }
+  else
+    {
+      photos_thumbnailer_dbus_complete_generate_thumbnails (self->skeleton, batch->invocation);
+    }
+
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Completed GenerateThumbnails");
+
+  g_hash_table_remove (self->batches, batch->invocation);
+  g_hash_table_remove (self->cancellables, batch->invocation);
+  photos_thumbnailer_batch_free (batch);
+
+  g_application_release (G_APPLICATION (self));
+}
+
+
+static gboolean
+photos_thumbnailer_handle_generate_thumbnails (PhotosThumbnailer *self,
+                                               GDBusMethodInvocation *invocation,
+                                               GVariant *thumbnails,
+                                               gint thumbnail_size)
+{
+  PhotosThumbnailerBatch *batch;
+
+  g_return_val_if_fail (PHOTOS_IS_THUMBNAILER (self), FALSE);
+  g_return_val_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation), FALSE);
+  g_return_val_if_fail (g_variant_is_of_type (thumbnails, G_VARIANT_TYPE ("a(sssxxass)")), FALSE);
+
+  batch = photos_thumbnailer_batch_new (invocation, thumbnails, thumbnail_size);
+  photos_debug (PHOTOS_DEBUG_THUMBNAILER, "Handling GenerateThumbnails for %u thumbnails", batch->n_items);
+
+  g_hash_table_insert (self->batches, invocation, batch);
+  g_hash_table_insert (self->cancellables, g_object_ref (invocation), g_object_ref (batch->cancellable));
+
+  g_application_hold (G_APPLICATION (self));
+  photos_thumbnailer_batch_continue (self, batch);
+
+  return TRUE;
+}
+
+
 static gboolean
 photos_thumbnailer_dbus_register (GApplication *application,
                                   GDBusConnection *connection,
@@ -704,10 +1033,18 @@ photos_thumbnailer_dbus_register (GApplication *application,
                             "handle-cancel",
                             G_CALLBACK (photos_thumbnailer_handle_cancel),
                             self);
+  g_signal_connect_swapped (self->skeleton,
+                            "handle-cancel-thumbnail",
+                            G_CALLBACK (photos_thumbnailer_handle_cancel_thumbnail),
+                            self);
   g_signal_connect_swapped (self->skeleton,
                             "handle-generate-thumbnail",
                             G_CALLBACK (photos_thumbnailer_handle_generate_thumbnail),
                             self);
+  g_signal_connect_swapped (self->skeleton,
+                            "handle-generate-thumbnails",
+                            G_CALLBACK (photos_thumbnailer_handle_generate_thumbnails),
+                            self);
 
   if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->skeleton),
                                          self->connection,
@@ -783,6 +1120,7 @@ photos_thumbnailer_dispose (GObject *object)
   g_assert_null (self->skeleton);
 
   g_clear_object (&self->connection);
+  g_clear_pointer (&self->batches, g_hash_table_unref);
   g_clear_pointer (&self->cancellables, g_hash_table_unref);
 
   G_OBJECT_CLASS (photos_thumbnailer_parent_class)->dispose (object);
@@ -814,7 +1152,9 @@ photos_thumbnailer_init (PhotosThumbnailer *self)
 
   photos_gegl_ensure_builtins ();
 
+  self->batches = g_hash_table_new (g_direct_hash, g_direct_equal);
   self->cancellables = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, g_object_unref);
+  self->max_concurrent_thumbnails = MAX (g_get_num_processors () / 2, 1U);
   g_application_add_main_option_entries (G_APPLICATION (self), COMMAND_LINE_OPTIONS);
 }
 
@@ -62,6 +62,19 @@ struct _PhotosTrackerControllerPrivate
   guint reset_count_id;
 };
 
+/* Each page is timed and counted on its own, because a refresh can
+ * start the next one while the cursor of the previous one is still
+ * being walked.
+ */
+typedef struct _PhotosTrackerControllerPage PhotosTrackerControllerPage;
+
+struct _PhotosTrackerControllerPage
+{
+  PhotosTrackerController *tracker_cntrlr;
+  gint64 start_time;
+  guint n_rows;
+};
+
 enum
 {
   PROP_0,
@@ -97,6 +110,39 @@ static void photos_tracker_controller_refresh_internal (PhotosTrackerController
 static void photos_tracker_controller_set_query_status (PhotosTrackerController *self, gboolean query_status);
 
 
+static PhotosTrackerControllerPage *
+photos_tracker_controller_page_new (PhotosTrackerController *self)
+{
+  PhotosTrackerControllerPage *page;
+
+  page = g_rc_box_new0 (PhotosTrackerControllerPage);
+  page->tracker_cntrlr = g_object_ref (self);
+  page->start_time = g_get_monotonic_time ();
+  return page;
+}
+
+
+static void
+photos_tracker_controller_page_clear (PhotosTrackerControllerPage *page)
+{
+  g_object_unref (page->tracker_cntrlr);
+}
+
+
+static PhotosTrackerControllerPage *
+photos_tracker_controller_page_ref (PhotosTrackerControllerPage *page)
+{
+  return (PhotosTrackerControllerPage *) g_rc_box_acquire (page);
+}
+
+
+static void
+photos_tracker_controller_page_unref (PhotosTrackerControllerPage *page)
+{
+  g_rc_box_release_full (page, (GDestroyNotify) photos_tracker_controller_page_clear);
+}
+
+
 static gboolean
 photos_tracker_controller_reset_count_timeout (gpointer user_data)
 {
@@ -174,12 +220,17 @@ photos_tracker_controller_query_error (PhotosTrackerController *self, GError *er
 
 
 static void
-photos_tracker_controller_query_finished (PhotosTrackerController *self, GError *error)
+photos_tracker_controller_query_finished (PhotosTrackerControllerPage *page, GError *error)
 {
+  PhotosTrackerController *self = page->tracker_cntrlr;
   PhotosTrackerControllerPrivate *priv;
+  gint64 latency = -1;
 
   priv = photos_tracker_controller_get_instance_private (self);
 
+  if (error == NULL)
+    latency = g_get_monotonic_time () - page->start_time;
+
   photos_tracker_controller_set_query_status (self, FALSE);
 
   if (error != NULL)
@@ -192,13 +243,19 @@ photos_tracker_controller_query_finished (PhotosTrackerController *self, GError
       priv->query_queued = FALSE;
       photos_tracker_controller_refresh_internal (self, priv->query_queued_flags);
     }
+
+  /* This can start the next page, so it comes after the queued
+   * refresh.
+   */
+  photos_offset_controller_page_finished (priv->offset_cntrlr, page->n_rows, latency);
 }
 
 
 static void
 photos_tracker_controller_cursor_next (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-  g_autoptr (PhotosTrackerController) self = PHOTOS_TRACKER_CONTROLLER (user_data);
+  PhotosTrackerControllerPage *page = (PhotosTrackerControllerPage *) user_data;
+  PhotosTrackerController *self = page->tracker_cntrlr;
   PhotosTrackerControllerPrivate *priv;
   TrackerSparqlCursor *cursor = TRACKER_SPARQL_CURSOR (source_object);
   gboolean success;
@@ -218,7 +275,7 @@ photos_tracker_controller_cursor_next (GObject *source_object, GAsyncResult *res
     success = tracker_sparql_cursor_next_finish (cursor, res, &error);
     if (error != NULL)
       {
-        photos_tracker_controller_query_finished (self, error);
+        photos_tracker_controller_query_finished (page, error);
         goto out;
       }
   }
@@ -226,7 +283,7 @@ photos_tracker_controller_cursor_next (GObject *source_object, GAsyncResult *res
   if (!success)
     {
       tracker_sparql_cursor_close (cursor);
-      photos_tracker_controller_query_finished (self, NULL);
+      photos_tracker_controller_query_finished (page, NULL);
       goto out;
     }
 
@@ -240,33 +297,35 @@ photos_tracker_controller_cursor_next (GObject *source_object, GAsyncResult *res
                                          priv->mode,
                                          cursor);
 
+  photos_offset_controller_update_key (priv->offset_cntrlr, cursor);
+  page->n_rows++;
+
   tracker_sparql_cursor_next_async (cursor,
                                     priv->cancellable,
                                     photos_tracker_controller_cursor_next,
-                                    g_object_ref (self));
+                                    photos_tracker_controller_page_ref (page));
 
  out:
-  return;
+  photos_tracker_controller_page_unref (page);
 }
 
 
 static void
 photos_tracker_controller_query_executed (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-  PhotosTrackerController *self = PHOTOS_TRACKER_CONTROLLER (user_data);
+  PhotosTrackerControllerPage *page = (PhotosTrackerControllerPage *) user_data;
   PhotosTrackerControllerPrivate *priv;
-  TrackerSparqlConnection *connection = TRACKER_SPARQL_CONNECTION (source_object);
   TrackerSparqlCursor *cursor; /* Use g_autoptr */
 
-  priv = photos_tracker_controller_get_instance_private (self);
+  priv = photos_tracker_controller_get_instance_private (page->tracker_cntrlr);
 
   {
     g_autoptr (GError) error = NULL;
 
-    cursor = tracker_sparql_connection_query_finish (connection, res, &error);
+    cursor = photos_tracker_queue_select_finish (source_object, res, &error);
     if (error != NULL)
       {
-        photos_tracker_controller_query_finished (self, error);
+        photos_tracker_controller_query_finished (page, error);
         return;
       }
   }
@@ -274,7 +333,7 @@ photos_tracker_controller_query_executed (GObject *source_object, GAsyncResult *
   tracker_sparql_cursor_next_async (cursor,
                                     priv->cancellable,
                                     photos_tracker_controller_cursor_next,
-                                    g_object_ref (self));
+                                    photos_tracker_controller_page_ref (page));
   g_object_unref (cursor);
 }
 
@@ -305,12 +364,14 @@ photos_tracker_controller_perform_current_query (PhotosTrackerController *self)
       goto out;
     }
 
+  photos_offset_controller_page_started (priv->offset_cntrlr);
+
   photos_tracker_queue_select (priv->queue,
                                priv->current_query,
                                priv->cancellable,
                                photos_tracker_controller_query_executed,
-                               g_object_ref (self),
-                               g_object_unref);
+                               photos_tracker_controller_page_new (self),
+                               (GDestroyNotify) photos_tracker_controller_page_unref);
 
  out:
   return;
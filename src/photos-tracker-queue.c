@@ -31,23 +31,6 @@
 #include "photos-tracker-queue.h"
 
 
-struct _PhotosTrackerQueue
-{
-  GObject parent_instance;
-  GError *initialization_error;
-  GQueue *queue;
-  TrackerSparqlConnection *connection;
-  gboolean is_initialized;
-  gboolean running;
-};
-
-static void photos_tracker_queue_initable_iface_init (GInitableIface *iface);
-
-
-G_DEFINE_TYPE_WITH_CODE (PhotosTrackerQueue, photos_tracker_queue, G_TYPE_OBJECT,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, photos_tracker_queue_initable_iface_init));
-
-
 typedef enum
 {
   PHOTOS_TRACKER_QUERY_SELECT,
@@ -55,7 +38,45 @@ typedef enum
   PHOTOS_TRACKER_QUERY_UPDATE_BLANK
 } PhotosTrackerQueryType;
 
+/* Queries are scheduled in three classes. SELECTs from the two read
+ * classes run concurrently up to a limit, with the interactive ones
+ * always being picked first. Writes run one at a time in the order in
+ * which they were queued, and a SELECT that was queued after a write
+ * doesn't start until the write is done, so that it sees the changes.
+ */
+typedef enum
+{
+  PHOTOS_TRACKER_QUEUE_KIND_INTERACTIVE,
+  PHOTOS_TRACKER_QUEUE_KIND_BACKGROUND,
+  PHOTOS_TRACKER_QUEUE_KIND_WRITE,
+  PHOTOS_TRACKER_QUEUE_N_KINDS
+} PhotosTrackerQueueKind;
+
 typedef struct _PhotosTrackerQueueData PhotosTrackerQueueData;
+typedef struct _PhotosTrackerQueueStats PhotosTrackerQueueStats;
+
+struct _PhotosTrackerQueueStats
+{
+  gint64 execution_time;
+  gint64 wait_time;
+  guint n_queries;
+};
+
+struct _PhotosTrackerQueue
+{
+  GObject parent_instance;
+  GError *initialization_error;
+  GHashTable *statements;
+  GHashTable *statements_busy;
+  GQueue pending[PHOTOS_TRACKER_QUEUE_N_KINDS];
+  PhotosTrackerQueueData *write_running;
+  PhotosTrackerQueueStats stats[PHOTOS_TRACKER_QUEUE_N_KINDS];
+  TrackerSparqlConnection *connection;
+  gboolean is_initialized;
+  guint n_running[PHOTOS_TRACKER_QUEUE_N_KINDS];
+  guint n_selects_max;
+  guint64 serial;
+};
 
 struct _PhotosTrackerQueueData
 {
@@ -64,12 +85,35 @@ struct _PhotosTrackerQueueData
   GDestroyNotify destroy_data;
   PhotosQuery *query;
   PhotosTrackerQueryType query_type;
+  PhotosTrackerQueue *queue;
+  PhotosTrackerQueueKind kind;
+  TrackerSparqlStatement *statement;
+  gint64 queued_time;
+  gint64 start_time;
   gpointer user_data;
+  guint64 serial;
 };
 
+static void photos_tracker_queue_initable_iface_init (GInitableIface *iface);
+
+
+G_DEFINE_TYPE_WITH_CODE (PhotosTrackerQueue, photos_tracker_queue, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, photos_tracker_queue_initable_iface_init));
+
 
 G_LOCK_DEFINE_STATIC (init_lock);
 
+static const gchar *KIND_NAMES[PHOTOS_TRACKER_QUEUE_N_KINDS] =
+{
+  "Interactive",
+  "Background",
+  "Write"
+};
+
+static const guint N_SELECTS_DEFAULT = 4;
+static const guint N_SELECTS_MAX = 32;
+static const guint N_STATEMENTS_MAX = 64;
+
 
 static void photos_tracker_queue_check (PhotosTrackerQueue *self);
 
@@ -79,6 +123,8 @@ photos_tracker_queue_data_free (PhotosTrackerQueueData *data)
 {
   g_clear_object (&data->query);
   g_clear_object (&data->cancellable);
+  g_clear_object (&data->queue);
+  g_clear_object (&data->statement);
 
   if (data->destroy_data != NULL)
     (*data->destroy_data) (data->user_data);
@@ -93,6 +139,7 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC (PhotosTrackerQueueData, photos_tracker_queue_data
 static PhotosTrackerQueueData *
 photos_tracker_queue_data_new (PhotosQuery *query,
                                PhotosTrackerQueryType query_type,
+                               PhotosTrackerQueueKind kind,
                                GCancellable *cancellable,
                                GAsyncReadyCallback callback,
                                gpointer user_data,
@@ -104,6 +151,7 @@ photos_tracker_queue_data_new (PhotosQuery *query,
 
   data->query = g_object_ref (query);
   data->query_type = query_type;
+  data->kind = kind;
   data->cancellable = cancellable;
   data->callback = callback;
   data->user_data = user_data;
@@ -113,9 +161,32 @@ photos_tracker_queue_data_new (PhotosQuery *query,
 }
 
 
+static guint
+photos_tracker_queue_get_n_selects_max (void)
+{
+  const gchar *selects_str;
+  guint ret_val = N_SELECTS_DEFAULT;
+
+  selects_str = g_getenv ("GNOME_PHOTOS_TRACKER_SELECTS");
+  if (selects_str != NULL)
+    {
+      g_autoptr (GError) error = NULL;
+      guint64 selects;
+
+      if (g_ascii_string_to_unsigned (selects_str, 10, 1, N_SELECTS_MAX, &selects, &error))
+        ret_val = (guint) selects;
+      else
+        g_warning ("Unable to parse GNOME_PHOTOS_TRACKER_SELECTS: %s", error->message);
+    }
+
+  return ret_val;
+}
+
+
 static void
 photos_tracker_queue_log_query (PhotosQuery *query)
 {
+  GVariant *bindings;
   PhotosSource *source;
   const gchar *sparql;
   const gchar *tag;
@@ -137,40 +208,192 @@ photos_tracker_queue_log_query (PhotosQuery *query)
 
   sparql = photos_query_get_sparql (query);
   photos_debug (PHOTOS_DEBUG_TRACKER, "%s", sparql);
+
+  bindings = photos_query_get_bindings (query);
+  if (bindings != NULL)
+    {
+      g_autofree gchar *bindings_str = NULL;
+
+      bindings_str = g_variant_print (bindings, FALSE);
+      photos_debug (PHOTOS_DEBUG_TRACKER, "Bindings: %s", bindings_str);
+    }
+}
+
+
+static TrackerSparqlStatement *
+photos_tracker_queue_get_statement (PhotosTrackerQueue *self, PhotosQuery *query)
+{
+  GVariant *bindings;
+  GVariant *value;
+  GVariantIter iter;
+  g_autoptr (GTimeZone) utc = NULL;
+  TrackerSparqlStatement *ret_val = NULL;
+  TrackerSparqlStatement *statement;
+  const gchar *name;
+  const gchar *sparql;
+
+  sparql = photos_query_get_sparql (query);
+
+  /* Bound parameters keep the SPARQL of a query the same across
+   * pages and search terms, so Tracker only needs to parse it once
+   * per session.
+   */
+  statement = TRACKER_SPARQL_STATEMENT (g_hash_table_lookup (self->statements, sparql));
+  if (statement == NULL)
+    {
+      g_autoptr (GError) error = NULL;
+
+      /* If it can't be prepared, then the query will fail in the
+       * same way, and the error will reach the caller through the
+       * usual path.
+       */
+      statement = tracker_sparql_connection_query_statement (self->connection, sparql, NULL, &error);
+      if (error != NULL)
+        {
+          g_warning ("Unable to prepare statement: %s", error->message);
+          goto out;
+        }
+
+      if (g_hash_table_size (self->statements) >= N_STATEMENTS_MAX)
+        {
+          photos_debug (PHOTOS_DEBUG_TRACKER, "Discarding %u prepared statements", N_STATEMENTS_MAX);
+          g_hash_table_remove_all (self->statements);
+        }
+
+      g_hash_table_insert (self->statements, g_strdup (sparql), statement);
+      ret_val = g_object_ref (statement);
+    }
+  else if (g_hash_table_contains (self->statements_busy, statement))
+    {
+      g_autoptr (GError) error = NULL;
+
+      /* The bindings of a statement are only consumed when it is
+       * executed, so the cached one can't be re-bound until the query
+       * that is using it is done. Use a separate one that isn't cached,
+       * instead of waiting.
+       */
+      photos_debug (PHOTOS_DEBUG_TRACKER, "Prepared statement is busy, preparing another one");
+
+      statement = tracker_sparql_connection_query_statement (self->connection, sparql, NULL, &error);
+      if (error != NULL)
+        {
+          g_warning ("Unable to prepare statement: %s", error->message);
+          goto out;
+        }
+
+      ret_val = statement;
+    }
+  else
+    {
+      ret_val = g_object_ref (statement);
+    }
+
+  tracker_sparql_statement_clear_bindings (ret_val);
+
+  utc = g_time_zone_new_utc ();
+
+  bindings = photos_query_get_bindings (query);
+  g_variant_iter_init (&iter, bindings);
+  while (g_variant_iter_loop (&iter, "{&sv}", &name, &value))
+    {
+      if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT64))
+        tracker_sparql_statement_bind_int (ret_val, name, g_variant_get_int64 (value));
+      else if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        tracker_sparql_statement_bind_string (ret_val, name, g_variant_get_string (value, NULL));
+      else if (g_variant_is_of_type (value, G_VARIANT_TYPE ("(s)")))
+        {
+          g_autoptr (GDateTime) date_time = NULL;
+          const gchar *iso8601;
+
+          /* A date-time is an ISO 8601 string wrapped in a tuple, to
+           * tell it apart from a plain string. Tracker stores them in
+           * UTC, but leaves out the offset for some values.
+           */
+          g_variant_get (value, "(&s)", &iso8601);
+          date_time = g_date_time_new_from_iso8601 (iso8601, utc);
+          if (date_time == NULL)
+            {
+              /* Binding it as a string would compare it as one, and
+               * silently skip or repeat rows. Leave it unbound, so that
+               * the query fails instead.
+               */
+              g_warning ("Unable to parse date-time for parameter %s: %s", name, iso8601);
+              continue;
+            }
+
+          tracker_sparql_statement_bind_datetime (ret_val, name, date_time);
+        }
+      else
+        g_assert_not_reached ();
+    }
+
+  g_hash_table_add (self->statements_busy, ret_val);
+
+ out:
+  return ret_val;
 }
 
 
 static void
 photos_tracker_queue_collector (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-  g_autoptr (PhotosTrackerQueue) self = PHOTOS_TRACKER_QUEUE (user_data);
-  g_autoptr (PhotosTrackerQueueData) data = NULL;
-
-  photos_debug (PHOTOS_DEBUG_TRACKER, "Query processed");
+  g_autoptr (PhotosTrackerQueue) self = NULL;
+  g_autoptr (PhotosTrackerQueueData) data = (PhotosTrackerQueueData *) user_data;
+  PhotosTrackerQueueStats *stats;
+  gint64 end;
+  gint64 execution_time;
+  gint64 wait_time;
+
+  self = g_steal_pointer (&data->queue);
+
+  end = g_get_monotonic_time ();
+  execution_time = end - data->start_time;
+  wait_time = data->start_time - data->queued_time;
+
+  if (data->statement != NULL)
+    g_hash_table_remove (self->statements_busy, data->statement);
+
+  stats = &self->stats[data->kind];
+  stats->execution_time += execution_time;
+  stats->wait_time += wait_time;
+  stats->n_queries++;
+
+  photos_debug (PHOTOS_DEBUG_TRACKER,
+                "Query processed (%s): Wait: %" G_GINT64_FORMAT ", Execution: %" G_GINT64_FORMAT
+                ", Average Wait: %" G_GINT64_FORMAT ", Average Execution: %" G_GINT64_FORMAT,
+                KIND_NAMES[data->kind],
+                wait_time,
+                execution_time,
+                stats->wait_time / stats->n_queries,
+                stats->execution_time / stats->n_queries);
 
-  data = g_queue_pop_head (self->queue);
   if (data->callback != NULL)
     (*data->callback) (source_object, res, data->user_data);
-  self->running = FALSE;
+
+  g_assert_cmpuint (self->n_running[data->kind], >, 0);
+  self->n_running[data->kind]--;
+
+  if (self->write_running == data)
+    self->write_running = NULL;
 
   photos_tracker_queue_check (self);
 }
 
 
 static void
-photos_tracker_queue_check (PhotosTrackerQueue *self)
+photos_tracker_queue_start (PhotosTrackerQueue *self, PhotosTrackerQueueData *data)
 {
-  PhotosTrackerQueueData *data;
   const gchar *sparql;
 
-  if (self->running)
-    return;
-
-  if (self->queue->length == 0)
-    return;
+  data->queue = g_object_ref (self);
+  data->start_time = g_get_monotonic_time ();
+  self->n_running[data->kind]++;
 
-  data = g_queue_peek_head (self->queue);
-  self->running = TRUE;
+  if (data->kind == PHOTOS_TRACKER_QUEUE_KIND_WRITE)
+    {
+      g_assert_null (self->write_running);
+      self->write_running = data;
+    }
 
   photos_tracker_queue_log_query (data->query);
   sparql = photos_query_get_sparql (data->query);
@@ -178,11 +401,26 @@ photos_tracker_queue_check (PhotosTrackerQueue *self)
   switch (data->query_type)
     {
     case PHOTOS_TRACKER_QUERY_SELECT:
-      tracker_sparql_connection_query_async (self->connection,
-                                             sparql,
-                                             data->cancellable,
-                                             photos_tracker_queue_collector,
-                                             g_object_ref (self));
+      {
+        if (photos_query_get_bindings (data->query) != NULL)
+          data->statement = photos_tracker_queue_get_statement (self, data->query);
+
+        if (data->statement != NULL)
+          {
+            tracker_sparql_statement_execute_async (data->statement,
+                                                    data->cancellable,
+                                                    photos_tracker_queue_collector,
+                                                    data);
+          }
+        else
+          {
+            tracker_sparql_connection_query_async (self->connection,
+                                                   sparql,
+                                                   data->cancellable,
+                                                   photos_tracker_queue_collector,
+                                                   data);
+          }
+      }
       break;
 
     case PHOTOS_TRACKER_QUERY_UPDATE:
@@ -190,7 +428,7 @@ photos_tracker_queue_check (PhotosTrackerQueue *self)
                                               sparql,
                                               data->cancellable,
                                               photos_tracker_queue_collector,
-                                              g_object_ref (self));
+                                              data);
       break;
 
     case PHOTOS_TRACKER_QUERY_UPDATE_BLANK:
@@ -198,7 +436,7 @@ photos_tracker_queue_check (PhotosTrackerQueue *self)
                                                     sparql,
                                                     data->cancellable,
                                                     photos_tracker_queue_collector,
-                                                    g_object_ref (self));
+                                                    data);
       break;
 
     default:
@@ -208,6 +446,88 @@ photos_tracker_queue_check (PhotosTrackerQueue *self)
 }
 
 
+static guint64
+photos_tracker_queue_get_write_serial (PhotosTrackerQueue *self)
+{
+  PhotosTrackerQueueData *data;
+  guint64 ret_val = G_MAXUINT64;
+
+  /* Writes are started in the order in which they were queued, so the
+   * oldest one that isn't done is either the running one or the head of
+   * the pending ones.
+   */
+  if (self->write_running != NULL)
+    ret_val = self->write_running->serial;
+
+  data = (PhotosTrackerQueueData *) g_queue_peek_head (&self->pending[PHOTOS_TRACKER_QUEUE_KIND_WRITE]);
+  if (data != NULL)
+    ret_val = MIN (ret_val, data->serial);
+
+  return ret_val;
+}
+
+
+static void
+photos_tracker_queue_check (PhotosTrackerQueue *self)
+{
+  guint n_background_max;
+  guint n_selects;
+  guint64 write_serial;
+
+  if (self->write_running == NULL && self->pending[PHOTOS_TRACKER_QUEUE_KIND_WRITE].length > 0)
+    {
+      PhotosTrackerQueueData *data;
+
+      data = (PhotosTrackerQueueData *) g_queue_pop_head (&self->pending[PHOTOS_TRACKER_QUEUE_KIND_WRITE]);
+      photos_tracker_queue_start (self, data);
+    }
+
+  /* A SELECT is held back by any write that was queued before it, not
+   * only by the one that is running.
+   */
+  write_serial = photos_tracker_queue_get_write_serial (self);
+
+  /* Keep a slot free for interactive queries, unless there is only
+   * one.
+   */
+  n_background_max = MAX (self->n_selects_max - 1, 1);
+
+  n_selects = self->n_running[PHOTOS_TRACKER_QUEUE_KIND_INTERACTIVE]
+              + self->n_running[PHOTOS_TRACKER_QUEUE_KIND_BACKGROUND];
+
+  while (n_selects < self->n_selects_max)
+    {
+      PhotosTrackerQueueData *data;
+
+      data = (PhotosTrackerQueueData *) g_queue_peek_head (&self->pending[PHOTOS_TRACKER_QUEUE_KIND_INTERACTIVE]);
+      if (data == NULL || data->serial > write_serial)
+        {
+          if (self->n_running[PHOTOS_TRACKER_QUEUE_KIND_BACKGROUND] >= n_background_max)
+            break;
+
+          data = (PhotosTrackerQueueData *) g_queue_peek_head (&self->pending[PHOTOS_TRACKER_QUEUE_KIND_BACKGROUND]);
+          if (data == NULL || data->serial > write_serial)
+            break;
+        }
+
+      g_queue_pop_head (&self->pending[data->kind]);
+      photos_tracker_queue_start (self, data);
+      n_selects++;
+    }
+}
+
+
+static void
+photos_tracker_queue_push (PhotosTrackerQueue *self, PhotosTrackerQueueData *data)
+{
+  data->queued_time = g_get_monotonic_time ();
+  data->serial = self->serial++;
+
+  g_queue_push_tail (&self->pending[data->kind], data);
+  photos_tracker_queue_check (self);
+}
+
+
 static GObject *
 photos_tracker_queue_constructor (GType type, guint n_construct_params, GObjectConstructParam *construct_params)
 {
@@ -231,6 +551,8 @@ photos_tracker_queue_dispose (GObject *object)
 {
   PhotosTrackerQueue *self = PHOTOS_TRACKER_QUEUE (object);
 
+  g_clear_pointer (&self->statements, g_hash_table_unref);
+  g_clear_pointer (&self->statements_busy, g_hash_table_unref);
   g_clear_object (&self->connection);
 
   G_OBJECT_CLASS (photos_tracker_queue_parent_class)->dispose (object);
@@ -241,9 +563,12 @@ static void
 photos_tracker_queue_finalize (GObject *object)
 {
   PhotosTrackerQueue *self = PHOTOS_TRACKER_QUEUE (object);
+  PhotosTrackerQueueKind kind;
+
+  for (kind = 0; kind < PHOTOS_TRACKER_QUEUE_N_KINDS; kind++)
+    g_queue_clear_full (&self->pending[kind], (GDestroyNotify) photos_tracker_queue_data_free);
 
   g_clear_error (&self->initialization_error);
-  g_queue_free (self->queue);
 
   G_OBJECT_CLASS (photos_tracker_queue_parent_class)->finalize (object);
 }
@@ -252,7 +577,15 @@ photos_tracker_queue_finalize (GObject *object)
 static void
 photos_tracker_queue_init (PhotosTrackerQueue *self)
 {
-  self->queue = g_queue_new ();
+  PhotosTrackerQueueKind kind;
+
+  for (kind = 0; kind < PHOTOS_TRACKER_QUEUE_N_KINDS; kind++)
+    g_queue_init (&self->pending[kind]);
+
+  self->statements = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  self->statements_busy = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  self->n_selects_max = photos_tracker_queue_get_n_selects_max ();
 }
 
 
@@ -368,21 +701,73 @@ photos_tracker_queue_select (PhotosTrackerQueue *self,
                              GAsyncReadyCallback callback,
                              gpointer user_data,
                              GDestroyNotify destroy_data)
+{
+  photos_tracker_queue_select_with_priority (self,
+                                             query,
+                                             PHOTOS_TRACKER_QUEUE_PRIORITY_INTERACTIVE,
+                                             cancellable,
+                                             callback,
+                                             user_data,
+                                             destroy_data);
+}
+
+
+TrackerSparqlCursor *
+photos_tracker_queue_select_finish (GObject *source_object, GAsyncResult *res, GError **error)
+{
+  TrackerSparqlCursor *cursor;
+
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (res), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (TRACKER_IS_SPARQL_STATEMENT (source_object))
+    cursor = tracker_sparql_statement_execute_finish (TRACKER_SPARQL_STATEMENT (source_object), res, error);
+  else
+    cursor = tracker_sparql_connection_query_finish (TRACKER_SPARQL_CONNECTION (source_object), res, error);
+
+  return cursor;
+}
+
+
+void
+photos_tracker_queue_select_with_priority (PhotosTrackerQueue *self,
+                                           PhotosQuery *query,
+                                           PhotosTrackerQueuePriority priority,
+                                           GCancellable *cancellable,
+                                           GAsyncReadyCallback callback,
+                                           gpointer user_data,
+                                           GDestroyNotify destroy_data)
 {
   PhotosTrackerQueueData *data;
+  PhotosTrackerQueueKind kind;
+
+  switch (priority)
+    {
+    case PHOTOS_TRACKER_QUEUE_PRIORITY_INTERACTIVE:
+      kind = PHOTOS_TRACKER_QUEUE_KIND_INTERACTIVE;
+      break;
+
+    case PHOTOS_TRACKER_QUEUE_PRIORITY_BACKGROUND:
+      kind = PHOTOS_TRACKER_QUEUE_KIND_BACKGROUND;
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+    }
 
   if (cancellable != NULL)
     g_object_ref (cancellable);
 
   data = photos_tracker_queue_data_new (query,
                                         PHOTOS_TRACKER_QUERY_SELECT,
+                                        kind,
                                         cancellable,
                                         callback,
                                         user_data,
                                         destroy_data);
 
-  g_queue_push_tail (self->queue, data);
-  photos_tracker_queue_check (self);
+  photos_tracker_queue_push (self, data);
 }
 
 
@@ -401,13 +786,13 @@ photos_tracker_queue_update (PhotosTrackerQueue *self,
 
   data = photos_tracker_queue_data_new (query,
                                         PHOTOS_TRACKER_QUERY_UPDATE,
+                                        PHOTOS_TRACKER_QUEUE_KIND_WRITE,
                                         cancellable,
                                         callback,
                                         user_data,
                                         destroy_data);
 
-  g_queue_push_tail (self->queue, data);
-  photos_tracker_queue_check (self);
+  photos_tracker_queue_push (self, data);
 }
 
 
@@ -426,11 +811,11 @@ photos_tracker_queue_update_blank (PhotosTrackerQueue *self,
 
   data = photos_tracker_queue_data_new (query,
                                         PHOTOS_TRACKER_QUERY_UPDATE_BLANK,
+                                        PHOTOS_TRACKER_QUEUE_KIND_WRITE,
                                         cancellable,
                                         callback,
                                         user_data,
                                         destroy_data);
 
-  g_queue_push_tail (self->queue, data);
-  photos_tracker_queue_check (self);
+  photos_tracker_queue_push (self, data);
 }
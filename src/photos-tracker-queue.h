@@ -33,6 +33,12 @@ G_BEGIN_DECLS
 #define PHOTOS_TYPE_TRACKER_QUEUE (photos_tracker_queue_get_type ())
 G_DECLARE_FINAL_TYPE (PhotosTrackerQueue, photos_tracker_queue, PHOTOS, TRACKER_QUEUE, GObject);
 
+typedef enum
+{
+  PHOTOS_TRACKER_QUEUE_PRIORITY_INTERACTIVE,
+  PHOTOS_TRACKER_QUEUE_PRIORITY_BACKGROUND
+} PhotosTrackerQueuePriority;
+
 PhotosTrackerQueue    *photos_tracker_queue_dup_singleton          (GCancellable *cancellable, GError **error);
 
 TrackerNotifier       *photos_tracker_queue_create_notifier        (PhotosTrackerQueue *self);
@@ -44,6 +50,18 @@ void                   photos_tracker_queue_select                 (PhotosTracke
                                                                     gpointer user_data,
                                                                     GDestroyNotify destroy_data);
 
+TrackerSparqlCursor   *photos_tracker_queue_select_finish          (GObject *source_object,
+                                                                    GAsyncResult *res,
+                                                                    GError **error);
+
+void                   photos_tracker_queue_select_with_priority   (PhotosTrackerQueue *self,
+                                                                    PhotosQuery *query,
+                                                                    PhotosTrackerQueuePriority priority,
+                                                                    GCancellable *cancellable,
+                                                                    GAsyncReadyCallback callback,
+                                                                    gpointer user_data,
+                                                                    GDestroyNotify destroy_data);
+
 void                   photos_tracker_queue_update                 (PhotosTrackerQueue *self,
                                                                     PhotosQuery *query,
                                                                     GCancellable *cancellable,
@@ -26,6 +26,7 @@
 
 #include <libgd/gd.h>
 
+#include "photos-base-item.h"
 #include "photos-empty-results-box.h"
 #include "photos-enums.h"
 #include "photos-error-box.h"
@@ -56,6 +57,7 @@ struct _PhotosViewContainer
   PhotosWindowMode mode;
   gboolean disposed;
   gchar *name;
+  guint prioritize_thumbnails_id;
 };
 
 enum
@@ -69,6 +71,106 @@ enum
 G_DEFINE_TYPE (PhotosViewContainer, photos_view_container, GTK_TYPE_STACK);
 
 
+static const guint PRIORITIZE_THUMBNAILS_TIMEOUT = 100; /* ms */
+
+
+static void
+photos_view_container_clear_prioritize_thumbnails_timeout (PhotosViewContainer *self)
+{
+  if (self->prioritize_thumbnails_id != 0)
+    {
+      g_source_remove (self->prioritize_thumbnails_id);
+      self->prioritize_thumbnails_id = 0;
+    }
+}
+
+
+static gboolean
+photos_view_container_prioritize_thumbnails_timeout (gpointer user_data)
+{
+  PhotosViewContainer *self = PHOTOS_VIEW_CONTAINER (user_data);
+  GList *children = NULL;
+  GList *l;
+  g_autoptr (GList) items = NULL;
+  GtkAdjustment *vadjustment;
+  GtkWidget *generic_box;
+  gdouble below;
+  gdouble page_size;
+  gdouble upper;
+  gdouble value;
+  guint n_below = 0;
+  guint n_visible = 0;
+
+  self->prioritize_thumbnails_id = 0;
+
+  generic_box = gtk_bin_get_child (GTK_BIN (self->view));
+  if (generic_box == NULL || !gtk_widget_get_realized (generic_box))
+    goto out;
+
+  vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (self->sw));
+  page_size = gtk_adjustment_get_page_size (vadjustment);
+  upper = gtk_adjustment_get_upper (vadjustment);
+  value = gtk_adjustment_get_value (vadjustment);
+
+  children = gtk_container_get_children (GTK_CONTAINER (generic_box));
+  for (l = children; l != NULL; l = l->next)
+    {
+      GdMainBoxItem *item;
+      GtkWidget *child = GTK_WIDGET (l->data);
+      gint height;
+      gint y;
+
+      if (!GD_IS_MAIN_BOX_CHILD (child) || !gtk_widget_get_child_visible (child))
+        continue;
+
+      if (!gtk_widget_translate_coordinates (child, self->view, 0, 0, NULL, &y))
+        continue;
+
+      height = gtk_widget_get_allocated_height (child);
+      if ((gdouble) (y + height) < value || (gdouble) y > value + page_size)
+        continue;
+
+      n_visible++;
+
+      item = gd_main_box_child_get_item (GD_MAIN_BOX_CHILD (child));
+      if (PHOTOS_IS_BASE_ITEM (item))
+        items = g_list_prepend (items, item);
+    }
+
+  items = g_list_reverse (items);
+  photos_base_item_prioritize_thumbnails (items);
+
+  /* Estimate how many items are left below the viewport from how many
+   * fit in it. Views that are not on screen are left alone.
+   */
+  if (gtk_widget_get_mapped (GTK_WIDGET (self)))
+    {
+      below = upper - (value + page_size);
+      if (page_size > 0.0 && below > 0.0)
+        n_below = (guint) (below / page_size * n_visible);
+
+      photos_offset_controller_set_viewport (self->offset_cntrlr, n_visible, n_below);
+    }
+
+ out:
+  g_list_free (children);
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+photos_view_container_prioritize_thumbnails (PhotosViewContainer *self)
+{
+  /* Coalesce bursts of scroll events, and let the view allocate any
+   * newly added children before looking at what is visible.
+   */
+  photos_view_container_clear_prioritize_thumbnails_timeout (self);
+  self->prioritize_thumbnails_id = g_timeout_add (PRIORITIZE_THUMBNAILS_TIMEOUT,
+                                                  photos_view_container_prioritize_thumbnails_timeout,
+                                                  self);
+}
+
+
 static void
 photos_view_container_edge_reached (PhotosViewContainer *self, GtkPositionType pos)
 {
@@ -80,7 +182,18 @@ photos_view_container_edge_reached (PhotosViewContainer *self, GtkPositionType p
 static void
 photos_view_container_connect_view (PhotosViewContainer *self)
 {
+  GtkAdjustment *vadjustment;
+
   g_signal_connect_swapped (self->sw, "edge-reached", G_CALLBACK (photos_view_container_edge_reached), self);
+
+  vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (self->sw));
+  g_signal_connect_swapped (vadjustment, "changed", G_CALLBACK (photos_view_container_prioritize_thumbnails), self);
+  g_signal_connect_swapped (vadjustment,
+                            "value-changed",
+                            G_CALLBACK (photos_view_container_prioritize_thumbnails),
+                            self);
+
+  photos_view_container_prioritize_thumbnails (self);
 }
 
 
@@ -97,7 +210,14 @@ photos_view_container_count_changed (PhotosViewContainer *self, gint count)
 static void
 photos_view_container_disconnect_view (PhotosViewContainer *self)
 {
+  GtkAdjustment *vadjustment;
+
   g_signal_handlers_disconnect_by_func (self->sw, photos_view_container_edge_reached, self);
+
+  vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (self->sw));
+  g_signal_handlers_disconnect_by_func (vadjustment, photos_view_container_prioritize_thumbnails, self);
+
+  photos_view_container_clear_prioritize_thumbnails_timeout (self);
 }
 
 
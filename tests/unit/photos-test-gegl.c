@@ -217,6 +217,16 @@ photos_test_gegl_setup_no_alpha_even_dimensions (PhotosTestGeglFixture *fixture,
 }
 
 
+static void
+photos_test_gegl_setup_no_alpha_large (PhotosTestGeglFixture *fixture, gconstpointer user_data)
+{
+  const Babl *format;
+
+  format = babl_format ("R'G'B' u8");
+  photos_test_gegl_setup (fixture, format, 1200.0, 1600.0);
+}
+
+
 static void
 photos_test_gegl_setup_no_alpha_odd_dimensions (PhotosTestGeglFixture *fixture, gconstpointer user_data)
 {
@@ -350,6 +360,71 @@ photos_test_gegl_buffer_check_conversion (PhotosTestGeglFixture *fixture,
 }
 
 
+static void
+photos_test_gegl_buffer_check_guess_sizes (PhotosTestGeglFixture *fixture, const gchar *operation)
+{
+  g_autoptr (GBytes) estimate_data = NULL;
+  g_autoptr (GBytes) exact_data = NULL;
+  GeglNode *buffer_source;
+  GeglNode *estimate;
+  GeglNode *exact;
+  g_autoptr (GeglNode) graph = NULL;
+  guint64 difference;
+  guint64 estimate_error;
+  guint64 estimate_error_1;
+  guint64 estimate_size;
+  guint64 estimate_size_1;
+  guint64 exact_error;
+  guint64 exact_error_1;
+  guint64 exact_size;
+  guint64 exact_size_1;
+
+  graph = gegl_node_new ();
+  buffer_source = gegl_node_new_child (graph, "operation", "gegl:buffer-source", "buffer", fixture->buffer, NULL);
+  estimate = gegl_node_new_child (graph, "operation", operation, "exact", FALSE, "keep-data", TRUE, NULL);
+  exact = gegl_node_new_child (graph, "operation", operation, "exact", TRUE, "keep-data", TRUE, NULL);
+  gegl_node_link (buffer_source, estimate);
+  gegl_node_link (buffer_source, exact);
+
+  gegl_node_process (estimate);
+  gegl_node_get (estimate,
+                 "size", &estimate_size,
+                 "size-1", &estimate_size_1,
+                 "size-error", &estimate_error,
+                 "size-1-error", &estimate_error_1,
+                 "data", &estimate_data,
+                 NULL);
+
+  gegl_node_process (exact);
+  gegl_node_get (exact,
+                 "size", &exact_size,
+                 "size-1", &exact_size_1,
+                 "size-error", &exact_error,
+                 "size-1-error", &exact_error_1,
+                 "data", &exact_data,
+                 NULL);
+
+  g_assert_cmpuint (exact_size, >, 0);
+  g_assert_cmpuint (exact_error, ==, 0);
+  g_assert_cmpuint (exact_error_1, ==, 0);
+
+  /* Only the images that were encoded in full are kept. */
+  g_assert_nonnull (exact_data);
+  g_assert_cmpuint (g_bytes_get_size (exact_data), ==, exact_size);
+  g_assert_null (estimate_data);
+
+  /* The zoomed image is too short to be sampled. */
+  g_assert_cmpuint (estimate_size_1, ==, exact_size_1);
+  g_assert_cmpuint (estimate_error_1, ==, 0);
+
+  /* The bound doesn't account for the small bias from encoding each
+   * band on its own, so allow for a few percent on top of it.
+   */
+  difference = estimate_size > exact_size ? estimate_size - exact_size : exact_size - estimate_size;
+  g_assert_cmpuint (difference, <=, estimate_error + exact_size / 20);
+}
+
+
 static void
 photos_test_gegl_buffer_check_orientation (PhotosTestGeglFixture *fixture,
                                            GQuark orientation,
@@ -730,6 +805,20 @@ photos_test_gegl_buffer_apply_orientation_top_mirror_3 (PhotosTestGeglFixture *f
 }
 
 
+static void
+photos_test_gegl_buffer_guess_sizes_jpg (PhotosTestGeglFixture *fixture, gconstpointer user_data)
+{
+  photos_test_gegl_buffer_check_guess_sizes (fixture, "photos:jpg-guess-sizes");
+}
+
+
+static void
+photos_test_gegl_buffer_guess_sizes_png (PhotosTestGeglFixture *fixture, gconstpointer user_data)
+{
+  photos_test_gegl_buffer_check_guess_sizes (fixture, "photos:png-guess-sizes");
+}
+
+
 static void
 photos_test_gegl_buffer_zoom_in_0 (PhotosTestGeglFixture *fixture, gconstpointer user_data)
 {
@@ -1095,6 +1184,20 @@ main (gint argc, gchar *argv[])
               photos_test_gegl_buffer_apply_orientation_top_mirror_3,
               photos_test_gegl_teardown);
 
+  g_test_add ("/gegl/buffer/guess-sizes/jpg",
+              PhotosTestGeglFixture,
+              NULL,
+              photos_test_gegl_setup_no_alpha_large,
+              photos_test_gegl_buffer_guess_sizes_jpg,
+              photos_test_gegl_teardown);
+
+  g_test_add ("/gegl/buffer/guess-sizes/png",
+              PhotosTestGeglFixture,
+              NULL,
+              photos_test_gegl_setup_no_alpha_large,
+              photos_test_gegl_buffer_guess_sizes_png,
+              photos_test_gegl_teardown);
+
   g_test_add ("/gegl/buffer/zoom/nop",
               PhotosTestGeglFixture,
               NULL,
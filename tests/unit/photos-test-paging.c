@@ -0,0 +1,107 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "photos-debug.h"
+#include "photos-paging.h"
+
+
+static void
+photos_test_paging_prefetch (void)
+{
+  /* Disabled */
+  g_assert_false (photos_paging_is_prefetch_needed (10, 0, 0));
+
+  /* Nothing is visible yet */
+  g_assert_false (photos_paging_is_prefetch_needed (0, 0, 2));
+
+  g_assert_true (photos_paging_is_prefetch_needed (10, 0, 2));
+  g_assert_true (photos_paging_is_prefetch_needed (10, 20, 2));
+  g_assert_false (photos_paging_is_prefetch_needed (10, 21, 2));
+  g_assert_true (photos_paging_is_prefetch_needed (10, 21, 3));
+}
+
+
+static void
+photos_test_paging_row_cost (void)
+{
+  gdouble row_cost;
+
+  row_cost = photos_paging_update_row_cost (0.0, 100, 100000);
+  g_assert_cmpfloat_with_epsilon (row_cost, 1000.0, 1e-9);
+
+  row_cost = photos_paging_update_row_cost (row_cost, 100, 300000);
+  g_assert_cmpfloat_with_epsilon (row_cost, 2000.0, 1e-9);
+
+  /* Failed and empty pages don't count */
+  row_cost = photos_paging_update_row_cost (row_cost, 100, -1);
+  g_assert_cmpfloat_with_epsilon (row_cost, 2000.0, 1e-9);
+
+  row_cost = photos_paging_update_row_cost (row_cost, 0, 300000);
+  g_assert_cmpfloat_with_epsilon (row_cost, 2000.0, 1e-9);
+}
+
+
+static void
+photos_test_paging_step_row_cost (void)
+{
+  /* As many rows as fit in the target latency */
+  g_assert_cmpint (photos_paging_get_step (10, 1000.0), ==, 200);
+
+  /* Never more than the maximum */
+  g_assert_cmpint (photos_paging_get_step (10, 1.0), ==, PHOTOS_PAGING_STEP_MAX);
+
+  /* Never less than the minimum, even if the rows are slow */
+  g_assert_cmpint (photos_paging_get_step (10, 1000000.0), ==, PHOTOS_PAGING_STEP_MIN);
+
+  /* Never less than a few screens, even if the rows are slow */
+  g_assert_cmpint (photos_paging_get_step (100, 1000.0), ==, 300);
+}
+
+
+static void
+photos_test_paging_step_visible (void)
+{
+  g_assert_cmpint (photos_paging_get_step (0, 0.0), ==, PHOTOS_PAGING_STEP_MIN);
+  g_assert_cmpint (photos_paging_get_step (10, 0.0), ==, PHOTOS_PAGING_STEP_MIN);
+  g_assert_cmpint (photos_paging_get_step (30, 0.0), ==, 90);
+  g_assert_cmpint (photos_paging_get_step (1000, 0.0), ==, PHOTOS_PAGING_STEP_MAX);
+  g_assert_cmpint (photos_paging_get_step (G_MAXUINT, 0.0), ==, PHOTOS_PAGING_STEP_MAX);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+  photos_debug_init ();
+
+  g_test_add_func ("/paging/prefetch", photos_test_paging_prefetch);
+  g_test_add_func ("/paging/row-cost", photos_test_paging_row_cost);
+  g_test_add_func ("/paging/step/row-cost", photos_test_paging_step_row_cost);
+  g_test_add_func ("/paging/step/visible", photos_test_paging_step_visible);
+
+  return g_test_run ();
+}
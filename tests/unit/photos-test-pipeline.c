@@ -20,8 +20,10 @@
 #include "config.h"
 
 #include <locale.h>
+#include <string.h>
 
 #include <gegl.h>
+#include <gegl-plugin.h>
 #include <gio/gio.h>
 #include <glib.h>
 
@@ -40,6 +42,78 @@ struct _PhotosTestPipelineFixture
   GMainLoop *loop;
 };
 
+/* Counts the pixels that flow through it, to tell whether the nodes
+ * upstream of a cache point were processed again.
+ */
+#define PHOTOS_TEST_TYPE_PIPELINE_COUNT (photos_test_pipeline_count_get_type ())
+G_DECLARE_FINAL_TYPE (PhotosTestPipelineCount,
+                      photos_test_pipeline_count,
+                      PHOTOS_TEST,
+                      PIPELINE_COUNT,
+                      GeglOperationPointFilter);
+
+struct _PhotosTestPipelineCount
+{
+  GeglOperationPointFilter parent_instance;
+};
+
+
+G_DEFINE_TYPE (PhotosTestPipelineCount, photos_test_pipeline_count, GEGL_TYPE_OPERATION_POINT_FILTER);
+
+
+static gint count_n_pixels;
+
+
+static void
+photos_test_pipeline_count_prepare (GeglOperation *operation)
+{
+  const Babl *format;
+
+  format = babl_format ("RGBA float");
+  gegl_operation_set_format (operation, "input", format);
+  gegl_operation_set_format (operation, "output", format);
+}
+
+
+static gboolean
+photos_test_pipeline_count_process (GeglOperation *operation,
+                                    void *in_buf,
+                                    void *out_buf,
+                                    glong n_pixels,
+                                    const GeglRectangle *roi,
+                                    gint level)
+{
+  memcpy (out_buf, in_buf, (gsize) n_pixels * 4 * sizeof (gfloat));
+  g_atomic_int_add (&count_n_pixels, (gint) n_pixels);
+  return TRUE;
+}
+
+
+static void
+photos_test_pipeline_count_init (PhotosTestPipelineCount *self)
+{
+}
+
+
+static void
+photos_test_pipeline_count_class_init (PhotosTestPipelineCountClass *class)
+{
+  GeglOperationClass *operation_class = GEGL_OPERATION_CLASS (class);
+  GeglOperationPointFilterClass *point_filter_class = GEGL_OPERATION_POINT_FILTER_CLASS (class);
+
+  operation_class->opencl_support = FALSE;
+
+  operation_class->prepare = photos_test_pipeline_count_prepare;
+  point_filter_class->process = photos_test_pipeline_count_process;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name", "photos-test:count",
+                                 "title", "Count",
+                                 "description", "Count the pixels that are processed",
+                                 "categories", "hidden",
+                                 NULL);
+}
+
 
 static gchar *
 photos_test_pipeline_filename_to_uri (const gchar *filename)
@@ -85,6 +159,114 @@ photos_test_pipeline_async (GObject *source_object, GAsyncResult *res, gpointer
 }
 
 
+static void
+photos_test_pipeline_add (PhotosPipeline *pipeline, const gchar *operation, const gchar *first_property_name, ...)
+{
+  va_list ap;
+
+  va_start (ap, first_property_name);
+  photos_pipeline_add_valist (pipeline, operation, first_property_name, ap);
+  va_end (ap);
+}
+
+
+static void
+photos_test_pipeline_blit (PhotosPipeline *pipeline, gint width, gint height)
+{
+  GeglNode *output;
+  GeglRectangle roi;
+  g_autofree gfloat *buf = NULL;
+
+  buf = g_new0 (gfloat, (gsize) width * (gsize) height * 4);
+  gegl_rectangle_set (&roi, 0, 0, (guint) width, (guint) height);
+
+  output = photos_pipeline_get_output (pipeline);
+  gegl_node_blit (output, 1.0, &roi, babl_format ("RGBA float"), buf, GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+}
+
+
+static GeglNode *
+photos_test_pipeline_find_node (PhotosPipeline *pipeline, const gchar *operation)
+{
+  GeglNode *graph;
+  GeglNode *input;
+  GeglNode *node;
+
+  graph = photos_pipeline_get_graph (pipeline);
+  input = gegl_node_get_input_proxy (graph, "input");
+  node = photos_pipeline_get_output (pipeline);
+
+  do
+    {
+      node = gegl_node_get_producer (node, "input", NULL);
+      g_assert_nonnull (node);
+      g_assert_true (node != input);
+    }
+  while (g_strcmp0 (gegl_node_get_operation (node), operation) != 0);
+
+  return node;
+}
+
+
+static GeglCachePolicy
+photos_test_pipeline_get_cache_policy (PhotosPipeline *pipeline, const gchar *operation)
+{
+  GeglCachePolicy cache_policy;
+  GeglNode *node;
+
+  node = photos_test_pipeline_find_node (pipeline, operation);
+  gegl_node_get (node, "cache-policy", &cache_policy, NULL);
+  return cache_policy;
+}
+
+
+static PhotosPipeline *
+photos_test_pipeline_new_with_source (PhotosTestPipelineFixture *fixture,
+                                      GeglNode *parent,
+                                      gint width,
+                                      gint height,
+                                      gboolean count)
+{
+  GeglNode *crop;
+  GeglNode *graph;
+  GeglNode *source;
+  PhotosPipeline *pipeline;
+  const gchar *const uris[] = { NULL };
+
+  photos_pipeline_new_async (parent, uris, NULL, photos_test_pipeline_async, fixture);
+  g_main_loop_run (fixture->loop);
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    pipeline = photos_pipeline_new_finish (fixture->res, &error);
+    g_assert_no_error (error);
+  }
+
+  source = gegl_node_new_child (parent, "operation", "gegl:color", NULL);
+  crop = gegl_node_new_child (parent,
+                              "operation", "gegl:crop",
+                              "height", (gdouble) height,
+                              "width", (gdouble) width,
+                              NULL);
+  gegl_node_link (source, crop);
+
+  if (count)
+    {
+      GeglNode *count_node;
+
+      count_node = gegl_node_new_child (parent, "operation", "photos-test:count", NULL);
+      gegl_node_link (crop, count_node);
+      crop = count_node;
+    }
+
+  graph = photos_pipeline_get_graph (pipeline);
+  gegl_node_link (crop, graph);
+
+  return pipeline;
+}
+
+
 static void
 photos_test_pipeline_check_empty (PhotosPipeline *pipeline, GeglNode *parent_expected)
 {
@@ -1829,6 +2011,176 @@ photos_test_pipeline_with_parent_with_uris_17 (PhotosTestPipelineFixture *fixtur
 }
 
 
+static void
+photos_test_pipeline_cache_point_move (PhotosTestPipelineFixture *fixture, gconstpointer user_data)
+{
+  g_autoptr (GeglNode) parent = NULL;
+  g_autoptr (PhotosPipeline) pipeline = NULL;
+  GeglCachePolicy cache_policy;
+
+  parent = gegl_node_new ();
+  pipeline = photos_test_pipeline_new_with_source (fixture, parent, 32, 32, FALSE);
+
+  /* Nothing upstream of the first active node is worth caching. */
+  photos_test_pipeline_add (pipeline, "photos:saturation", "scale", 1.5, NULL);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "photos:saturation");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_AUTO);
+
+  photos_test_pipeline_add (pipeline, "gegl:unsharp-mask", "std-dev", 3.0, NULL);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "photos:saturation");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_ALWAYS);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "gegl:unsharp-mask");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_AUTO);
+
+  /* A small image leaves room for both cache points. */
+  photos_test_pipeline_add (pipeline, "gegl:exposure", "exposure", 0.5, NULL);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "gegl:unsharp-mask");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_ALWAYS);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "photos:saturation");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_ALWAYS);
+}
+
+
+static void
+photos_test_pipeline_cache_point_reset (PhotosTestPipelineFixture *fixture, gconstpointer user_data)
+{
+  g_autoptr (GeglNode) parent = NULL;
+  g_autoptr (PhotosPipeline) pipeline = NULL;
+  GeglCachePolicy cache_policy;
+
+  /* At 5000×5000 RGBA float, only one cache point fits in the budget.
+   * Nothing is processed, so the pixels are never allocated.
+   */
+  parent = gegl_node_new ();
+  pipeline = photos_test_pipeline_new_with_source (fixture, parent, 5000, 5000, FALSE);
+
+  photos_test_pipeline_add (pipeline, "photos:saturation", "scale", 1.5, NULL);
+  photos_test_pipeline_add (pipeline, "gegl:unsharp-mask", "std-dev", 3.0, NULL);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "photos:saturation");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_ALWAYS);
+
+  photos_test_pipeline_add (pipeline, "gegl:exposure", "exposure", 0.5, NULL);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "gegl:unsharp-mask");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_ALWAYS);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "photos:saturation");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_AUTO);
+
+  photos_test_pipeline_add (pipeline, "gegl:unsharp-mask", "std-dev", 2.0, NULL);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "photos:saturation");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_ALWAYS);
+  cache_policy = photos_test_pipeline_get_cache_policy (pipeline, "gegl:unsharp-mask");
+  g_assert_cmpint (cache_policy, ==, GEGL_CACHE_POLICY_AUTO);
+}
+
+
+static void
+photos_test_pipeline_cache_point_reuse (PhotosTestPipelineFixture *fixture, gconstpointer user_data)
+{
+  g_autoptr (GeglNode) parent = NULL;
+  g_autoptr (PhotosPipeline) pipeline = NULL;
+  gint n_pixels;
+
+  parent = gegl_node_new ();
+  pipeline = photos_test_pipeline_new_with_source (fixture, parent, 64, 64, TRUE);
+
+  photos_test_pipeline_add (pipeline, "photos:saturation", "scale", 1.5, NULL);
+  photos_test_pipeline_add (pipeline, "gegl:unsharp-mask", "std-dev", 1.0, NULL);
+
+  g_atomic_int_set (&count_n_pixels, 0);
+  photos_test_pipeline_blit (pipeline, 64, 64);
+  n_pixels = g_atomic_int_get (&count_n_pixels);
+  g_assert_cmpint (n_pixels, >, 0);
+
+  /* Dragging the slider only processes the edited node again. */
+  photos_test_pipeline_add (pipeline, "gegl:unsharp-mask", "std-dev", 2.0, NULL);
+  photos_test_pipeline_blit (pipeline, 64, 64);
+  photos_test_pipeline_add (pipeline, "gegl:unsharp-mask", "std-dev", 3.0, NULL);
+  photos_test_pipeline_blit (pipeline, 64, 64);
+  g_assert_cmpint (g_atomic_int_get (&count_n_pixels), ==, n_pixels);
+}
+
+
+static void
+photos_test_pipeline_proxy_graph (PhotosTestPipelineFixture *fixture, gconstpointer user_data)
+{
+  g_autoptr (GSList) children = NULL;
+  g_autoptr (GeglNode) graph = NULL;
+  GeglNode *input;
+  GeglNode *output;
+  GeglNode *previous;
+  g_autoptr (PhotosPipeline) pipeline = NULL;
+  const gchar *operation;
+  const gchar *const filenames[] = { "photos-test-pipeline-edited-00.xml", NULL };
+  const gchar *const operations[] =
+    {
+      "gegl:brightness-contrast",
+      "gegl:exposure",
+      "gegl:unsharp-mask",
+      "photos:magic-filter",
+      "photos:saturation",
+      "gegl:shadows-highlights",
+      "gegl:noise-reduction"
+    };
+  gdouble height;
+  gdouble scale;
+  gdouble width;
+  gdouble x;
+  gdouble y;
+  guint i;
+  guint length;
+
+  photos_test_pipeline_pipeline_new_async (NULL, filenames, NULL, photos_test_pipeline_async, fixture);
+  g_main_loop_run (fixture->loop);
+
+  {
+    g_autoptr (GError) error = NULL;
+
+    pipeline = photos_pipeline_new_finish (fixture->res, &error);
+    g_assert_no_error (error);
+  }
+
+  graph = photos_pipeline_new_proxy_graph (pipeline, 0.5);
+  g_assert_true (GEGL_IS_NODE (graph));
+  g_assert_null (gegl_node_get_parent (graph));
+
+  children = gegl_node_get_children (graph);
+  length = g_slist_length (children);
+  g_assert_cmpuint (length, ==, 10);
+
+  input = gegl_node_get_input_proxy (graph, "input");
+  output = gegl_node_get_output_proxy (graph, "output");
+
+  previous = output;
+  for (i = 0; i < G_N_ELEMENTS (operations); i++)
+    {
+      previous = gegl_node_get_producer (previous, "input", NULL);
+      g_assert_true (previous != input);
+
+      operation = gegl_node_get_operation (previous);
+      g_assert_cmpstr (operation, ==, operations[i]);
+
+      if (g_strcmp0 (operation, "photos:saturation") == 0)
+        {
+          gegl_node_get (previous, "scale", &scale, NULL);
+          g_assert_cmpfloat (scale, ==, 2.0);
+        }
+    }
+
+  previous = gegl_node_get_producer (previous, "input", NULL);
+  operation = gegl_node_get_operation (previous);
+  g_assert_cmpstr (operation, ==, "gegl:crop");
+
+  gegl_node_get (previous, "height", &height, "width", &width, "x", &x, "y", &y, NULL);
+  g_assert_cmpfloat_with_epsilon (height, 308.448 / 2.0, 1e-6);
+  g_assert_cmpfloat_with_epsilon (width, 199.584 / 2.0, 1e-6);
+  g_assert_cmpfloat_with_epsilon (x, 120.528 / 2.0, 1e-6);
+  g_assert_cmpfloat_with_epsilon (y, 185.776 / 2.0, 1e-6);
+
+  previous = gegl_node_get_producer (previous, "input", NULL);
+  g_assert_true (previous == input);
+}
+
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -1839,6 +2191,7 @@ main (gint argc, gchar *argv[])
   photos_debug_init ();
   photos_gegl_init ();
   photos_gegl_ensure_builtins ();
+  g_type_ensure (PHOTOS_TEST_TYPE_PIPELINE_COUNT);
 
   g_test_add ("/pipeline/new/insta-filter-none",
               PhotosTestPipelineFixture,
@@ -2344,6 +2697,34 @@ main (gint argc, gchar *argv[])
               photos_test_pipeline_with_parent_with_uris_17,
               photos_test_pipeline_teardown);
 
+  g_test_add ("/pipeline/cache-point/move",
+              PhotosTestPipelineFixture,
+              NULL,
+              photos_test_pipeline_setup,
+              photos_test_pipeline_cache_point_move,
+              photos_test_pipeline_teardown);
+
+  g_test_add ("/pipeline/cache-point/reset",
+              PhotosTestPipelineFixture,
+              NULL,
+              photos_test_pipeline_setup,
+              photos_test_pipeline_cache_point_reset,
+              photos_test_pipeline_teardown);
+
+  g_test_add ("/pipeline/cache-point/reuse",
+              PhotosTestPipelineFixture,
+              NULL,
+              photos_test_pipeline_setup,
+              photos_test_pipeline_cache_point_reuse,
+              photos_test_pipeline_teardown);
+
+  g_test_add ("/pipeline/proxy-graph",
+              PhotosTestPipelineFixture,
+              NULL,
+              photos_test_pipeline_setup,
+              photos_test_pipeline_proxy_graph,
+              photos_test_pipeline_teardown);
+
   exit_status = g_test_run ();
 
   gegl_exit ();
@@ -0,0 +1,274 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <tracker-sparql.h>
+
+#include "photos-debug.h"
+#include "photos-query-seek.h"
+
+
+typedef struct _PhotosTestQuerySeekFixture PhotosTestQuerySeekFixture;
+
+struct _PhotosTestQuerySeekFixture
+{
+  TrackerSparqlConnection *connection;
+};
+
+
+/* Ties on ctime and mtime are broken by the urn, and unbound values
+ * sort after the bound ones.
+ */
+static const gchar *EXPECTED[] =
+{
+  "urn:photos-test:b",
+  "urn:photos-test:a",
+  "urn:photos-test:c",
+  "urn:photos-test:d",
+  "urn:photos-test:e",
+  "urn:photos-test:g",
+  "urn:photos-test:f",
+  "urn:photos-test:i",
+  "urn:photos-test:h",
+  NULL
+};
+
+static const gchar *INSERT
+  = "INSERT DATA {"
+    "  <urn:photos-test:a> a nmm:Photo ;"
+    "    nie:contentCreated '2021-01-02T00:00:00Z' ;"
+    "    nie:contentLastModified '2021-01-02T00:00:00Z' ."
+    "  <urn:photos-test:b> a nmm:Photo ;"
+    "    nie:contentCreated '2021-01-02T00:00:00Z' ;"
+    "    nie:contentLastModified '2021-01-02T00:00:00Z' ."
+    "  <urn:photos-test:c> a nmm:Photo ;"
+    "    nie:contentCreated '2021-01-02T00:00:00Z' ;"
+    "    nie:contentLastModified '2021-01-01T00:00:00Z' ."
+    "  <urn:photos-test:d> a nmm:Photo ;"
+    "    nie:contentCreated '2021-01-02T00:00:00Z' ."
+    "  <urn:photos-test:e> a nmm:Photo ;"
+    "    nie:contentCreated '2021-01-01T00:00:00Z' ;"
+    "    nie:contentLastModified '2021-01-01T00:00:00Z' ."
+    "  <urn:photos-test:f> a nmm:Photo ;"
+    "    nie:contentLastModified '2021-01-02T00:00:00Z' ."
+    "  <urn:photos-test:g> a nmm:Photo ;"
+    "    nie:contentLastModified '2021-01-02T00:00:00Z' ."
+    "  <urn:photos-test:h> a nmm:Photo ."
+    "  <urn:photos-test:i> a nmm:Photo ."
+    "}";
+
+/* Like the templates, the filter comes right after the sub-SELECT
+ * that projects the variables it refers to.
+ */
+static const gchar *SELECT_FORMAT
+  = "SELECT ?urn ?ctime ?mtime "
+    "{"
+    "  {"
+    "    SELECT ?urn (nie:contentCreated (?urn) AS ?ctime) (nie:contentLastModified (?urn) AS ?mtime) "
+    "    {"
+    "      ?urn a nmm:Photo ."
+    "    }"
+    "  }"
+    "  %s"
+    "} "
+    PHOTOS_QUERY_SEEK_ORDER " "
+    "LIMIT %u";
+
+
+static gchar *
+photos_test_query_seek_dup_string (TrackerSparqlCursor *cursor, gint column)
+{
+  const gchar *str;
+
+  if (!tracker_sparql_cursor_is_bound (cursor, column))
+    return NULL;
+
+  str = tracker_sparql_cursor_get_string (cursor, column, NULL);
+  return g_strdup (str);
+}
+
+
+static void
+photos_test_query_seek_bind (TrackerSparqlStatement *statement, GVariant *bindings)
+{
+  GVariant *value;
+  GVariantIter iter;
+  g_autoptr (GTimeZone) utc = NULL;
+  const gchar *name;
+
+  utc = g_time_zone_new_utc ();
+
+  /* Keep this in sync with photos_tracker_queue_get_statement */
+  g_variant_iter_init (&iter, bindings);
+  while (g_variant_iter_loop (&iter, "{&sv}", &name, &value))
+    {
+      if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+          tracker_sparql_statement_bind_string (statement, name, g_variant_get_string (value, NULL));
+        }
+      else if (g_variant_is_of_type (value, G_VARIANT_TYPE ("(s)")))
+        {
+          g_autoptr (GDateTime) date_time = NULL;
+          const gchar *iso8601;
+
+          g_variant_get (value, "(&s)", &iso8601);
+          date_time = g_date_time_new_from_iso8601 (iso8601, utc);
+          g_assert_nonnull (date_time);
+          tracker_sparql_statement_bind_datetime (statement, name, date_time);
+        }
+      else
+        {
+          g_assert_not_reached ();
+        }
+    }
+}
+
+
+static void
+photos_test_query_seek_setup (PhotosTestQuerySeekFixture *fixture, gconstpointer user_data)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GFile) ontology = NULL;
+
+  ontology = tracker_sparql_get_ontology_nepomuk ();
+  fixture->connection = tracker_sparql_connection_new (TRACKER_SPARQL_CONNECTION_FLAGS_NONE,
+                                                       NULL,
+                                                       ontology,
+                                                       NULL,
+                                                       &error);
+  g_assert_no_error (error);
+
+  tracker_sparql_connection_update (fixture->connection, INSERT, NULL, &error);
+  g_assert_no_error (error);
+}
+
+
+static void
+photos_test_query_seek_teardown (PhotosTestQuerySeekFixture *fixture, gconstpointer user_data)
+{
+  if (fixture->connection != NULL)
+    tracker_sparql_connection_close (fixture->connection);
+
+  g_clear_object (&fixture->connection);
+}
+
+
+static void
+photos_test_query_seek_pages (PhotosTestQuerySeekFixture *fixture, gconstpointer user_data)
+{
+  g_autofree gchar *ctime = NULL;
+  g_autofree gchar *mtime = NULL;
+  g_autofree gchar *urn = NULL;
+  const guint step = GPOINTER_TO_UINT (user_data);
+  guint n_rows = 0;
+
+  /* Each page seeks past the last row of the previous one, and the
+   * pages together must give every row exactly once, in order.
+   */
+  while (TRUE)
+    {
+      GVariantDict bindings;
+      g_autoptr (GError) error = NULL;
+      g_autoptr (GVariant) bindings_variant = NULL;
+      g_autoptr (TrackerSparqlCursor) cursor = NULL;
+      g_autoptr (TrackerSparqlStatement) statement = NULL;
+      g_autofree gchar *seek_filter = NULL;
+      g_autofree gchar *sparql = NULL;
+      guint n_page_rows = 0;
+
+      g_variant_dict_init (&bindings, NULL);
+
+      if (urn != NULL)
+        seek_filter = photos_query_seek_get_filter (ctime, mtime, urn, &bindings);
+
+      bindings_variant = g_variant_ref_sink (g_variant_dict_end (&bindings));
+
+      sparql = g_strdup_printf (SELECT_FORMAT, seek_filter == NULL ? "" : seek_filter, step);
+      statement = tracker_sparql_connection_query_statement (fixture->connection, sparql, NULL, &error);
+      g_assert_no_error (error);
+
+      photos_test_query_seek_bind (statement, bindings_variant);
+
+      cursor = tracker_sparql_statement_execute (statement, NULL, &error);
+      g_assert_no_error (error);
+
+      while (tracker_sparql_cursor_next (cursor, NULL, &error))
+        {
+          g_assert_nonnull (EXPECTED[n_rows]);
+
+          g_clear_pointer (&urn, g_free);
+          urn = photos_test_query_seek_dup_string (cursor, 0);
+          g_assert_cmpstr (urn, ==, EXPECTED[n_rows]);
+
+          g_clear_pointer (&ctime, g_free);
+          ctime = photos_test_query_seek_dup_string (cursor, 1);
+
+          g_clear_pointer (&mtime, g_free);
+          mtime = photos_test_query_seek_dup_string (cursor, 2);
+
+          n_page_rows++;
+          n_rows++;
+        }
+
+      g_assert_no_error (error);
+      g_assert_cmpuint (n_page_rows, <=, step);
+
+      if (n_page_rows == 0)
+        break;
+    }
+
+  g_assert_null (EXPECTED[n_rows]);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+  photos_debug_init ();
+
+  g_test_add ("/query-seek/pages/1",
+              PhotosTestQuerySeekFixture,
+              GUINT_TO_POINTER (1),
+              photos_test_query_seek_setup,
+              photos_test_query_seek_pages,
+              photos_test_query_seek_teardown);
+
+  g_test_add ("/query-seek/pages/2",
+              PhotosTestQuerySeekFixture,
+              GUINT_TO_POINTER (2),
+              photos_test_query_seek_setup,
+              photos_test_query_seek_pages,
+              photos_test_query_seek_teardown);
+
+  g_test_add ("/query-seek/pages/all",
+              PhotosTestQuerySeekFixture,
+              GUINT_TO_POINTER (G_N_ELEMENTS (EXPECTED)),
+              photos_test_query_seek_setup,
+              photos_test_query_seek_pages,
+              photos_test_query_seek_teardown);
+
+  return g_test_run ();
+}
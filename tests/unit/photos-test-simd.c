@@ -0,0 +1,524 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The vectorized kernels are checked against the scalar ones in
+ * photos-simd, which are the reference. When run with -m perf, their
+ * throughput is measured on a buffer the size of a 24 megapixel image.
+ */
+
+
+#include "config.h"
+
+#include <locale.h>
+#include <math.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "photos-debug.h"
+#include "photos-simd.h"
+
+
+typedef struct _PhotosTestSimdVariant PhotosTestSimdVariant;
+
+struct _PhotosTestSimdVariant
+{
+  const gchar *name;
+  PhotosSimdFlags flags;
+};
+
+static const PhotosTestSimdVariant VARIANTS[] =
+{
+  { "scalar", PHOTOS_SIMD_NONE },
+  { "sse2", PHOTOS_SIMD_SSE2 },
+  { "avx2", PHOTOS_SIMD_AVX2 },
+  { "neon", PHOTOS_SIMD_NEON }
+};
+
+static const guint CURVE_N_INTERVALS = 255 * 16;
+static const glong PERF_N_PIXELS = 6000 * 4000;
+static const guint PERF_N_ITERATIONS = 5;
+
+
+static gfloat *
+photos_test_simd_create_curves (void)
+{
+  gfloat *curves;
+  guint i;
+
+  curves = g_new (gfloat, 3 * (CURVE_N_INTERVALS + 1));
+  for (i = 0; i < 3 * (CURVE_N_INTERVALS + 1); i++)
+    curves[i] = (gfloat) g_test_rand_double ();
+
+  return curves;
+}
+
+
+static PhotosSimdApplyCurvesFunc
+photos_test_simd_get_apply_curves_func (const PhotosTestSimdVariant *variant)
+{
+  if (variant->flags == PHOTOS_SIMD_NONE)
+    return photos_simd_apply_curves_scalar;
+
+  if ((photos_simd_get_support () & variant->flags) == 0)
+    return NULL;
+
+  return photos_simd_get_apply_curves_func (variant->flags);
+}
+
+
+static PhotosSimdMultiplyFunc
+photos_test_simd_get_multiply_func (const PhotosTestSimdVariant *variant, gboolean opaque)
+{
+  if (variant->flags == PHOTOS_SIMD_NONE)
+    return opaque ? photos_simd_multiply_opaque_scalar : photos_simd_multiply_scalar;
+
+  if ((photos_simd_get_support () & variant->flags) == 0)
+    return NULL;
+
+  if (opaque)
+    return photos_simd_get_multiply_opaque_func (variant->flags);
+
+  return photos_simd_get_multiply_func (variant->flags);
+}
+
+
+static PhotosSimdScaleChannelsFunc
+photos_test_simd_get_scale_channels_func (const PhotosTestSimdVariant *variant)
+{
+  if (variant->flags == PHOTOS_SIMD_NONE)
+    return photos_simd_scale_channels_scalar;
+
+  if ((photos_simd_get_support () & variant->flags) == 0)
+    return NULL;
+
+  return photos_simd_get_scale_channels_func (variant->flags);
+}
+
+
+static void
+photos_test_simd_apply_curves (gconstpointer user_data)
+{
+  const PhotosTestSimdVariant *variant = (const PhotosTestSimdVariant *) user_data;
+  PhotosSimdApplyCurvesFunc apply_curves;
+  g_autofree gfloat *curves = NULL;
+  const glong n_pixels[] = { 0, 1, 2, 5, 7, 8, 9, 1031 };
+  guint i;
+
+  apply_curves = photos_test_simd_get_apply_curves_func (variant);
+  if (apply_curves == NULL)
+    {
+      g_test_skip ("No such kernel, or not supported by this CPU");
+      return;
+    }
+
+  curves = photos_test_simd_create_curves ();
+
+  for (i = 0; i < G_N_ELEMENTS (n_pixels); i++)
+    {
+      guint n_components;
+
+      for (n_components = 3; n_components <= 4; n_components++)
+        {
+          g_autofree gfloat *expected = NULL;
+          g_autofree gfloat *in = NULL;
+          g_autofree gfloat *out = NULL;
+          gsize j;
+          gsize n;
+
+          /* One extra float, to check unaligned access. */
+          n = (gsize) n_pixels[i] * n_components;
+          in = g_new (gfloat, n + 1);
+          out = g_new (gfloat, n + 1);
+          expected = g_new (gfloat, n + 1);
+
+          /* Include values outside [0, 1], which are clamped. */
+          for (j = 0; j < n + 1; j++)
+            in[j] = (gfloat) g_test_rand_double_range (-0.1, 1.1);
+
+          if (n > 0)
+            in[1] = NAN;
+
+          photos_simd_apply_curves_scalar (in + 1, expected, n_pixels[i], n_components, curves, CURVE_N_INTERVALS);
+
+          (*apply_curves) (in + 1, out, n_pixels[i], n_components, curves, CURVE_N_INTERVALS);
+          for (j = 0; j < n; j++)
+            {
+              if (j % n_components == 3)
+                g_assert_cmpmem (&out[j], sizeof (gfloat), &in[j + 1], sizeof (gfloat));
+              else
+                g_assert_cmpfloat_with_epsilon (out[j], expected[j], 1e-6);
+            }
+        }
+    }
+}
+
+
+static void
+photos_test_simd_apply_curves_perf (gconstpointer user_data)
+{
+  const PhotosTestSimdVariant *variant = (const PhotosTestSimdVariant *) user_data;
+  PhotosSimdApplyCurvesFunc apply_curves;
+  g_autofree gfloat *curves = NULL;
+  g_autofree gfloat *in = NULL;
+  g_autofree gfloat *out = NULL;
+  gsize i;
+  guint n_components;
+
+  apply_curves = photos_test_simd_get_apply_curves_func (variant);
+  if (apply_curves == NULL)
+    {
+      g_test_skip ("No such kernel, or not supported by this CPU");
+      return;
+    }
+
+  curves = photos_test_simd_create_curves ();
+
+  in = g_new (gfloat, (gsize) PERF_N_PIXELS * 4);
+  out = g_new (gfloat, (gsize) PERF_N_PIXELS * 4);
+  for (i = 0; i < (gsize) PERF_N_PIXELS * 4; i++)
+    in[i] = (gfloat) (i % 4093) / 4092.0f;
+
+  for (n_components = 3; n_components <= 4; n_components++)
+    {
+      gdouble best = G_MAXDOUBLE;
+      gdouble pixels_per_second;
+      guint j;
+
+      for (j = 0; j < PERF_N_ITERATIONS; j++)
+        {
+          gdouble elapsed;
+
+          g_test_timer_start ();
+          (*apply_curves) (in, out, PERF_N_PIXELS, n_components, curves, CURVE_N_INTERVALS);
+          elapsed = g_test_timer_elapsed ();
+          best = MIN (best, elapsed);
+        }
+
+      pixels_per_second = (gdouble) PERF_N_PIXELS / best;
+      g_test_maximized_result (pixels_per_second,
+                               "%s, %u components: %.0f pixels/s",
+                               variant->name,
+                               n_components,
+                               pixels_per_second);
+    }
+}
+
+
+static void
+photos_test_simd_multiply_check (const PhotosTestSimdVariant *variant, gboolean opaque)
+{
+  PhotosSimdMultiplyFunc multiply;
+  const glong n_pixels[] = { 0, 1, 2, 3, 5, 8, 1031 };
+  guint i;
+
+  multiply = photos_test_simd_get_multiply_func (variant, opaque);
+  if (multiply == NULL)
+    {
+      g_test_skip ("No such kernel, or not supported by this CPU");
+      return;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (n_pixels); i++)
+    {
+      g_autofree gfloat *aux = NULL;
+      g_autofree gfloat *expected = NULL;
+      g_autofree gfloat *in = NULL;
+      g_autofree gfloat *out = NULL;
+      glong j;
+      gsize n;
+
+      /* One extra float, to check unaligned access. */
+      n = (gsize) n_pixels[i] * 4;
+      aux = g_new (gfloat, n + 1);
+      in = g_new (gfloat, n + 1);
+      out = g_new (gfloat, n + 1);
+      expected = g_new (gfloat, n + 1);
+
+      /* Premultiplied pixels, including fully transparent and fully
+       * opaque ones.
+       */
+      for (j = 0; j < n_pixels[i]; j++)
+        {
+          gfloat *pixel_aux = aux + 1 + 4 * j;
+          gfloat *pixel_in = in + 1 + 4 * j;
+          gfloat aA;
+          gfloat aB;
+          guint k;
+
+          aA = opaque ? 1.0f : (gfloat) g_test_rand_double_range (-0.25, 1.25);
+          aA = CLAMP (aA, 0.0f, 1.0f);
+          aB = (gfloat) g_test_rand_double_range (-0.25, 1.25);
+          aB = CLAMP (aB, 0.0f, 1.0f);
+
+          for (k = 0; k < 3; k++)
+            {
+              pixel_aux[k] = aA * (gfloat) g_test_rand_double ();
+              pixel_in[k] = aB * (gfloat) g_test_rand_double ();
+            }
+
+          pixel_aux[3] = aA;
+          pixel_in[3] = aB;
+        }
+
+      if (opaque)
+        photos_simd_multiply_opaque_scalar (in + 1, aux + 1, expected, n_pixels[i]);
+      else
+        photos_simd_multiply_scalar (in + 1, aux + 1, expected, n_pixels[i]);
+
+      (*multiply) (in + 1, aux + 1, out, n_pixels[i]);
+      g_assert_cmpmem (out, n * sizeof (gfloat), expected, n * sizeof (gfloat));
+    }
+}
+
+
+static void
+photos_test_simd_multiply (gconstpointer user_data)
+{
+  const PhotosTestSimdVariant *variant = (const PhotosTestSimdVariant *) user_data;
+
+  photos_test_simd_multiply_check (variant, FALSE);
+}
+
+
+static void
+photos_test_simd_multiply_opaque (gconstpointer user_data)
+{
+  const PhotosTestSimdVariant *variant = (const PhotosTestSimdVariant *) user_data;
+
+  photos_test_simd_multiply_check (variant, TRUE);
+}
+
+
+static void
+photos_test_simd_multiply_perf (gconstpointer user_data)
+{
+  const PhotosTestSimdVariant *variant = (const PhotosTestSimdVariant *) user_data;
+  g_autofree gfloat *aux = NULL;
+  g_autofree gfloat *buf = NULL;
+  gboolean opaque;
+  gsize i;
+
+  aux = g_new (gfloat, (gsize) PERF_N_PIXELS * 4);
+  buf = g_new (gfloat, (gsize) PERF_N_PIXELS * 4);
+
+  for (opaque = FALSE; opaque <= TRUE; opaque++)
+    {
+      PhotosSimdMultiplyFunc multiply;
+      gdouble best = G_MAXDOUBLE;
+      gdouble pixels_per_second;
+      guint j;
+
+      multiply = photos_test_simd_get_multiply_func (variant, opaque);
+      if (multiply == NULL)
+        {
+          g_test_skip ("No such kernel, or not supported by this CPU");
+          return;
+        }
+
+      for (i = 0; i < (gsize) PERF_N_PIXELS * 4; i++)
+        {
+          aux[i] = opaque && i % 4 == 3 ? 1.0f : (gfloat) (i % 251) / 250.0f;
+          buf[i] = (gfloat) (i % 241) / 240.0f;
+        }
+
+      /* The output is written over the input, like GEGL does when it
+       * can, so the values change between iterations, but stay within
+       * [0, 1].
+       */
+      for (j = 0; j < PERF_N_ITERATIONS; j++)
+        {
+          gdouble elapsed;
+
+          g_test_timer_start ();
+          (*multiply) (buf, aux, buf, PERF_N_PIXELS);
+          elapsed = g_test_timer_elapsed ();
+          best = MIN (best, elapsed);
+        }
+
+      pixels_per_second = (gdouble) PERF_N_PIXELS / best;
+      g_test_maximized_result (pixels_per_second,
+                               "%s, %s aux: %.0f pixels/s",
+                               variant->name,
+                               opaque ? "opaque" : "translucent",
+                               pixels_per_second);
+    }
+}
+
+
+static void
+photos_test_simd_scale_channels (gconstpointer user_data)
+{
+  const PhotosTestSimdVariant *variant = (const PhotosTestSimdVariant *) user_data;
+  PhotosSimdScaleChannelsFunc scale_channels;
+  const glong n_pixels[] = { 0, 1, 2, 5, 7, 8, 9, 1031 };
+  const gfloat scales[] = { 0.0f, 0.37f, 1.0f, 1.83f };
+  guint i;
+
+  scale_channels = photos_test_simd_get_scale_channels_func (variant);
+  if (scale_channels == NULL)
+    {
+      g_test_skip ("No such kernel, or not supported by this CPU");
+      return;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (n_pixels); i++)
+    {
+      guint j;
+      guint n_components;
+
+      for (n_components = 3; n_components <= 4; n_components++)
+        {
+          for (j = 0; j < G_N_ELEMENTS (scales); j++)
+            {
+              gboolean lch;
+
+              for (lch = FALSE; lch <= TRUE; lch++)
+                {
+                  g_autofree gfloat *expected = NULL;
+                  g_autofree gfloat *in = NULL;
+                  g_autofree gfloat *out = NULL;
+                  gfloat factors[4];
+                  gsize k;
+                  gsize n;
+
+                  factors[0] = 1.0f;
+                  factors[1] = scales[j];
+                  factors[2] = lch ? 1.0f : scales[j];
+                  factors[3] = 1.0f;
+
+                  /* One extra float, to check unaligned access. */
+                  n = (gsize) n_pixels[i] * n_components;
+                  in = g_new (gfloat, n + 1);
+                  out = g_new (gfloat, n + 1);
+                  expected = g_new (gfloat, n + 1);
+
+                  for (k = 0; k < n + 1; k++)
+                    in[k] = (gfloat) g_test_rand_double_range (-128.0, 128.0);
+
+                  photos_simd_scale_channels_scalar (in + 1, expected, n_pixels[i], n_components, factors);
+
+                  (*scale_channels) (in + 1, out, n_pixels[i], n_components, factors);
+                  g_assert_cmpmem (out, n * sizeof (gfloat), expected, n * sizeof (gfloat));
+
+                  (*scale_channels) (in + 1, in + 1, n_pixels[i], n_components, factors);
+                  g_assert_cmpmem (in + 1, n * sizeof (gfloat), expected, n * sizeof (gfloat));
+                }
+            }
+        }
+    }
+}
+
+
+static void
+photos_test_simd_scale_channels_perf (gconstpointer user_data)
+{
+  const PhotosTestSimdVariant *variant = (const PhotosTestSimdVariant *) user_data;
+  PhotosSimdScaleChannelsFunc scale_channels;
+  g_autofree gfloat *buf = NULL;
+  const gfloat factors[] = { 1.0f, 0.75f, 0.75f, 1.0f };
+  gsize i;
+  guint n_components;
+
+  scale_channels = photos_test_simd_get_scale_channels_func (variant);
+  if (scale_channels == NULL)
+    {
+      g_test_skip ("No such kernel, or not supported by this CPU");
+      return;
+    }
+
+  buf = g_new (gfloat, (gsize) PERF_N_PIXELS * 4);
+  for (i = 0; i < (gsize) PERF_N_PIXELS * 4; i++)
+    buf[i] = (gfloat) (i % 256) - 128.0f;
+
+  for (n_components = 3; n_components <= 4; n_components++)
+    {
+      gdouble best = G_MAXDOUBLE;
+      gdouble pixels_per_second;
+      guint j;
+
+      for (j = 0; j < PERF_N_ITERATIONS; j++)
+        {
+          gdouble elapsed;
+
+          g_test_timer_start ();
+          (*scale_channels) (buf, buf, PERF_N_PIXELS, n_components, factors);
+          elapsed = g_test_timer_elapsed ();
+          best = MIN (best, elapsed);
+        }
+
+      pixels_per_second = (gdouble) PERF_N_PIXELS / best;
+      g_test_maximized_result (pixels_per_second,
+                               "%s, %u components: %.0f pixels/s",
+                               variant->name,
+                               n_components,
+                               pixels_per_second);
+    }
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  guint i;
+
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+  photos_debug_init ();
+
+  for (i = 1; i < G_N_ELEMENTS (VARIANTS); i++)
+    {
+      g_autofree gchar *path_apply_curves = NULL;
+      g_autofree gchar *path_multiply = NULL;
+      g_autofree gchar *path_multiply_opaque = NULL;
+      g_autofree gchar *path_scale_channels = NULL;
+
+      path_apply_curves = g_strdup_printf ("/simd/apply-curves/%s", VARIANTS[i].name);
+      g_test_add_data_func (path_apply_curves, &VARIANTS[i], photos_test_simd_apply_curves);
+
+      path_multiply = g_strdup_printf ("/simd/multiply/%s", VARIANTS[i].name);
+      g_test_add_data_func (path_multiply, &VARIANTS[i], photos_test_simd_multiply);
+
+      path_multiply_opaque = g_strdup_printf ("/simd/multiply-opaque/%s", VARIANTS[i].name);
+      g_test_add_data_func (path_multiply_opaque, &VARIANTS[i], photos_test_simd_multiply_opaque);
+
+      path_scale_channels = g_strdup_printf ("/simd/scale-channels/%s", VARIANTS[i].name);
+      g_test_add_data_func (path_scale_channels, &VARIANTS[i], photos_test_simd_scale_channels);
+    }
+
+  if (g_test_perf ())
+    {
+      for (i = 0; i < G_N_ELEMENTS (VARIANTS); i++)
+        {
+          g_autofree gchar *path_apply_curves = NULL;
+          g_autofree gchar *path_multiply = NULL;
+          g_autofree gchar *path_scale_channels = NULL;
+
+          path_apply_curves = g_strdup_printf ("/simd/apply-curves/perf/%s", VARIANTS[i].name);
+          g_test_add_data_func (path_apply_curves, &VARIANTS[i], photos_test_simd_apply_curves_perf);
+
+          path_multiply = g_strdup_printf ("/simd/multiply/perf/%s", VARIANTS[i].name);
+          g_test_add_data_func (path_multiply, &VARIANTS[i], photos_test_simd_multiply_perf);
+
+          path_scale_channels = g_strdup_printf ("/simd/scale-channels/perf/%s", VARIANTS[i].name);
+          g_test_add_data_func (path_scale_channels, &VARIANTS[i], photos_test_simd_scale_channels_perf);
+        }
+    }
+
+  return g_test_run ();
+}
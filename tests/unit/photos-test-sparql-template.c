@@ -0,0 +1,250 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The real query templates are read from the source tree. When run
+ * with -m perf, the rate at which they can be rendered is measured
+ * with bindings of roughly the same size as the ones used by
+ * photos-query-builder.c.
+ */
+
+
+#include "config.h"
+
+#include <locale.h>
+#include <string.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "photos-debug.h"
+#include "photos-sparql-template.h"
+
+
+static const gchar *TEMPLATES[] =
+{
+  "photos-query-all.sparql.template",
+  "photos-query-collections.sparql.template",
+  "photos-query-favorites.sparql.template",
+  "photos-query-photos.sparql.template"
+};
+
+static const guint PERF_N_ITERATIONS = 5;
+static const guint PERF_N_RENDERS = 10000;
+
+static const gchar *PROJECTION
+  = "?urn ?file nfo:fileName (?file) AS ?filename nie:mimeType (?urn) AS ?mimetype nie:title (?urn) AS ?title "
+    "tracker:coalesce (nco:fullname (?creator), nco:fullname (?publisher), '') AS ?author "
+    "tracker:coalesce (nfo:fileLastModified (?file), nie:contentLastModified (?urn)) AS ?mtime "
+    "nao:identifier (?urn) AS ?identifier rdf:type (?urn) AS ?type nie:dataSource(?urn) AS ?datasource "
+    "( EXISTS { ?urn nco:contributor ?contributor FILTER ( ?contributor != ?creator ) } ) AS ?has_contributor "
+    "tracker:coalesce(nie:contentCreated (?urn), nfo:fileCreated (?file)) AS ?ctime "
+    "nfo:width (?urn) AS ?width nfo:height (?urn) AS ?height nfo:equipment (?urn) AS ?equipment "
+    "nfo:orientation (?urn) AS ?orientation nmm:exposureTime (?urn) AS ?exposure_time "
+    "nmm:fnumber (?urn) AS ?fnumber nmm:focalLength (?urn) AS ?focal_length nmm:isoSpeed (?urn) AS ?isospeed "
+    "nmm:flash (?urn) AS ?flash slo:location (?urn) AS ?location ";
+
+
+static gchar *
+photos_test_sparql_template_render (PhotosSparqlTemplate *sparql_template)
+{
+  gchar *sparql;
+
+  sparql = photos_sparql_template_get_sparql (sparql_template,
+                                              "blocked_mime_types_filter", "(nie:mimeType(?urn) != 'image/gif')",
+                                              "collections_filter", "(fn:starts-with (nao:identifier (?urn), 'x'))",
+                                              "item_where", "",
+                                              "miner_files_name", "org.freedesktop.Tracker3.Miner.Files",
+                                              "order", "ORDER BY DESC (?ctime) DESC (?mtime) DESC (str (?urn))",
+                                              "offset_limit", "LIMIT ~limit",
+                                              "projection", PROJECTION,
+                                              "projection_dbus", PROJECTION,
+                                              "projection_forwarded", PROJECTION,
+                                              "projection_private", PROJECTION,
+                                              "search_match_filter", "(true)",
+                                              "seek_filter", "FILTER (str (?urn) < ~urn)",
+                                              "source_filter", "(true)",
+                                              "values", "",
+                                              NULL);
+
+  return sparql;
+}
+
+
+static PhotosSparqlTemplate *
+photos_test_sparql_template_new_from_source (const gchar *filename)
+{
+  g_autoptr (GFile) file = NULL;
+  PhotosSparqlTemplate *sparql_template;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *uri = NULL;
+
+  path = g_test_build_filename (G_TEST_DIST, "..", "..", "src", filename, NULL);
+  file = g_file_new_for_path (path);
+  uri = g_file_get_uri (file);
+
+  sparql_template = photos_sparql_template_new (uri);
+  return sparql_template;
+}
+
+
+static PhotosSparqlTemplate *
+photos_test_sparql_template_new_from_text (const gchar *text, gchar **out_path)
+{
+  g_autoptr (GError) error = NULL;
+  PhotosSparqlTemplate *sparql_template;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *uri = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("photos-test-sparql-template-XXXXXX", &path, &error);
+  g_assert_no_error (error);
+  g_close (fd, NULL);
+
+  g_file_set_contents (path, text, -1, &error);
+  g_assert_no_error (error);
+
+  uri = g_filename_to_uri (path, NULL, &error);
+  g_assert_no_error (error);
+
+  sparql_template = photos_sparql_template_new (uri);
+  *out_path = g_steal_pointer (&path);
+  return sparql_template;
+}
+
+
+static void
+photos_test_sparql_template_placeholders (void)
+{
+  g_autoptr (PhotosSparqlTemplate) sparql_template = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *sparql = NULL;
+
+  sparql_template = photos_test_sparql_template_new_from_text ("SELECT {{a}} {{ b }} {{a}} {{unbound}} {{{c}} {{}}",
+                                                               &path);
+
+  sparql = photos_sparql_template_get_sparql (sparql_template, "a", "x", "b", "yy", "c", "", NULL);
+  g_assert_cmpstr (sparql, ==, "SELECT x yy x {{unbound}} { {{}}");
+
+  g_unlink (path);
+}
+
+
+static void
+photos_test_sparql_template_unbound (void)
+{
+  g_autoptr (PhotosSparqlTemplate) sparql_template = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *sparql = NULL;
+  const gchar *text = "SELECT ?urn {{projection}} WHERE { {{values}} }";
+
+  sparql_template = photos_test_sparql_template_new_from_text (text, &path);
+
+  sparql = photos_sparql_template_get_sparql (sparql_template, NULL);
+  g_assert_cmpstr (sparql, ==, text);
+
+  g_unlink (path);
+}
+
+
+static void
+photos_test_sparql_template_real (gconstpointer user_data)
+{
+  const gchar *filename = (const gchar *) user_data;
+  g_autoptr (PhotosSparqlTemplate) sparql_template = NULL;
+  g_autofree gchar *sparql = NULL;
+
+  sparql_template = photos_test_sparql_template_new_from_source (filename);
+  sparql = photos_test_sparql_template_render (sparql_template);
+
+  g_assert_nonnull (strstr (sparql, "SELECT"));
+  g_assert_nonnull (strstr (sparql, "ORDER BY DESC (?ctime) DESC (?mtime) DESC (str (?urn))"));
+  g_assert_nonnull (strstr (sparql, "FILTER (str (?urn) < ~urn)"));
+  g_assert_nonnull (strstr (sparql, "LIMIT ~limit"));
+  g_assert_null (strstr (sparql, "{{"));
+  g_assert_null (strstr (sparql, "}}"));
+}
+
+
+static void
+photos_test_sparql_template_perf (gconstpointer user_data)
+{
+  const gchar *filename = (const gchar *) user_data;
+  g_autoptr (PhotosSparqlTemplate) sparql_template = NULL;
+  gdouble best = G_MAXDOUBLE;
+  gdouble renders_per_second;
+  guint i;
+
+  sparql_template = photos_test_sparql_template_new_from_source (filename);
+
+  for (i = 0; i < PERF_N_ITERATIONS; i++)
+    {
+      gdouble elapsed;
+      guint j;
+
+      g_test_timer_start ();
+
+      for (j = 0; j < PERF_N_RENDERS; j++)
+        {
+          g_autofree gchar *sparql = NULL;
+
+          sparql = photos_test_sparql_template_render (sparql_template);
+        }
+
+      elapsed = g_test_timer_elapsed ();
+      best = MIN (best, elapsed);
+    }
+
+  renders_per_second = (gdouble) PERF_N_RENDERS / best;
+  g_test_maximized_result (renders_per_second, "%s: %.0f renders/s", filename, renders_per_second);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  guint i;
+
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+  photos_debug_init ();
+
+  g_test_add_func ("/sparql-template/placeholders", photos_test_sparql_template_placeholders);
+  g_test_add_func ("/sparql-template/unbound", photos_test_sparql_template_unbound);
+
+  for (i = 0; i < G_N_ELEMENTS (TEMPLATES); i++)
+    {
+      g_autofree gchar *path = NULL;
+
+      path = g_strdup_printf ("/sparql-template/real/%s", TEMPLATES[i]);
+      g_test_add_data_func (path, TEMPLATES[i], photos_test_sparql_template_real);
+    }
+
+  if (g_test_perf ())
+    {
+      for (i = 0; i < G_N_ELEMENTS (TEMPLATES); i++)
+        {
+          g_autofree gchar *path = NULL;
+
+          path = g_strdup_printf ("/sparql-template/perf/%s", TEMPLATES[i]);
+          g_test_add_data_func (path, TEMPLATES[i], photos_test_sparql_template_perf);
+        }
+    }
+
+  return g_test_run ();
+}
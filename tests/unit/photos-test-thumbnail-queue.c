@@ -0,0 +1,279 @@
+/*
+ * Photos - access, organize and share your photos on GNOME
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "photos-debug.h"
+#include "photos-thumbnail-queue.h"
+
+
+typedef struct _PhotosTestThumbnailQueueFixture PhotosTestThumbnailQueueFixture;
+
+struct _PhotosTestThumbnailQueueFixture
+{
+  GObject *items[3];
+  PhotosThumbnailQueue *queue;
+};
+
+
+static void
+photos_test_thumbnail_queue_complete (GTask *task)
+{
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+
+static void
+photos_test_thumbnail_queue_setup (PhotosTestThumbnailQueueFixture *fixture, gconstpointer user_data)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (fixture->items); i++)
+    fixture->items[i] = g_object_new (G_TYPE_OBJECT, NULL);
+
+  fixture->queue = photos_thumbnail_queue_new ();
+}
+
+
+static void
+photos_test_thumbnail_queue_teardown (PhotosTestThumbnailQueueFixture *fixture, gconstpointer user_data)
+{
+  GTask *task;
+  guint i;
+
+  while ((task = photos_thumbnail_queue_pop (fixture->queue)) != NULL)
+    photos_test_thumbnail_queue_complete (task);
+
+  g_clear_pointer (&fixture->queue, photos_thumbnail_queue_free);
+
+  for (i = 0; i < G_N_ELEMENTS (fixture->items); i++)
+    g_clear_object (&fixture->items[i]);
+}
+
+
+static void
+photos_test_thumbnail_queue_order (PhotosTestThumbnailQueueFixture *fixture, gconstpointer user_data)
+{
+  GTask *task;
+
+  task = photos_thumbnail_queue_push (fixture->queue,
+                                      g_task_new (fixture->items[0], NULL, NULL, NULL),
+                                      PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE);
+  g_assert_null (task);
+
+  task = photos_thumbnail_queue_push (fixture->queue,
+                                      g_task_new (fixture->items[1], NULL, NULL, NULL),
+                                      PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL);
+  g_assert_null (task);
+
+  task = photos_thumbnail_queue_push (fixture->queue,
+                                      g_task_new (fixture->items[2], NULL, NULL, NULL),
+                                      PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL);
+  g_assert_null (task);
+
+  task = photos_thumbnail_queue_pop (fixture->queue);
+  g_assert_true (g_task_get_source_object (task) == fixture->items[1]);
+  photos_test_thumbnail_queue_complete (task);
+
+  task = photos_thumbnail_queue_pop (fixture->queue);
+  g_assert_true (g_task_get_source_object (task) == fixture->items[2]);
+  photos_test_thumbnail_queue_complete (task);
+
+  task = photos_thumbnail_queue_pop (fixture->queue);
+  g_assert_true (g_task_get_source_object (task) == fixture->items[0]);
+  photos_test_thumbnail_queue_complete (task);
+
+  g_assert_null (photos_thumbnail_queue_pop (fixture->queue));
+}
+
+
+static void
+photos_test_thumbnail_queue_pop_n (PhotosTestThumbnailQueueFixture *fixture, gconstpointer user_data)
+{
+  GTask *tasks[G_N_ELEMENTS (fixture->items)];
+  guint i;
+  guint n_tasks;
+
+  photos_thumbnail_queue_push (fixture->queue,
+                               g_task_new (fixture->items[0], NULL, NULL, NULL),
+                               PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL);
+  photos_thumbnail_queue_push (fixture->queue,
+                               g_task_new (fixture->items[1], NULL, NULL, NULL),
+                               PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE);
+  photos_thumbnail_queue_push (fixture->queue,
+                               g_task_new (fixture->items[2], NULL, NULL, NULL),
+                               PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL);
+
+  /* Only jobs of the requested priority are taken, in order. */
+  n_tasks = photos_thumbnail_queue_pop_n (fixture->queue,
+                                          PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL,
+                                          tasks,
+                                          G_N_ELEMENTS (tasks));
+  g_assert_cmpuint (n_tasks, ==, 2);
+  g_assert_true (g_task_get_source_object (tasks[0]) == fixture->items[0]);
+  g_assert_true (g_task_get_source_object (tasks[1]) == fixture->items[2]);
+
+  for (i = 0; i < n_tasks; i++)
+    photos_test_thumbnail_queue_complete (tasks[i]);
+
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL), ==, 0);
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE),
+                    ==,
+                    1);
+
+  /* The items are no longer queued, so they can be queued again. */
+  g_assert_null (photos_thumbnail_queue_push (fixture->queue,
+                                              g_task_new (fixture->items[0], NULL, NULL, NULL),
+                                              PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL));
+}
+
+
+static void
+photos_test_thumbnail_queue_promote (PhotosTestThumbnailQueueFixture *fixture, gconstpointer user_data)
+{
+  GTask *task;
+  gboolean promoted;
+
+  photos_thumbnail_queue_push (fixture->queue,
+                               g_task_new (fixture->items[0], NULL, NULL, NULL),
+                               PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL);
+  photos_thumbnail_queue_push (fixture->queue,
+                               g_task_new (fixture->items[1], NULL, NULL, NULL),
+                               PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL);
+
+  promoted = photos_thumbnail_queue_promote (fixture->queue, fixture->items[1]);
+  g_assert_true (promoted);
+
+  promoted = photos_thumbnail_queue_promote (fixture->queue, fixture->items[2]);
+  g_assert_false (promoted);
+
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE),
+                    ==,
+                    1);
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL), ==, 1);
+
+  photos_thumbnail_queue_demote_all (fixture->queue);
+
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE),
+                    ==,
+                    0);
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_LOCAL), ==, 2);
+
+  /* Demoted jobs go back to the head of their usual queue. */
+  task = photos_thumbnail_queue_pop (fixture->queue);
+  g_assert_true (g_task_get_source_object (task) == fixture->items[1]);
+  photos_test_thumbnail_queue_complete (task);
+}
+
+
+static void
+photos_test_thumbnail_queue_push_twice (PhotosTestThumbnailQueueFixture *fixture, gconstpointer user_data)
+{
+  GTask *first_task;
+  GTask *second_task;
+  GTask *superseded_task;
+  GTask *task;
+
+  first_task = g_task_new (fixture->items[0], NULL, NULL, NULL);
+  superseded_task = photos_thumbnail_queue_push (fixture->queue,
+                                                 g_object_ref (first_task),
+                                                 PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE);
+  g_assert_null (superseded_task);
+
+  photos_thumbnail_queue_push (fixture->queue,
+                               g_task_new (fixture->items[1], NULL, NULL, NULL),
+                               PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE);
+
+  photos_thumbnail_queue_promote (fixture->queue, fixture->items[0]);
+
+  /* Queueing the same item again must not add a second job, and the new
+   * task keeps the position of the old one.
+   */
+  second_task = g_task_new (fixture->items[0], NULL, NULL, NULL);
+  superseded_task = photos_thumbnail_queue_push (fixture->queue,
+                                                 g_object_ref (second_task),
+                                                 PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE);
+  g_assert_true (superseded_task == first_task);
+  photos_test_thumbnail_queue_complete (superseded_task);
+
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_VISIBLE),
+                    ==,
+                    1);
+  g_assert_cmpuint (photos_thumbnail_queue_get_length (fixture->queue, PHOTOS_THUMBNAIL_QUEUE_PRIORITY_REMOTE),
+                    ==,
+                    1);
+
+  task = photos_thumbnail_queue_pop (fixture->queue);
+  g_assert_true (task == second_task);
+  photos_test_thumbnail_queue_complete (task);
+
+  task = photos_thumbnail_queue_pop (fixture->queue);
+  g_assert_true (g_task_get_source_object (task) == fixture->items[1]);
+  photos_test_thumbnail_queue_complete (task);
+
+  g_assert_null (photos_thumbnail_queue_pop (fixture->queue));
+
+  g_object_unref (first_task);
+  g_object_unref (second_task);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+  photos_debug_init ();
+
+  g_test_add ("/thumbnail-queue/order",
+              PhotosTestThumbnailQueueFixture,
+              NULL,
+              photos_test_thumbnail_queue_setup,
+              photos_test_thumbnail_queue_order,
+              photos_test_thumbnail_queue_teardown);
+
+  g_test_add ("/thumbnail-queue/pop-n",
+              PhotosTestThumbnailQueueFixture,
+              NULL,
+              photos_test_thumbnail_queue_setup,
+              photos_test_thumbnail_queue_pop_n,
+              photos_test_thumbnail_queue_teardown);
+
+  g_test_add ("/thumbnail-queue/promote",
+              PhotosTestThumbnailQueueFixture,
+              NULL,
+              photos_test_thumbnail_queue_setup,
+              photos_test_thumbnail_queue_promote,
+              photos_test_thumbnail_queue_teardown);
+
+  g_test_add ("/thumbnail-queue/push-twice",
+              PhotosTestThumbnailQueueFixture,
+              NULL,
+              photos_test_thumbnail_queue_setup,
+              photos_test_thumbnail_queue_push_twice,
+              photos_test_thumbnail_queue_teardown);
+
+  return g_test_run ();
+}